@@ -0,0 +1,779 @@
+/**
+microbenchmarks of the hot cpu kernels, without a window or gl: the n-body step, the grid
+mesh, the math helpers, the geodesic integrators and libblackhole's batch query. every kernel is warmed up, then timed
+over repetitions of a calibrated number of iterations; the median and the median absolute
+deviation (mad) per iteration are printed and can be written as json. --compare diffs two
+such files and fails when a kernel got slower than the threshold and its noise.
+
+usage: bench [--filter TEXT] [--repetitions N] [--min-time S] [--warmup S] [--json FILE]
+       bench --compare BASE.json NEW.json [--threshold F]
+**/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "blackhole.h"
+#include "geodesic.h"
+#include "grid_mesh.h"
+#include "math_utils.h"
+#include "simulation.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MAX_REPETITIONS 101
+#define BENCH_MAX_RESULTS 128
+#define BENCH_NAME_LENGTH 64
+#define BENCH_MATH_BATCH 1024   // values per math iteration
+#define BENCH_GEODESIC_STEPS 256 // steps per geodesic iteration
+#define BENCH_GEODESIC_RAYS 16   // rays per trace iteration
+#define BENCH_LIBRARY_RAYS 256   // rays per libblackhole batch
+
+typedef void (*bench_kernel_t)(void *state, long iterations);
+
+typedef struct
+{
+    char name[BENCH_NAME_LENGTH];
+    double median_ns; // per iteration
+    double mad_ns;
+    int repetitions;
+    long iterations; // per repetition
+} bench_result_t;
+
+typedef struct
+{
+    const char *filter;
+    int repetitions;
+    double min_time; // seconds per repetition
+    double warmup;   // seconds before the first repetition
+    bench_result_t results[BENCH_MAX_RESULTS];
+    int result_count;
+} bench_runner_t;
+
+// results feed this so the compiler can't drop the work
+static volatile float bench_sink;
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static float bench_random(unsigned int *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (float)(*state >> 8) / 16777216.0f;
+}
+
+static int bench_compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double bench_median(double *values, int count)
+{
+    qsort(values, count, sizeof(double), bench_compare_doubles);
+    return count % 2 ? values[count / 2] : 0.5 * (values[count / 2 - 1] + values[count / 2]);
+}
+
+static double bench_run_for(bench_kernel_t kernel, void *state, long iterations)
+{
+    double start = bench_now();
+    kernel(state, iterations);
+    return bench_now() - start;
+}
+
+static void bench_measure(bench_runner_t *runner, const char *name, bench_kernel_t kernel, void *state)
+{
+    if (runner->filter && !strstr(name, runner->filter))
+        return;
+    if (runner->result_count == BENCH_MAX_RESULTS)
+    {
+        printf("Failed to record %s: more than %d benchmarks\n", name, BENCH_MAX_RESULTS);
+        return;
+    }
+
+    // warm-up (caches, branch predictors, page faults, cpu clock), doubling the iterations
+    // until one call lasts min_time, which also calibrates the repetitions
+    long iterations = 1;
+    double warm_start = bench_now();
+    for (;;)
+    {
+        double elapsed = bench_run_for(kernel, state, iterations);
+        if (elapsed >= runner->min_time && bench_now() - warm_start >= runner->warmup)
+            break;
+        if (elapsed < runner->min_time)
+            iterations *= 2;
+    }
+
+    double samples[BENCH_MAX_REPETITIONS];
+    for (int r = 0; r < runner->repetitions; ++r)
+        samples[r] = 1e9 * bench_run_for(kernel, state, iterations) / (double)iterations;
+    double median = bench_median(samples, runner->repetitions);
+    for (int r = 0; r < runner->repetitions; ++r)
+        samples[r] = fabs(samples[r] - median);
+    double mad = bench_median(samples, runner->repetitions);
+
+    bench_result_t *result = &runner->results[runner->result_count++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->median_ns = median;
+    result->mad_ns = mad;
+    result->repetitions = runner->repetitions;
+    result->iterations = iterations;
+    printf("%-36s %14.1f %10.1f %6.2f%% %10ld\n", name, median, mad, median > 0.0 ? 100.0 * mad / median : 0.0,
+           iterations);
+    fflush(stdout);
+}
+
+// ------------------------------
+// kernels
+// ------------------------------
+
+typedef struct
+{
+    celestial_body_t *initial;
+    celestial_body_t *next;
+    int count;
+    collision_broadphase_t broadphase;
+} bench_simulation_t;
+
+// every iteration steps the same initial state, so the work doesn't drift with merges
+static void bench_simulation_kernel(void *state, long iterations)
+{
+    bench_simulation_t *s = state;
+    for (long i = 0; i < iterations; ++i)
+        simulation_step_buffered(s->initial, s->next, s->count, 500.0 / 60.0, COLLISION_MERGE, &s->broadphase);
+    bench_sink = s->next[0].position_and_radius.x;
+}
+
+// the app's three bodies, then a disk of stars around them
+static void bench_make_bodies(celestial_body_t *bodies, int count)
+{
+    unsigned int random = 99u;
+    for (int i = 0; i < count; ++i)
+    {
+        if (i < SIMULATION_INITIAL_BODY_COUNT)
+        {
+            bodies[i] = simulation_initial_bodies[i];
+            continue;
+        }
+        float angle = 2.0f * (float)M_PI * bench_random(&random);
+        float radius = 3e11f + 3e12f * bench_random(&random);
+        bodies[i] = (celestial_body_t){
+            .position_and_radius = {radius * cosf(angle), 1e10f * (bench_random(&random) - 0.5f), radius * sinf(angle), 1e9f},
+            .color = {1, 1, 1, 1},
+            .mass = 1e29f,
+            .velocity = {-sinf(angle) * 5e6f, 0.0f, cosf(angle) * 5e6f},
+        };
+    }
+}
+
+typedef struct
+{
+    celestial_body_t bodies[3];
+    int grid_size;
+    vector3_t *vertices;
+    unsigned int *indices;
+} bench_grid_t;
+
+static void bench_grid_vertices_kernel(void *state, long iterations)
+{
+    bench_grid_t *g = state;
+    for (long i = 0; i < iterations; ++i)
+        grid_mesh_compute_vertices(g->bodies, 3, g->grid_size, GRID_MESH_DEFAULT_SPACING * GRID_MESH_DEFAULT_SIZE / g->grid_size,
+                                   g->vertices);
+    bench_sink = g->vertices[0].y;
+}
+
+// many bodies: the exact sum against the field approximation, same bodies and grid
+typedef struct
+{
+    celestial_body_t *bodies;
+    int body_count;
+    int grid_size;
+    vector3_t *vertices;
+    grid_mesh_field_t field;
+} bench_grid_field_t;
+
+static void bench_grid_exact_kernel(void *state, long iterations)
+{
+    bench_grid_field_t *g = state;
+    for (long i = 0; i < iterations; ++i)
+        grid_mesh_compute_vertices(g->bodies, g->body_count, g->grid_size,
+                                   GRID_MESH_DEFAULT_SPACING * GRID_MESH_DEFAULT_SIZE / g->grid_size, g->vertices);
+    bench_sink = g->vertices[0].y;
+}
+
+static void bench_grid_field_kernel(void *state, long iterations)
+{
+    bench_grid_field_t *g = state;
+    for (long i = 0; i < iterations; ++i)
+        grid_mesh_compute_vertices_field(&g->field, g->bodies, g->body_count, g->grid_size,
+                                         GRID_MESH_DEFAULT_SPACING * GRID_MESH_DEFAULT_SIZE / g->grid_size,
+                                         GRID_MESH_DEFAULT_RELATIVE_ERROR, g->vertices);
+    bench_sink = g->vertices[0].y;
+}
+
+// largest dip error of the field against the exact sum, relative to the exact dip
+static double bench_grid_field_error(bench_grid_field_t *g, vector3_t *exact)
+{
+    float spacing = GRID_MESH_DEFAULT_SPACING * GRID_MESH_DEFAULT_SIZE / g->grid_size;
+    grid_mesh_compute_vertices(g->bodies, g->body_count, g->grid_size, spacing, exact);
+    grid_mesh_compute_vertices_field(&g->field, g->bodies, g->body_count, g->grid_size, spacing,
+                                     GRID_MESH_DEFAULT_RELATIVE_ERROR, g->vertices);
+    double error = 0.0;
+    for (int i = 0; i < GRID_MESH_VERTEX_COUNT(g->grid_size); ++i)
+    {
+        double dip = (double)exact[i].y - GRID_MESH_FLAT_HEIGHT;
+        if (dip > 0.0)
+            error = fmax(error, fabs((double)g->vertices[i].y - exact[i].y) / dip);
+    }
+    return error;
+}
+
+static void bench_grid_indices_kernel(void *state, long iterations)
+{
+    bench_grid_t *g = state;
+    for (long i = 0; i < iterations; ++i)
+        grid_mesh_compute_indices(g->grid_size, g->indices);
+    bench_sink = (float)g->indices[1];
+}
+
+typedef struct
+{
+    float *x, *y, *z, *ox, *oy, *oz, *positive, *angles, *sines, *cosines;
+    matrix4_t matrix;
+} bench_math_t;
+
+static void bench_normalize_scalar_kernel(void *state, long iterations)
+{
+    bench_math_t *m = state;
+    for (long it = 0; it < iterations; ++it)
+    {
+        for (int i = 0; i < BENCH_MATH_BATCH; ++i)
+        {
+            vector3_t v = vector3_normalize((vector3_t){m->x[i], m->y[i], m->z[i]});
+            m->ox[i] = v.x;
+        }
+    }
+    bench_sink = m->ox[0];
+}
+
+static void bench_cross_kernel(void *state, long iterations)
+{
+    bench_math_t *m = state;
+    for (long it = 0; it < iterations; ++it)
+    {
+        for (int i = 0; i < BENCH_MATH_BATCH; ++i)
+        {
+            vector3_t v = vector3_cross((vector3_t){m->x[i], m->y[i], m->z[i]}, (vector3_t){m->z[i], m->x[i], m->y[i]});
+            m->ox[i] = v.x + v.y + v.z;
+        }
+    }
+    bench_sink = m->ox[0];
+}
+
+static void bench_matrix_multiply_kernel(void *state, long iterations)
+{
+    bench_math_t *m = state;
+    matrix4_t product = m->matrix;
+    for (long it = 0; it < iterations; ++it)
+    {
+        for (int i = 0; i < BENCH_MATH_BATCH; ++i)
+            product = matrix4_multiply(m->matrix, product);
+        product.elements[15] = 1.0f; // keep the values finite
+    }
+    bench_sink = product.elements[0];
+}
+
+static void bench_look_at_kernel(void *state, long iterations)
+{
+    bench_math_t *m = state;
+    float sum = 0.0f;
+    for (long it = 0; it < iterations; ++it)
+    {
+        for (int i = 0; i < BENCH_MATH_BATCH; ++i)
+        {
+            matrix4_t view = matrix4_look_at((vector3_t){m->x[i], m->y[i], 5.0f + m->z[i]}, (vector3_t){0, 0, 0}, (vector3_t){0, 1, 0});
+            sum += view.elements[14];
+        }
+    }
+    bench_sink = sum;
+}
+
+static void bench_batch_transform_kernel(void *state, long iterations)
+{
+    bench_math_t *m = state;
+    for (long it = 0; it < iterations; ++it)
+        vector3_batch_transform_points(&m->matrix, (vector3_soa_t){m->x, m->y, m->z}, (vector3_soa_t){m->ox, m->oy, m->oz},
+                                       BENCH_MATH_BATCH);
+    bench_sink = m->ox[0];
+}
+
+static void bench_batch_normalize_kernel(void *state, long iterations)
+{
+    bench_math_t *m = state;
+    for (long it = 0; it < iterations; ++it)
+        vector3_batch_normalize((vector3_soa_t){m->x, m->y, m->z}, (vector3_soa_t){m->ox, m->oy, m->oz}, BENCH_MATH_BATCH);
+    bench_sink = m->ox[0];
+}
+
+static void bench_batch_sqrt_kernel(void *state, long iterations)
+{
+    bench_math_t *m = state;
+    for (long it = 0; it < iterations; ++it)
+        math_batch_sqrt(m->positive, m->sines, BENCH_MATH_BATCH);
+    bench_sink = m->sines[0];
+}
+
+static void bench_batch_rsqrt_kernel(void *state, long iterations)
+{
+    bench_math_t *m = state;
+    for (long it = 0; it < iterations; ++it)
+        math_batch_rsqrt(m->positive, m->sines, BENCH_MATH_BATCH);
+    bench_sink = m->sines[0];
+}
+
+static void bench_batch_sincos_kernel(void *state, long iterations)
+{
+    bench_math_t *m = state;
+    for (long it = 0; it < iterations; ++it)
+        math_batch_sincos(m->angles, m->sines, m->cosines, BENCH_MATH_BATCH);
+    bench_sink = m->sines[0] + m->cosines[0];
+}
+
+static bool bench_math_init(bench_math_t *m)
+{
+    float **arrays[] = {&m->x, &m->y, &m->z, &m->ox, &m->oy, &m->oz, &m->positive, &m->angles, &m->sines, &m->cosines};
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i)
+    {
+        *arrays[i] = math_aligned_alloc(sizeof(float) * BENCH_MATH_BATCH);
+        ok = ok && *arrays[i];
+    }
+    if (!ok)
+        return false;
+
+    unsigned int random = 7u;
+    for (int i = 0; i < BENCH_MATH_BATCH; ++i)
+    {
+        m->x[i] = 2.0f * bench_random(&random) - 1.0f;
+        m->y[i] = 2.0f * bench_random(&random) - 1.0f;
+        m->z[i] = 2.0f * bench_random(&random) - 1.0f;
+        m->positive[i] = 1e-3f + 1e3f * bench_random(&random);
+        m->angles[i] = 100.0f * (2.0f * bench_random(&random) - 1.0f);
+    }
+    m->matrix = matrix4_look_at((vector3_t){3, 4, 5}, (vector3_t){0, 0, 0}, (vector3_t){0, 1, 0});
+    return true;
+}
+
+static void bench_math_free(bench_math_t *m)
+{
+    float *arrays[] = {m->x, m->y, m->z, m->ox, m->oy, m->oz, m->positive, m->angles, m->sines, m->cosines};
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i)
+        math_aligned_free(arrays[i]);
+}
+
+typedef struct
+{
+    geodesic_scene_t scene;
+    raytracer_integrator_t integrator;
+    vector3_t origin;
+    vector3_t directions[BENCH_GEODESIC_RAYS];
+} bench_geodesic_t;
+
+// BENCH_GEODESIC_STEPS steps of one photon passing the hole, restarted every iteration
+static void bench_geodesic_step_kernel(void *state, long iterations)
+{
+    bench_geodesic_t *g = state;
+    float rs = g->scene.schwarzschild_radius;
+    geodesic_ray_t ray;
+    for (long it = 0; it < iterations; ++it)
+    {
+        geodesic_init(&ray, g->integrator, g->origin, g->directions[it % BENCH_GEODESIC_RAYS], rs);
+        for (int s = 0; s < BENCH_GEODESIC_STEPS; ++s)
+        {
+            if (g->integrator == RAYTRACER_INTEGRATOR_CARTESIAN)
+                geodesic_step_cartesian(&ray, rs, 5e7f);
+            else
+                geodesic_step_spherical(&ray, rs, 5e7f);
+        }
+    }
+    bench_sink = ray.r;
+}
+
+// whole rays as the shader traces them (disk, bodies, horizon, escape)
+static void bench_geodesic_trace_kernel(void *state, long iterations)
+{
+    bench_geodesic_t *g = state;
+    geodesic_hit_t hit = {0};
+    for (long it = 0; it < iterations; ++it)
+    {
+        for (int i = 0; i < BENCH_GEODESIC_RAYS; ++i)
+            geodesic_trace(&g->scene, g->integrator, 26000, 5e7f, g->origin, g->directions[i], &hit);
+    }
+    bench_sink = (float)hit.steps;
+}
+
+static void bench_geodesic_init(bench_geodesic_t *g, raytracer_integrator_t integrator)
+{
+    float rs = SIMULATION_SCHWARZSCHILD_RADIUS;
+    *g = (bench_geodesic_t){
+        .scene = {
+            .schwarzschild_radius = rs,
+            .disk_r1 = rs * 2.2f,
+            .disk_r2 = rs * 5.2f,
+            .body_count = SIMULATION_INITIAL_BODY_COUNT,
+        },
+        .integrator = integrator,
+        .origin = {0.0f, 5e10f, 6e11f},
+    };
+    for (int i = 0; i < SIMULATION_INITIAL_BODY_COUNT; ++i)
+        g->scene.body_pos_radius[i] = simulation_initial_bodies[i].position_and_radius;
+    // a fan of rays around the direction to the hole, some captured, some deflected
+    vector3_t forward = vector3_normalize(vector3_scale(g->origin, -1.0f));
+    for (int i = 0; i < BENCH_GEODESIC_RAYS; ++i)
+    {
+        float u = ((i % 4) - 1.5f) * 0.08f, v = ((i / 4) - 1.5f) * 0.08f;
+        g->directions[i] = vector3_normalize(vector3_add(forward, (vector3_t){u, v, 0.0f}));
+    }
+}
+
+typedef struct
+{
+    blackhole_context_t *context;
+    float *arrays[6 + 4];
+    uint8_t hit[BENCH_LIBRARY_RAYS];
+    int32_t steps[BENCH_LIBRARY_RAYS];
+    blackhole_rays_t rays;
+    blackhole_results_t results;
+} bench_library_t;
+
+// one batch of BENCH_LIBRARY_RAYS rays per iteration on the context's threads
+static void bench_library_kernel(void *state, long iterations)
+{
+    bench_library_t *l = state;
+    for (long it = 0; it < iterations; ++it)
+        blackhole_trace_rays(l->context, &l->rays, &l->results, BENCH_LIBRARY_RAYS);
+    bench_sink = (float)l->steps[0];
+}
+
+// the app's scene and a 16x16 fan of rays from bench_geodesic_init's origin
+static bool bench_library_init(bench_library_t *l, int thread_count)
+{
+    blackhole_config_t config = blackhole_default_config();
+    config.thread_count = thread_count;
+    l->context = blackhole_create(&config);
+    bool ok = l->context != NULL;
+    for (int i = 0; i < 10; ++i)
+    {
+        l->arrays[i] = math_aligned_alloc(sizeof(float) * BENCH_LIBRARY_RAYS);
+        ok = ok && l->arrays[i];
+    }
+    if (!ok)
+        return false;
+
+    vector3_t origin = {0.0f, 5e10f, 6e11f};
+    vector3_t forward = vector3_normalize(vector3_scale(origin, -1.0f));
+    for (int i = 0; i < BENCH_LIBRARY_RAYS; ++i)
+    {
+        float u = ((i % 16) - 7.5f) * 0.04f, v = ((i / 16) - 7.5f) * 0.04f;
+        l->arrays[0][i] = origin.x;
+        l->arrays[1][i] = origin.y;
+        l->arrays[2][i] = origin.z;
+        l->arrays[3][i] = forward.x + u;
+        l->arrays[4][i] = forward.y + v;
+        l->arrays[5][i] = forward.z;
+    }
+    l->rays = (blackhole_rays_t){l->arrays[0], l->arrays[1], l->arrays[2], l->arrays[3], l->arrays[4], l->arrays[5]};
+    l->results = (blackhole_results_t){l->hit, l->arrays[6], l->arrays[7], l->arrays[8], l->arrays[9], l->steps};
+    return true;
+}
+
+static void bench_library_free(bench_library_t *l)
+{
+    blackhole_destroy(l->context);
+    for (int i = 0; i < 10; ++i)
+        math_aligned_free(l->arrays[i]);
+}
+
+// ------------------------------
+// json and comparison
+// ------------------------------
+
+static bool bench_write_json(const bench_runner_t *runner, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        printf("Failed to open %s for writing\n", path);
+        return false;
+    }
+    fprintf(file, "{\n  \"simd\": \"%s\",\n  \"benchmarks\": [\n", math_simd_level_name(math_simd_level()));
+    // one benchmark per line, which is what bench_read_json expects
+    for (int i = 0; i < runner->result_count; ++i)
+    {
+        const bench_result_t *r = &runner->results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"median_ns\": %.3f, \"mad_ns\": %.3f, \"repetitions\": %d, \"iterations\": %ld}%s\n",
+                r->name, r->median_ns, r->mad_ns, r->repetitions, r->iterations, i + 1 < runner->result_count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    bool ok = fclose(file) == 0;
+    if (!ok)
+        printf("Failed to write %s\n", path);
+    return ok;
+}
+
+static int bench_read_json(const char *path, bench_result_t *results, int capacity)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        printf("Failed to open %s\n", path);
+        return -1;
+    }
+    int count = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), file) && count < capacity)
+    {
+        bench_result_t *r = &results[count];
+        if (sscanf(line, " {\"name\": \"%63[^\"]\", \"median_ns\": %lf, \"mad_ns\": %lf, \"repetitions\": %d, \"iterations\": %ld",
+                   r->name, &r->median_ns, &r->mad_ns, &r->repetitions, &r->iterations) == 5)
+            ++count;
+    }
+    fclose(file);
+    return count;
+}
+
+// a kernel regressed when its median grew by more than threshold (relative) and by more
+// than three times the combined mad, so noisy kernels don't fail on jitter alone
+static int bench_compare(const char *base_path, const char *new_path, double threshold)
+{
+    static bench_result_t base[BENCH_MAX_RESULTS], current[BENCH_MAX_RESULTS];
+    int base_count = bench_read_json(base_path, base, BENCH_MAX_RESULTS);
+    int current_count = bench_read_json(new_path, current, BENCH_MAX_RESULTS);
+    if (base_count < 0 || current_count < 0)
+        return 2;
+
+    int regressions = 0;
+    printf("%-36s %12s %12s %9s\n", "benchmark", "base ns", "new ns", "change");
+    for (int i = 0; i < current_count; ++i)
+    {
+        const bench_result_t *c = &current[i];
+        const bench_result_t *b = NULL;
+        for (int j = 0; j < base_count && !b; ++j)
+            b = strcmp(base[j].name, c->name) == 0 ? &base[j] : NULL;
+        if (!b)
+        {
+            printf("%-36s %12s %12.1f %9s\n", c->name, "-", c->median_ns, "new");
+            continue;
+        }
+        double change = b->median_ns > 0.0 ? c->median_ns / b->median_ns - 1.0 : 0.0;
+        double noise = 3.0 * (b->mad_ns + c->mad_ns);
+        bool regressed = change > threshold && c->median_ns - b->median_ns > noise;
+        bool improved = change < -threshold && b->median_ns - c->median_ns > noise;
+        regressions += regressed;
+        printf("%-36s %12.1f %12.1f %+8.1f%% %s\n", c->name, b->median_ns, c->median_ns, 100.0 * change,
+               regressed ? "REGRESSION" : improved ? "faster" : "");
+    }
+    for (int j = 0; j < base_count; ++j)
+    {
+        bool found = false;
+        for (int i = 0; i < current_count && !found; ++i)
+            found = strcmp(base[j].name, current[i].name) == 0;
+        if (!found)
+            printf("%-36s %12.1f %12s %9s\n", base[j].name, base[j].median_ns, "-", "removed");
+    }
+    printf("%d regression%s beyond %.1f%%\n", regressions, regressions == 1 ? "" : "s", 100.0 * threshold);
+    return regressions ? 1 : 0;
+}
+
+// ------------------------------
+// main
+// ------------------------------
+
+static void bench_usage(const char *program)
+{
+    printf("usage: %s [--filter TEXT] [--repetitions N] [--min-time S] [--warmup S] [--json FILE]\n", program);
+    printf("       %s --compare BASE.json NEW.json [--threshold F]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    bench_runner_t *runner = calloc(1, sizeof(bench_runner_t));
+    if (!runner)
+    {
+        printf("Failed to allocate the benchmark runner\n");
+        return 1;
+    }
+    runner->repetitions = 15;
+    runner->min_time = 0.01;
+    runner->warmup = 0.05;
+    const char *json_path = NULL, *compare_base = NULL, *compare_new = NULL;
+    double threshold = 0.10;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            runner->filter = argv[++i];
+        else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+            runner->repetitions = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+            runner->min_time = atof(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            runner->warmup = atof(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            json_path = argv[++i];
+        else if (strcmp(argv[i], "--compare") == 0 && i + 2 < argc)
+        {
+            compare_base = argv[++i];
+            compare_new = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else
+        {
+            bench_usage(argv[0]);
+            free(runner);
+            return 1;
+        }
+    }
+    if (compare_base)
+    {
+        free(runner);
+        return bench_compare(compare_base, compare_new, threshold);
+    }
+    if (runner->repetitions < 1 || runner->repetitions > BENCH_MAX_REPETITIONS || runner->min_time <= 0.0)
+    {
+        printf("Failed: repetitions must be 1..%d and min-time positive\n", BENCH_MAX_REPETITIONS);
+        free(runner);
+        return 1;
+    }
+
+    printf("--- Kernel benchmarks (%d repetitions of >= %.0f ms, simd %s) ---\n", runner->repetitions,
+           1e3 * runner->min_time, math_simd_level_name(math_simd_level()));
+    printf("%-36s %14s %10s %7s %10s\n", "benchmark", "median ns", "mad ns", "mad", "iterations");
+
+    // n-body step: o(n^2) gravity plus the broadphase
+    const int body_counts[] = {3, 16, 64, 256, 1024};
+    for (size_t c = 0; c < sizeof(body_counts) / sizeof(body_counts[0]); ++c)
+    {
+        bench_simulation_t simulation = {.count = body_counts[c]};
+        simulation.initial = malloc(sizeof(celestial_body_t) * simulation.count);
+        simulation.next = malloc(sizeof(celestial_body_t) * simulation.count);
+        if (simulation.initial && simulation.next)
+        {
+            char name[BENCH_NAME_LENGTH];
+            bench_make_bodies(simulation.initial, simulation.count);
+            snprintf(name, sizeof(name), "simulation_step/n=%d", simulation.count);
+            bench_measure(runner, name, bench_simulation_kernel, &simulation);
+        }
+        free(simulation.initial);
+        free(simulation.next);
+        collision_destroy(&simulation.broadphase);
+    }
+
+    // grid mesh at several resolutions over the same extent
+    const int grid_sizes[] = {25, GRID_MESH_DEFAULT_SIZE, 100, 200};
+    for (size_t g = 0; g < sizeof(grid_sizes) / sizeof(grid_sizes[0]); ++g)
+    {
+        bench_grid_t grid = {.grid_size = grid_sizes[g]};
+        bench_make_bodies(grid.bodies, 3);
+        grid.vertices = malloc(sizeof(vector3_t) * GRID_MESH_VERTEX_COUNT(grid.grid_size));
+        grid.indices = malloc(sizeof(unsigned int) * GRID_MESH_INDEX_COUNT(grid.grid_size));
+        if (grid.vertices && grid.indices)
+        {
+            char name[BENCH_NAME_LENGTH];
+            snprintf(name, sizeof(name), "grid_vertices/size=%d", grid.grid_size);
+            bench_measure(runner, name, bench_grid_vertices_kernel, &grid);
+            snprintf(name, sizeof(name), "grid_indices/size=%d", grid.grid_size);
+            bench_measure(runner, name, bench_grid_indices_kernel, &grid);
+        }
+        free(grid.vertices);
+        free(grid.indices);
+    }
+
+    // grid mesh of a many-body scene: the exact sum against the field approximation
+    const struct
+    {
+        int body_count, grid_size;
+    } field_cases[] = {{1024, 100}, {4096, 100}, {4096, 200}};
+    for (size_t c = 0; c < sizeof(field_cases) / sizeof(field_cases[0]); ++c)
+    {
+        bench_grid_field_t grid = {.body_count = field_cases[c].body_count, .grid_size = field_cases[c].grid_size};
+        grid.bodies = malloc(sizeof(celestial_body_t) * grid.body_count);
+        grid.vertices = malloc(sizeof(vector3_t) * GRID_MESH_VERTEX_COUNT(grid.grid_size));
+        vector3_t *exact = malloc(sizeof(vector3_t) * GRID_MESH_VERTEX_COUNT(grid.grid_size));
+        if (grid.bodies && grid.vertices && exact)
+        {
+            char name[BENCH_NAME_LENGTH];
+            bench_make_bodies(grid.bodies, grid.body_count);
+            snprintf(name, sizeof(name), "grid_exact/bodies=%d,size=%d", grid.body_count, grid.grid_size);
+            bench_measure(runner, name, bench_grid_exact_kernel, &grid);
+            snprintf(name, sizeof(name), "grid_field/bodies=%d,size=%d", grid.body_count, grid.grid_size);
+            bench_measure(runner, name, bench_grid_field_kernel, &grid);
+            if (!runner->filter || strstr(name, runner->filter))
+            {
+                double error = bench_grid_field_error(&grid, exact);
+                printf("[INFO] %s: dip error %.2e of %.0e allowed, %ld exact and %ld cell terms\n", name, error,
+                       GRID_MESH_DEFAULT_RELATIVE_ERROR, grid.field.exact_terms, grid.field.cell_terms);
+            }
+        }
+        free(grid.bodies);
+        free(grid.vertices);
+        free(exact);
+        grid_mesh_field_destroy(&grid.field);
+    }
+
+    // math helpers, BENCH_MATH_BATCH values per iteration
+    bench_math_t math = {0};
+    if (bench_math_init(&math))
+    {
+        bench_measure(runner, "math/vector3_normalize x1024", bench_normalize_scalar_kernel, &math);
+        bench_measure(runner, "math/vector3_cross x1024", bench_cross_kernel, &math);
+        bench_measure(runner, "math/matrix4_multiply x1024", bench_matrix_multiply_kernel, &math);
+        bench_measure(runner, "math/matrix4_look_at x1024", bench_look_at_kernel, &math);
+        bench_measure(runner, "math/batch_transform x1024", bench_batch_transform_kernel, &math);
+        bench_measure(runner, "math/batch_normalize x1024", bench_batch_normalize_kernel, &math);
+        bench_measure(runner, "math/batch_sqrt x1024", bench_batch_sqrt_kernel, &math);
+        bench_measure(runner, "math/batch_rsqrt x1024", bench_batch_rsqrt_kernel, &math);
+        bench_measure(runner, "math/batch_sincos x1024", bench_batch_sincos_kernel, &math);
+    }
+    else
+    {
+        printf("Failed to allocate the math arrays\n");
+    }
+    bench_math_free(&math);
+
+    // the shader's geodesic integration, ported to the cpu in geodesic.c
+    bench_geodesic_t geodesic;
+    bench_geodesic_init(&geodesic, RAYTRACER_INTEGRATOR_SPHERICAL_EULER);
+    bench_measure(runner, "geodesic/step_spherical x256", bench_geodesic_step_kernel, &geodesic);
+    bench_measure(runner, "geodesic/trace_spherical x16", bench_geodesic_trace_kernel, &geodesic);
+    bench_geodesic_init(&geodesic, RAYTRACER_INTEGRATOR_CARTESIAN);
+    bench_measure(runner, "geodesic/step_cartesian x256", bench_geodesic_step_kernel, &geodesic);
+    bench_measure(runner, "geodesic/trace_cartesian x16", bench_geodesic_trace_kernel, &geodesic);
+
+    // the embeddable batch api on one thread and on every core
+    const int library_threads[] = {1, 0};
+    for (size_t t = 0; t < sizeof(library_threads) / sizeof(library_threads[0]); ++t)
+    {
+        const char *name = library_threads[t] == 1 ? "library/trace_rays x256 threads=1" : "library/trace_rays x256 threads=all";
+        bench_library_t *library = calloc(1, sizeof(bench_library_t));
+        if (library && bench_library_init(library, library_threads[t]))
+            bench_measure(runner, name, bench_library_kernel, library);
+        else
+            printf("Failed to set up the libblackhole benchmark\n");
+        if (library)
+            bench_library_free(library);
+        free(library);
+    }
+
+    bool ok = !json_path || bench_write_json(runner, json_path);
+    free(runner);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+/**
+measures the spatial hash broadphase against the all-pairs overlap test on random
+bodies: checks that both find the same contacts and reports the time per step as N grows
+
+usage: bench_collision [--counts N,N,...] [--brute-max N] [--contacts C]
+**/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "collision.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MAX_COUNTS 16
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static float bench_random(unsigned int *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (float)(*state >> 8) / 16777216.0f;
+}
+
+// bodies in a flattened box (like a disk of stars), sized so that each touches about
+// contacts others; a few are heavy and large, and reach across many cells
+static void bench_make_bodies(celestial_body_t *bodies, int count, double contacts)
+{
+    unsigned int state = 4242u + (unsigned int)count;
+    const float extent = 1e13f, thickness = 1e12f;
+    double volume = (double)extent * extent * thickness;
+    // expected neighbours within 2r: count * (4/3) pi (2r)^3 / volume
+    float radius = (float)cbrt(contacts * volume / (count * 4.0 / 3.0 * M_PI * 8.0));
+    for (int i = 0; i < count; ++i)
+    {
+        bool giant = i % 1000 == 0;
+        bodies[i] = (celestial_body_t){
+            .position_and_radius = {extent * bench_random(&state), thickness * bench_random(&state),
+                                    extent * bench_random(&state), radius * (giant ? 20.0f : 0.5f + bench_random(&state))},
+            .color = {1, 1, 1, 1},
+            .mass = giant ? 1e33f : 2e30f,
+        };
+    }
+}
+
+static int bench_compare_pairs(const void *a, const void *b)
+{
+    const collision_pair_t *x = a, *y = b;
+    return x->a != y->a ? x->a - y->a : x->b - y->b;
+}
+
+static int bench_brute_force(const celestial_body_t *bodies, int count, collision_pair_t *pairs, int capacity)
+{
+    int pair_count = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        for (int j = i + 1; j < count; ++j)
+        {
+            vector4_t p = bodies[i].position_and_radius, q = bodies[j].position_and_radius;
+            double dx = (double)q.x - p.x, dy = (double)q.y - p.y, dz = (double)q.z - p.z;
+            double reach = (double)p.w + q.w;
+            if (dx * dx + dy * dy + dz * dz <= reach * reach && pair_count < capacity)
+                pairs[pair_count++] = (collision_pair_t){i, j};
+        }
+    }
+    return pair_count;
+}
+
+int main(int argc, char **argv)
+{
+    int counts[BENCH_MAX_COUNTS] = {1000, 10000, 100000, 200000};
+    int count_total = 4;
+    int brute_max = 20000;
+    double contacts = 0.5;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--counts") == 0 && i + 1 < argc)
+        {
+            count_total = 0;
+            for (char *token = strtok(argv[++i], ","); token && count_total < BENCH_MAX_COUNTS; token = strtok(NULL, ","))
+                counts[count_total++] = atoi(token);
+        }
+        else if (strcmp(argv[i], "--brute-max") == 0 && i + 1 < argc)
+            brute_max = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--contacts") == 0 && i + 1 < argc)
+            contacts = atof(argv[++i]);
+        else
+        {
+            printf("usage: %s [--counts N,N,...] [--brute-max N] [--contacts C]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    collision_broadphase_t broadphase = {0};
+    bool mismatch = false;
+    printf("--- Collision broadphase (about %.2f contacts per body) ---\n", contacts);
+    printf("%10s %10s %14s %14s %10s\n", "bodies", "pairs", "hash ms", "all-pairs ms", "speedup");
+    for (int c = 0; c < count_total; ++c)
+    {
+        int count = counts[c];
+        if (count < 2)
+            continue;
+        celestial_body_t *bodies = malloc(sizeof(celestial_body_t) * count);
+        if (!bodies)
+        {
+            printf("Failed to allocate %d bodies\n", count);
+            return 1;
+        }
+        bench_make_bodies(bodies, count, contacts);
+
+        // best of a few runs; the first one also grows the buffers
+        double sweep = 1e30;
+        int pair_count = 0;
+        for (int run = 0; run < 5; ++run)
+        {
+            double start = bench_now();
+            pair_count = collision_find_pairs(&broadphase, bodies, count);
+            double elapsed = bench_now() - start;
+            sweep = elapsed < sweep ? elapsed : sweep;
+        }
+
+        double brute = 0.0;
+        if (count <= brute_max)
+        {
+            int capacity = pair_count * 2 + 1024;
+            collision_pair_t *expected = malloc(sizeof(collision_pair_t) * capacity);
+            double start = bench_now();
+            int expected_count = bench_brute_force(bodies, count, expected, capacity);
+            brute = bench_now() - start;
+
+            qsort(broadphase.pairs, pair_count, sizeof(collision_pair_t), bench_compare_pairs);
+            if (expected_count != pair_count ||
+                memcmp(expected, broadphase.pairs, sizeof(collision_pair_t) * pair_count) != 0)
+            {
+                printf("Failed: %d bodies, hash found %d pairs, all-pairs %d\n", count, pair_count, expected_count);
+                mismatch = true;
+            }
+            free(expected);
+            printf("%10d %10d %14.3f %14.3f %9.1fx\n", count, pair_count, 1e3 * sweep, 1e3 * brute, brute / sweep);
+        }
+        else
+        {
+            printf("%10d %10d %14.3f %14s %10s\n", count, pair_count, 1e3 * sweep, "-", "-");
+        }
+        free(bodies);
+    }
+
+    // contact handling: merging conserves mass and momentum
+    celestial_body_t pair[2] = {
+        {.position_and_radius = {0, 0, 0, 2}, .mass = 3.0f, .velocity = {1, 0, 0}},
+        {.position_and_radius = {3, 0, 0, 2}, .mass = 1.0f, .velocity = {-1, 2, 0}},
+    };
+    collision_pair_t contact = {0, 1};
+    collision_resolve(pair, &contact, 1, COLLISION_MERGE);
+    bool merged = pair[0].mass == 4.0f && pair[1].mass == 0.0f && fabsf(pair[0].velocity.x - 0.5f) < 1e-6f &&
+                  fabsf(pair[0].velocity.y - 0.5f) < 1e-6f && fabsf(pair[0].position_and_radius.x - 0.75f) < 1e-6f;
+    printf("merge conserves mass and momentum: %s\n", merged ? "yes" : "no");
+
+    collision_destroy(&broadphase);
+    if (mismatch || !merged)
+        return 1;
+    return 0;
+}
@@ -0,0 +1,246 @@
+/**
+measures the per-tile body culling on a scene of many small bodies: traces every pixel
+against all bodies and against its tile's candidates only, checks that no pixel changes
+and reports body tests and time per image
+
+usage: bench_culling [--size WxH] [--bodies N] [--views N] [--steps N] [--step-size S]
+                     [--integrator spherical|cartesian|both]
+
+both integrators are checked by default: the culling bound has to hold for the spherical
+euler integrator of the quality presets as well as for the cartesian one.
+**/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "camera.h"
+#include "culling.h"
+#include "geodesic.h"
+#include "simulation.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct
+{
+    double seconds;
+    long long body_tests;
+    int mismatched;
+} bench_pass_t;
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// small bodies on a jittered shell around the hole, plus the hole itself like the app's scene
+static int bench_make_bodies(vector4_t *bodies, int count, float rs)
+{
+    unsigned int state = 12345u;
+    for (int i = 0; i < count - 1; ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        float azimuth = (float)(state >> 8) / 16777216.0f * 2.0f * (float)M_PI;
+        state = state * 1664525u + 1013904223u;
+        float height = ((float)(state >> 8) / 16777216.0f - 0.5f) * 0.6f;
+        state = state * 1664525u + 1013904223u;
+        float distance = rs * (6.0f + 10.0f * (float)(state >> 8) / 16777216.0f);
+        bodies[i] = (vector4_t){distance * cosf(azimuth), distance * height, distance * sinf(azimuth), rs * 0.3f};
+    }
+    bodies[count - 1] = (vector4_t){0.0f, 0.0f, 0.0f, rs};
+    return count;
+}
+
+static void bench_view(camera_t *cam, int width, int height, culling_view_t *view)
+{
+    view->position = camera_get_position(cam);
+    view->forward = vector3_normalize(vector3_subtract(cam->target, view->position));
+    vector3_t global_up = {0, 1, 0};
+    view->right = vector3_normalize(vector3_cross(view->forward, global_up));
+    view->up = vector3_cross(view->right, view->forward);
+    view->tan_half_fov = tanf((float)M_PI / 6.0f);
+    view->aspect = (float)width / (float)height;
+    view->width = view->region_width = width;
+    view->height = view->region_height = height;
+    view->origin_x = view->origin_y = 0;
+}
+
+// traces the view once; with masks, every tile only sees its candidate bodies
+static void bench_trace(const geodesic_scene_t *scene, raytracer_integrator_t integrator, const culling_view_t *view,
+                        const uint32_t *masks, int max_steps, float step_size, geodesic_hit_t *hits, bench_pass_t *pass)
+{
+    int tiles_x, tiles_y;
+    culling_tile_count(view->width, view->height, &tiles_x, &tiles_y);
+
+    double start = bench_now();
+    for (int y = 0; y < view->height; ++y)
+    {
+        for (int x = 0; x < view->width; ++x)
+        {
+            // compacted candidate list of the tile, body_index mapped back afterwards
+            geodesic_scene_t tile = *scene;
+            int map[MAX_CELESTIAL_BODIES];
+            tile.body_count = 0;
+            uint32_t mask = masks ? masks[(y / CULLING_TILE_SIZE) * tiles_x + x / CULLING_TILE_SIZE] : 0xffffffffu;
+            for (int i = 0; i < scene->body_count; ++i)
+            {
+                if (mask & (1u << i))
+                {
+                    map[tile.body_count] = i;
+                    tile.body_pos_radius[tile.body_count++] = scene->body_pos_radius[i];
+                }
+            }
+
+            geodesic_hit_t *hit = &hits[y * view->width + x];
+            vector3_t dir = camera_pixel_ray(view->right, view->up, view->forward, view->tan_half_fov, view->aspect,
+                                             view->width, view->height, (float)x + 0.5f, (float)y + 0.5f);
+            geodesic_trace(&tile, integrator, max_steps, step_size, view->position, dir, hit);
+            if (hit->body_index >= 0)
+                hit->body_index = map[hit->body_index];
+            pass->body_tests += (long long)hit->steps * tile.body_count;
+        }
+    }
+    pass->seconds += bench_now() - start;
+}
+
+// traces every view with and without the tile lists; returns the changed pixels, -1 if out of memory
+static int bench_integrator(const geodesic_scene_t *scene, raytracer_integrator_t integrator, const char *name,
+                            int width, int height, int views, int max_steps, float step_size)
+{
+    int tiles_x, tiles_y;
+    culling_tile_count(width, height, &tiles_x, &tiles_y);
+    uint32_t *masks = malloc(sizeof(uint32_t) * tiles_x * tiles_y);
+    geodesic_hit_t *reference = malloc(sizeof(geodesic_hit_t) * width * height);
+    geodesic_hit_t *culled = malloc(sizeof(geodesic_hit_t) * width * height);
+    if (!masks || !reference || !culled)
+    {
+        printf("Failed to allocate the benchmark buffers\n");
+        free(masks);
+        free(reference);
+        free(culled);
+        return -1;
+    }
+
+    bench_pass_t all = {0}, tiled = {0};
+    long long empty_tiles = 0, candidates = 0;
+    double cull_seconds = 0.0;
+    for (int v = 0; v < views; ++v)
+    {
+        // orbit the default camera and alternate the distance, so bodies pass in front of and behind the hole
+        camera_t cam = initial_camera_state;
+        cam.azimuth = 2.0f * (float)M_PI * (float)v / (float)views;
+        cam.elevation = (float)M_PI / 2.0f - 0.15f * (float)(v % 3);
+        cam.radius = v % 2 ? 8e10f : initial_camera_state.radius;
+        culling_view_t view;
+        bench_view(&cam, width, height, &view);
+
+        double start = bench_now();
+        culling_build_body_tiles(&view, scene->schwarzschild_radius, scene->body_pos_radius, scene->body_count, masks);
+        cull_seconds += bench_now() - start;
+        for (int t = 0; t < tiles_x * tiles_y; ++t)
+        {
+            empty_tiles += masks[t] == 0;
+            candidates += __builtin_popcount(masks[t]);
+        }
+
+        bench_trace(scene, integrator, &view, NULL, max_steps, step_size, reference, &all);
+        bench_trace(scene, integrator, &view, masks, max_steps, step_size, culled, &tiled);
+        for (int i = 0; i < width * height; ++i)
+        {
+            if (reference[i].reason != culled[i].reason || reference[i].body_index != culled[i].body_index ||
+                reference[i].steps != culled[i].steps)
+                tiled.mismatched++;
+        }
+    }
+
+    int tile_total = tiles_x * tiles_y * views;
+    printf("--- Body culling, %s (%dx%d, %d bodies, %d views, %d tiles of %d px) ---\n", name, width, height,
+           scene->body_count, views, tiles_x * tiles_y, CULLING_TILE_SIZE);
+    printf("empty tiles: %.1f %%, candidates per tile: %.2f, culling cost: %.3f ms per view\n",
+           100.0 * (double)empty_tiles / tile_total, (double)candidates / tile_total, 1e3 * cull_seconds / views);
+    printf("all bodies  %14lld body tests  %8.3f s\n", all.body_tests, all.seconds);
+    printf("tile lists  %14lld body tests  %8.3f s  (%.2fx fewer tests, %.2fx faster)\n", tiled.body_tests, tiled.seconds,
+           (double)all.body_tests / (double)(tiled.body_tests ? tiled.body_tests : 1), all.seconds / tiled.seconds);
+    printf("changed pixels: %d\n", tiled.mismatched);
+
+    free(masks);
+    free(reference);
+    free(culled);
+    return tiled.mismatched;
+}
+
+int main(int argc, char **argv)
+{
+    int width = 160, height = 120;
+    int body_count = MAX_CELESTIAL_BODIES;
+    int views = 4;
+    int max_steps = 6500;
+    float step_size = 2e8f;
+    bool spherical = true, cartesian = true;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &width, &height) == 2)
+            ++i;
+        else if (strcmp(argv[i], "--bodies") == 0 && i + 1 < argc)
+            body_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--views") == 0 && i + 1 < argc)
+            views = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc)
+            max_steps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--step-size") == 0 && i + 1 < argc)
+            step_size = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--integrator") == 0 && i + 1 < argc)
+        {
+            const char *name = argv[++i];
+            spherical = strcmp(name, "spherical") == 0 || strcmp(name, "both") == 0;
+            cartesian = strcmp(name, "cartesian") == 0 || strcmp(name, "both") == 0;
+            if (!spherical && !cartesian)
+            {
+                printf("Failed to parse the integrator %s (spherical, cartesian or both)\n", name);
+                return 1;
+            }
+        }
+        else
+        {
+            printf("usage: %s [--size WxH] [--bodies N] [--views N] [--steps N] [--step-size S]\n"
+                   "       [--integrator spherical|cartesian|both]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || views <= 0 || max_steps <= 0 || step_size <= 0.0f || body_count < 2 ||
+        body_count > MAX_CELESTIAL_BODIES)
+    {
+        printf("Failed to parse the benchmark options (2 <= bodies <= %d)\n", MAX_CELESTIAL_BODIES);
+        return 1;
+    }
+
+    float rs = SIMULATION_SCHWARZSCHILD_RADIUS;
+    geodesic_scene_t scene = {.schwarzschild_radius = rs, .disk_r1 = rs * 2.2f, .disk_r2 = rs * 5.2f};
+    scene.body_count = bench_make_bodies(scene.body_pos_radius, body_count, rs);
+
+    // the deflection table is built once per process; keep it out of the per-view culling cost
+    double start = bench_now();
+    culling_max_deflection(10.0f * rs, rs);
+    printf("[INFO] Deflection table built in %.2f ms\n", 1e3 * (bench_now() - start));
+
+    int spherical_changed = spherical ? bench_integrator(&scene, RAYTRACER_INTEGRATOR_SPHERICAL_EULER, "spherical euler",
+                                                         width, height, views, max_steps, step_size)
+                                      : 0;
+    int cartesian_changed = cartesian ? bench_integrator(&scene, RAYTRACER_INTEGRATOR_CARTESIAN, "cartesian", width,
+                                                         height, views, max_steps, step_size)
+                                      : 0;
+    if (spherical_changed < 0 || cartesian_changed < 0)
+        return 1;
+    if (spherical_changed > 0 || cartesian_changed > 0)
+    {
+        printf("Failed: culling removed a body that a ray reaches\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,230 @@
+/**
+compares the ray tracer's spherical euler and cartesian photon integrators on the cpu:
+cost per step and how far the cartesian image drifts from the spherical one, per ray
+(termination, escape direction) and per shaded pixel (cpu_render, the shader's shading)
+
+usage: bench_geodesic [--size WxH] [--steps N] [--step-size S] [--max-mismatch F] [--max-angle DEG]
+                      [--outlier-angle DEG] [--max-outliers F] [--pixel-threshold N] [--max-pixels F]
+**/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "camera.h"
+#include "cpu_render.h"
+#include "geodesic.h"
+#include "simulation.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct
+{
+    geodesic_hit_t *hits;
+    long long steps;
+    double seconds;
+} bench_result_t;
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static bool bench_trace_image(const geodesic_scene_t *scene, raytracer_integrator_t integrator, int width, int height,
+                              int max_steps, float step_size, bench_result_t *result)
+{
+    result->hits = malloc(sizeof(geodesic_hit_t) * (size_t)width * (size_t)height);
+    if (!result->hits)
+    {
+        printf("Failed to allocate %dx%d hits\n", width, height);
+        return false;
+    }
+
+    vector3_t pos = camera_get_position(&initial_camera_state);
+    vector3_t fwd = vector3_normalize(vector3_subtract(initial_camera_state.target, pos));
+    vector3_t global_up = {0, 1, 0};
+    vector3_t right = vector3_normalize(vector3_cross(fwd, global_up));
+    vector3_t up = vector3_cross(right, fwd);
+    float tan_half_fov = tanf((float)M_PI / 6.0f), aspect = (float)width / (float)height;
+
+    result->steps = 0;
+    double start = bench_now();
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            geodesic_hit_t *hit = &result->hits[y * width + x];
+            vector3_t dir = camera_pixel_ray(right, up, fwd, tan_half_fov, aspect, width, height, (float)x + 0.5f,
+                                             (float)y + 0.5f);
+            geodesic_trace(scene, integrator, max_steps, step_size, pos, dir, hit);
+            result->steps += hit->steps;
+        }
+    }
+    result->seconds = bench_now() - start;
+    return true;
+}
+
+// the image as the trace pass shades it, sky included, rgb rows top-down
+static unsigned char *bench_shade_image(const starfield_t *sky, raytracer_integrator_t integrator, int width, int height,
+                                        int max_steps, float step_size)
+{
+    unsigned char *rgb = malloc((size_t)width * height * 3);
+    if (!rgb)
+    {
+        printf("Failed to allocate a %dx%d image\n", width, height);
+        return NULL;
+    }
+    cpu_render_frame_t frame = {.integrator = integrator, .max_steps = max_steps, .step_size = step_size};
+    cpu_render_set_camera(&frame, &initial_camera_state, width, height);
+    cpu_render_set_scene(&frame, SIMULATION_SCHWARZSCHILD_RADIUS, simulation_initial_bodies,
+                         SIMULATION_INITIAL_BODY_COUNT);
+    cpu_render_tile(&frame, sky, 0, 0, width, height, rgb);
+    return rgb;
+}
+
+int main(int argc, char **argv)
+{
+    int width = 80, height = 60;
+    int max_steps = 26000;
+    float step_size = 5e7f;
+    double max_mismatch = 0.01;  // fraction of rays whose termination reason differs
+    double max_angle = 0.5;      // mean escape-direction difference, degrees
+    double outlier_angle = 2.0;  // escape-direction difference that makes a single ray an outlier, degrees
+    double max_outliers = 0.005; // fraction of escaping rays beyond outlier_angle
+    int pixel_threshold = 32;    // largest channel difference (of 255) of a shaded pixel that counts as changed
+    double max_pixels = 0.01;    // fraction of changed pixels
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &width, &height) == 2)
+            ++i;
+        else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc)
+            max_steps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--step-size") == 0 && i + 1 < argc)
+            step_size = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--max-mismatch") == 0 && i + 1 < argc)
+            max_mismatch = atof(argv[++i]);
+        else if (strcmp(argv[i], "--max-angle") == 0 && i + 1 < argc)
+            max_angle = atof(argv[++i]);
+        else if (strcmp(argv[i], "--outlier-angle") == 0 && i + 1 < argc)
+            outlier_angle = atof(argv[++i]);
+        else if (strcmp(argv[i], "--max-outliers") == 0 && i + 1 < argc)
+            max_outliers = atof(argv[++i]);
+        else if (strcmp(argv[i], "--pixel-threshold") == 0 && i + 1 < argc)
+            pixel_threshold = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-pixels") == 0 && i + 1 < argc)
+            max_pixels = atof(argv[++i]);
+        else
+        {
+            printf("usage: %s [--size WxH] [--steps N] [--step-size S] [--max-mismatch F] [--max-angle DEG]\n"
+                   "       [--outlier-angle DEG] [--max-outliers F] [--pixel-threshold N] [--max-pixels F]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || max_steps <= 0 || step_size <= 0.0f)
+    {
+        printf("Failed to parse the benchmark options\n");
+        return 1;
+    }
+
+    float rs = SIMULATION_SCHWARZSCHILD_RADIUS;
+    geodesic_scene_t scene = {
+        .schwarzschild_radius = rs,
+        .disk_r1 = rs * 2.2f,
+        .disk_r2 = rs * 5.2f,
+        .body_count = SIMULATION_INITIAL_BODY_COUNT,
+    };
+    for (int i = 0; i < SIMULATION_INITIAL_BODY_COUNT; ++i)
+        scene.body_pos_radius[i] = simulation_initial_bodies[i].position_and_radius;
+
+    bench_result_t spherical, cartesian;
+    if (!bench_trace_image(&scene, RAYTRACER_INTEGRATOR_SPHERICAL_EULER, width, height, max_steps, step_size, &spherical))
+        return 1;
+    if (!bench_trace_image(&scene, RAYTRACER_INTEGRATOR_CARTESIAN, width, height, max_steps, step_size, &cartesian))
+        return 1;
+
+    int rays = width * height;
+    int mismatched = 0, escaped = 0, outliers = 0;
+    double angle_sum = 0.0, angle_max = 0.0;
+    for (int i = 0; i < rays; ++i)
+    {
+        const geodesic_hit_t *a = &spherical.hits[i];
+        const geodesic_hit_t *b = &cartesian.hits[i];
+        if (a->reason != b->reason || a->body_index != b->body_index)
+        {
+            ++mismatched;
+            continue;
+        }
+        if (a->reason != RAY_STATS_ESCAPE && a->reason != RAY_STATS_BUDGET)
+            continue;
+        float cosine = utility_clamp_float(a->direction.x * b->direction.x + a->direction.y * b->direction.y +
+                                               a->direction.z * b->direction.z, -1.0f, 1.0f);
+        double angle = acos(cosine) * 180.0 / M_PI;
+        angle_sum += angle;
+        if (angle > angle_max)
+            angle_max = angle;
+        outliers += angle > outlier_angle;
+        ++escaped;
+    }
+
+    // the same view shaded with each integrator
+    starfield_t sky = {0};
+    if (!starfield_bake(&sky, STARFIELD_DEFAULT_FACE_SIZE))
+        return 1;
+    unsigned char *spherical_rgb = bench_shade_image(&sky, RAYTRACER_INTEGRATOR_SPHERICAL_EULER, width, height,
+                                                     max_steps, step_size);
+    unsigned char *cartesian_rgb = bench_shade_image(&sky, RAYTRACER_INTEGRATOR_CARTESIAN, width, height, max_steps,
+                                                     step_size);
+    starfield_destroy(&sky);
+    if (!spherical_rgb || !cartesian_rgb)
+        return 1;
+    int changed_pixels = 0;
+    double channel_sum = 0.0;
+    for (int i = 0; i < rays; ++i)
+    {
+        int largest = 0;
+        for (int c = 0; c < 3; ++c)
+        {
+            int difference = abs((int)spherical_rgb[i * 3 + c] - (int)cartesian_rgb[i * 3 + c]);
+            channel_sum += difference;
+            largest = difference > largest ? difference : largest;
+        }
+        changed_pixels += largest > pixel_threshold;
+    }
+    free(spherical_rgb);
+    free(cartesian_rgb);
+
+    double spherical_ns = spherical.seconds * 1e9 / (double)(spherical.steps ? spherical.steps : 1);
+    double cartesian_ns = cartesian.seconds * 1e9 / (double)(cartesian.steps ? cartesian.steps : 1);
+    double mismatch = (double)mismatched / (double)rays;
+    double mean_angle = escaped ? angle_sum / escaped : 0.0;
+    double outlier_fraction = escaped ? (double)outliers / escaped : 0.0;
+    double changed_fraction = (double)changed_pixels / (double)rays;
+
+    printf("--- Geodesic integrators (%dx%d rays, %d steps of %.3g) ---\n", width, height, max_steps, step_size);
+    printf("spherical  %12lld steps  %8.3f s  %7.2f ns/step\n", spherical.steps, spherical.seconds, spherical_ns);
+    printf("cartesian  %12lld steps  %8.3f s  %7.2f ns/step\n", cartesian.steps, cartesian.seconds, cartesian_ns);
+    printf("speedup per step: %.2fx, per image: %.2fx\n", spherical_ns / cartesian_ns, spherical.seconds / cartesian.seconds);
+    printf("termination mismatch: %.3f %% of rays (limit %.3f %%)\n", 100.0 * mismatch, 100.0 * max_mismatch);
+    printf("escape direction: mean %.4f deg, max %.4f deg over %d rays (limit %.4f deg mean)\n", mean_angle, angle_max,
+           escaped, max_angle);
+    printf("escape outliers: %.3f %% of rays beyond %.2f deg (limit %.3f %%)\n", 100.0 * outlier_fraction,
+           outlier_angle, 100.0 * max_outliers);
+    printf("shaded pixels: %.3f %% differ by more than %d (limit %.3f %%), mean channel difference %.2f\n",
+           100.0 * changed_fraction, pixel_threshold, 100.0 * max_pixels, channel_sum / (3.0 * rays));
+
+    free(spherical.hits);
+    free(cartesian.hits);
+
+    if (mismatch > max_mismatch || mean_angle > max_angle || outlier_fraction > max_outliers ||
+        changed_fraction > max_pixels)
+    {
+        printf("Failed: cartesian integrator differs from the spherical reference beyond the limits\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,317 @@
+/**
+checks the batch math functions against double precision libm at every instruction set
+the cpu supports, then times them against the scalar helpers they replace
+
+usage: bench_math [--count N] [--runs R]
+**/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "math_utils.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// error limits promised in math_utils.h
+#define BENCH_NORMALIZE_LIMIT 1e-6
+#define BENCH_RSQRT_LIMIT 1e-6
+#define BENCH_SINCOS_LIMIT 1e-6
+#define BENCH_SINCOS_RANGE 8192.0f
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static float bench_random(unsigned int *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (float)(*state >> 8) / 16777216.0f;
+}
+
+typedef struct
+{
+    float *x, *y, *z;       // input points
+    float *ox, *oy, *oz;    // outputs
+    float *positive;        // inputs of sqrt / rsqrt
+    float *angles;          // inputs of sincos
+    float *sines, *cosines; // outputs of sqrt / rsqrt / sincos
+    int count;
+} bench_data_t;
+
+static bool bench_alloc(bench_data_t *data, int count)
+{
+    float **arrays[] = {&data->x, &data->y, &data->z, &data->ox, &data->oy, &data->oz,
+                        &data->positive, &data->angles, &data->sines, &data->cosines};
+    data->count = count;
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i)
+    {
+        *arrays[i] = math_aligned_alloc(sizeof(float) * count);
+        if (!*arrays[i])
+            return false;
+    }
+
+    unsigned int state = 1234u;
+    for (int i = 0; i < count; ++i)
+    {
+        // a spread of magnitudes, and a few zero vectors
+        float scale = powf(10.0f, 8.0f * bench_random(&state) - 4.0f);
+        bool zero = i % 97 == 0;
+        data->x[i] = zero ? 0.0f : scale * (2.0f * bench_random(&state) - 1.0f);
+        data->y[i] = zero ? 0.0f : scale * (2.0f * bench_random(&state) - 1.0f);
+        data->z[i] = zero ? 0.0f : scale * (2.0f * bench_random(&state) - 1.0f);
+        data->positive[i] = powf(10.0f, 20.0f * bench_random(&state) - 10.0f);
+        data->angles[i] = BENCH_SINCOS_RANGE * (2.0f * bench_random(&state) - 1.0f);
+    }
+    return true;
+}
+
+static void bench_free(bench_data_t *data)
+{
+    float *arrays[] = {data->x, data->y, data->z, data->ox, data->oy, data->oz,
+                       data->positive, data->angles, data->sines, data->cosines};
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i)
+        math_aligned_free(arrays[i]);
+}
+
+static matrix4_t bench_affine_matrix(void)
+{
+    matrix4_t view = matrix4_look_at((vector3_t){3, 4, 5}, (vector3_t){0, 0, 0}, (vector3_t){0, 1, 0});
+    view.elements[12] += 0.25f;
+    return view;
+}
+
+// largest errors of every function at the current level; false if one is over its limit
+static bool bench_accuracy(bench_data_t *data)
+{
+    int n = data->count;
+    vector3_soa_t in = {data->x, data->y, data->z}, out = {data->ox, data->oy, data->oz};
+    double error;
+    bool ok = true;
+
+    // transform: compared with the double product, relative to the size of the terms
+    matrix4_t m = bench_affine_matrix();
+    vector3_batch_transform_points(&m, in, out, n);
+    error = 0.0;
+    for (int i = 0; i < n; ++i)
+    {
+        const float *e = m.elements;
+        double p[3] = {data->x[i], data->y[i], data->z[i]};
+        float *o[3] = {data->ox, data->oy, data->oz};
+        for (int r = 0; r < 3; ++r)
+        {
+            double exact = e[r] * p[0] + e[4 + r] * p[1] + e[8 + r] * p[2] + e[12 + r];
+            double size = fabs(e[r] * p[0]) + fabs(e[4 + r] * p[1]) + fabs(e[8 + r] * p[2]) + fabs(e[12 + r]);
+            double relative = fabs(o[r][i] - exact) / size;
+            error = relative > error ? relative : error;
+        }
+    }
+    bool transform_ok = error < 1e-6;
+    printf("  transform  %10.3g %s\n", error, transform_ok ? "" : "FAILED");
+    ok = ok && transform_ok;
+
+    vector3_batch_normalize(in, out, n);
+    error = 0.0;
+    for (int i = 0; i < n; ++i)
+    {
+        double x = data->x[i], y = data->y[i], z = data->z[i];
+        double length = sqrt(x * x + y * y + z * z);
+        double e[3] = {length > 0.0 ? x / length : 0.0, length > 0.0 ? y / length : 0.0, length > 0.0 ? z / length : 0.0};
+        double d = fabs(data->ox[i] - e[0]) + fabs(data->oy[i] - e[1]) + fabs(data->oz[i] - e[2]);
+        error = d > error ? d : error;
+    }
+    bool normalize_ok = error < BENCH_NORMALIZE_LIMIT * 3.0;
+    printf("  normalize  %10.3g %s\n", error, normalize_ok ? "" : "FAILED");
+    ok = ok && normalize_ok;
+
+    math_batch_sqrt(data->positive, data->sines, n);
+    bool sqrt_ok = true;
+    for (int i = 0; i < n; ++i)
+        sqrt_ok = sqrt_ok && data->sines[i] == sqrtf(data->positive[i]);
+    printf("  sqrt       %10s %s\n", sqrt_ok ? "exact" : "inexact", sqrt_ok ? "" : "FAILED");
+    ok = ok && sqrt_ok;
+
+    math_batch_rsqrt(data->positive, data->sines, n);
+    error = 0.0;
+    for (int i = 0; i < n; ++i)
+    {
+        double exact = 1.0 / sqrt((double)data->positive[i]);
+        double relative = fabs(data->sines[i] - exact) / exact;
+        error = relative > error ? relative : error;
+    }
+    bool rsqrt_ok = error < BENCH_RSQRT_LIMIT;
+    printf("  rsqrt      %10.3g %s\n", error, rsqrt_ok ? "" : "FAILED");
+    ok = ok && rsqrt_ok;
+
+    math_batch_sincos(data->angles, data->sines, data->cosines, n);
+    error = 0.0;
+    bool scalar_match = true;
+    for (int i = 0; i < n; ++i)
+    {
+        double s = fabs(data->sines[i] - sin((double)data->angles[i]));
+        double c = fabs(data->cosines[i] - cos((double)data->angles[i]));
+        error = s > error ? s : error;
+        error = c > error ? c : error;
+        float scalar_sine, scalar_cosine;
+        math_sincos(data->angles[i], &scalar_sine, &scalar_cosine);
+        scalar_match = scalar_match && scalar_sine == data->sines[i] && scalar_cosine == data->cosines[i];
+    }
+    bool sincos_ok = error < BENCH_SINCOS_LIMIT && scalar_match;
+    printf("  sincos     %10.3g %s%s\n", error, scalar_match ? "" : "(differs from math_sincos) ",
+           sincos_ok ? "" : "FAILED");
+    return ok && sincos_ok;
+}
+
+// the scalar code each batch function replaces
+static void bench_scalar_transform(const matrix4_t *m, bench_data_t *data)
+{
+    for (int i = 0; i < data->count; ++i)
+    {
+        vector4_t p = {data->x[i], data->y[i], data->z[i], 1.0f};
+        const float *e = m->elements;
+        data->ox[i] = e[0] * p.x + e[4] * p.y + e[8] * p.z + e[12];
+        data->oy[i] = e[1] * p.x + e[5] * p.y + e[9] * p.z + e[13];
+        data->oz[i] = e[2] * p.x + e[6] * p.y + e[10] * p.z + e[14];
+    }
+}
+
+static void bench_scalar_normalize(bench_data_t *data)
+{
+    for (int i = 0; i < data->count; ++i)
+    {
+        vector3_t v = vector3_normalize((vector3_t){data->x[i], data->y[i], data->z[i]});
+        data->ox[i] = v.x;
+        data->oy[i] = v.y;
+        data->oz[i] = v.z;
+    }
+}
+
+static void bench_scalar_sqrt(bench_data_t *data, bool reciprocal)
+{
+    for (int i = 0; i < data->count; ++i)
+        data->sines[i] = reciprocal ? 1.0f / sqrtf(data->positive[i]) : sqrtf(data->positive[i]);
+}
+
+static void bench_scalar_sincos(bench_data_t *data)
+{
+    for (int i = 0; i < data->count; ++i)
+    {
+        data->sines[i] = sinf(data->angles[i]);
+        data->cosines[i] = cosf(data->angles[i]);
+    }
+}
+
+enum
+{
+    BENCH_TRANSFORM,
+    BENCH_NORMALIZE,
+    BENCH_SQRT,
+    BENCH_RSQRT,
+    BENCH_SINCOS,
+    BENCH_FUNCTION_COUNT
+};
+
+static const char *bench_function_names[BENCH_FUNCTION_COUNT] = {"transform", "normalize", "sqrt", "rsqrt", "sincos"};
+
+// best time of runs calls of function at the current level, or of the scalar helpers
+static double bench_time(bench_data_t *data, int function, bool helpers, int runs)
+{
+    matrix4_t m = bench_affine_matrix();
+    vector3_soa_t in = {data->x, data->y, data->z}, out = {data->ox, data->oy, data->oz};
+    double best = 1e30;
+    for (int run = 0; run < runs; ++run)
+    {
+        double start = bench_now();
+        switch (function)
+        {
+        case BENCH_TRANSFORM:
+            helpers ? bench_scalar_transform(&m, data) : vector3_batch_transform_points(&m, in, out, data->count);
+            break;
+        case BENCH_NORMALIZE:
+            helpers ? bench_scalar_normalize(data) : vector3_batch_normalize(in, out, data->count);
+            break;
+        case BENCH_SQRT:
+            helpers ? bench_scalar_sqrt(data, false) : math_batch_sqrt(data->positive, data->sines, data->count);
+            break;
+        case BENCH_RSQRT:
+            helpers ? bench_scalar_sqrt(data, true) : math_batch_rsqrt(data->positive, data->sines, data->count);
+            break;
+        case BENCH_SINCOS:
+            helpers ? bench_scalar_sincos(data) : math_batch_sincos(data->angles, data->sines, data->cosines, data->count);
+            break;
+        }
+        double elapsed = bench_now() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int count = 1 << 20;
+    int runs = 10;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+            count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+            runs = atoi(argv[++i]);
+        else
+        {
+            printf("usage: %s [--count N] [--runs R]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (count < 1 || runs < 1)
+    {
+        printf("Failed: count and runs must be positive\n");
+        return 1;
+    }
+
+    bench_data_t data = {0};
+    if (!bench_alloc(&data, count))
+    {
+        printf("Failed to allocate %d values\n", count);
+        bench_free(&data);
+        return 1;
+    }
+
+    math_simd_level_t supported = math_simd_supported();
+    printf("--- Batch math, %d values, cpu supports %s ---\n", count, math_simd_level_name(supported));
+
+    // accuracy at every level, largest error against double precision
+    bool ok = true;
+    for (int level = MATH_SIMD_SCALAR; level <= (int)supported; ++level)
+    {
+        math_simd_set_level((math_simd_level_t)level);
+        printf("accuracy (%s):\n", math_simd_level_name((math_simd_level_t)level));
+        ok = bench_accuracy(&data) && ok;
+    }
+
+    // ns per value of the scalar helpers and of each level
+    printf("\n%-10s %10s", "ns/value", "helpers");
+    for (int level = MATH_SIMD_SCALAR; level <= (int)supported; ++level)
+        printf(" %10s", math_simd_level_name((math_simd_level_t)level));
+    printf(" %10s\n", "speedup");
+    for (int function = 0; function < BENCH_FUNCTION_COUNT; ++function)
+    {
+        double helpers = bench_time(&data, function, true, runs);
+        double widest = helpers;
+        printf("%-10s %10.3f", bench_function_names[function], 1e9 * helpers / count);
+        for (int level = MATH_SIMD_SCALAR; level <= (int)supported; ++level)
+        {
+            math_simd_set_level((math_simd_level_t)level);
+            widest = bench_time(&data, function, false, runs);
+            printf(" %10.3f", 1e9 * widest / count);
+        }
+        printf(" %9.1fx\n", helpers / widest);
+    }
+
+    bench_free(&data);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#ifndef BLACKHOLE_H
+#define BLACKHOLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+libblackhole: batch lensing queries against a schwarzschild black hole with an accretion
+disk and spherical bodies, on the cpu. all state lives in a context; rays and results are
+caller-owned arrays that are read and written in place.
+**/
+
+// upper bound on worker threads of a context
+#define BLACKHOLE_MAX_THREADS 64
+
+// upper bound on bodies in a scene
+#define BLACKHOLE_MAX_BODIES 16
+
+typedef struct blackhole_context blackhole_context_t;
+
+typedef enum
+{
+    BLACKHOLE_INTEGRATOR_SPHERICAL = 0, // explicit euler in (r, theta, phi), as the shader
+    BLACKHOLE_INTEGRATOR_CARTESIAN = 1, // semi-implicit euler on a = -1.5 rs h² r̂ / r⁴
+} blackhole_integrator_t;
+
+// why a ray stopped (same values as ray_stats_reason_t)
+typedef enum
+{
+    BLACKHOLE_HIT_HORIZON,
+    BLACKHOLE_HIT_DISK,
+    BLACKHOLE_HIT_BODY,
+    BLACKHOLE_HIT_ESCAPE,
+    BLACKHOLE_HIT_BUDGET, // ran out of steps first
+} blackhole_hit_t;
+
+typedef struct
+{
+    int thread_count; // threads tracing a batch, the caller included; 0 = one per core
+    blackhole_integrator_t integrator;
+    int max_steps;    // step budget per ray
+    float step_size;  // base step (metres), adapted with the distance like the shader does
+} blackhole_config_t;
+
+// a batch of rays as structure-of-arrays; directions need not be unit length
+typedef struct
+{
+    const float *origin_x, *origin_y, *origin_z;
+    const float *direction_x, *direction_y, *direction_z;
+} blackhole_rays_t;
+
+// where the results of a batch go; any array may be NULL to skip that output
+typedef struct
+{
+    uint8_t *hit;                             // blackhole_hit_t
+    float *escape_x, *escape_y, *escape_z;    // unit direction of travel where the ray stopped
+    float *disk_radius;                       // radius of the disk crossing, 0 unless BLACKHOLE_HIT_DISK
+    int32_t *steps;                           // integration steps taken
+} blackhole_results_t;
+
+/**
+ * @brief the app's settings: the spherical integrator, its step budget and base step, and
+ * one thread per core
+ */
+blackhole_config_t blackhole_default_config(void);
+
+/**
+ * @brief create a context with the app's scene (schwarzschild radius 1.269e10 m, disk
+ * from 2.2 to 5.2 rs, no bodies) and start its threads; NULL on failure
+ */
+blackhole_context_t *blackhole_create(const blackhole_config_t *config);
+
+/**
+ * @brief stop the threads and free the context
+ */
+void blackhole_destroy(blackhole_context_t *context);
+
+/**
+ * @brief black hole at the origin and its disk in the y = 0 plane between disk_inner and disk_outer
+ */
+void blackhole_set_black_hole(blackhole_context_t *context, float schwarzschild_radius, float disk_inner, float disk_outer);
+
+/**
+ * @brief bodies as (x, y, z, radius) quadruples; false if count is above BLACKHOLE_MAX_BODIES
+ */
+bool blackhole_set_bodies(blackhole_context_t *context, const float *position_radius, int count);
+
+/**
+ * @brief trace count rays on all the context's threads and fill results
+ *
+ * nothing is allocated or copied: the rays are read from and the results written to the
+ * caller's arrays. one batch runs at a time per context; use a context per calling thread.
+ */
+void blackhole_trace_rays(blackhole_context_t *context, const blackhole_rays_t *rays, const blackhole_results_t *results,
+                          int count);
+
+#endif // BLACKHOLE_H
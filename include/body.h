@@ -0,0 +1,22 @@
+#ifndef BODY_H
+#define BODY_H
+
+#include "math_utils.h"
+
+// physical constants (SI units)
+extern const double SPEED_OF_LIGHT;
+extern const double GRAVITATIONAL_CONSTANT;
+
+// upper bound on bodies the ray tracer can see (size of the shader arrays)
+#define MAX_CELESTIAL_BODIES 16
+
+// celestial body
+typedef struct
+{
+    vector4_t position_and_radius; // .xyz for position, .w for radius
+    vector4_t color;
+    float mass;
+    vector3_t velocity;
+} celestial_body_t;
+
+#endif // BODY_H
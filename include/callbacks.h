@@ -5,6 +5,7 @@
 #define GLFW_INCLUDE_NONE
 #endif
 #include <GLFW/glfw3.h>
+#include "replay.h"
 
 void callback_mouse_button(GLFWwindow *window, int button, int action, int mods);
 
@@ -16,5 +17,17 @@ void callback_key(GLFWwindow *window, int key, int scancode, int action, int mod
 
 void callback_framebuffer_size(GLFWwindow *window, int width, int height);
 
+/**
+ * @brief size the window of a replay to the recorded framebuffer and lock it there; the
+ * recording's own resizes still resize it
+ */
+void callback_begin_replay(GLFWwindow *window, int width, int height);
+
+/**
+ * @brief act on an input as the callbacks above do (they record it first); replays feed
+ * their recorded inputs through here. window may be NULL when headless.
+ */
+void callback_apply_event(GLFWwindow *window, const replay_event_t *event);
+
 #endif // CALLBACKS_H
 
@@ -27,6 +27,13 @@ extern camera_t camera;
 
 vector3_t camera_get_position(const camera_t *cam);
 
+/**
+ * @brief the ray tracer shader's pixelRay: unit direction through pixel position (px, py) of a
+ * width x height view, y growing downwards the screen; pixel centres sit at whole numbers + 0.5
+ */
+vector3_t camera_pixel_ray(vector3_t right, vector3_t up, vector3_t forward, float tan_half_fov, float aspect,
+                           int width, int height, float px, float py);
+
 void camera_update_moving_state(camera_t *cam);
 
 void camera_process_mouse_move(camera_t *cam, double x, double y);
@@ -0,0 +1,78 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include "cpu_render.h"
+#include <stdbool.h>
+
+/**
+distributed cpu rendering of frame sequences: a coordinator splits every frame into tiles
+and hands them to worker processes over tcp or unix sockets; workers trace the tiles with
+cpu_render and send them back run-length encoded.
+
+addresses are "unix:PATH" or "HOST:PORT" ("*:PORT" listens on every interface). messages
+are in host byte order, so the coordinator and its workers must share the architecture.
+**/
+
+// protocol revision, checked when a worker says hello
+#define CLUSTER_PROTOCOL_VERSION 1
+
+// edge length of a tile in pixels
+#define CLUSTER_DEFAULT_TILE_SIZE 64
+
+// connections a coordinator accepts over its run, dead ones included
+#define CLUSTER_MAX_WORKERS 64
+
+// tiles a worker holds at most: the one it renders and the ones queued behind it
+#define CLUSTER_MAX_QUEUE_DEPTH 8
+#define CLUSTER_DEFAULT_QUEUE_DEPTH 2
+
+// frames being rendered at once; a frame's tiles are only issued when its slot is free
+#define CLUSTER_FRAMES_IN_FLIGHT 4
+
+// seconds between worker heartbeats, and of silence before a worker counts as dead
+#define CLUSTER_HEARTBEAT_INTERVAL 0.5
+#define CLUSTER_DEFAULT_TIMEOUT 5.0
+
+/**
+ * @brief scene of a frame; called once per frame in increasing frame order, false aborts the run
+ */
+typedef bool (*cluster_scene_fn)(int frame, cpu_render_frame_t *scene, void *user);
+
+typedef struct
+{
+    const char *address;
+    int width, height;
+    int tile_size;
+    int first_frame, frame_count;
+    int queue_depth;           // tiles in flight per worker, up to CLUSTER_MAX_QUEUE_DEPTH
+    double timeout;            // seconds without a message before a worker is dropped
+    int spawn_workers;         // local worker processes forked once the address listens
+    const char *output_prefix; // frames are written to PREFIX%04d.ppm; NULL drops them
+    cluster_scene_fn scene;
+    void *scene_user;
+} cluster_config_t;
+
+typedef struct
+{
+    int fail_after;  // test hook: exit without a word after this many tiles (0 = never)
+    int stall_after; // test hook: go silent after this many tiles, no heartbeats (0 = never)
+} cluster_worker_options_t;
+
+/**
+ * @brief listen on the address and render every frame of the sequence with the workers
+ * that connect, then print the cluster throughput and per-worker utilisation
+ *
+ * a worker with a free queue slot gets the next tile; once no tile is left to issue, an idle
+ * worker steals the last queued tile of the busiest one. workers that disconnect or stay
+ * silent longer than the timeout are dropped and their tiles re-issued. runs until every
+ * frame is done; false when the address can't listen, a scene fails or a frame can't be written.
+ */
+bool cluster_coordinate(const cluster_config_t *config);
+
+/**
+ * @brief connect to a coordinator (retrying for a few seconds) and render tiles until it
+ * says quit or goes away
+ */
+bool cluster_work(const char *address, const cluster_worker_options_t *options);
+
+#endif // CLUSTER_H
@@ -0,0 +1,71 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include "body.h"
+#include <stdbool.h>
+
+// coefficient of restitution of COLLISION_BOUNCE (1 = elastic)
+#define COLLISION_RESTITUTION 1.0
+
+// what happens to two bodies whose spheres overlap
+typedef enum
+{
+    COLLISION_OFF,    // pass through each other
+    COLLISION_MERGE,  // the lighter body is absorbed by the heavier one
+    COLLISION_BOUNCE, // elastic impulse along the line of centres, then pushed apart
+} collision_mode_t;
+
+typedef struct
+{
+    int a, b; // body indices, a < b
+} collision_pair_t;
+
+// a regular-sized body binned into the grid, with a copy of its sphere so a bucket scan
+// reads contiguous memory
+typedef struct
+{
+    int index;
+    int cell[3];
+    vector4_t sphere;
+} collision_entry_t;
+
+// reusable buffers of the broadphase; zero-initialise, grows on demand
+typedef struct
+{
+    unsigned int *buckets;      // hash bucket of every regular body
+    collision_entry_t *entries; // regular bodies grouped by bucket
+    int *bucket_start;          // first entry of each bucket, plus one past the end
+    int *large;        // bodies too big for a cell
+    int capacity;      // bodies the per-body arrays hold
+    int table_size;    // hash buckets (a power of two)
+    collision_pair_t *pairs;
+    int pair_count;
+    int pair_capacity;
+} collision_broadphase_t;
+
+/**
+ * @brief find every pair of overlapping spheres among count bodies in about O(N + pairs)
+ *
+ * bodies are binned into a uniform grid, hashed into a table sized to the body count,
+ * with cells twice the mean diameter; overlapping regular bodies are then in neighbouring
+ * cells, so each one is only compared with the cells around it. the few bodies larger
+ * than that are compared with the cells their sphere reaches. candidates are confirmed with
+ * the exact sphere test, and bodies without mass (absorbed) are skipped. returns the pair
+ * count; the pairs are in broadphase->pairs.
+ */
+int collision_find_pairs(collision_broadphase_t *broadphase, const celestial_body_t *bodies, int count);
+
+/**
+ * @brief apply mode to the pairs found by collision_find_pairs
+ *
+ * merging conserves mass and momentum, keeps the heavier body (so its index, e.g. the
+ * black hole's, stays valid) and leaves the absorbed one with zero mass and radius.
+ */
+void collision_resolve(celestial_body_t *bodies, const collision_pair_t *pairs, int pair_count, collision_mode_t mode);
+
+/**
+ * @brief free the broadphase buffers
+ */
+void collision_destroy(collision_broadphase_t *broadphase);
+
+#endif // COLLISION_H
@@ -0,0 +1,45 @@
+#ifndef CPU_RENDER_H
+#define CPU_RENDER_H
+
+#include "camera.h"
+#include "geodesic.h"
+#include "starfield.h"
+
+// one frame as the cpu renderer sees it: camera, black hole, bodies and quality. plain
+// data without pointers, so it can be copied between processes as is.
+typedef struct
+{
+    int frame;
+    int width, height; // full image in pixels
+    vector3_t position, right, up, forward;
+    float tan_half_fov, aspect;
+    float time; // seconds, drives the disk pattern like the shader's time uniform
+    raytracer_integrator_t integrator;
+    int max_steps;
+    float step_size;
+    geodesic_scene_t scene;
+    vector4_t body_colors[MAX_CELESTIAL_BODIES];
+} cpu_render_frame_t;
+
+/**
+ * @brief fill the camera part of frame from an orbit camera, with the renderer's 60° field of view
+ */
+void cpu_render_set_camera(cpu_render_frame_t *frame, const camera_t *cam, int width, int height);
+
+/**
+ * @brief fill the scene part of frame: a black hole with the app's disk (2.2 to 5.2 rs) and
+ * the bodies (position, radius and color) of a physics snapshot
+ */
+void cpu_render_set_scene(cpu_render_frame_t *frame, float schwarzschild_radius, const celestial_body_t *bodies,
+                          int count);
+
+/**
+ * @brief trace and shade the pixels of a tile like the ray tracer shader's trace pass
+ *
+ * x and y are the top-left pixel of the tile with rows top-down; rgb receives width x
+ * height rgb8 pixels in the same order. sky may be NULL for a black background.
+ */
+void cpu_render_tile(const cpu_render_frame_t *frame, const starfield_t *sky, int x, int y, int width, int height,
+                     unsigned char *rgb);
+
+#endif // CPU_RENDER_H
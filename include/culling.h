@@ -0,0 +1,48 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include "math_utils.h"
+#include <stdint.h>
+
+// edge length in trace pixels of one culling tile
+#define CULLING_TILE_SIZE 16
+
+// camera of one trace pass, as the shader's pixelRay sees it
+typedef struct
+{
+    vector3_t position;
+    vector3_t right, up, forward;
+    float tan_half_fov;
+    float aspect;
+    int width, height;               // full trace resolution in pixels
+    int origin_x, origin_y;          // traced window of the full image; the masks cover only
+    int region_width, region_height; // this window (the whole frame, or one poster tile)
+} culling_view_t;
+
+/**
+ * @brief number of tiles covering a width x height trace target
+ */
+void culling_tile_count(int width, int height, int *tiles_x, int *tiles_y);
+
+/**
+ * @brief upper bound of the total deflection (radians) of a photon with impact parameter b
+ *
+ * the exact deflection, tabulated on first use; values above π mean the photon is captured
+ * or winds around the photon sphere (b close to b_crit = 3√3/2 rs).
+ */
+float culling_max_deflection(float impact_parameter, float rs);
+
+/**
+ * @brief conservative body candidates per tile, bit i set when body i can appear in the tile
+ *
+ * a photon turns only towards the hole, within its orbit plane and by at most the
+ * deflection bound, so its path stays in a thin wedge of directions from the camera;
+ * bodies outside every wedge of a tile are dropped. tiles close to the shadow, where rays
+ * wind around the hole (mirror images), keep every body. masks holds the tile count of the
+ * region, rows ordered like gl_FragCoord (tile row 0 is the region's first CULLING_TILE_SIZE
+ * pixel rows).
+ */
+void culling_build_body_tiles(const culling_view_t *view, float rs, const vector4_t *bodies, int body_count,
+                              uint32_t *masks);
+
+#endif // CULLING_H
@@ -0,0 +1,72 @@
+#ifndef GEODESIC_H
+#define GEODESIC_H
+
+#include "body.h"
+#include "math_utils.h"
+#include "ray_stats.h"
+
+// ray tracer integrators; the value is the shader's INTEGRATOR define
+typedef enum
+{
+    RAYTRACER_INTEGRATOR_SPHERICAL_EULER = 0,
+    RAYTRACER_INTEGRATOR_CARTESIAN = 1, // no trigonometry per step, no pole singularity
+} raytracer_integrator_t;
+
+// what a cpu ray sees; mirrors the SceneData fields the ray tracer shader uses
+typedef struct
+{
+    float schwarzschild_radius;
+    float disk_r1, disk_r2;
+    int body_count;
+    vector4_t body_pos_radius[MAX_CELESTIAL_BODIES];
+} geodesic_scene_t;
+
+// photon state for both integrators. the spherical form keeps (r, theta, phi) and
+// their derivatives; the cartesian form keeps position, velocity and h² = |p x v|².
+typedef struct
+{
+    vector3_t position;
+    float r;
+    float theta, phi, dr, dtheta, dphi; // spherical euler only
+    float energy;                       // spherical euler only, conserved E = f dt/dλ
+    vector3_t velocity;                 // cartesian only
+    float h2;                           // cartesian only
+} geodesic_ray_t;
+
+// end of a traced ray
+typedef struct
+{
+    ray_stats_reason_t reason;
+    int steps;
+    int body_index;      // RAY_STATS_BODY only
+    vector3_t position;  // where the integration stopped
+    vector3_t direction; // direction of travel there (escape direction for the sky lookup)
+} geodesic_hit_t;
+
+/**
+ * @brief set up a photon at pos travelling along the unit vector dir
+ */
+void geodesic_init(geodesic_ray_t *ray, raytracer_integrator_t integrator, vector3_t pos, vector3_t dir, float rs);
+
+/**
+ * @brief one step of the schwarzschild geodesic in spherical coordinates (explicit euler, as in the shader)
+ */
+void geodesic_step_spherical(geodesic_ray_t *ray, float rs, float dl);
+
+/**
+ * @brief one step of the cartesian photon equation a = -1.5 rs h² r̂ / r⁴ (semi-implicit euler)
+ */
+void geodesic_step_cartesian(geodesic_ray_t *ray, float rs, float dl);
+
+/**
+ * @brief current direction of travel as a unit vector
+ */
+vector3_t geodesic_direction(const geodesic_ray_t *ray, raytracer_integrator_t integrator);
+
+/**
+ * @brief trace a ray like the shader does (adaptive step, disk, bodies, horizon, escape, step budget)
+ */
+void geodesic_trace(const geodesic_scene_t *scene, raytracer_integrator_t integrator, int max_steps, float step_size,
+                    vector3_t origin, vector3_t dir, geodesic_hit_t *hit);
+
+#endif // GEODESIC_H
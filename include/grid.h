@@ -1,6 +1,7 @@
 #ifndef GRID_H
 #define GRID_H
 
+#include "jobs.h"
 #include "math_utils.h"
 #include "renderer.h"
 #include <stdbool.h>
@@ -19,27 +20,23 @@ void grid_init_buffers(void);
 void grid_cleanup_buffers(void);
 
 /**
- * @brief start the background grid generation thread
+ * @brief queue a grid computation after physics_job, at most 30 times per second and only
+ * once the previous one has finished; returns the job of the latest computation
  */
-void grid_start_thread(void);
+job_handle_t grid_schedule(double now, job_handle_t physics_job);
 
 /**
- * @brief stop the background grid generation thread
+ * @brief upload the latest mesh computed by grid_schedule to the gpu, if it wasn't uploaded yet
  */
-void grid_stop_thread(void);
-
-/**
- * @brief returns true if the grid thread is running
- */
-bool grid_is_threaded(void);
+void grid_update_mesh(renderer_engine_t *engine);
 
 /**
- * @brief update mesh from background thread (uploads to gpu)
+ * @brief number of meshes computed so far; changes whenever a new mesh is ready to upload
  */
-void grid_update_mesh(renderer_engine_t *engine);
+unsigned grid_get_generation(void);
 
 /**
- * @brief legacy synchronous grid generation (fallback)
+ * @brief compute and upload the mesh on the calling thread
  */
 void grid_generate_mesh(renderer_engine_t *engine);
 
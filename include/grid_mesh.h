@@ -0,0 +1,73 @@
+#ifndef GRID_MESH_H
+#define GRID_MESH_H
+
+#include "body.h"
+#include "math_utils.h"
+
+// grid configuration of the app
+#define GRID_MESH_DEFAULT_SIZE 50
+#define GRID_MESH_DEFAULT_SPACING 1e10f
+
+// the height of the grid before any body pulls it down
+#define GRID_MESH_FLAT_HEIGHT -25e10f
+
+// error the app's grid allows the field approximation, as a fraction of each vertex's dip
+#define GRID_MESH_DEFAULT_RELATIVE_ERROR 1e-3f
+
+// below this many bodies the field is no faster than the exact sum (measured crossover
+// on a 50x50 grid is about 128 bodies for a disk and 256 for a ring)
+#define GRID_MESH_FIELD_MIN_BODIES 256
+
+// vertex and index counts of a grid_size x grid_size cell mesh
+#define GRID_MESH_VERTEX_COUNT(grid_size) (((grid_size) + 1) * ((grid_size) + 1))
+#define GRID_MESH_INDEX_COUNT(grid_size) ((grid_size) * (grid_size) * 4)
+
+/**
+ * @brief heights of a grid_size x grid_size cell grid centred on the origin, pulled down by
+ * every body (flamm's paraboloid); no gl or threads. writes GRID_MESH_VERTEX_COUNT vertices
+ * row by row and returns their count, or 0 if the scratch rows can't be allocated.
+ */
+int grid_mesh_compute_vertices(const celestial_body_t *bodies, int body_count, int grid_size, float spacing,
+                               vector3_t *vertices);
+
+typedef struct grid_mesh_field_node grid_mesh_field_node_t;
+
+// quadtree of the bodies over the grid plane with the aggregates of the field
+// approximation; zero-initialise, grows on demand and is reused between meshes
+typedef struct
+{
+    grid_mesh_field_node_t *nodes;
+    int node_count, node_capacity;
+    float *body_x, *body_z, *body_weight, *body_rs; // per body with a dip
+    int *order;                                     // body indices, grouped by leaf
+    int *exact, *cells;                             // interaction lists of a vertex block
+    int capacity;                                   // bodies the per-body arrays hold
+    long exact_terms, cell_terms;                   // vertex-body and vertex-cell terms of the last mesh
+} grid_mesh_field_t;
+
+/**
+ * @brief the heights of grid_mesh_compute_vertices in about O(vertices * log bodies)
+ *
+ * the bodies are binned into a quadtree. every 8x8 block of vertices sums the bodies of
+ * nearby cells exactly and takes each distant cell as one second-order expansion around its
+ * weighted centroid, once the expansion's third-order remainder bound fits the cell's
+ * share (by weight) of max_relative_error times a lower bound of the block's dip. so no
+ * vertex's dip (its height above the flat grid) is off by more than that fraction, up to
+ * float rounding. fewer than GRID_MESH_FIELD_MIN_BODIES bodies, or a
+ * max_relative_error of 0, take the exact sum.
+ */
+int grid_mesh_compute_vertices_field(grid_mesh_field_t *field, const celestial_body_t *bodies, int body_count,
+                                     int grid_size, float spacing, float max_relative_error, vector3_t *vertices);
+
+/**
+ * @brief free the field buffers
+ */
+void grid_mesh_field_destroy(grid_mesh_field_t *field);
+
+/**
+ * @brief line list over the vertices of grid_mesh_compute_vertices (a horizontal and a
+ * vertical edge per cell); writes GRID_MESH_INDEX_COUNT indices and returns their count
+ */
+int grid_mesh_compute_indices(int grid_size, unsigned int *indices);
+
+#endif // GRID_MESH_H
@@ -0,0 +1,19 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <stdbool.h>
+
+/**
+ * @brief create an offscreen opengl 3.3 core context through egl and make it current.
+ * prefers mesa's surfaceless platform and falls back to a 1x1 pbuffer surface, so it
+ * works without a display server (including the llvmpipe software driver).
+ * returns false if egl is unavailable or the build was made without it.
+ */
+bool headless_context_create(void);
+
+/**
+ * @brief release the egl context and display
+ */
+void headless_context_destroy(void);
+
+#endif // HEADLESS_H
@@ -0,0 +1,93 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include "camera.h"
+#include "renderer.h"
+#include <stdbool.h>
+
+/**
+idle-aware rendering: before each frame the render loop asks what changed since the last
+one. when nothing did (physics paused, camera still, no input), it sleeps in
+glfwWaitEventsTimeout instead of tracing the same picture again, and wakes up on input or
+when the disk animation is due.
+**/
+
+// frames rendered after the last change so interleaved tracing and the temporal upscaler
+// converge: the upscaler blends in at least 5% of every frame, and 0.95^60 is below 5%
+#define IDLE_SETTLE_FRAMES 60
+
+// default frame rate of the disk animation while nothing else changes
+#define IDLE_DEFAULT_ANIMATION_FPS 10.0
+
+// longest sleep, so a physics step or grid mesh finishing after a pause still shows up
+#define IDLE_MAX_WAIT 0.25
+
+typedef enum
+{
+    IDLE_DIRTY_INPUT = 1 << 0,     // a key, button, scroll or resize event arrived
+    IDLE_DIRTY_CAMERA = 1 << 1,    // the camera moved
+    IDLE_DIRTY_PHYSICS = 1 << 2,   // the simulation runs, or finished a step since the last frame
+    IDLE_DIRTY_GRID = 1 << 3,      // a new grid mesh is ready
+    IDLE_DIRTY_WINDOW = 1 << 4,    // the framebuffer size changed
+    IDLE_DIRTY_SETTLING = 1 << 5,  // temporal history converging or quality climbing back
+    IDLE_DIRTY_ANIMATION = 1 << 6, // the disk animation frame is due
+    IDLE_DIRTY_OVERLAY = 1 << 7,   // the profiler overlay shows live timings
+} idle_dirty_t;
+
+#define IDLE_DIRTY_REASON_COUNT 8
+
+typedef struct
+{
+    bool enabled;
+    double animation_interval; // seconds between disk animation frames while idle; 0 freezes the disk
+    unsigned pending;          // reasons marked by input since the last frame
+
+    // state shown by the last rendered frame
+    vector3_t target;
+    float radius, azimuth, elevation;
+    unsigned physics_generation, grid_generation;
+    int width, height;
+    double last_frame_time;
+    int settle_frames; // frames still to render for temporal convergence
+
+    // statistics
+    long rendered_frames;
+    double idle_seconds; // time spent waiting instead of rendering
+    long reason_frames[IDLE_DIRTY_REASON_COUNT];
+} idle_tracker_t;
+
+// global tracker of the render loop; input callbacks mark it dirty
+extern idle_tracker_t idle_tracker;
+
+/**
+ * @brief reset the tracker; disabled trackers report every frame dirty. animation_fps 0 freezes the disk while idle
+ */
+void idle_init(idle_tracker_t *idle, bool enabled, double animation_fps);
+
+/**
+ * @brief record a change the tracker can't see in the scene state (input events)
+ */
+void idle_mark(idle_tracker_t *idle, unsigned reasons);
+
+/**
+ * @brief what changed since the last rendered frame (idle_dirty_t bits); 0 means the frame can be skipped
+ */
+unsigned idle_check(const idle_tracker_t *idle, const renderer_engine_t *engine, const camera_t *cam, double now);
+
+/**
+ * @brief remember what the frame rendered for reasons showed
+ */
+void idle_frame_rendered(idle_tracker_t *idle, unsigned reasons, const renderer_engine_t *engine, const camera_t *cam,
+                         double now);
+
+/**
+ * @brief sleep until input arrives, the next animation frame is due or IDLE_MAX_WAIT passes
+ */
+void idle_wait(idle_tracker_t *idle, renderer_engine_t *engine, double now);
+
+/**
+ * @brief print rendered and skipped frames and what caused the rendered ones
+ */
+void idle_print_stats(const idle_tracker_t *idle, double run_seconds);
+
+#endif // IDLE_H
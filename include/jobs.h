@@ -0,0 +1,82 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+
+// upper bound on worker threads
+#define JOBS_MAX_WORKERS 64
+
+// jobs submitted but not finished at any one time; jobs_submit helps run jobs while full
+#define JOBS_CAPACITY 1024
+
+// jobs that can wait on one job; further dependents wait for it on submit instead
+#define JOBS_MAX_DEPENDENTS 16
+
+typedef void (*job_function_t)(void *data);
+
+// refers to a submitted job. a zero handle, or one whose job has finished, is done.
+typedef struct
+{
+    int index;
+    unsigned int generation;
+} job_handle_t;
+
+// counters of one thread of the pool (workers, then the threads outside it)
+typedef struct
+{
+    long long executed; // jobs run
+    long long stolen;   // jobs taken from another thread's deque
+    double busy_seconds;
+} jobs_worker_stats_t;
+
+/**
+ * @brief start the worker threads. worker_count < 0 means one per core minus the calling
+ * (render) thread; 0 runs every job on the threads that wait for them. with pin_threads,
+ * worker i is bound to core i + 1 (linux only).
+ */
+bool jobs_init(int worker_count, bool pin_threads);
+
+/**
+ * @brief wait for every job, then stop and join the workers
+ */
+void jobs_shutdown(void);
+
+/**
+ * @brief number of worker threads (0 when jobs run on the waiting threads)
+ */
+int jobs_worker_count(void);
+
+/**
+ * @brief queue function(data) to run once every dependency has finished
+ *
+ * workers push to and pop from the bottom of their own deque and steal from the top of
+ * the others'; jobs submitted outside the pool go to a shared deque the workers steal from.
+ */
+job_handle_t jobs_submit(job_function_t function, void *data, const job_handle_t *dependencies, int dependency_count);
+
+/**
+ * @brief true once the job has run
+ */
+bool jobs_is_done(job_handle_t job);
+
+/**
+ * @brief run queued jobs until the job has finished (never blocks while there is work)
+ */
+void jobs_wait(job_handle_t job);
+
+/**
+ * @brief run queued jobs until no job is left
+ */
+void jobs_wait_all(void);
+
+/**
+ * @brief counters of worker index (jobs_worker_count() is the threads outside the pool)
+ */
+jobs_worker_stats_t jobs_get_stats(int worker);
+
+/**
+ * @brief print jobs, steals and utilisation per worker between jobs_init and now (or jobs_shutdown)
+ */
+void jobs_print_stats(void);
+
+#endif // JOBS_H
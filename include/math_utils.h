@@ -1,6 +1,8 @@
 #ifndef MATH_UTILS_H
 #define MATH_UTILS_H
 
+#include <stddef.h>
+
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
@@ -49,5 +51,83 @@ matrix4_t matrix4_look_at(vector3_t eye, vector3_t center, vector3_t up);
 
 matrix4_t matrix4_multiply(matrix4_t a, matrix4_t b);
 
+
+
+// batch math over structure-of-arrays data. every function picks the widest instruction
+// set the cpu supports (avx, sse or scalar) on first use; arrays need no particular
+// alignment, but math_aligned_alloc'd ones load fastest. outputs may alias inputs.
+
+// alignment of math_aligned_alloc (one avx register)
+#define MATH_SIMD_ALIGNMENT 32
+
+typedef enum
+{
+    MATH_SIMD_SCALAR,
+    MATH_SIMD_SSE, // 4 floats per instruction (sse2)
+    MATH_SIMD_AVX, // 8 floats per instruction
+} math_simd_level_t;
+
+// three parallel coordinate arrays
+typedef struct
+{
+    float *x, *y, *z;
+} vector3_soa_t;
+
+/**
+ * @brief widest instruction set this cpu (and os) supports
+ */
+math_simd_level_t math_simd_supported(void);
+
+/**
+ * @brief instruction set the batch functions use
+ */
+math_simd_level_t math_simd_level(void);
+
+/**
+ * @brief use a narrower instruction set (benchmarks, comparisons); clamped to the supported one
+ */
+void math_simd_set_level(math_simd_level_t level);
+
+const char *math_simd_level_name(math_simd_level_t level);
+
+/**
+ * @brief size bytes aligned to MATH_SIMD_ALIGNMENT; release with math_aligned_free
+ */
+void *math_aligned_alloc(size_t size);
+
+void math_aligned_free(void *pointer);
+
+/**
+ * @brief out[i] = m * (in[i], 1), divided by w when m is projective
+ */
+void vector3_batch_transform_points(const matrix4_t *m, vector3_soa_t in, vector3_soa_t out, int count);
+
+/**
+ * @brief out[i] = in[i] / |in[i]| (zero vectors stay zero); relative error below 1e-6
+ */
+void vector3_batch_normalize(vector3_soa_t in, vector3_soa_t out, int count);
+
+/**
+ * @brief out[i] = sqrt(in[i]), correctly rounded
+ */
+void math_batch_sqrt(const float *in, float *out, int count);
+
+/**
+ * @brief out[i] = 1 / sqrt(in[i]) from the hardware estimate plus one newton step
+ * (relative error below 1e-6)
+ */
+void math_batch_rsqrt(const float *in, float *out, int count);
+
+/**
+ * @brief sine and cosine of each angle, polynomial after range reduction to [-π/4, π/4];
+ * absolute error below 1e-6 for |angle| < 8192
+ */
+void math_batch_sincos(const float *angles, float *sines, float *cosines, int count);
+
+/**
+ * @brief scalar math_batch_sincos (same results as the batch version)
+ */
+void math_sincos(float angle, float *sine, float *cosine);
+
 #endif // MATH_UTILS_H
 
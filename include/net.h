@@ -0,0 +1,73 @@
+#ifndef NET_H
+#define NET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+stream sockets and length-prefixed messages shared by the cluster renderer and the frame
+stream. addresses are "unix:PATH" or "HOST:PORT" ("*:PORT" listens on every interface).
+messages are in host byte order.
+**/
+
+// upper bound on the payload of one message
+#define NET_MAX_MESSAGE (64u << 20)
+
+typedef struct
+{
+    uint32_t type;
+    uint32_t length; // payload bytes after the header
+} net_header_t;
+
+// received bytes not parsed yet
+typedef struct
+{
+    unsigned char *data;
+    size_t start, size, capacity;
+} net_buffer_t;
+
+/**
+ * @brief a listening or connected stream socket for the address (tcp sockets get
+ * TCP_NODELAY); -1 on failure
+ */
+int net_open(const char *address, bool listening);
+
+/**
+ * @brief remove the socket file of a unix address after its listener is closed
+ */
+void net_release(const char *address);
+
+/**
+ * @brief send all bytes, blocking; false if the connection is gone
+ */
+bool net_send_all(int fd, const void *data, size_t size);
+
+/**
+ * @brief send a header and its payload
+ */
+bool net_send_message(int fd, uint32_t type, const void *payload, uint32_t length);
+
+/**
+ * @brief read what the socket has into buffer, waiting for data when wait is set; false on
+ * end of stream or error. received (optional) is set to the bytes read.
+ */
+bool net_receive(net_buffer_t *buffer, int fd, bool wait, size_t *received);
+
+/**
+ * @brief take the next complete message from buffer; the payload stays valid until the next
+ * receive. corrupt is set when the header announces more than NET_MAX_MESSAGE.
+ */
+bool net_next_message(net_buffer_t *buffer, net_header_t *header, const unsigned char **payload, bool *corrupt);
+
+/**
+ * @brief free the buffer's storage
+ */
+void net_buffer_free(net_buffer_t *buffer);
+
+/**
+ * @brief monotonic seconds, the same clock as profiler_now
+ */
+double net_now(void);
+
+#endif // NET_H
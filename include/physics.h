@@ -1,48 +1,38 @@
 #ifndef PHYSICS_H
 #define PHYSICS_H
 
-#include "math_utils.h"
+#include "body.h"
+#include "collision.h"
+#include "jobs.h"
 #include <stdbool.h>
 
-// physical constants
-extern const double SPEED_OF_LIGHT;
-extern const double GRAVITATIONAL_CONSTANT;
+// physical constants of the app's scene
 extern const float BLACK_HOLE_SCHWARZSCHILD_RADIUS;
 extern float RAY_INTEGRATION_STEP;
 extern const double RAY_ESCAPE_RADIUS;
 extern const int NUM_CELESTIAL_BODIES;
 extern bool is_physics_paused;
 
-// celestial body
-typedef struct
-{
-    vector4_t position_and_radius; // .xyz for position, .w for radius
-    vector4_t color;
-    float mass;
-    vector3_t velocity;
-} celestial_body_t;
+// what touching bodies do in the app's physics step (--collisions)
+extern collision_mode_t collision_mode;
 
 // global celestial bodies array
 extern celestial_body_t celestial_bodies[];
 
 
-void simulation_update_physics(double delta_time);
-
 /**
- * @brief Start the background physics thread (no effect if unsupported).
- * The thread advances physics independently using a fixed timestep.
+ * @brief Put celestial_bodies back to the initial scene (simulation_initial_bodies).
  */
-void physics_start_thread(void);
+void physics_reset(void);
 
-/**
- * @brief Stop the background physics thread and join it (if running).
- */
-void physics_stop_thread(void);
+void simulation_update_physics(double delta_time);
 
 /**
- * @brief Returns true if the physics thread is running.
+ * @brief Queue the fixed-timestep (60 Hz) steps that delta_time real seconds call for as
+ * one job; returns the job of the latest steps. While that job is still running no new
+ * one is queued and the time carries over.
  */
-bool physics_is_threaded(void);
+job_handle_t physics_schedule(double delta_time);
 
 /**
  * @brief Acquire/release a short critical section for safe read access to
@@ -51,5 +41,17 @@ bool physics_is_threaded(void);
 void physics_lock(void);
 void physics_unlock(void);
 
+/**
+ * @brief Copy celestial_bodies into out_bodies (NUM_CELESTIAL_BODIES entries).
+ * Holds the physics lock only for the copy, so callers can do their own work on
+ * the snapshot without blocking the physics thread.
+ */
+void physics_snapshot_bodies(celestial_body_t *out_bodies);
+
+/**
+ * @brief Number of physics steps applied so far; changes whenever celestial_bodies does.
+ */
+unsigned physics_get_generation(void);
+
 #endif // PHYSICS_H
 
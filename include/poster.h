@@ -0,0 +1,64 @@
+#ifndef POSTER_H
+#define POSTER_H
+
+#include "camera.h"
+#include "renderer.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// edge length of one poster tile in pixels (the size of the offscreen targets)
+#define POSTER_DEFAULT_TILE_SIZE 1024
+
+// output of a tiled render: a binary ppm (p6) sized up front and filled tile by tile,
+// plus a "<path>.progress" sidecar: a "poster WIDTH HEIGHT TILE_SIZE" line, then the
+// finished tiles, one index per line.
+// tiles are numbered row by row from the top-left corner.
+typedef struct
+{
+    int fd;
+    FILE *progress;
+    char progress_path[1024];
+    int width, height;
+    int tile_size;
+    int tiles_x, tiles_y;
+    long header_length;
+    unsigned char *done; // one flag per tile
+    int done_count;
+    unsigned char *row;  // rgb scratch row of one tile
+} poster_file_t;
+
+/**
+ * @brief create the output, or reopen it and its sidecar to resume an interrupted render
+ *
+ * an existing file is only resumed when its header matches width x height and a sidecar
+ * exists; otherwise it is replaced.
+ */
+bool poster_file_open(poster_file_t *file, const char *path, int width, int height, int tile_size);
+
+/**
+ * @brief pixel rectangle of a tile: left column, bottom row (gl convention) and size
+ */
+void poster_file_tile_rect(const poster_file_t *file, int tile, int *x, int *y, int *width, int *height);
+
+/**
+ * @brief write a rendered tile and record it in the sidecar once it is on disk
+ *
+ * pixels are rgba8 rows bottom-up as read back from gl, pixels_width wide; only the part
+ * inside the image is written.
+ */
+bool poster_file_write_tile(poster_file_t *file, int tile, const unsigned char *pixels, int pixels_width);
+
+/**
+ * @brief close the output; the sidecar is removed once every tile is done
+ */
+bool poster_file_close(poster_file_t *file);
+
+/**
+ * @brief render a width x height still of the initial scene into a ppm, one tile at a time
+ *
+ * memory use depends only on the tile size. rerunning with the same arguments after an
+ * interruption renders only the missing tiles.
+ */
+bool poster_render(renderer_engine_t *engine, camera_t *cam, const char *path, int width, int height, int tile_size);
+
+#endif // POSTER_H
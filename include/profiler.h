@@ -0,0 +1,106 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+
+// instrumented stages. the first block runs on the render thread and is also
+// timed on the gpu; the rest are cpu-only and may be recorded from any thread.
+typedef enum
+{
+    PROFILER_STAGE_GRID_UPLOAD,
+    PROFILER_STAGE_GRID_RENDER,
+    PROFILER_STAGE_RAY_TRACE,
+    PROFILER_STAGE_BLIT,
+    PROFILER_STAGE_SWAP,
+    PROFILER_STAGE_FRAME,
+    PROFILER_STAGE_PHYSICS_STEP,
+    PROFILER_STAGE_GRID_STEP,
+    PROFILER_STAGE_PHYSICS_LOCK_WAIT,
+    PROFILER_STAGE_PHYSICS_LOCK_HOLD,
+    PROFILER_STAGE_COUNT
+} profiler_stage_t;
+
+// percentiles of the most recent samples of one stage, in milliseconds
+typedef struct
+{
+    int sample_count;
+    double p50, p95, p99;
+} profiler_stats_t;
+
+// a stage can additionally be split by variant (e.g. one per ray tracer quality tier)
+#define PROFILER_MAX_VARIANTS 4
+
+// overlay visibility
+extern bool is_profiler_overlay_visible;
+
+/**
+ * @brief create the gpu timer queries (requires a current gl context)
+ */
+void profiler_init(void);
+
+/**
+ * @brief delete the gpu timer queries
+ */
+void profiler_shutdown(void);
+
+/**
+ * @brief monotonic time in seconds
+ */
+double profiler_now(void);
+
+/**
+ * @brief collect finished gpu queries from two frames ago; call at the start of each frame
+ */
+void profiler_begin_frame(void);
+
+/**
+ * @brief start a cpu scope (and a gpu query if the stage has one) on the render thread
+ */
+double profiler_begin(profiler_stage_t stage);
+
+/**
+ * @brief like profiler_begin, but the samples also go to the given variant's histogram
+ */
+double profiler_begin_variant(profiler_stage_t stage, int variant);
+
+/**
+ * @brief name a variant for the summary and the trace export
+ */
+void profiler_set_variant_name(profiler_stage_t stage, int variant, const char *name);
+
+/**
+ * @brief end the scope opened by profiler_begin or profiler_begin_variant
+ */
+void profiler_end(profiler_stage_t stage, double start_time);
+
+/**
+ * @brief record a cpu sample from any thread
+ */
+void profiler_record(profiler_stage_t stage, double start_time, double duration);
+
+/**
+ * @brief percentiles of a stage's recent cpu or gpu samples
+ */
+profiler_stats_t profiler_get_stats(profiler_stage_t stage, bool gpu);
+
+/**
+ * @brief percentiles of one variant of a stage
+ */
+profiler_stats_t profiler_get_variant_stats(profiler_stage_t stage, int variant, bool gpu);
+
+/**
+ * @brief draw the per-stage bars in the lower left corner of the default framebuffer
+ */
+void profiler_render_overlay(int window_width, int window_height);
+
+/**
+ * @brief print p50/p95/p99 of every stage to stdout
+ */
+void profiler_print_summary(void);
+
+/**
+ * @brief write the recorded events as chrome trace_event json (chrome://tracing, perfetto)
+ */
+bool profiler_write_trace(const char *path);
+
+#endif // PROFILER_H
@@ -0,0 +1,63 @@
+#ifndef QUALITY_H
+#define QUALITY_H
+
+#include "shaders.h"
+#include "profiler.h"
+#include <stdbool.h>
+
+// one ray tracer program is compiled per preset, and each gets a profiler variant
+#define QUALITY_MAX_PRESETS PROFILER_MAX_VARIANTS
+#define QUALITY_NAME_LENGTH 32
+
+// one step of the quality ladder
+typedef struct
+{
+    char name[QUALITY_NAME_LENGTH];
+    int render_scale;                    // trace divisor is the engine's base divisor times this
+    raytracer_permutation_t permutation; // step budget, step size (tolerance) and features
+} quality_preset_t;
+
+// drops to the cheapest preset on input and climbs back one preset per
+// restore_interval once the input has been quiet for settle_time seconds.
+typedef struct
+{
+    quality_preset_t presets[QUALITY_MAX_PRESETS]; // cheapest first, full quality last
+    int preset_count;
+    int current;
+    double settle_time;
+    double restore_interval;
+    double last_input_time;
+    double last_change_time;
+} quality_controller_t;
+
+/**
+ * @brief built-in ladder: interactive, balanced, full; starts at full quality
+ */
+void quality_init_defaults(quality_controller_t *quality);
+
+/**
+ * @brief replace the presets and timings from a config file
+ *
+ * format: "key = value" lines, '#' comments. settle_time and restore_interval
+ * (seconds) are global; every "[name]" section starts a preset (cheapest first)
+ * with the keys render_scale, max_steps, step_size, disk, bodies, starfield and
+ * integrator (spherical or cartesian).
+ */
+bool quality_load_config(quality_controller_t *quality, const char *path);
+
+/**
+ * @brief report camera input (orbit, pan, zoom); drops to the cheapest preset immediately
+ */
+void quality_notify_input(quality_controller_t *quality, double now);
+
+/**
+ * @brief advance the progressive restore; returns the preset index for this frame
+ */
+int quality_update(quality_controller_t *quality, double now);
+
+/**
+ * @brief preset selected by the last update
+ */
+const quality_preset_t *quality_current(const quality_controller_t *quality);
+
+#endif // QUALITY_H
@@ -0,0 +1,72 @@
+#ifndef RAY_STATS_H
+#define RAY_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// log2 buckets of steps per ray: [0], [1], [2, 3], [4, 7], ... the last bucket is open-ended
+#define RAY_STATS_HISTOGRAM_BUCKETS 16
+
+// frames kept for export; older frames are overwritten
+#define RAY_STATS_MAX_FRAMES 1024
+
+// why the integration of a ray stopped; the values are written by the ENABLE_STATS shader permutation
+typedef enum
+{
+    RAY_STATS_HORIZON,
+    RAY_STATS_DISK,
+    RAY_STATS_BODY,
+    RAY_STATS_ESCAPE,
+    RAY_STATS_BUDGET, // ran out of MAX_STEPS before anything else happened
+    RAY_STATS_REASON_COUNT
+} ray_stats_reason_t;
+
+extern const char *ray_stats_reason_names[RAY_STATS_REASON_COUNT];
+
+// totals of one traced frame
+typedef struct
+{
+    int frame_index;
+    int quality_level;
+    int step_budget;
+    int ray_count;
+    uint64_t total_steps;
+    uint32_t max_steps_taken;
+    uint32_t reasons[RAY_STATS_REASON_COUNT];
+    uint32_t histogram[RAY_STATS_HISTOGRAM_BUCKETS];
+} ray_stats_frame_t;
+
+// ring of recent frames
+typedef struct
+{
+    ray_stats_frame_t frames[RAY_STATS_MAX_FRAMES];
+    int count;
+    int next;
+} ray_stats_log_t;
+
+/**
+ * @brief reduce a (steps, reason) pair per pixel, rows tightly packed, into frame totals
+ */
+void ray_stats_reduce(const uint32_t *pixels, int width, int height, ray_stats_frame_t *frame);
+
+/**
+ * @brief append a frame, overwriting the oldest once the log is full
+ */
+void ray_stats_log_add(ray_stats_log_t *log, const ray_stats_frame_t *frame);
+
+/**
+ * @brief drop all recorded frames
+ */
+void ray_stats_log_clear(ray_stats_log_t *log);
+
+/**
+ * @brief print mean steps and termination reasons over the recorded frames
+ */
+void ray_stats_print_summary(const ray_stats_log_t *log);
+
+/**
+ * @brief write every recorded frame (totals, reasons, histogram) as json
+ */
+bool ray_stats_write_json(const ray_stats_log_t *log, const char *path);
+
+#endif // RAY_STATS_H
@@ -0,0 +1,87 @@
+#ifndef READBACK_H
+#define READBACK_H
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+#include <stdbool.h>
+#include <stddef.h>
+
+// frames in flight between capture and delivery
+#define READBACK_RING_SIZE 3
+
+// receives a mapped frame (rgba8 unless readback_set_format says otherwise, rows bottom-up,
+// tightly packed). the pointer is only
+// valid during the call; consumers that keep the pixels must copy them. capture_time is
+// the profiler_now() of the capture, for consumers that measure end-to-end latency.
+typedef void (*readback_consumer_t)(const unsigned char *pixels, int width, int height, int frame_index,
+                                    double capture_time, void *user_data);
+
+typedef struct
+{
+    GLuint buffer;
+    GLsync fence;
+    size_t capacity;
+    int width, height;
+    int frame_index;
+    double capture_time;
+} readback_slot_t;
+
+// ring of pixel buffer objects: frames are copied asynchronously on capture and
+// mapped a few frames later once their fence has signalled
+typedef struct
+{
+    readback_slot_t slots[READBACK_RING_SIZE];
+    int head;       // next slot to capture into
+    int tail;       // oldest slot in flight
+    int in_flight;
+    readback_consumer_t consumer;
+    void *user_data;
+    GLenum format, type; // glReadPixels layout of the captures
+    int pixel_size;      // bytes per pixel of that layout
+
+    // statistics
+    int captured_frames;
+    int delivered_frames;
+    int dropped_frames;
+    int latency_frames_total;
+    double latency_seconds_total;
+    double latency_seconds_max;
+} readback_ring_t;
+
+/**
+ * @brief create the pixel buffers (requires a current gl context)
+ */
+void readback_init(readback_ring_t *ring, readback_consumer_t consumer, void *user_data);
+
+/**
+ * @brief capture another pixel layout than rgba8 (e.g. GL_RG_INTEGER and GL_UNSIGNED_INT, 8
+ * bytes per pixel); call before the first capture
+ */
+void readback_set_format(readback_ring_t *ring, GLenum format, GLenum type, int pixel_size);
+
+/**
+ * @brief queue an asynchronous copy of the framebuffer's colour attachment 0 (or the back
+ * buffer for framebuffer 0). returns false and counts a dropped frame if the ring is full.
+ */
+bool readback_capture(readback_ring_t *ring, GLuint framebuffer, int width, int height, int frame_index);
+
+/**
+ * @brief hand every finished frame to the consumer. with wait set, blocks until the ring is empty.
+ */
+void readback_poll(readback_ring_t *ring, int current_frame_index, bool wait);
+
+/**
+ * @brief print delivered/dropped counts and latency
+ */
+void readback_print_stats(const readback_ring_t *ring);
+
+/**
+ * @brief delete the pixel buffers and fences (pending frames are discarded)
+ */
+void readback_destroy(readback_ring_t *ring);
+
+#endif // READBACK_H
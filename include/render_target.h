@@ -0,0 +1,83 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+#include <stdbool.h>
+
+// allocations are rounded up to a multiple of this many pixels per axis
+#define RENDER_TARGET_SIZE_CLASS 64
+
+// one entry per render pass that owns an offscreen target
+typedef enum
+{
+    RENDER_TARGET_TRACE,     // low resolution output of the ray tracer (sparse when interleaved)
+    RENDER_TARGET_HISTORY_0, // interleaved tracing: reconstructed frames, ping-ponged
+    RENDER_TARGET_HISTORY_1,
+    RENDER_TARGET_UPSCALE_0, // temporal upscaling: window resolution accumulation, ping-ponged
+    RENDER_TARGET_UPSCALE_1,
+    RENDER_TARGET_RAY_STATS, // steps and termination reason per traced pixel (second trace output)
+    RENDER_TARGET_DISPLAY,   // final image when there is no window (headless mode)
+    RENDER_TARGET_COUNT
+} render_target_id_t;
+
+// framebuffer + colour texture pair. the texture is allocated at a size class
+// (alloc_width x alloc_height) and only the width x height corner is used.
+typedef struct
+{
+    GLuint framebuffer;
+    GLuint texture;
+    GLenum internal_format;
+    int width, height;
+    int alloc_width, alloc_height;
+    int requested_width, requested_height;
+} render_target_t;
+
+// owns the targets of every pass; sizes are requested at any time and
+// applied once per frame so resize storms cost at most one reallocation.
+typedef struct
+{
+    render_target_t targets[RENDER_TARGET_COUNT];
+} render_target_manager_t;
+
+/**
+ * @brief set the pixel format of every target; no gl objects are created yet
+ */
+void render_target_manager_init(render_target_manager_t *manager);
+
+/**
+ * @brief record the size a pass wants; takes effect at the next apply
+ */
+void render_target_manager_request(render_target_manager_t *manager, render_target_id_t id, int width, int height);
+
+/**
+ * @brief create or resize targets whose requested size changed (call at a frame boundary)
+ */
+void render_target_manager_apply(render_target_manager_t *manager);
+
+/**
+ * @brief delete the target of a pass that was turned off; it is created again by the next
+ * request and apply
+ */
+void render_target_manager_release(render_target_manager_t *manager, render_target_id_t id);
+
+/**
+ * @brief delete all framebuffers and textures
+ */
+void render_target_manager_destroy(render_target_manager_t *manager);
+
+/**
+ * @brief bind the target's framebuffer and set the viewport to its used area
+ */
+void render_target_bind(const render_target_t *target);
+
+/**
+ * @brief fraction of the allocated texture that holds the image (for sampling)
+ */
+void render_target_uv_scale(const render_target_t *target, float *u, float *v);
+
+#endif // RENDER_TARGET_H
@@ -3,6 +3,14 @@
 
 #include "math_utils.h"
 #include "camera.h"
+#include "physics.h"
+#include "render_target.h"
+#include "shaders.h"
+#include "quality.h"
+#include "starfield.h"
+#include "ray_stats.h"
+#include "readback.h"
+#include "culling.h"
 
 #ifdef __APPLE__
 #define GL_SILENCE_DEPRECATION
@@ -12,20 +20,115 @@
 #endif
 #include <GLFW/glfw3.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+// uniform buffer binding point of the ray tracer's SceneData block
+#define SCENE_UNIFORM_BINDING 0
+
+// texture unit of the baked sky cubemap (units 0 and 1 belong to the per-pass inputs)
+#define STARFIELD_TEXTURE_UNIT 2
+
+// texture unit of the per-tile body candidate masks
+#define BODY_TILES_TEXTURE_UNIT 3
+
+// cpu mirror of the std140 SceneData block (SCENE_DATA_BLOCK in shaders.c).
+// vec3 members are paired with a float so every row fills exactly 16 bytes.
+typedef struct
+{
+    vector3_t cam_pos;
+    float tan_half_fov;
+    vector3_t cam_right;
+    float aspect;
+    vector3_t cam_up;
+    float disk_r1;
+    vector3_t cam_forward;
+    float disk_r2;
+    vector3_t prev_cam_pos; // camera of the previous frame, for history reprojection
+    float focus_distance;
+    vector3_t prev_cam_right;
+    float history_valid;
+    vector3_t prev_cam_up;
+    float upscale_history_valid;
+    vector3_t prev_cam_forward;
+    float scene_reserved;
+    float resolution[2]; // full trace resolution, also when only a subset is traced
+    float time;
+    int interleave_checkerboard;
+    int interleave_scale[2];
+    int interleave_offset[2];
+    float jitter[2];
+    float output_resolution[2];
+    int region_origin[2]; // first pixel of the trace target in the full image (poster tiles)
+    int region_reserved[2];
+    vector4_t obj_pos_radius[MAX_CELESTIAL_BODIES];
+    vector4_t obj_color[MAX_CELESTIAL_BODIES];
+} scene_uniform_block_t;
+
+// interleaved tracing: how many frames it takes to trace every pixel once
+typedef enum
+{
+    INTERLEAVE_OFF = 1,
+    INTERLEAVE_CHECKERBOARD = 2, // half the pixels per frame
+    INTERLEAVE_2X2 = 4           // one pixel of every 2x2 block per frame
+} interleave_mode_t;
 
 // renderer engine
 typedef struct
 {
     GLFWwindow *window;
     GLuint fullscreen_quad_vao;
-    GLuint render_texture;
-    GLuint raytracer_shader_program;
+    render_target_manager_t render_targets;
+    quality_controller_t quality;                   // preset ladder; configure before engine_initialize
+    GLuint raytracer_programs[QUALITY_MAX_PRESETS]; // one permutation per quality preset
+    int quality_level;                              // preset used for the current frame
+    int quality_render_scale;                       // preset render_scale the trace targets are sized for
     GLuint grid_shader_program;
     GLuint texture_quad_shader_program;
+    GLuint scene_ubo;
+    GLint grid_view_proj_location;
+    GLint texture_quad_uv_scale_location;
+    GLuint reconstruct_program;
+    GLuint upscale_program;
+    GLuint heatmap_program;
+    GLint heatmap_stats_size_location, heatmap_max_steps_location;
+    GLuint stats_programs[QUALITY_MAX_PRESETS]; // ENABLE_STATS permutations, compiled on first use
+    bool ray_stats_enabled;    // trace with the stats permutation and reduce every frame
+    bool heatmap_visible;      // draw the step heatmap over the image
+    ray_stats_log_t ray_stats;
+    readback_ring_t ray_stats_ring; // asynchronous readback of the stats target, reduced when it arrives
+    ray_stats_frame_t ray_stats_pending[READBACK_RING_SIZE]; // frame, preset and budget of the captures in flight
+    int ray_stats_pending_first, ray_stats_pending_count;
+    starfield_t starfield;     // cpu copy of the sky, for starfield_sample
+    GLuint starfield_texture;  // the same sky as a mipmapped cubemap
+    const char *sky_path;      // equirectangular ppm panorama; NULL bakes the procedural stars
+    bool body_culling_enabled; // test only the bodies a tile can see (culling.c); off = every body everywhere
+    GLuint body_tile_texture;  // r32ui, one candidate mask per CULLING_TILE_SIZE tile of the trace target
+    int body_tiles_x, body_tiles_y;
+    uint32_t *body_tile_masks;
+    size_t body_tile_capacity;
+    int view_width, view_height; // nonzero while the trace target is a window of a larger image (posters)
+    int region_x, region_y;      // bottom-left pixel of that window
     GLuint grid_vao, grid_vbo, grid_ebo;
     int grid_index_count;
     int window_width, window_height;
-    int render_texture_width, render_texture_height;
+    int render_scale_divisor; // trace target is the window size divided by this (times the preset's render_scale)
+    bool headless;            // offscreen egl context; the output image is RENDER_TARGET_DISPLAY
+    int frame_index;
+    int frame_limit;          // headless runs stop after this many frames (0 = unbounded)
+    double start_time;
+    bool clock_fixed;         // replays: engine_get_time returns fixed_time instead of the wall clock
+    double fixed_time;
+    bool resize_pending;
+    int pending_window_width, pending_window_height;
+    interleave_mode_t interleave_mode;
+    int interleave_phase;      // advances every traced frame, selects the pixel subset
+    int history_index;         // history target written this frame
+    bool history_valid;        // false after resizes and mode changes
+    vector3_t prev_cam_pos, prev_cam_right, prev_cam_up, prev_cam_forward;
+    bool upscale_enabled;      // accumulate jittered traces at window resolution instead of stretching them
+    int upscale_phase;         // index into the jitter sequence
+    int upscale_index;         // upscale target written this frame
+    bool upscale_history_valid;
 } renderer_engine_t;
 
 // global renderer engine
@@ -34,11 +137,75 @@ extern renderer_engine_t renderer_engine;
 // initializes glfw, opengl context, shaders, and all rendering objects.
 bool engine_initialize(renderer_engine_t *engine);
 
+// same as engine_initialize but on an offscreen egl context rendering width x height, without vsync.
+bool engine_initialize_headless(renderer_engine_t *engine, int width, int height);
+
+// resolves uniform locations and block bindings once, after the programs are linked.
+void engine_init_shader_bindings(renderer_engine_t *engine);
+
 // initializes a vertex array object for drawing a fullscreen quad.
 void engine_init_fullscreen_quad(renderer_engine_t *engine);
 
-// initializes the texture used as a render target for the ray tracer.
-void engine_init_render_texture(renderer_engine_t *engine);
+// creates the offscreen render targets for the current window size.
+void engine_init_render_targets(renderer_engine_t *engine);
+
+// records a new framebuffer size; applied by engine_begin_frame so callbacks never touch gl objects.
+void engine_request_resize(renderer_engine_t *engine, int width, int height);
+
+// applies pending resizes to the viewport and render targets. call once at the start of each frame.
+void engine_begin_frame(renderer_engine_t *engine);
+
+// framebuffer that receives the final image: 0 for the window, the display target when headless.
+GLuint engine_output_framebuffer(const renderer_engine_t *engine);
+
+// binds the framebuffer that receives the final image (window or offscreen display target).
+void engine_bind_output_framebuffer(renderer_engine_t *engine);
+
+// seconds since the engine was initialized (or the pinned clock, see engine_set_fixed_time).
+double engine_get_time(const renderer_engine_t *engine);
+
+// seconds since the engine was initialized, never pinned.
+double engine_get_wall_time(const renderer_engine_t *engine);
+
+// pins engine_get_time to seconds (until the next call), so recorded runs and their replays
+// drive the quality controller, the shaders and the input handling with the same clock.
+void engine_set_fixed_time(renderer_engine_t *engine, double seconds);
+
+// true once the window was closed, or the headless frame limit was reached.
+bool engine_should_close(const renderer_engine_t *engine);
+
+// swaps buffers (or flushes in headless mode) and advances frame_index.
+void engine_present(renderer_engine_t *engine);
+
+// processes window events; no-op in headless mode.
+void engine_poll_events(renderer_engine_t *engine);
+
+// sleeps until a window event arrives or timeout seconds pass, then processes the events; no-op in headless mode.
+void engine_wait_events(renderer_engine_t *engine, double timeout);
+
+// reads the output framebuffer back synchronously and writes it as a binary ppm.
+bool engine_write_output_ppm(renderer_engine_t *engine, const char *path);
+
+// advances the quality controller and resizes the trace target if the preset asks for it.
+// returns the preset index used for this frame.
+int engine_update_quality(renderer_engine_t *engine);
+
+// switches interleaved tracing; resizes the trace target and drops the history.
+void engine_set_interleave_mode(renderer_engine_t *engine, interleave_mode_t mode);
+
+// switches temporal upscaling and drops its history.
+void engine_set_upscale(renderer_engine_t *engine, bool enabled);
+
+// makes the trace target a window at (x, y) of a width x height image instead of the whole
+// frame (poster tiles); 0 x 0 goes back to whole frames. the scene is frozen at time 0 meanwhile.
+void engine_set_view_region(renderer_engine_t *engine, int width, int height, int x, int y);
+
+// switches ray statistics on (compiling the stats permutations once) or off; clears the log when enabled.
+bool engine_set_ray_stats(renderer_engine_t *engine, bool enabled);
+
+// reduces every ray stats readback still in flight into the log (waiting for the gpu), so
+// the log is complete before it is printed or written.
+void engine_flush_ray_stats(renderer_engine_t *engine);
 
 // renders the main scene using the ray tracing shader into a texture.
 void engine_render_raytraced_scene_to_texture(renderer_engine_t *engine, camera_t *cam);
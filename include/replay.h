@@ -0,0 +1,98 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "camera.h"
+#include "physics.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// file signature and format version
+#define REPLAY_MAGIC "BHREPLAY"
+#define REPLAY_VERSION 1
+
+typedef enum
+{
+    REPLAY_OFF,
+    REPLAY_RECORDING,
+    REPLAY_PLAYING,
+} replay_mode_t;
+
+// one input as the glfw callbacks receive it
+typedef enum
+{
+    REPLAY_EVENT_MOUSE_BUTTON, // a = button, b = action, c = mods, x/y = cursor position
+    REPLAY_EVENT_CURSOR,       // x/y = cursor position
+    REPLAY_EVENT_SCROLL,       // x/y = offsets
+    REPLAY_EVENT_KEY,          // a = key, b = scancode, c = action, d = mods
+    REPLAY_EVENT_RESIZE,       // a/b = framebuffer size
+} replay_event_type_t;
+
+typedef struct
+{
+    replay_event_type_t type;
+    int a, b, c, d;
+    double x, y;
+} replay_event_t;
+
+// everything the run starts from besides the command line options
+typedef struct
+{
+    int body_count;
+    celestial_body_t bodies[MAX_CELESTIAL_BODIES];
+    camera_t camera;
+    int collision_mode;
+    int width, height; // framebuffer size
+    double start_time; // engine clock when the first frame's delta is measured from
+} replay_seed_t;
+
+// a recording or playback in progress
+typedef struct
+{
+    replay_mode_t mode;
+    FILE *file;
+    const char *path;
+    bool paced;        // playback: hold every frame until its recorded time
+    int frame_count;   // frames recorded or played so far
+    long event_count;  // events recorded or played so far
+    double wall_start; // playback: wall clock at the first frame
+    double first_time; // playback: recorded clock of the first frame
+    int next_record;   // playback: tag of the record read ahead, EOF at the end
+} replay_t;
+
+// the app's replay, fed by the input callbacks and the main loop
+extern replay_t replay_session;
+
+/**
+ * @brief start logging to path: the seed now, then every frame's clock and the inputs that
+ * arrive during it. the file is compact binary in host byte order.
+ */
+bool replay_start_recording(replay_t *replay, const char *path, const replay_seed_t *seed);
+
+/**
+ * @brief open a recording and read its seed; with paced the frames keep the recorded
+ * timing, otherwise they run as fast as possible
+ */
+bool replay_start_playback(replay_t *replay, const char *path, bool paced, replay_seed_t *seed);
+
+/**
+ * @brief begin a frame: records *time as the frame's clock, or replaces it with the
+ * recorded one (waiting for it when paced). returns false once a playback has no frames left.
+ */
+bool replay_begin_frame(replay_t *replay, double *time);
+
+/**
+ * @brief append an input to the current frame (no-op unless recording)
+ */
+void replay_record_event(replay_t *replay, const replay_event_t *event);
+
+/**
+ * @brief next recorded input of the current frame; false when the frame has no more
+ */
+bool replay_next_event(replay_t *replay, replay_event_t *event);
+
+/**
+ * @brief finish the file and print what was recorded or played
+ */
+void replay_close(replay_t *replay);
+
+#endif // REPLAY_H
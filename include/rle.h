@@ -0,0 +1,23 @@
+#ifndef RLE_H
+#define RLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// worst-case encoded size of pixel_count rgb pixels (no two neighbours equal)
+#define RLE_MAX_ENCODED_SIZE(pixel_count) ((size_t)(pixel_count) * 4)
+
+/**
+ * @brief run-length encode rgb8 pixels as (run length - 1, r, g, b) records of up to 256
+ * equal pixels; returns the encoded size. out holds RLE_MAX_ENCODED_SIZE(pixel_count) bytes.
+ *
+ * the black shadow, the empty sky between stars and flat bodies come out as long runs.
+ */
+size_t rle_encode_rgb(const unsigned char *rgb, int pixel_count, unsigned char *out);
+
+/**
+ * @brief decode exactly pixel_count pixels into rgb; false if the data is short, long or corrupt
+ */
+bool rle_decode_rgb(const unsigned char *data, size_t size, unsigned char *rgb, int pixel_count);
+
+#endif // RLE_H
@@ -0,0 +1,26 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+#include <stdbool.h>
+
+/**
+ * @brief pick the cache directory and read the driver identity (requires a current gl context).
+ * the directory is $BLACKHOLE_SHADER_CACHE_DIR, else $XDG_CACHE_HOME/blackhole-simulator,
+ * else ~/.cache/blackhole-simulator. caching is disabled if the driver has no binary formats.
+ */
+void shader_cache_init(void);
+
+/**
+ * @brief create a program from source, loading a cached program binary instead when one
+ * exists for the same sources and driver. falls back to compiling (and refreshes the cache
+ * entry) when the binary is missing, stale or rejected by the driver.
+ */
+GLuint shader_cache_create_program(const char *vertex_source, const char *fragment_source);
+
+#endif // SHADER_CACHE_H
@@ -1,12 +1,29 @@
 #ifndef SHADERS_H
 #define SHADERS_H
 
+#include "geodesic.h"
+
 #ifdef __APPLE__
 #define GL_SILENCE_DEPRECATION
 #include <OpenGL/gl3.h>
 #else
 #include <GL/glew.h>
 #endif
+#include <stdbool.h>
+
+// compile-time configuration of the ray tracer; every field becomes a #define so the
+// driver can unroll the body loop and fold the step constants.
+typedef struct
+{
+    int num_objects;   // NUM_OBJECTS
+    int max_steps;     // MAX_STEPS
+    float step_size;   // STEP_SIZE, base affine step before distance scaling
+    raytracer_integrator_t integrator;
+    bool enable_disk;
+    bool enable_bodies;
+    bool enable_starfield;
+    bool enable_stats; // second output with steps and termination reason per pixel (ray_stats.h)
+} raytracer_permutation_t;
 
 // compiles a shader from a source string
 GLuint utility_compile_shader(const char *source, GLenum type);
@@ -14,12 +31,21 @@ GLuint utility_compile_shader(const char *source, GLenum type);
 // creates a shader program by linking vertex and fragment shaders
 GLuint utility_create_shader_program(const char *vertex_source, const char *fragment_source);
 
+// same as utility_create_shader_program, but lets glGetProgramBinary retrieve the linked program
+GLuint utility_create_retrievable_shader_program(const char *vertex_source, const char *fragment_source);
+
+// returns a malloc'd ray tracer fragment source specialized for the permutation
+char *utility_build_raytracer_source(const raytracer_permutation_t *permutation);
+
 // shader source code
 extern const char *quad_vertex_shader_source;
 extern const char *quad_fragment_shader_source;
 extern const char *grid_vertex_shader_source;
 extern const char *grid_fragment_shader_source;
 extern const char *raytracer_fragment_shader_source;
+extern const char *reconstruct_fragment_shader_source;
+extern const char *upscale_fragment_shader_source;
+extern const char *heatmap_fragment_shader_source;
 
 #endif // SHADERS_H
 
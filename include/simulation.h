@@ -0,0 +1,24 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "body.h"
+#include "collision.h"
+
+// the app's scene: two stars orbiting a supermassive black hole (body 2)
+#define SIMULATION_INITIAL_BODY_COUNT 3
+#define SIMULATION_SCHWARZSCHILD_RADIUS 1.269e10f
+
+// initial state of the app's scene, shared by the app, the tools and the benches
+extern const celestial_body_t simulation_initial_bodies[SIMULATION_INITIAL_BODY_COUNT];
+
+/**
+ * @brief advance count bodies by delta_time seconds: gravity between every pair, then the
+ * position update, then contacts found with broadphase and handled by mode. with
+ * COLLISION_OFF overlapping bodies pull on each other not at all and no contacts are searched.
+ *
+ * no locks, threads or gl; in_bodies and out_bodies may be the same array (in-place step).
+ */
+void simulation_step_buffered(const celestial_body_t *in_bodies, celestial_body_t *out_bodies, int count,
+                              double delta_time, collision_mode_t mode, collision_broadphase_t *broadphase);
+
+#endif // SIMULATION_H
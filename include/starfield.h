@@ -0,0 +1,50 @@
+#ifndef STARFIELD_H
+#define STARFIELD_H
+
+#include "math_utils.h"
+#include <stdbool.h>
+
+// default edge length of one cube face, roughly the angular resolution of the trace target
+#define STARFIELD_DEFAULT_FACE_SIZE 256
+
+// cube face order matches GL_TEXTURE_CUBE_MAP_POSITIVE_X + face
+typedef enum
+{
+    STARFIELD_FACE_POSITIVE_X,
+    STARFIELD_FACE_NEGATIVE_X,
+    STARFIELD_FACE_POSITIVE_Y,
+    STARFIELD_FACE_NEGATIVE_Y,
+    STARFIELD_FACE_POSITIVE_Z,
+    STARFIELD_FACE_NEGATIVE_Z,
+    STARFIELD_FACE_COUNT
+} starfield_face_t;
+
+// sky background as a cubemap in host memory: six face_size x face_size rgba8
+// faces, rows in the gl cubemap convention (first row is t = 0)
+typedef struct
+{
+    int face_size;
+    unsigned char *faces[STARFIELD_FACE_COUNT];
+} starfield_t;
+
+/**
+ * @brief fill the cubemap with the procedural point-star sky
+ */
+bool starfield_bake(starfield_t *starfield, int face_size);
+
+/**
+ * @brief fill the cubemap from an equirectangular binary ppm (p6) panorama
+ */
+bool starfield_load_panorama(starfield_t *starfield, const char *path, int face_size);
+
+/**
+ * @brief bilinear lookup of the base level in the given direction (cpu ray paths)
+ */
+vector4_t starfield_sample(const starfield_t *starfield, vector3_t direction);
+
+/**
+ * @brief free the faces
+ */
+void starfield_destroy(starfield_t *starfield);
+
+#endif // STARFIELD_H
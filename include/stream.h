@@ -0,0 +1,97 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+frame streaming to remote viewers. finished frames are compared with the previous one
+tile by tile; the tiles that changed are run-length encoded and sent to every client on a
+server thread. a client still busy with earlier frames skips frames (and gets the latest one
+as a keyframe once it has caught up) instead of holding up the others or the render loop.
+
+on the wire, frames and acks are net messages (see net.h).
+**/
+
+// edge length of a dirty-detection tile in pixels
+#define STREAM_TILE_SIZE 32
+
+// viewers connected at once
+#define STREAM_MAX_CLIENTS 16
+
+// frames a client may have unacknowledged; beyond that it skips frames instead of queueing
+// them in socket buffers, which keeps a slow viewer's latency bounded
+#define STREAM_MAX_IN_FLIGHT 2
+
+// latency samples kept for the percentiles of the summary
+#define STREAM_LATENCY_SAMPLES 4096
+
+typedef enum
+{
+    STREAM_MESSAGE_FRAME = 1, // server -> client: stream_frame_header_t, then the tiles
+    STREAM_MESSAGE_ACK,       // client -> server: stream_ack_t once the frame is decoded
+} stream_message_type_t;
+
+// payload of STREAM_MESSAGE_FRAME, followed by tile_count (stream_tile_t, rle bytes) records
+typedef struct
+{
+    int32_t frame_index;
+    int32_t width, height; // pixels; rgb rows top-down
+    int32_t tile_size;
+    uint32_t tile_count;
+    uint32_t keyframe; // 1: every tile is present; 0: only the tiles that changed since the last frame
+} stream_frame_header_t;
+
+typedef struct
+{
+    uint32_t tile; // row by row from the top-left
+    uint32_t encoded_size;
+} stream_tile_t;
+
+typedef struct
+{
+    int32_t frame_index;
+} stream_ack_t;
+
+typedef struct stream_server stream_server_t;
+
+// a client's copy of the stream
+typedef struct
+{
+    unsigned char *rgb; // width x height, rows top-down
+    int width, height;
+    int frame_index;
+    bool keyframe; // the last frame applied was a keyframe
+} stream_view_t;
+
+/**
+ * @brief listen on the address and start the server thread; NULL on failure
+ */
+stream_server_t *stream_server_start(const char *address);
+
+/**
+ * @brief hand a finished frame to the server: rgba8 rows bottom-up, as read back from gl
+ *
+ * only copies the pixels; encoding and sending happen on the server thread. a frame that
+ * wasn't picked up yet is replaced. capture_time is when the frame was finished (profiler_now).
+ */
+void stream_server_submit(stream_server_t *server, const unsigned char *rgba, int width, int height, int frame_index,
+                          double capture_time);
+
+/**
+ * @brief stop the thread, disconnect the clients and print encode, size and latency statistics
+ */
+void stream_server_stop(stream_server_t *server);
+
+/**
+ * @brief apply a STREAM_MESSAGE_FRAME payload to view; false if it is corrupt or a delta
+ * arrives before the first keyframe
+ */
+bool stream_view_apply(stream_view_t *view, const unsigned char *payload, uint32_t length);
+
+/**
+ * @brief free the view's pixels
+ */
+void stream_view_free(stream_view_t *view);
+
+#endif // STREAM_H
@@ -0,0 +1,216 @@
+/**
+libblackhole contexts: a scene, integrator settings and a small thread pool that splits
+each batch of rays into chunks the caller's thread and the workers take in turn
+**/
+
+#define _GNU_SOURCE
+
+#include "blackhole.h"
+#include "geodesic.h"
+#include "simulation.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// rays per chunk: a ray costs up to a full step budget, so chunks stay small to balance
+// rays that escape quickly against rays that circle the hole; the shared counter is cheap next to that
+#define BLACKHOLE_CHUNK_RAYS 16
+
+struct blackhole_context
+{
+    geodesic_scene_t scene;
+    raytracer_integrator_t integrator;
+    int max_steps;
+    float step_size;
+
+    int thread_count; // the caller included
+    pthread_t threads[BLACKHOLE_MAX_THREADS];
+    pthread_mutex_t mutex;
+    pthread_cond_t batch_ready; // a batch was published, or the context is stopping
+    pthread_cond_t batch_done;  // the last worker left the batch
+
+    // the batch in flight
+    const blackhole_rays_t *rays;
+    const blackhole_results_t *results;
+    int count;
+    atomic_int next_chunk;
+    int busy_workers;         // workers still inside the batch
+    unsigned long generation; // bumped per batch, so a worker joins every batch once
+    bool stopping;
+};
+
+static void blackhole_trace_one(const blackhole_context_t *context, const blackhole_rays_t *rays,
+                                const blackhole_results_t *results, int i)
+{
+    vector3_t origin = {rays->origin_x[i], rays->origin_y[i], rays->origin_z[i]};
+    vector3_t direction = vector3_normalize((vector3_t){rays->direction_x[i], rays->direction_y[i], rays->direction_z[i]});
+    geodesic_hit_t hit;
+    geodesic_trace(&context->scene, context->integrator, context->max_steps, context->step_size, origin, direction, &hit);
+
+    if (results->hit)
+        results->hit[i] = (uint8_t)hit.reason;
+    if (results->escape_x)
+        results->escape_x[i] = hit.direction.x;
+    if (results->escape_y)
+        results->escape_y[i] = hit.direction.y;
+    if (results->escape_z)
+        results->escape_z[i] = hit.direction.z;
+    if (results->disk_radius)
+        results->disk_radius[i] =
+            hit.reason == RAY_STATS_DISK ? sqrtf(hit.position.x * hit.position.x + hit.position.z * hit.position.z) : 0.0f;
+    if (results->steps)
+        results->steps[i] = hit.steps;
+}
+
+// take chunks of the current batch until none is left
+static void blackhole_run_chunks(blackhole_context_t *context)
+{
+    for (;;)
+    {
+        int start = atomic_fetch_add(&context->next_chunk, 1) * BLACKHOLE_CHUNK_RAYS;
+        if (start >= context->count)
+            return;
+        int end = start + BLACKHOLE_CHUNK_RAYS < context->count ? start + BLACKHOLE_CHUNK_RAYS : context->count;
+        for (int i = start; i < end; ++i)
+            blackhole_trace_one(context, context->rays, context->results, i);
+    }
+}
+
+static void *blackhole_worker(void *arg)
+{
+    blackhole_context_t *context = arg;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&context->mutex);
+    for (;;)
+    {
+        while (!context->stopping && context->generation == seen)
+            pthread_cond_wait(&context->batch_ready, &context->mutex);
+        if (context->stopping)
+            break;
+        seen = context->generation;
+        pthread_mutex_unlock(&context->mutex);
+
+        blackhole_run_chunks(context);
+
+        pthread_mutex_lock(&context->mutex);
+        if (--context->busy_workers == 0)
+            pthread_cond_signal(&context->batch_done);
+    }
+    pthread_mutex_unlock(&context->mutex);
+    return NULL;
+}
+
+blackhole_config_t blackhole_default_config(void)
+{
+    return (blackhole_config_t){
+        .thread_count = 0,
+        .integrator = BLACKHOLE_INTEGRATOR_SPHERICAL,
+        .max_steps = 26000,
+        .step_size = 5e7f,
+    };
+}
+
+blackhole_context_t *blackhole_create(const blackhole_config_t *config)
+{
+    blackhole_context_t *context = calloc(1, sizeof(blackhole_context_t));
+    if (!context)
+        return NULL;
+
+    context->integrator = config->integrator == BLACKHOLE_INTEGRATOR_CARTESIAN ? RAYTRACER_INTEGRATOR_CARTESIAN
+                                                                               : RAYTRACER_INTEGRATOR_SPHERICAL_EULER;
+    context->max_steps = config->max_steps > 0 ? config->max_steps : 26000;
+    context->step_size = config->step_size > 0.0f ? config->step_size : 5e7f;
+    float rs = SIMULATION_SCHWARZSCHILD_RADIUS;
+    blackhole_set_black_hole(context, rs, rs * 2.2f, rs * 5.2f);
+
+    int threads = config->thread_count;
+    if (threads <= 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (int)cores : 1;
+    }
+    threads = threads < BLACKHOLE_MAX_THREADS ? threads : BLACKHOLE_MAX_THREADS;
+
+    pthread_mutex_init(&context->mutex, NULL);
+    pthread_cond_init(&context->batch_ready, NULL);
+    pthread_cond_init(&context->batch_done, NULL);
+    context->thread_count = 1;
+    for (int i = 0; i < threads - 1; ++i)
+    {
+        if (pthread_create(&context->threads[i], NULL, blackhole_worker, context) != 0)
+            break; // fewer threads still work
+        ++context->thread_count;
+    }
+    return context;
+}
+
+void blackhole_destroy(blackhole_context_t *context)
+{
+    if (!context)
+        return;
+    pthread_mutex_lock(&context->mutex);
+    context->stopping = true;
+    pthread_cond_broadcast(&context->batch_ready);
+    pthread_mutex_unlock(&context->mutex);
+    for (int i = 0; i < context->thread_count - 1; ++i)
+        pthread_join(context->threads[i], NULL);
+    pthread_cond_destroy(&context->batch_done);
+    pthread_cond_destroy(&context->batch_ready);
+    pthread_mutex_destroy(&context->mutex);
+    free(context);
+}
+
+void blackhole_set_black_hole(blackhole_context_t *context, float schwarzschild_radius, float disk_inner, float disk_outer)
+{
+    context->scene.schwarzschild_radius = schwarzschild_radius;
+    context->scene.disk_r1 = disk_inner;
+    context->scene.disk_r2 = disk_outer;
+}
+
+bool blackhole_set_bodies(blackhole_context_t *context, const float *position_radius, int count)
+{
+    if (count < 0 || count > BLACKHOLE_MAX_BODIES || count > MAX_CELESTIAL_BODIES)
+        return false;
+    context->scene.body_count = count;
+    for (int i = 0; i < count; ++i)
+    {
+        const float *b = position_radius + 4 * i;
+        context->scene.body_pos_radius[i] = (vector4_t){b[0], b[1], b[2], b[3]};
+    }
+    return true;
+}
+
+void blackhole_trace_rays(blackhole_context_t *context, const blackhole_rays_t *rays, const blackhole_results_t *results,
+                          int count)
+{
+    if (count <= 0)
+        return;
+
+    context->rays = rays;
+    context->results = results;
+    context->count = count;
+    atomic_store(&context->next_chunk, 0);
+
+    // small batches aren't worth waking the workers
+    int workers = context->thread_count - 1;
+    if (workers == 0 || count <= BLACKHOLE_CHUNK_RAYS)
+    {
+        blackhole_run_chunks(context);
+        return;
+    }
+
+    pthread_mutex_lock(&context->mutex);
+    context->busy_workers = workers;
+    ++context->generation;
+    pthread_cond_broadcast(&context->batch_ready);
+    pthread_mutex_unlock(&context->mutex);
+
+    blackhole_run_chunks(context);
+
+    pthread_mutex_lock(&context->mutex);
+    while (context->busy_workers > 0)
+        pthread_cond_wait(&context->batch_done, &context->mutex);
+    pthread_mutex_unlock(&context->mutex);
+}
@@ -7,6 +7,11 @@ utils for visualization, callback functions for the glfw window.
 #include "physics.h"
 #include "grid.h"
 #include "renderer.h"
+#include "profiler.h"
+#include "quality.h"
+#include "ray_stats.h"
+#include "replay.h"
+#include "idle.h"
 #include <stdio.h>
 
 #ifdef __APPLE__
@@ -16,15 +21,17 @@ utils for visualization, callback functions for the glfw window.
 #include <GL/glew.h>
 #endif
 
-// handles mouse button press and release
-void callback_mouse_button(GLFWwindow *window, int button, int action, int mods)
+// handles mouse button press and release; x, y is the cursor position at the time
+static void callback_apply_mouse_button(int button, int action, double x, double y)
 {
     if (button == GLFW_MOUSE_BUTTON_LEFT)
     {
         if (action == GLFW_PRESS)
         {
             camera.is_dragging_orbit = true;
-            glfwGetCursorPos(window, &camera.last_cursor_x, &camera.last_cursor_y);
+            quality_notify_input(&renderer_engine.quality, engine_get_time(&renderer_engine));
+            camera.last_cursor_x = x;
+            camera.last_cursor_y = y;
         }
         else if (action == GLFW_RELEASE)
         {
@@ -36,7 +43,9 @@ void callback_mouse_button(GLFWwindow *window, int button, int action, int mods)
         if (action == GLFW_PRESS)
         {
             camera.is_dragging_pan = true;
-            glfwGetCursorPos(window, &camera.last_cursor_x, &camera.last_cursor_y);
+            quality_notify_input(&renderer_engine.quality, engine_get_time(&renderer_engine));
+            camera.last_cursor_x = x;
+            camera.last_cursor_y = y;
         }
         else if (action == GLFW_RELEASE)
         {
@@ -47,26 +56,33 @@ void callback_mouse_button(GLFWwindow *window, int button, int action, int mods)
 }
 
 // passes cursor position to the camera_process_mouse_move function
-void callback_cursor_position(GLFWwindow *window, double xpos, double ypos)
+static void callback_apply_cursor_position(double xpos, double ypos)
 {
+    // dragging keeps the quality down; it is restored once the input settles
+    if (camera.is_dragging_orbit || camera.is_dragging_pan)
+    {
+        quality_notify_input(&renderer_engine.quality, engine_get_time(&renderer_engine));
+    }
     camera_process_mouse_move(&camera, xpos, ypos);
 }
 
 // passes scroll offset to the camera_process_scroll function
-void callback_scroll(GLFWwindow *window, double xoffset, double yoffset)
+static void callback_apply_scroll(double yoffset)
 {
+    quality_notify_input(&renderer_engine.quality, engine_get_time(&renderer_engine));
     camera_process_scroll(&camera, yoffset);
 }
 
-# handles keyboard events
-void callback_key(GLFWwindow *window, int key, int scancode, int action, int mods)
+// handles keyboard events
+static void callback_apply_key(GLFWwindow *window, int key, int action)
 {
     if (action == GLFW_PRESS)
     {
         switch (key)
         {
         case GLFW_KEY_ESCAPE:
-            glfwSetWindowShouldClose(window, GLFW_TRUE);
+            if (window)
+                glfwSetWindowShouldClose(window, GLFW_TRUE);
             break;
         case GLFW_KEY_R:
             camera_reset(&camera);
@@ -82,23 +98,146 @@ void callback_key(GLFWwindow *window, int key, int scancode, int action, int mod
             is_grid_visible = !is_grid_visible;
             printf("[INFO] Grid %s\n", is_grid_visible ? "visible" : "hidden");
             break;
+        // toggles the frame-stage profiler overlay
+        case GLFW_KEY_O:
+            is_profiler_overlay_visible = !is_profiler_overlay_visible;
+            printf("[INFO] Profiler overlay %s\n", is_profiler_overlay_visible ? "visible" : "hidden");
+            break;
+        // dumps stage percentiles and a chrome trace of the recent frames
+        case GLFW_KEY_T:
+            profiler_print_summary();
+            profiler_write_trace("blackhole_trace.json");
+            engine_flush_ray_stats(&renderer_engine);
+            if (renderer_engine.ray_stats.count > 0)
+            {
+                ray_stats_write_json(&renderer_engine.ray_stats, "blackhole_ray_stats.json");
+            }
+            break;
+        // cycles interleaved tracing: every pixel, half of them, a quarter of them per frame
+        case GLFW_KEY_C:
+        {
+            interleave_mode_t mode = renderer_engine.interleave_mode == INTERLEAVE_OFF            ? INTERLEAVE_CHECKERBOARD
+                                     : renderer_engine.interleave_mode == INTERLEAVE_CHECKERBOARD ? INTERLEAVE_2X2
+                                                                                                  : INTERLEAVE_OFF;
+            engine_set_interleave_mode(&renderer_engine, mode);
+            printf("[INFO] Interleaved tracing: 1/%d of the pixels per frame\n", (int)mode);
+            break;
+        }
+        // toggles temporal upscaling (off = bilinear stretch of the trace target)
+        case GLFW_KEY_U:
+            engine_set_upscale(&renderer_engine, !renderer_engine.upscale_enabled);
+            printf("[INFO] Temporal upscaling %s\n", renderer_engine.upscale_enabled ? "enabled" : "disabled");
+            break;
+        // toggles per-tile body culling, to compare the ray trace cost with and without it
+        case GLFW_KEY_B:
+            renderer_engine.body_culling_enabled = !renderer_engine.body_culling_enabled;
+            printf("[INFO] Body culling %s\n", renderer_engine.body_culling_enabled ? "enabled" : "disabled");
+            break;
+        // toggles the ray-step heatmap; the statistics are gathered while it is visible
+        case GLFW_KEY_H:
+            if (engine_set_ray_stats(&renderer_engine, !renderer_engine.heatmap_visible))
+            {
+                renderer_engine.heatmap_visible = !renderer_engine.heatmap_visible;
+                if (!renderer_engine.heatmap_visible)
+                {
+                    ray_stats_print_summary(&renderer_engine.ray_stats);
+                }
+            }
+            break;
         }
     }
 }
 
+// sizes the window so its framebuffer is width x height, whatever the display's content scale
+static void callback_resize_window(GLFWwindow *window, int width, int height)
+{
+    int window_width, window_height, framebuffer_width, framebuffer_height;
+    glfwGetWindowSize(window, &window_width, &window_height);
+    glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+    if (framebuffer_width <= 0 || framebuffer_height <= 0)
+        return; // minimized
+    glfwSetWindowSize(window, width * window_width / framebuffer_width, height * window_height / framebuffer_height);
+}
+
+void callback_begin_replay(GLFWwindow *window, int width, int height)
+{
+    glfwSetWindowAttrib(window, GLFW_RESIZABLE, GLFW_FALSE);
+    callback_resize_window(window, width, height);
+    engine_request_resize(&renderer_engine, width, height);
+}
+
+void callback_apply_event(GLFWwindow *window, const replay_event_t *event)
+{
+    // keys toggle state the idle tracker doesn't watch; plain cursor moves change nothing
+    if (event->type != REPLAY_EVENT_CURSOR)
+    {
+        idle_mark(&idle_tracker, IDLE_DIRTY_INPUT);
+    }
+
+    switch (event->type)
+    {
+    case REPLAY_EVENT_MOUSE_BUTTON:
+        callback_apply_mouse_button(event->a, event->b, event->x, event->y);
+        break;
+    case REPLAY_EVENT_CURSOR:
+        callback_apply_cursor_position(event->x, event->y);
+        break;
+    case REPLAY_EVENT_SCROLL:
+        callback_apply_scroll(event->y);
+        break;
+    case REPLAY_EVENT_KEY:
+        callback_apply_key(window, event->a, event->c);
+        break;
+    case REPLAY_EVENT_RESIZE:
+        // a replayed resize sizes the window too; its live framebuffer event then follows
+        if (window && replay_session.mode == REPLAY_PLAYING)
+            callback_resize_window(window, event->a, event->b);
+        // only record the size; the viewport and render targets are resized at the next frame boundary
+        engine_request_resize(&renderer_engine, event->a, event->b);
+        break;
+    }
+}
+
+// live input is recorded while recording and ignored while a replay plays (escape still quits,
+// and the render targets still follow the real framebuffer)
+static void callback_live_event(GLFWwindow *window, const replay_event_t *event)
+{
+    if (replay_session.mode == REPLAY_PLAYING)
+    {
+        if (event->type == REPLAY_EVENT_KEY && event->a == GLFW_KEY_ESCAPE && event->c == GLFW_PRESS)
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+        else if (event->type == REPLAY_EVENT_RESIZE)
+            engine_request_resize(&renderer_engine, event->a, event->b);
+        return;
+    }
+    replay_record_event(&replay_session, event);
+    callback_apply_event(window, event);
+}
+
+void callback_mouse_button(GLFWwindow *window, int button, int action, int mods)
+{
+    double x, y;
+    glfwGetCursorPos(window, &x, &y);
+    callback_live_event(window, &(replay_event_t){REPLAY_EVENT_MOUSE_BUTTON, button, action, mods, 0, x, y});
+}
+
+void callback_cursor_position(GLFWwindow *window, double xpos, double ypos)
+{
+    callback_live_event(window, &(replay_event_t){REPLAY_EVENT_CURSOR, 0, 0, 0, 0, xpos, ypos});
+}
+
+void callback_scroll(GLFWwindow *window, double xoffset, double yoffset)
+{
+    callback_live_event(window, &(replay_event_t){REPLAY_EVENT_SCROLL, 0, 0, 0, 0, xoffset, yoffset});
+}
+
+void callback_key(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    callback_live_event(window, &(replay_event_t){REPLAY_EVENT_KEY, key, scancode, action, mods, 0.0, 0.0});
+}
+
 // window resize
 void callback_framebuffer_size(GLFWwindow *window, int width, int height)
 {
-    // update viewport and renderer engine dimensions
-    glViewport(0, 0, width, height);
-    renderer_engine.window_width = width;
-    renderer_engine.window_height = height;
-
-    // update render texture dimensions
-    renderer_engine.render_texture_width = width;
-    renderer_engine.render_texture_height = height;
-    glBindTexture(GL_TEXTURE_2D, renderer_engine.render_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, renderer_engine.render_texture_width, renderer_engine.render_texture_height,
-                 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    callback_live_event(window, &(replay_event_t){REPLAY_EVENT_RESIZE, width, height, 0, 0, 0.0, 0.0});
 }
@@ -41,6 +41,16 @@ vector3_t camera_get_position(const camera_t *cam)
     return vector3_add(cam->target, orbital_pos);
 }
 
+// same formula as pixelRay in shaders.c
+vector3_t camera_pixel_ray(vector3_t right, vector3_t up, vector3_t forward, float tan_half_fov, float aspect,
+                           int width, int height, float px, float py)
+{
+    float u = (2.0f * (px + 0.5f) / (float)width - 1.0f) * aspect * tan_half_fov;
+    float v = (1.0f - 2.0f * (py + 0.5f) / (float)height) * tan_half_fov;
+    vector3_t dir = vector3_add(vector3_scale(right, u), vector3_scale(up, -v));
+    return vector3_normalize(vector3_add(dir, forward));
+}
+
 // is dragging or panning -> moving
 void camera_update_moving_state(camera_t *cam)
 {
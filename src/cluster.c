@@ -0,0 +1,768 @@
+/**
+coordinator and worker of the distributed tile renderer: sockets, the message protocol,
+tile scheduling with stealing, heartbeats and re-issue of the tiles of dead workers
+**/
+
+#define _GNU_SOURCE
+
+#include "cluster.h"
+#include "net.h"
+#include "rle.h"
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// seconds a worker keeps retrying to connect
+#define CLUSTER_CONNECT_RETRY 5.0
+
+// tiles a worker can hold after cancellations raced with new ones
+#define CLUSTER_WORKER_QUEUE 64
+
+// ------------------------------
+// wire format
+// ------------------------------
+
+typedef enum
+{
+    CLUSTER_MESSAGE_HELLO = 1, // worker -> coordinator: cluster_hello_t
+    CLUSTER_MESSAGE_SCENE,     // coordinator -> worker: cpu_render_frame_t
+    CLUSTER_MESSAGE_TILE,      // coordinator -> worker: cluster_tile_t to render
+    CLUSTER_MESSAGE_CANCEL,    // coordinator -> worker: cluster_tile_t stolen by another worker
+    CLUSTER_MESSAGE_RESULT,    // worker -> coordinator: cluster_result_t, then the rle pixels
+    CLUSTER_MESSAGE_HEARTBEAT, // worker -> coordinator: no payload
+    CLUSTER_MESSAGE_QUIT,      // coordinator -> worker: no payload
+} cluster_message_type_t;
+
+typedef struct
+{
+    uint32_t version;
+    int32_t pid;
+} cluster_hello_t;
+
+typedef struct
+{
+    int32_t frame, tile;
+    int32_t x, y, width, height; // pixels, rows top-down
+} cluster_tile_t;
+
+typedef struct
+{
+    cluster_tile_t tile;
+    float render_seconds;
+    uint32_t encoded_size;
+} cluster_result_t;
+
+// ------------------------------
+// helpers
+// ------------------------------
+
+static void cluster_sleep(double seconds)
+{
+    struct timespec ts = {(time_t)seconds, (long)((seconds - (double)(time_t)seconds) * 1e9)};
+    nanosleep(&ts, NULL);
+}
+
+// ------------------------------
+// coordinator
+// ------------------------------
+
+typedef struct
+{
+    int frame, tile;
+} cluster_assignment_t;
+
+typedef struct
+{
+    int fd; // -1 once dropped
+    int pid;
+    net_buffer_t input;
+    cluster_assignment_t queue[CLUSTER_MAX_QUEUE_DEPTH]; // in issue order; the first is being rendered
+    int queue_count;
+    int scene_frames[CLUSTER_FRAMES_IN_FLIGHT]; // frame whose scene the worker holds per slot
+    double connected_at, dropped_at, last_seen;
+    long tiles, duplicates, stolen_from, stolen_by, reissued;
+    double render_seconds;
+    long long bytes_received;
+} cluster_worker_t;
+
+typedef struct
+{
+    int frame; // -1 when the slot is free
+    cpu_render_frame_t scene;
+    unsigned char *rgb; // whole frame, rows top-down
+    unsigned char *done;
+    int done_count;
+} cluster_frame_t;
+
+typedef struct
+{
+    const cluster_config_t *config;
+    int listen_fd;
+    int tiles_x, tiles_y, tiles_per_frame;
+    cluster_worker_t workers[CLUSTER_MAX_WORKERS];
+    int worker_count;
+    cluster_frame_t frames[CLUSTER_FRAMES_IN_FLIGHT];
+    int next_frame, next_tile; // next tile never issued
+    int frames_written;
+    cluster_assignment_t *reissue; // tiles of dropped workers, handed out before new ones
+    int reissue_count;
+    unsigned char *tile_rgb; // decode scratch of one tile
+    bool failed;
+    long tiles_reissued, tiles_stolen, duplicates;
+    long long bytes_received, raw_bytes;
+} cluster_coordinator_t;
+
+static void cluster_tile_rect(const cluster_coordinator_t *c, int tile, cluster_tile_t *rect)
+{
+    int size = c->config->tile_size;
+    rect->tile = tile;
+    rect->x = (tile % c->tiles_x) * size;
+    rect->y = (tile / c->tiles_x) * size;
+    rect->width = rect->x + size <= c->config->width ? size : c->config->width - rect->x;
+    rect->height = rect->y + size <= c->config->height ? size : c->config->height - rect->y;
+}
+
+static bool cluster_write_frame(const cluster_coordinator_t *c, const cluster_frame_t *frame)
+{
+    if (!c->config->output_prefix)
+        return true;
+    char path[1024];
+    snprintf(path, sizeof(path), "%s%04d.ppm", c->config->output_prefix, frame->frame);
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        printf("Failed to open %s for writing\n", path);
+        return false;
+    }
+    size_t size = (size_t)c->config->width * c->config->height * 3;
+    fprintf(file, "P6\n%d %d\n255\n", c->config->width, c->config->height);
+    bool ok = fwrite(frame->rgb, 1, size, file) == size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+        printf("Failed to write %s\n", path);
+    return ok;
+}
+
+static void cluster_drop_worker(cluster_coordinator_t *c, cluster_worker_t *w, const char *reason)
+{
+    close(w->fd);
+    w->fd = -1;
+    w->dropped_at = net_now();
+    for (int i = 0; i < w->queue_count; ++i)
+    {
+        cluster_frame_t *frame = &c->frames[w->queue[i].frame % CLUSTER_FRAMES_IN_FLIGHT];
+        if (frame->frame == w->queue[i].frame && !frame->done[w->queue[i].tile])
+            c->reissue[c->reissue_count++] = w->queue[i];
+    }
+    w->reissued = w->queue_count;
+    c->tiles_reissued += w->queue_count;
+    printf("[INFO] Worker %d (pid %d) dropped: %s; %d tile(s) re-issued\n", (int)(w - c->workers), w->pid, reason,
+           w->queue_count);
+    w->queue_count = 0;
+
+    int alive = 0;
+    for (int i = 0; i < c->worker_count; ++i)
+        alive += c->workers[i].fd >= 0;
+    if (alive == 0)
+        printf("[INFO] No workers left; waiting for new ones on %s\n", c->config->address);
+}
+
+// a tile nobody holds: re-issued ones first, then the next one of the sequence
+static bool cluster_take_tile(cluster_coordinator_t *c, cluster_assignment_t *assignment)
+{
+    if (c->reissue_count > 0)
+    {
+        // the oldest frame first so it can be written and its slot reused
+        int best = 0;
+        for (int i = 1; i < c->reissue_count; ++i)
+            if (c->reissue[i].frame < c->reissue[best].frame)
+                best = i;
+        *assignment = c->reissue[best];
+        c->reissue[best] = c->reissue[--c->reissue_count];
+        return true;
+    }
+
+    const cluster_config_t *config = c->config;
+    if (c->next_frame >= config->first_frame + config->frame_count)
+        return false;
+    cluster_frame_t *frame = &c->frames[c->next_frame % CLUSTER_FRAMES_IN_FLIGHT];
+    if (c->next_tile == 0)
+    {
+        if (frame->frame != -1)
+            return false; // the window is full until the oldest frame is done
+        if (!config->scene(c->next_frame, &frame->scene, config->scene_user))
+        {
+            printf("Failed to build the scene of frame %d\n", c->next_frame);
+            c->failed = true;
+            return false;
+        }
+        frame->scene.frame = c->next_frame;
+        frame->scene.width = config->width;
+        frame->scene.height = config->height;
+        memset(frame->done, 0, (size_t)c->tiles_per_frame);
+        frame->done_count = 0;
+        frame->frame = c->next_frame;
+    }
+    *assignment = (cluster_assignment_t){c->next_frame, c->next_tile};
+    if (++c->next_tile == c->tiles_per_frame)
+    {
+        c->next_tile = 0;
+        ++c->next_frame;
+    }
+    return true;
+}
+
+// an idle worker takes the last queued tile of the worker with the longest queue; the
+// victim's first tile is the one it is rendering and is never taken
+static bool cluster_steal_tile(cluster_coordinator_t *c, cluster_worker_t *thief, cluster_assignment_t *assignment)
+{
+    cluster_worker_t *victim = NULL;
+    for (int i = 0; i < c->worker_count; ++i)
+    {
+        cluster_worker_t *w = &c->workers[i];
+        if (w != thief && w->fd >= 0 && w->queue_count >= 2 && (!victim || w->queue_count > victim->queue_count))
+            victim = w;
+    }
+    if (!victim)
+        return false;
+
+    *assignment = victim->queue[--victim->queue_count];
+    cluster_tile_t cancel;
+    cluster_tile_rect(c, assignment->tile, &cancel);
+    cancel.frame = assignment->frame;
+    if (!net_send_message(victim->fd, CLUSTER_MESSAGE_CANCEL, &cancel, sizeof(cancel)))
+        cluster_drop_worker(c, victim, "send failed");
+    ++victim->stolen_from;
+    ++thief->stolen_by;
+    ++c->tiles_stolen;
+    return true;
+}
+
+static bool cluster_issue(cluster_coordinator_t *c, cluster_worker_t *w, cluster_assignment_t assignment)
+{
+    int slot = assignment.frame % CLUSTER_FRAMES_IN_FLIGHT;
+    if (w->scene_frames[slot] != assignment.frame)
+    {
+        if (!net_send_message(w->fd, CLUSTER_MESSAGE_SCENE, &c->frames[slot].scene, sizeof(cpu_render_frame_t)))
+            return false;
+        w->scene_frames[slot] = assignment.frame;
+    }
+    cluster_tile_t tile;
+    cluster_tile_rect(c, assignment.tile, &tile);
+    tile.frame = assignment.frame;
+    if (!net_send_message(w->fd, CLUSTER_MESSAGE_TILE, &tile, sizeof(tile)))
+        return false;
+    w->queue[w->queue_count++] = assignment;
+    return true;
+}
+
+static void cluster_fill_worker(cluster_coordinator_t *c, cluster_worker_t *w)
+{
+    while (w->fd >= 0 && w->queue_count < c->config->queue_depth && !c->failed)
+    {
+        cluster_assignment_t assignment;
+        if (!cluster_take_tile(c, &assignment) && (w->queue_count > 0 || !cluster_steal_tile(c, w, &assignment)))
+            return;
+        if (!cluster_issue(c, w, assignment))
+        {
+            c->reissue[c->reissue_count++] = assignment;
+            cluster_drop_worker(c, w, "send failed");
+        }
+    }
+}
+
+static bool cluster_handle_result(cluster_coordinator_t *c, cluster_worker_t *w, const unsigned char *payload,
+                                  uint32_t length)
+{
+    cluster_result_t result;
+    if (length < sizeof(result))
+        return false;
+    memcpy(&result, payload, sizeof(result));
+    if (length != sizeof(result) + result.encoded_size)
+        return false;
+
+    // a tile that was stolen after the worker started it comes back twice
+    bool queued = false;
+    for (int i = 0; i < w->queue_count; ++i)
+    {
+        if (w->queue[i].frame == result.tile.frame && w->queue[i].tile == result.tile.tile)
+        {
+            memmove(&w->queue[i], &w->queue[i + 1], sizeof(w->queue[0]) * (size_t)(w->queue_count - i - 1));
+            --w->queue_count;
+            queued = true;
+            break;
+        }
+    }
+    w->render_seconds += result.render_seconds;
+
+    if (result.tile.frame < 0 || result.tile.tile < 0 || result.tile.tile >= c->tiles_per_frame)
+        return false;
+    cluster_frame_t *frame = &c->frames[result.tile.frame % CLUSTER_FRAMES_IN_FLIGHT];
+    if (!queued || frame->frame != result.tile.frame || frame->done[result.tile.tile])
+    {
+        ++w->duplicates;
+        ++c->duplicates;
+        return true;
+    }
+
+    cluster_tile_t rect;
+    cluster_tile_rect(c, result.tile.tile, &rect);
+    if (!rle_decode_rgb(payload + sizeof(result), result.encoded_size, c->tile_rgb, rect.width * rect.height))
+        return false;
+    for (int row = 0; row < rect.height; ++row)
+    {
+        memcpy(frame->rgb + ((size_t)(rect.y + row) * c->config->width + rect.x) * 3,
+               c->tile_rgb + (size_t)row * rect.width * 3, (size_t)rect.width * 3);
+    }
+    frame->done[result.tile.tile] = 1;
+    ++w->tiles;
+    c->raw_bytes += (long long)rect.width * rect.height * 3;
+
+    if (++frame->done_count == c->tiles_per_frame)
+    {
+        if (!cluster_write_frame(c, frame))
+            c->failed = true;
+        printf("[INFO] Frame %d done (%d/%d)\n", frame->frame, c->frames_written + 1, c->config->frame_count);
+        frame->frame = -1;
+        ++c->frames_written;
+    }
+    return true;
+}
+
+static void cluster_handle_input(cluster_coordinator_t *c, cluster_worker_t *w, double now)
+{
+    size_t received;
+    if (!net_receive(&w->input, w->fd, false, &received))
+    {
+        cluster_drop_worker(c, w, "connection closed");
+        return;
+    }
+    w->bytes_received += received;
+    c->bytes_received += received;
+    if (received > 0)
+        w->last_seen = now;
+
+    net_header_t header;
+    const unsigned char *payload;
+    bool corrupt;
+    while (net_next_message(&w->input, &header, &payload, &corrupt))
+    {
+        bool ok = true;
+        if (header.type == CLUSTER_MESSAGE_HELLO && header.length == sizeof(cluster_hello_t))
+        {
+            cluster_hello_t hello;
+            memcpy(&hello, payload, sizeof(hello));
+            w->pid = hello.pid;
+            ok = hello.version == CLUSTER_PROTOCOL_VERSION;
+        }
+        else if (header.type == CLUSTER_MESSAGE_RESULT)
+        {
+            ok = cluster_handle_result(c, w, payload, header.length);
+        }
+        else if (header.type != CLUSTER_MESSAGE_HEARTBEAT)
+        {
+            ok = false;
+        }
+        if (!ok)
+        {
+            cluster_drop_worker(c, w, "protocol error");
+            return;
+        }
+    }
+    if (corrupt)
+        cluster_drop_worker(c, w, "protocol error");
+}
+
+static void cluster_accept(cluster_coordinator_t *c, double now)
+{
+    int fd = accept(c->listen_fd, NULL, NULL);
+    if (fd < 0)
+        return;
+    if (c->worker_count == CLUSTER_MAX_WORKERS)
+    {
+        printf("[INFO] Refused a worker: %d connections already\n", CLUSTER_MAX_WORKERS);
+        close(fd);
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // fails harmlessly on unix sockets
+
+    cluster_worker_t *w = &c->workers[c->worker_count++];
+    *w = (cluster_worker_t){.fd = fd, .connected_at = now, .last_seen = now};
+    for (int i = 0; i < CLUSTER_FRAMES_IN_FLIGHT; ++i)
+        w->scene_frames[i] = -1;
+}
+
+static void cluster_print_stats(const cluster_coordinator_t *c, double seconds)
+{
+    const cluster_config_t *config = c->config;
+    long tiles = (long)c->frames_written * c->tiles_per_frame;
+    double rays = (double)c->frames_written * config->width * config->height;
+    printf("--- Cluster (%d frames of %dx%d, %d tiles of %d px each, %.2f s) ---\n", c->frames_written, config->width,
+           config->height, c->tiles_per_frame, config->tile_size, seconds);
+    printf("throughput: %.3f frames/s, %.1f tiles/s, %.3f Mrays/s\n", c->frames_written / seconds, tiles / seconds,
+           rays / seconds * 1e-6);
+    printf("tiles: %ld re-issued from dropped workers, %ld stolen by idle workers, %ld duplicates discarded\n",
+           c->tiles_reissued, c->tiles_stolen, c->duplicates);
+    printf("network: %.2f MB received for %.2f MB of pixels (%.1fx smaller)\n", c->bytes_received / 1e6,
+           c->raw_bytes / 1e6, c->bytes_received > 0 ? (double)c->raw_bytes / (double)c->bytes_received : 0.0);
+    printf("%-6s %8s %7s %6s %6s %9s %11s %6s  %s\n", "worker", "pid", "tiles", "stole", "lost", "render s",
+           "connected s", "util", "state");
+    double end = net_now();
+    for (int i = 0; i < c->worker_count; ++i)
+    {
+        const cluster_worker_t *w = &c->workers[i];
+        double connected = (w->fd >= 0 ? end : w->dropped_at) - w->connected_at;
+        printf("%-6d %8d %7ld %6ld %6ld %9.2f %11.2f %5.1f%%  %s\n", i, w->pid, w->tiles, w->stolen_by, w->stolen_from,
+               w->render_seconds, connected, connected > 0.0 ? 100.0 * w->render_seconds / connected : 0.0,
+               w->fd >= 0 ? "alive" : "dropped");
+    }
+}
+
+// local workers for a run on one machine; they connect like any remote worker
+static bool cluster_spawn(const char *address, int count, int listen_fd, pid_t *children, int *spawned)
+{
+    for (*spawned = 0; *spawned < count; ++*spawned)
+    {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            printf("Failed to spawn worker %d\n", *spawned);
+            return false;
+        }
+        if (pid == 0)
+        {
+            close(listen_fd);
+            cluster_worker_options_t options = {0};
+            _exit(cluster_work(address, &options) ? 0 : 1);
+        }
+        children[*spawned] = pid;
+    }
+    return true;
+}
+
+bool cluster_coordinate(const cluster_config_t *config)
+{
+    if (config->width <= 0 || config->height <= 0 || config->tile_size <= 0 || config->frame_count <= 0 ||
+        config->queue_depth < 1 || config->queue_depth > CLUSTER_MAX_QUEUE_DEPTH || !config->scene)
+    {
+        printf("Failed to start the coordinator: invalid configuration\n");
+        return false;
+    }
+
+    cluster_coordinator_t *c = calloc(1, sizeof(cluster_coordinator_t));
+    if (!c)
+        return false;
+    c->config = config;
+    c->tiles_x = (config->width + config->tile_size - 1) / config->tile_size;
+    c->tiles_y = (config->height + config->tile_size - 1) / config->tile_size;
+    c->tiles_per_frame = c->tiles_x * c->tiles_y;
+    c->next_frame = config->first_frame;
+    c->reissue = malloc(sizeof(cluster_assignment_t) * (size_t)c->tiles_per_frame * CLUSTER_FRAMES_IN_FLIGHT);
+    c->tile_rgb = malloc((size_t)config->tile_size * config->tile_size * 3);
+    bool ok = c->reissue && c->tile_rgb;
+    for (int i = 0; i < CLUSTER_FRAMES_IN_FLIGHT; ++i)
+    {
+        c->frames[i].frame = -1;
+        c->frames[i].rgb = malloc((size_t)config->width * config->height * 3);
+        c->frames[i].done = malloc((size_t)c->tiles_per_frame);
+        ok = ok && c->frames[i].rgb && c->frames[i].done;
+    }
+    pid_t children[CLUSTER_MAX_WORKERS];
+    int spawned = 0;
+    c->listen_fd = ok ? net_open(config->address, true) : -1;
+    if (!ok)
+        printf("Failed to allocate the coordinator's frames\n");
+    else if (c->listen_fd < 0)
+        printf("Failed to listen on %s\n", config->address);
+    else
+        printf("[INFO] Coordinator listening on %s: %d frames of %dx%d in %d tiles\n", config->address,
+               config->frame_count, config->width, config->height, c->tiles_per_frame);
+    ok = c->listen_fd >= 0;
+
+    int spawn = config->spawn_workers < CLUSTER_MAX_WORKERS ? config->spawn_workers : CLUSTER_MAX_WORKERS;
+    if (ok && !cluster_spawn(config->address, spawn, c->listen_fd, children, &spawned))
+        ok = false;
+
+    double start = net_now();
+    while (ok && !c->failed && c->frames_written < config->frame_count)
+    {
+        struct pollfd fds[CLUSTER_MAX_WORKERS + 1];
+        cluster_worker_t *polled[CLUSTER_MAX_WORKERS + 1];
+        int count = 0;
+        fds[count++] = (struct pollfd){.fd = c->listen_fd, .events = POLLIN};
+        for (int i = 0; i < c->worker_count; ++i)
+        {
+            if (c->workers[i].fd < 0)
+                continue;
+            polled[count] = &c->workers[i];
+            fds[count++] = (struct pollfd){.fd = c->workers[i].fd, .events = POLLIN};
+        }
+        // wake up at least every heartbeat interval to notice silent workers
+        poll(fds, (nfds_t)count, (int)(CLUSTER_HEARTBEAT_INTERVAL * 1000.0));
+
+        double now = net_now();
+        if (fds[0].revents & POLLIN)
+            cluster_accept(c, now);
+        for (int i = 1; i < count; ++i)
+        {
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                cluster_handle_input(c, polled[i], now);
+        }
+        for (int i = 0; i < c->worker_count; ++i)
+        {
+            cluster_worker_t *w = &c->workers[i];
+            if (w->fd >= 0 && now - w->last_seen > config->timeout)
+            {
+                char reason[64];
+                snprintf(reason, sizeof(reason), "silent for %.1f s", now - w->last_seen);
+                cluster_drop_worker(c, w, reason);
+            }
+        }
+        for (int i = 0; i < c->worker_count; ++i)
+            cluster_fill_worker(c, &c->workers[i]);
+    }
+    double seconds = net_now() - start;
+
+    for (int i = 0; i < c->worker_count; ++i)
+    {
+        if (c->workers[i].fd >= 0)
+            net_send_message(c->workers[i].fd, CLUSTER_MESSAGE_QUIT, NULL, 0);
+    }
+    if (ok)
+        cluster_print_stats(c, seconds);
+    for (int i = 0; i < c->worker_count; ++i)
+    {
+        if (c->workers[i].fd >= 0)
+            close(c->workers[i].fd);
+        net_buffer_free(&c->workers[i].input);
+    }
+    if (c->listen_fd >= 0)
+        close(c->listen_fd);
+    for (int i = 0; i < spawned; ++i)
+        waitpid(children[i], NULL, 0);
+    if (c->listen_fd >= 0)
+        net_release(config->address);
+
+    ok = ok && !c->failed;
+    for (int i = 0; i < CLUSTER_FRAMES_IN_FLIGHT; ++i)
+    {
+        free(c->frames[i].rgb);
+        free(c->frames[i].done);
+    }
+    free(c->reissue);
+    free(c->tile_rgb);
+    free(c);
+    return ok;
+}
+
+// ------------------------------
+// worker
+// ------------------------------
+
+typedef struct
+{
+    int fd;
+    pthread_mutex_t send_mutex; // results and heartbeats share the socket
+    atomic_bool stop_heartbeat;
+} cluster_link_t;
+
+static bool cluster_link_send(cluster_link_t *link, cluster_message_type_t type, const void *payload, uint32_t length)
+{
+    pthread_mutex_lock(&link->send_mutex);
+    bool ok = net_send_message(link->fd, type, payload, length);
+    pthread_mutex_unlock(&link->send_mutex);
+    return ok;
+}
+
+// keeps the coordinator from dropping the worker while it renders a slow tile
+static void *cluster_heartbeat_thread(void *data)
+{
+    cluster_link_t *link = data;
+    while (!atomic_load(&link->stop_heartbeat))
+    {
+        cluster_sleep(CLUSTER_HEARTBEAT_INTERVAL);
+        if (!atomic_load(&link->stop_heartbeat) && !cluster_link_send(link, CLUSTER_MESSAGE_HEARTBEAT, NULL, 0))
+            break;
+    }
+    return NULL;
+}
+
+static int cluster_connect(const char *address)
+{
+    double deadline = net_now() + CLUSTER_CONNECT_RETRY;
+    for (;;)
+    {
+        int fd = net_open(address, false);
+        if (fd >= 0 || net_now() > deadline)
+            return fd;
+        cluster_sleep(0.1);
+    }
+}
+
+bool cluster_work(const char *address, const cluster_worker_options_t *options)
+{
+    cluster_link_t link = {.fd = cluster_connect(address)};
+    if (link.fd < 0)
+    {
+        printf("Failed to connect to the coordinator at %s\n", address);
+        return false;
+    }
+    pthread_mutex_init(&link.send_mutex, NULL);
+    atomic_init(&link.stop_heartbeat, false);
+
+    starfield_t sky;
+    bool have_sky = starfield_bake(&sky, STARFIELD_DEFAULT_FACE_SIZE);
+    if (!have_sky)
+        printf("[INFO] Worker %d renders without the starfield\n", (int)getpid());
+
+    cluster_hello_t hello = {CLUSTER_PROTOCOL_VERSION, (int32_t)getpid()};
+    pthread_t heartbeat;
+    bool ok = cluster_link_send(&link, CLUSTER_MESSAGE_HELLO, &hello, sizeof(hello)) &&
+              pthread_create(&heartbeat, NULL, cluster_heartbeat_thread, &link) == 0;
+    bool heartbeat_started = ok;
+
+    cpu_render_frame_t *scenes = malloc(sizeof(cpu_render_frame_t) * CLUSTER_FRAMES_IN_FLIGHT);
+    cluster_tile_t queue[CLUSTER_WORKER_QUEUE];
+    int queue_count = 0;
+    net_buffer_t input = {0};
+    unsigned char *rgb = NULL, *message = NULL;
+    size_t rgb_capacity = 0;
+    long tiles = 0;
+    bool quit = false;
+    ok = ok && scenes;
+    for (int i = 0; ok && i < CLUSTER_FRAMES_IN_FLIGHT; ++i)
+        scenes[i].frame = -1;
+
+    while (ok && !quit)
+    {
+        // block only with nothing to render; otherwise just pick up new tiles and cancellations
+        if (!net_receive(&input, link.fd, queue_count == 0, NULL))
+            break; // the coordinator is gone
+        net_header_t header;
+        const unsigned char *payload;
+        bool corrupt;
+        while (ok && net_next_message(&input, &header, &payload, &corrupt))
+        {
+            cluster_tile_t tile;
+            if (header.type == CLUSTER_MESSAGE_SCENE && header.length == sizeof(cpu_render_frame_t))
+            {
+                cpu_render_frame_t scene;
+                memcpy(&scene, payload, sizeof(scene));
+                scenes[scene.frame % CLUSTER_FRAMES_IN_FLIGHT] = scene;
+            }
+            else if ((header.type == CLUSTER_MESSAGE_TILE || header.type == CLUSTER_MESSAGE_CANCEL) &&
+                     header.length == sizeof(cluster_tile_t))
+            {
+                memcpy(&tile, payload, sizeof(tile));
+                if (header.type == CLUSTER_MESSAGE_TILE && queue_count < CLUSTER_WORKER_QUEUE)
+                {
+                    queue[queue_count++] = tile;
+                }
+                else
+                {
+                    for (int i = 0; i < queue_count; ++i)
+                    {
+                        if (queue[i].frame == tile.frame && queue[i].tile == tile.tile)
+                        {
+                            memmove(&queue[i], &queue[i + 1], sizeof(queue[0]) * (size_t)(queue_count - i - 1));
+                            --queue_count;
+                            break;
+                        }
+                    }
+                }
+            }
+            else if (header.type == CLUSTER_MESSAGE_QUIT)
+            {
+                quit = true;
+            }
+            else
+            {
+                ok = false;
+            }
+        }
+        if (corrupt || !ok)
+        {
+            printf("Failed to read a message from the coordinator\n");
+            ok = false;
+            break;
+        }
+        if (quit || queue_count == 0)
+            continue;
+
+        cluster_tile_t tile = queue[0];
+        memmove(&queue[0], &queue[1], sizeof(queue[0]) * (size_t)(--queue_count));
+        const cpu_render_frame_t *scene = &scenes[tile.frame % CLUSTER_FRAMES_IN_FLIGHT];
+        size_t pixels = (size_t)tile.width * tile.height;
+        if (scene->frame != tile.frame || tile.width <= 0 || tile.height <= 0 || tile.x < 0 || tile.y < 0 ||
+            tile.x + tile.width > scene->width || tile.y + tile.height > scene->height)
+        {
+            printf("Failed to render tile %d of frame %d: no matching scene\n", tile.tile, tile.frame);
+            ok = false;
+            break;
+        }
+        if (pixels * 3 > rgb_capacity)
+        {
+            free(rgb);
+            free(message);
+            rgb_capacity = pixels * 3;
+            rgb = malloc(rgb_capacity);
+            message = malloc(sizeof(cluster_result_t) + RLE_MAX_ENCODED_SIZE(pixels));
+            if (!rgb || !message)
+            {
+                ok = false;
+                break;
+            }
+        }
+
+        double start = net_now();
+        cpu_render_tile(scene, have_sky ? &sky : NULL, tile.x, tile.y, tile.width, tile.height, rgb);
+        cluster_result_t result = {.tile = tile, .render_seconds = (float)(net_now() - start)};
+        result.encoded_size = (uint32_t)rle_encode_rgb(rgb, (int)pixels, message + sizeof(result));
+        memcpy(message, &result, sizeof(result));
+        if (!cluster_link_send(&link, CLUSTER_MESSAGE_RESULT, message, sizeof(result) + result.encoded_size))
+            break;
+        ++tiles;
+
+        if (options->fail_after > 0 && tiles >= options->fail_after)
+        {
+            printf("[INFO] Worker %d exits after %ld tiles (--fail-after)\n", (int)getpid(), tiles);
+            fflush(stdout);
+            _exit(1);
+        }
+        if (options->stall_after > 0 && tiles >= options->stall_after)
+        {
+            // no heartbeats and no results: wait for the coordinator to give up on us
+            printf("[INFO] Worker %d stalls after %ld tiles (--stall-after)\n", (int)getpid(), tiles);
+            atomic_store(&link.stop_heartbeat, true);
+            while (net_receive(&input, link.fd, true, NULL))
+                input.start = input.size;
+            break;
+        }
+    }
+
+    atomic_store(&link.stop_heartbeat, true);
+    shutdown(link.fd, SHUT_RDWR); // wakes the heartbeat thread if it is blocked sending
+    if (heartbeat_started)
+        pthread_join(heartbeat, NULL);
+    close(link.fd);
+    pthread_mutex_destroy(&link.send_mutex);
+    if (have_sky)
+        starfield_destroy(&sky);
+    free(scenes);
+    net_buffer_free(&input);
+    free(rgb);
+    free(message);
+    return ok;
+}
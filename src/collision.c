@@ -0,0 +1,306 @@
+/**
+broadphase collision detection (uniform spatial hash) and contact handling, kept apart from the
+gravity pass so a cheaper force method does not lose collisions
+**/
+
+#include "collision.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static bool collision_overlap(vector4_t p, vector4_t q)
+{
+    double dx = (double)q.x - p.x, dy = (double)q.y - p.y, dz = (double)q.z - p.z;
+    double reach = (double)p.w + q.w;
+    return dx * dx + dy * dy + dz * dz <= reach * reach;
+}
+
+static bool collision_add_pair(collision_broadphase_t *broadphase, int a, int b)
+{
+    if (broadphase->pair_count == broadphase->pair_capacity)
+    {
+        int capacity = broadphase->pair_capacity ? broadphase->pair_capacity * 2 : 64;
+        collision_pair_t *pairs = realloc(broadphase->pairs, sizeof(collision_pair_t) * capacity);
+        if (!pairs)
+        {
+            printf("Failed to grow the collision pair list to %d\n", capacity);
+            return false;
+        }
+        broadphase->pairs = pairs;
+        broadphase->pair_capacity = capacity;
+    }
+    broadphase->pairs[broadphase->pair_count++] = (collision_pair_t){a < b ? a : b, a < b ? b : a};
+    return true;
+}
+
+static bool collision_reserve(collision_broadphase_t *broadphase, int count)
+{
+    if (count <= broadphase->capacity)
+        return true;
+    int table_size = 64;
+    while (table_size < 2 * count)
+        table_size *= 2;
+
+    unsigned int *buckets = realloc(broadphase->buckets, sizeof(unsigned int) * count);
+    if (buckets)
+        broadphase->buckets = buckets;
+    collision_entry_t *entries = realloc(broadphase->entries, sizeof(collision_entry_t) * count);
+    if (entries)
+        broadphase->entries = entries;
+    int *large = realloc(broadphase->large, sizeof(int) * count);
+    if (large)
+        broadphase->large = large;
+    int *bucket_start = realloc(broadphase->bucket_start, sizeof(int) * (table_size + 1));
+    if (bucket_start)
+        broadphase->bucket_start = bucket_start;
+    if (!buckets || !entries || !large || !bucket_start)
+    {
+        printf("Failed to allocate the broadphase for %d bodies\n", count);
+        return false;
+    }
+    broadphase->capacity = count;
+    broadphase->table_size = table_size;
+    return true;
+}
+
+static unsigned int collision_hash(const collision_broadphase_t *broadphase, int x, int y, int z)
+{
+    return ((unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^ (unsigned int)z * 83492791u) &
+           (unsigned int)(broadphase->table_size - 1);
+}
+
+static int collision_cell(double value, double inverse_cell_size)
+{
+    double cell = floor(value * inverse_cell_size);
+    return cell < -1e9 ? -1000000000 : cell > 1e9 ? 1000000000 : (int)cell;
+}
+
+// compares a body with the regular bodies binned in cell (x, y, z); with only_later set,
+// just with those of a higher index (for pairs within one cell)
+static bool collision_test_cell(collision_broadphase_t *broadphase, int i, vector4_t sphere, int x, int y, int z,
+                                bool only_later)
+{
+    unsigned int bucket = collision_hash(broadphase, x, y, z);
+    for (int e = broadphase->bucket_start[bucket]; e < broadphase->bucket_start[bucket + 1]; ++e)
+    {
+        const collision_entry_t *entry = &broadphase->entries[e];
+        if (entry->index == i || (only_later && entry->index < i) || entry->cell[0] != x || entry->cell[1] != y ||
+            entry->cell[2] != z)
+            continue; // another cell hashed into the same bucket
+        if (collision_overlap(sphere, entry->sphere) && !collision_add_pair(broadphase, i, entry->index))
+            return false;
+    }
+    return true;
+}
+
+int collision_find_pairs(collision_broadphase_t *broadphase, const celestial_body_t *bodies, int count)
+{
+    broadphase->pair_count = 0;
+    if (!collision_reserve(broadphase, count))
+        return 0;
+
+    // cells twice the mean diameter: regular bodies (radius up to half a cell) that
+    // touch are at most one cell apart
+    double radius_sum = 0.0;
+    int active = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (bodies[i].mass > 0.0f)
+        {
+            radius_sum += bodies[i].position_and_radius.w;
+            ++active;
+        }
+    }
+    if (active < 2)
+        return 0;
+    double cell_size = radius_sum > 0.0 ? 4.0 * radius_sum / active : 1.0;
+    double inverse_cell_size = 1.0 / cell_size;
+    double regular_radius = 0.5 * cell_size;
+
+    // counting sort of the regular bodies by bucket; bucket_start ends up at each bucket's first entry
+    int *bucket_start = broadphase->bucket_start;
+    for (int b = 0; b <= broadphase->table_size; ++b)
+        bucket_start[b] = 0;
+    int regular_count = 0, large_count = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (bodies[i].mass <= 0.0f)
+            continue;
+        vector4_t p = bodies[i].position_and_radius;
+        if (p.w > regular_radius)
+        {
+            broadphase->large[large_count++] = i;
+            continue;
+        }
+        unsigned int bucket = collision_hash(broadphase, collision_cell(p.x, inverse_cell_size),
+                                             collision_cell(p.y, inverse_cell_size), collision_cell(p.z, inverse_cell_size));
+        broadphase->buckets[i] = bucket;
+        bucket_start[bucket]++;
+        ++regular_count;
+    }
+    for (int b = 1; b < broadphase->table_size; ++b)
+        bucket_start[b] += bucket_start[b - 1];
+    bucket_start[broadphase->table_size] = regular_count;
+    for (int i = count - 1; i >= 0; --i)
+    {
+        vector4_t p = bodies[i].position_and_radius;
+        if (bodies[i].mass <= 0.0f || p.w > regular_radius)
+            continue;
+        broadphase->entries[--bucket_start[broadphase->buckets[i]]] = (collision_entry_t){
+            i,
+            {collision_cell(p.x, inverse_cell_size), collision_cell(p.y, inverse_cell_size), collision_cell(p.z, inverse_cell_size)},
+            p,
+        };
+    }
+
+    // regular pairs: the own cell and the 13 neighbours that come after it, so each pair of
+    // neighbouring cells is looked at from one side only
+    for (int e = 0; e < regular_count; ++e)
+    {
+        const collision_entry_t *entry = &broadphase->entries[e];
+        for (int offset = 13; offset < 27; ++offset)
+        {
+            int dx = offset % 3 - 1, dy = offset / 3 % 3 - 1, dz = offset / 9 - 1;
+            if (!collision_test_cell(broadphase, entry->index, entry->sphere, entry->cell[0] + dx, entry->cell[1] + dy,
+                                     entry->cell[2] + dz, offset == 13))
+                return broadphase->pair_count;
+        }
+    }
+
+    // large bodies against the cells their sphere (grown by a regular radius) reaches, or
+    // against every regular body when that is fewer tests
+    for (int l = 0; l < large_count; ++l)
+    {
+        int i = broadphase->large[l];
+        vector4_t p = bodies[i].position_and_radius;
+        double reach = (double)p.w + regular_radius;
+        int lo[3] = {collision_cell(p.x - reach, inverse_cell_size), collision_cell(p.y - reach, inverse_cell_size),
+                     collision_cell(p.z - reach, inverse_cell_size)};
+        int hi[3] = {collision_cell(p.x + reach, inverse_cell_size), collision_cell(p.y + reach, inverse_cell_size),
+                     collision_cell(p.z + reach, inverse_cell_size)};
+        double cells = ((double)hi[0] - lo[0] + 1.0) * ((double)hi[1] - lo[1] + 1.0) * ((double)hi[2] - lo[2] + 1.0);
+        if (cells > regular_count)
+        {
+            for (int e = 0; e < regular_count; ++e)
+            {
+                const collision_entry_t *entry = &broadphase->entries[e];
+                if (collision_overlap(p, entry->sphere) && !collision_add_pair(broadphase, i, entry->index))
+                    return broadphase->pair_count;
+            }
+            continue;
+        }
+        for (int z = lo[2]; z <= hi[2]; ++z)
+            for (int y = lo[1]; y <= hi[1]; ++y)
+                for (int x = lo[0]; x <= hi[0]; ++x)
+                    if (!collision_test_cell(broadphase, i, p, x, y, z, false))
+                        return broadphase->pair_count;
+    }
+
+    // large bodies among themselves
+    for (int a = 0; a < large_count; ++a)
+    {
+        for (int b = a + 1; b < large_count; ++b)
+        {
+            int i = broadphase->large[a], j = broadphase->large[b];
+            if (collision_overlap(bodies[i].position_and_radius, bodies[j].position_and_radius) &&
+                !collision_add_pair(broadphase, i, j))
+                return broadphase->pair_count;
+        }
+    }
+    return broadphase->pair_count;
+}
+
+// the lighter body of a pair joins the heavier one: mass, momentum and centre of mass are
+// conserved and the survivor keeps its density
+static void collision_merge(celestial_body_t *survivor, celestial_body_t *absorbed)
+{
+    double m1 = survivor->mass, m2 = absorbed->mass, total = m1 + m2;
+    double w1 = m1 / total, w2 = m2 / total;
+    vector4_t *p = &survivor->position_and_radius;
+    const vector4_t *q = &absorbed->position_and_radius;
+
+    p->x = (float)(w1 * p->x + w2 * q->x);
+    p->y = (float)(w1 * p->y + w2 * q->y);
+    p->z = (float)(w1 * p->z + w2 * q->z);
+    p->w = (float)(p->w * cbrt(total / m1));
+    survivor->velocity.x = (float)(w1 * survivor->velocity.x + w2 * absorbed->velocity.x);
+    survivor->velocity.y = (float)(w1 * survivor->velocity.y + w2 * absorbed->velocity.y);
+    survivor->velocity.z = (float)(w1 * survivor->velocity.z + w2 * absorbed->velocity.z);
+    survivor->color.x = (float)(w1 * survivor->color.x + w2 * absorbed->color.x);
+    survivor->color.y = (float)(w1 * survivor->color.y + w2 * absorbed->color.y);
+    survivor->color.z = (float)(w1 * survivor->color.z + w2 * absorbed->color.z);
+    survivor->mass = (float)total;
+
+    absorbed->mass = 0.0f;
+    absorbed->position_and_radius.w = 0.0f;
+    absorbed->velocity = (vector3_t){0.0f, 0.0f, 0.0f};
+}
+
+// impulse along the line of centres if the bodies approach, then separation of the overlap
+// in inverse proportion to the masses
+static void collision_bounce(celestial_body_t *a, celestial_body_t *b)
+{
+    vector4_t *p = &a->position_and_radius, *q = &b->position_and_radius;
+    double nx = (double)q->x - p->x, ny = (double)q->y - p->y, nz = (double)q->z - p->z;
+    double distance = sqrt(nx * nx + ny * ny + nz * nz);
+    if (distance <= 0.0)
+        return; // coincident centres: no normal to push along
+    nx /= distance;
+    ny /= distance;
+    nz /= distance;
+
+    double inverse_a = 1.0 / a->mass, inverse_b = 1.0 / b->mass;
+    double approach = ((double)b->velocity.x - a->velocity.x) * nx + ((double)b->velocity.y - a->velocity.y) * ny +
+                      ((double)b->velocity.z - a->velocity.z) * nz;
+    if (approach < 0.0)
+    {
+        double impulse = -(1.0 + COLLISION_RESTITUTION) * approach / (inverse_a + inverse_b);
+        a->velocity.x -= (float)(impulse * inverse_a * nx);
+        a->velocity.y -= (float)(impulse * inverse_a * ny);
+        a->velocity.z -= (float)(impulse * inverse_a * nz);
+        b->velocity.x += (float)(impulse * inverse_b * nx);
+        b->velocity.y += (float)(impulse * inverse_b * ny);
+        b->velocity.z += (float)(impulse * inverse_b * nz);
+    }
+
+    double overlap = (double)p->w + q->w - distance;
+    double share_a = overlap * inverse_a / (inverse_a + inverse_b), share_b = overlap - share_a;
+    p->x -= (float)(share_a * nx);
+    p->y -= (float)(share_a * ny);
+    p->z -= (float)(share_a * nz);
+    q->x += (float)(share_b * nx);
+    q->y += (float)(share_b * ny);
+    q->z += (float)(share_b * nz);
+}
+
+void collision_resolve(celestial_body_t *bodies, const collision_pair_t *pairs, int pair_count, collision_mode_t mode)
+{
+    for (int i = 0; i < pair_count && mode != COLLISION_OFF; ++i)
+    {
+        celestial_body_t *a = &bodies[pairs[i].a], *b = &bodies[pairs[i].b];
+        // a body absorbed earlier in this pass is gone; its other contacts are found next step
+        if (a->mass <= 0.0f || b->mass <= 0.0f)
+            continue;
+        if (mode == COLLISION_MERGE)
+        {
+            if (b->mass > a->mass)
+                collision_merge(b, a);
+            else
+                collision_merge(a, b);
+        }
+        else
+        {
+            collision_bounce(a, b);
+        }
+    }
+}
+
+void collision_destroy(collision_broadphase_t *broadphase)
+{
+    free(broadphase->buckets);
+    free(broadphase->entries);
+    free(broadphase->bucket_start);
+    free(broadphase->large);
+    free(broadphase->pairs);
+    *broadphase = (collision_broadphase_t){0};
+}
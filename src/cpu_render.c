@@ -0,0 +1,122 @@
+/**
+cpu version of the ray tracer shader's trace pass, for renders that don't need a gpu
+**/
+
+#include "cpu_render.h"
+#include <math.h>
+
+static float cpu_render_dot(vector3_t a, vector3_t b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static float cpu_render_smoothstep(float edge0, float edge1, float x)
+{
+    float t = utility_clamp_float((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+static vector3_t cpu_render_mix(vector3_t a, vector3_t b, float t)
+{
+    return vector3_add(vector3_scale(a, 1.0f - t), vector3_scale(b, t));
+}
+
+// the shader's pixelRay at the centre of a pixel with gl rows (bottom-up)
+static vector3_t cpu_render_pixel_ray(const cpu_render_frame_t *frame, int x, int gl_y)
+{
+    return camera_pixel_ray(frame->right, frame->up, frame->forward, frame->tan_half_fov, frame->aspect, frame->width,
+                            frame->height, (float)x + 0.5f, (float)gl_y + 0.5f);
+}
+
+static vector3_t cpu_render_shade(const cpu_render_frame_t *frame, const starfield_t *sky, const geodesic_hit_t *hit)
+{
+    const geodesic_scene_t *scene = &frame->scene;
+    vector3_t p = hit->position;
+    switch (hit->reason)
+    {
+    case RAY_STATS_DISK:
+    {
+        float r_norm = (vector3_length(p) - scene->disk_r1) / (scene->disk_r2 - scene->disk_r1);
+        r_norm = utility_clamp_float(r_norm, 0.0f, 1.0f);
+        vector3_t hot = {1.0f, 1.0f, 0.8f}, mid = {1.0f, 0.5f, 0.0f}, cool = {0.8f, 0.0f, 0.0f};
+        vector3_t color = cpu_render_mix(mid, hot, cpu_render_smoothstep(0.0f, 0.3f, 1.0f - r_norm));
+        color = cpu_render_mix(cool, color, cpu_render_smoothstep(0.3f, 1.0f, 1.0f - r_norm));
+        float angle = atan2f(p.y, p.x);
+        float spiral = 0.5f + 0.5f * sinf(angle * 10.0f - r_norm * 20.0f - frame->time * 0.1f);
+        return vector3_scale(color, 0.8f + 0.4f * spiral);
+    }
+    case RAY_STATS_HORIZON:
+        return (vector3_t){0.0f, 0.0f, 0.0f};
+    case RAY_STATS_BODY:
+    {
+        vector4_t body = scene->body_pos_radius[hit->body_index];
+        vector4_t albedo = frame->body_colors[hit->body_index];
+        vector3_t n = vector3_normalize(vector3_subtract(p, (vector3_t){body.x, body.y, body.z}));
+        vector3_t v = vector3_normalize(vector3_subtract(frame->position, p));
+        vector3_t l = vector3_normalize((vector3_t){-1.0f, 1.0f, -1.0f});
+        float diffuse = fmaxf(cpu_render_dot(n, l), 0.0f);
+        float specular = 0.5f * powf(fmaxf(cpu_render_dot(n, vector3_normalize(vector3_add(l, v))), 0.0f), 32.0f);
+        vector3_t color = vector3_scale((vector3_t){albedo.x, albedo.y, albedo.z}, 0.5f + diffuse);
+        return vector3_add(color, (vector3_t){specular, specular, specular});
+    }
+    default:
+    {
+        if (!sky)
+            return (vector3_t){0.0f, 0.0f, 0.0f};
+        vector4_t star = starfield_sample(sky, hit->direction);
+        return (vector3_t){star.x, star.y, star.z};
+    }
+    }
+}
+
+static unsigned char cpu_render_byte(float value)
+{
+    return (unsigned char)(utility_clamp_float(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+void cpu_render_set_camera(cpu_render_frame_t *frame, const camera_t *cam, int width, int height)
+{
+    // same basis as the renderer's scene uniforms
+    frame->position = camera_get_position(cam);
+    frame->forward = vector3_normalize(vector3_subtract(cam->target, frame->position));
+    frame->right = vector3_normalize(vector3_cross(frame->forward, (vector3_t){0.0f, 1.0f, 0.0f}));
+    frame->up = vector3_cross(frame->right, frame->forward);
+    frame->tan_half_fov = tanf((float)M_PI / 6.0f);
+    frame->aspect = (float)width / (float)height;
+    frame->width = width;
+    frame->height = height;
+}
+
+void cpu_render_set_scene(cpu_render_frame_t *frame, float schwarzschild_radius, const celestial_body_t *bodies,
+                          int count)
+{
+    frame->scene.schwarzschild_radius = schwarzschild_radius;
+    frame->scene.disk_r1 = schwarzschild_radius * 2.2f;
+    frame->scene.disk_r2 = schwarzschild_radius * 5.2f;
+    frame->scene.body_count = count < MAX_CELESTIAL_BODIES ? count : MAX_CELESTIAL_BODIES;
+    for (int i = 0; i < frame->scene.body_count; ++i)
+    {
+        frame->scene.body_pos_radius[i] = bodies[i].position_and_radius;
+        frame->body_colors[i] = bodies[i].color;
+    }
+}
+
+void cpu_render_tile(const cpu_render_frame_t *frame, const starfield_t *sky, int x, int y, int width, int height,
+                     unsigned char *rgb)
+{
+    for (int row = 0; row < height; ++row)
+    {
+        int gl_y = frame->height - 1 - (y + row);
+        for (int column = 0; column < width; ++column)
+        {
+            geodesic_hit_t hit;
+            geodesic_trace(&frame->scene, frame->integrator, frame->max_steps, frame->step_size, frame->position,
+                           cpu_render_pixel_ray(frame, x + column, gl_y), &hit);
+            vector3_t color = cpu_render_shade(frame, sky, &hit);
+            unsigned char *pixel = rgb + ((size_t)row * width + column) * 3;
+            pixel[0] = cpu_render_byte(color.x);
+            pixel[1] = cpu_render_byte(color.y);
+            pixel[2] = cpu_render_byte(color.z);
+        }
+    }
+}
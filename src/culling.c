@@ -0,0 +1,217 @@
+/**
+conservative screen-space body culling: which bodies the lensed rays of a tile can reach
+**/
+
+#include "culling.h"
+#include "camera.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+// the integrators take finite steps, so their paths bend a little more than the exact
+// geodesic; the bound is widened by this factor (validated with bench_culling for both
+// the spherical euler and the cartesian integrator)
+#define CULLING_DEFLECTION_SAFETY 1.15
+
+// exact deflection tabulated over log(b - b_crit) in units of rs
+#define CULLING_DEFLECTION_TABLE_SIZE 256
+#define CULLING_DEFLECTION_LOG_MIN (-7.0)
+#define CULLING_DEFLECTION_LOG_MAX 7.0
+
+// bound on the turning of a tile's rays beyond which their paths are no longer confined
+// to a convex wedge
+#define CULLING_MAX_TURN 2.5
+
+typedef struct
+{
+    double x, y, z;
+} culling_vec_t;
+
+static culling_vec_t culling_vec(vector3_t v)
+{
+    return (culling_vec_t){v.x, v.y, v.z};
+}
+
+static double culling_dot(culling_vec_t a, culling_vec_t b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static culling_vec_t culling_normalize(culling_vec_t v)
+{
+    double length = sqrt(culling_dot(v, v));
+    return (culling_vec_t){v.x / length, v.y / length, v.z / length};
+}
+
+static double culling_angle(culling_vec_t a, culling_vec_t b)
+{
+    double cosine = culling_dot(a, b);
+    return acos(cosine < -1.0 ? -1.0 : cosine > 1.0 ? 1.0 : cosine);
+}
+
+// the shader's pixelRay at a (sub)pixel position, renormalised in double for the angles between rays
+static culling_vec_t culling_pixel_ray(const culling_view_t *view, double px, double py)
+{
+    return culling_normalize(culling_vec(camera_pixel_ray(view->right, view->up, view->forward, view->tan_half_fov,
+                                                          view->aspect, view->width, view->height, (float)px,
+                                                          (float)py)));
+}
+
+void culling_tile_count(int width, int height, int *tiles_x, int *tiles_y)
+{
+    *tiles_x = (width + CULLING_TILE_SIZE - 1) / CULLING_TILE_SIZE;
+    *tiles_y = (height + CULLING_TILE_SIZE - 1) / CULLING_TILE_SIZE;
+}
+
+// total deflection of a photon with impact parameter b (units of rs) from the orbit
+// equation u'' = -u + 1.5 u², integrated from infinity to infinity with rk4 in phi
+static double culling_exact_deflection(double b)
+{
+    // within 1e-5 of the value at a ten times finer step, far inside CULLING_DEFLECTION_SAFETY,
+    // and cheap enough (about 3 ms for the table) for the first frame
+    const double dphi = 1e-2;
+    double u = 0.0, du = 1.0 / b, phi = 0.0;
+    while (phi < 100.0)
+    {
+        double k1u = du, k1d = -u + 1.5 * u * u;
+        double k2u = du + 0.5 * dphi * k1d, k2d = -(u + 0.5 * dphi * k1u) + 1.5 * (u + 0.5 * dphi * k1u) * (u + 0.5 * dphi * k1u);
+        double k3u = du + 0.5 * dphi * k2d, k3d = -(u + 0.5 * dphi * k2u) + 1.5 * (u + 0.5 * dphi * k2u) * (u + 0.5 * dphi * k2u);
+        double k4u = du + dphi * k3d, k4d = -(u + dphi * k3u) + 1.5 * (u + dphi * k3u) * (u + dphi * k3u);
+        double next = u + dphi / 6.0 * (k1u + 2.0 * k2u + 2.0 * k3u + k4u);
+        du += dphi / 6.0 * (k1d + 2.0 * k2d + 2.0 * k3d + k4d);
+        if (next <= 0.0)
+            return phi + dphi * u / (u - next) - M_PI; // back at infinity
+        u = next;
+        phi += dphi;
+    }
+    return phi;
+}
+
+// filled once by whichever thread asks first; read-only afterwards
+static float culling_deflection_table[CULLING_DEFLECTION_TABLE_SIZE];
+static pthread_once_t culling_deflection_once = PTHREAD_ONCE_INIT;
+
+static void culling_build_deflection_table(void)
+{
+    const double b_crit = 1.5 * sqrt(3.0);
+    const double step = (CULLING_DEFLECTION_LOG_MAX - CULLING_DEFLECTION_LOG_MIN) / (CULLING_DEFLECTION_TABLE_SIZE - 1);
+    for (int i = 0; i < CULLING_DEFLECTION_TABLE_SIZE; ++i)
+        culling_deflection_table[i] = (float)culling_exact_deflection(b_crit + exp(CULLING_DEFLECTION_LOG_MIN + step * i));
+}
+
+float culling_max_deflection(float impact_parameter, float rs)
+{
+    pthread_once(&culling_deflection_once, culling_build_deflection_table);
+    const double b_crit = 1.5 * sqrt(3.0);
+    const double step = (CULLING_DEFLECTION_LOG_MAX - CULLING_DEFLECTION_LOG_MIN) / (CULLING_DEFLECTION_TABLE_SIZE - 1);
+
+    double excess = impact_parameter / rs - b_crit;
+    if (excess <= exp(CULLING_DEFLECTION_LOG_MIN))
+        return 4.0f; // captured or winding around the photon sphere
+    double position = (log(excess) - CULLING_DEFLECTION_LOG_MIN) / step;
+    if (position >= CULLING_DEFLECTION_TABLE_SIZE - 1)
+        return (float)(2.0 / excess); // above the weak-field 2 rs / b this far out
+    // the deflection falls with b, so the entry below the query bounds it
+    return culling_deflection_table[(int)position];
+}
+
+void culling_build_body_tiles(const culling_view_t *view, float rs, const vector4_t *bodies, int body_count,
+                              uint32_t *masks)
+{
+    int tiles_x, tiles_y;
+    culling_tile_count(view->region_width, view->region_height, &tiles_x, &tiles_y);
+    uint32_t all = body_count >= 32 ? 0xffffffffu : (1u << body_count) - 1u;
+
+    culling_vec_t camera = culling_vec(view->position);
+    double r = sqrt(culling_dot(camera, camera));
+    culling_vec_t to_hole = {-camera.x / r, -camera.y / r, -camera.z / r};
+
+    // per body: direction from the camera and the angular radius of the sphere
+    culling_vec_t body_direction[32];
+    double body_angle[32];
+    uint32_t surrounding = 0; // bodies the camera is inside of
+    for (int i = 0; i < body_count && i < 32; ++i)
+    {
+        culling_vec_t d = {bodies[i].x - camera.x, bodies[i].y - camera.y, bodies[i].z - camera.z};
+        double distance = sqrt(culling_dot(d, d));
+        if (distance <= bodies[i].w)
+        {
+            surrounding |= 1u << i;
+            continue;
+        }
+        body_direction[i] = (culling_vec_t){d.x / distance, d.y / distance, d.z / distance};
+        body_angle[i] = asin(bodies[i].w / distance);
+    }
+
+    for (int ty = 0; ty < tiles_y; ++ty)
+    {
+        for (int tx = 0; tx < tiles_x; ++tx)
+        {
+            uint32_t *mask = &masks[ty * tiles_x + tx];
+            // inside the photon sphere every direction can wind around the hole
+            if (r <= 1.5 * rs)
+            {
+                *mask = all;
+                continue;
+            }
+
+            // pix spans [x0, x0 + size] with the +0.5 centre offset and up to half a pixel of jitter
+            double x0 = view->origin_x + tx * CULLING_TILE_SIZE, y0 = view->origin_y + ty * CULLING_TILE_SIZE;
+            double x1 = x0 + CULLING_TILE_SIZE, y1 = y0 + CULLING_TILE_SIZE;
+            culling_vec_t centre = culling_pixel_ray(view, 0.5 * (x0 + x1), 0.5 * (y0 + y1));
+            double spread = 0.0;
+            double corners[4][2] = {{x0, y0}, {x1, y0}, {x0, y1}, {x1, y1}};
+            for (int c = 0; c < 4; ++c)
+            {
+                double angle = culling_angle(centre, culling_pixel_ray(view, corners[c][0], corners[c][1]));
+                spread = angle > spread ? angle : spread;
+            }
+
+            // smallest impact parameter in the tile. b = h / sqrt(1 - rs h² / r³) for a unit
+            // coordinate direction with h = r sin(psi); outgoing rays never get closer than r
+            double psi = culling_angle(centre, to_hole) - spread;
+            psi = psi < 0.0 ? 0.0 : psi > M_PI / 2.0 ? M_PI / 2.0 : psi;
+            double s = sin(psi);
+            double b = r * s / sqrt(1.0 - rs * s * s / r);
+
+            double deflection = CULLING_DEFLECTION_SAFETY * culling_max_deflection((float)b, rs);
+
+            // a photon only turns towards the hole, inside its orbit plane: the centre ray's
+            // directions sweep the arc from centre towards the hole by at most the deflection.
+            // the other rays of the tile start within spread of it, and their orbit planes are
+            // tilted by about spread / sin(psi), which moves the end of their arc further out
+            double tilt = 2.0 * spread / fmax(sin(psi), 1e-6);
+            double margin = spread + deflection * fmin(tilt, M_PI);
+            if (deflection + margin >= CULLING_MAX_TURN)
+            {
+                *mask = all;
+                continue;
+            }
+
+            culling_vec_t towards = {to_hole.x - culling_dot(to_hole, centre) * centre.x,
+                                     to_hole.y - culling_dot(to_hole, centre) * centre.y,
+                                     to_hole.z - culling_dot(to_hole, centre) * centre.z};
+            towards = culling_normalize(towards);
+            culling_vec_t normal = {centre.y * towards.z - centre.z * towards.y, centre.z * towards.x - centre.x * towards.z,
+                                    centre.x * towards.y - centre.y * towards.x};
+            culling_vec_t end = {cos(deflection) * centre.x + sin(deflection) * towards.x,
+                                 cos(deflection) * centre.y + sin(deflection) * towards.y,
+                                 cos(deflection) * centre.z + sin(deflection) * towards.z};
+
+            *mask = surrounding;
+            for (int i = 0; i < body_count && i < 32; ++i)
+            {
+                if (surrounding & (1u << i))
+                    continue;
+                // angular distance from the body to the arc
+                culling_vec_t u = body_direction[i];
+                double along = atan2(culling_dot(u, towards), culling_dot(u, centre));
+                double distance = along >= 0.0 && along <= deflection
+                                      ? asin(fmin(fabs(culling_dot(u, normal)), 1.0))
+                                      : fmin(culling_angle(u, centre), culling_angle(u, end));
+                if (distance <= margin + body_angle[i])
+                    *mask |= 1u << i;
+            }
+        }
+    }
+}
@@ -0,0 +1,151 @@
+/**
+cpu port of the ray tracer's photon integration (spherical and cartesian forms)
+**/
+
+#include "geodesic.h"
+#include <math.h>
+
+// same constants as the shader
+#define GEODESIC_ESCAPE_RADIUS 1e30f
+
+void geodesic_init(geodesic_ray_t *ray, raytracer_integrator_t integrator, vector3_t pos, vector3_t dir, float rs)
+{
+    *ray = (geodesic_ray_t){0};
+    ray->position = pos;
+    ray->r = vector3_length(pos);
+
+    if (integrator == RAYTRACER_INTEGRATOR_CARTESIAN)
+    {
+        vector3_t h = vector3_cross(pos, dir);
+        ray->velocity = dir;
+        ray->h2 = h.x * h.x + h.y * h.y + h.z * h.z;
+        return;
+    }
+
+    ray->theta = acosf(pos.z / ray->r);
+    ray->phi = atan2f(pos.y, pos.x);
+    float st = sinf(ray->theta), ct = cosf(ray->theta), sp = sinf(ray->phi), cp = cosf(ray->phi);
+    ray->dr = st * cp * dir.x + st * sp * dir.y + ct * dir.z;
+    ray->dtheta = (ct * cp * dir.x + ct * sp * dir.y - st * dir.z) / ray->r;
+    ray->dphi = (-sp * dir.x + cp * dir.y) / (ray->r * st);
+
+    float f = 1.0f - rs / ray->r;
+    // null condition: f dt² = dr²/f + r² dΩ²
+    float spatial = ray->dr * ray->dr / f + ray->r * ray->r * (ray->dtheta * ray->dtheta + st * st * ray->dphi * ray->dphi);
+    float dt_dl = sqrtf(spatial / f);
+    ray->energy = f * dt_dl;
+}
+
+void geodesic_step_spherical(geodesic_ray_t *ray, float rs, float dl)
+{
+    float r = ray->r, theta = ray->theta;
+    float dr = ray->dr, dtheta = ray->dtheta, dphi = ray->dphi;
+    float f = 1.0f - rs / r;
+    float st = sinf(theta), ct = cosf(theta);
+
+    // the shader's geodesicRHS
+    float dt_dl = ray->energy / f;
+    float d2r = -(rs / (2.0f * r * r)) * f * dt_dl * dt_dl + (rs / (2.0f * r * r * f)) * dr * dr +
+                r * f * (dtheta * dtheta + st * st * dphi * dphi);
+    float d2theta = -2.0f * dr * dtheta / r + st * ct * dphi * dphi;
+    float d2phi = -2.0f * dr * dphi / r - 2.0f * ct / st * dtheta * dphi;
+
+    ray->r += dl * dr;
+    ray->theta += dl * dtheta;
+    ray->phi += dl * dphi;
+    ray->dr += dl * d2r;
+    ray->dtheta += dl * d2theta;
+    ray->dphi += dl * d2phi;
+
+    float nst = sinf(ray->theta);
+    ray->position = (vector3_t){ray->r * nst * cosf(ray->phi), ray->r * nst * sinf(ray->phi), ray->r * cosf(ray->theta)};
+}
+
+void geodesic_step_cartesian(geodesic_ray_t *ray, float rs, float dl)
+{
+    vector3_t p = ray->position;
+    float r2 = p.x * p.x + p.y * p.y + p.z * p.z;
+    float inv_r = 1.0f / sqrtf(r2);
+
+    // a = -1.5 rs h² p / r⁵, factored so no intermediate leaves float range at r ~ 1e11
+    float k = -1.5f * rs * (ray->h2 / r2) * inv_r * inv_r * inv_r;
+    ray->velocity = vector3_add(ray->velocity, vector3_scale(p, k * dl));
+    ray->position = vector3_add(p, vector3_scale(ray->velocity, dl));
+    ray->r = vector3_length(ray->position);
+}
+
+vector3_t geodesic_direction(const geodesic_ray_t *ray, raytracer_integrator_t integrator)
+{
+    if (integrator == RAYTRACER_INTEGRATOR_CARTESIAN)
+        return vector3_normalize(ray->velocity);
+
+    float st = sinf(ray->theta), ct = cosf(ray->theta), sp = sinf(ray->phi), cp = cosf(ray->phi);
+    vector3_t radial = {st * cp, st * sp, ct};
+    vector3_t polar = {ct * cp, ct * sp, -st};
+    vector3_t azimuthal = {-sp, cp, 0.0f};
+    vector3_t v = vector3_scale(radial, ray->dr);
+    v = vector3_add(v, vector3_scale(polar, ray->r * ray->dtheta));
+    v = vector3_add(v, vector3_scale(azimuthal, ray->r * st * ray->dphi));
+    return vector3_normalize(v);
+}
+
+void geodesic_trace(const geodesic_scene_t *scene, raytracer_integrator_t integrator, int max_steps, float step_size,
+                    vector3_t origin, vector3_t dir, geodesic_hit_t *hit)
+{
+    float rs = scene->schwarzschild_radius;
+    geodesic_ray_t ray;
+    geodesic_init(&ray, integrator, origin, dir, rs);
+
+    hit->reason = RAY_STATS_BUDGET;
+    hit->steps = 0;
+    hit->body_index = -1;
+    vector3_t previous = ray.position;
+
+    for (int i = 0; i < max_steps; ++i)
+    {
+        if (ray.r <= rs)
+        {
+            hit->reason = RAY_STATS_HORIZON;
+            break;
+        }
+        float step_scale = utility_clamp_float(ray.r / (rs * 20.0f), 0.1f, 5.0f);
+        if (integrator == RAYTRACER_INTEGRATOR_CARTESIAN)
+            geodesic_step_cartesian(&ray, rs, step_size * step_scale);
+        else
+            geodesic_step_spherical(&ray, rs, step_size * step_scale);
+        hit->steps++;
+
+        // disk in the y = 0 plane between disk_r1 and disk_r2
+        vector3_t p = ray.position;
+        float disk_r = sqrtf(p.x * p.x + p.z * p.z);
+        if (previous.y * p.y < 0.0f && disk_r >= scene->disk_r1 && disk_r <= scene->disk_r2)
+        {
+            hit->reason = RAY_STATS_DISK;
+            break;
+        }
+
+        for (int body = 0; body < scene->body_count; ++body)
+        {
+            vector4_t b = scene->body_pos_radius[body];
+            vector3_t d = {p.x - b.x, p.y - b.y, p.z - b.z};
+            if (d.x * d.x + d.y * d.y + d.z * d.z <= b.w * b.w)
+            {
+                hit->reason = RAY_STATS_BODY;
+                hit->body_index = body;
+                break;
+            }
+        }
+        if (hit->reason == RAY_STATS_BODY)
+            break;
+
+        previous = p;
+        if (ray.r > GEODESIC_ESCAPE_RADIUS)
+        {
+            hit->reason = RAY_STATS_ESCAPE;
+            break;
+        }
+    }
+
+    hit->position = ray.position;
+    hit->direction = geodesic_direction(&ray, integrator);
+}
@@ -3,12 +3,13 @@ spacetime grid visualization that is deformed based on the gravitational forces
 **/
 
 #include "grid.h"
+#include "grid_mesh.h"
 #include "physics.h"
 #include "renderer.h"
+#include "profiler.h"
 #include <stdlib.h>
 #include <math.h>
 #include <pthread.h>
-#include <time.h>
 #include <stdatomic.h>
 #include <string.h>
 
@@ -22,9 +23,8 @@ spacetime grid visualization that is deformed based on the gravitational forces
 bool is_grid_visible = true;
 
 // grid configuration
-const int GRID_SIZE = 50;
-const float GRID_SPACING = 1e10f;
-const double PLANET_CURVATURE_SCALE = 500.0;
+const int GRID_SIZE = GRID_MESH_DEFAULT_SIZE;
+const float GRID_SPACING = GRID_MESH_DEFAULT_SPACING;
 
 // grid mesh buffer structure
 typedef struct
@@ -40,137 +40,65 @@ typedef struct
 // ------------------------------
 
 static pthread_mutex_t grid_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_t grid_thread_handle = 0;
-static atomic_bool grid_thread_should_run = false;
+static job_handle_t grid_job;
+static double grid_last_schedule_time = -1.0;
+
+// grid updates at 30 Hz
+#define GRID_UPDATE_HZ 30.0
 
 // double-buffered grid data
 static grid_buffer_t grid_buffers[2];
 static int grid_read_buffer = 0;
 static int grid_write_buffer = 1;
-static atomic_bool grid_data_ready = false;
+static atomic_bool grid_data_ready = false; // the read buffer holds a mesh that wasn't uploaded yet
+static atomic_uint grid_generation;
+
+// quadtree of the background job; only one grid job runs at a time
+static grid_mesh_field_t grid_field;
 
 // ------------------------------
-// grid generation core logic
+// grid generation (the mesh itself is grid_mesh.c)
 // ------------------------------
 
-static void compute_grid_vertices(grid_buffer_t *buffer)
+static void compute_grid_vertices(grid_buffer_t *buffer, grid_mesh_field_t *field)
 {
-    int vertex_count = 0;
-    
     // snapshot physics data once
-    celestial_body_t bodies_snapshot[NUM_CELESTIAL_BODIES];
-    physics_lock();
-    for (int i = 0; i < NUM_CELESTIAL_BODIES; ++i)
-    {
-        bodies_snapshot[i] = celestial_bodies[i];
-    }
-    physics_unlock();
-    
-    // compute grid vertices
-    for (int z = 0; z <= GRID_SIZE; ++z)
-    {
-        for (int x = 0; x <= GRID_SIZE; ++x)
-        {
-            float world_x = (x - GRID_SIZE / 2) * GRID_SPACING;
-            float world_z = (z - GRID_SIZE / 2) * GRID_SPACING;
-            float y = -25e10f; // flat surface
-
-            // for each celestial body
-            for (int i = 0; i < NUM_CELESTIAL_BODIES; ++i)
-            {
-                // get position of the body
-                vector3_t obj_pos = {
-                    bodies_snapshot[i].position_and_radius.x,
-                    bodies_snapshot[i].position_and_radius.y,
-                    bodies_snapshot[i].position_and_radius.z
-                };
-                
-                double mass = bodies_snapshot[i].mass;
-                // calculate schwarzschild radius
-                double schwarzschild_radius = 2.0 * GRAVITATIONAL_CONSTANT * mass / (SPEED_OF_LIGHT * SPEED_OF_LIGHT);
-                
-                // distance between grid point and body
-                double dx = world_x - obj_pos.x;
-                double dz = world_z - obj_pos.z;
-                double dist_sq = dx * dx + dz * dz;
-
-                double delta_y = 0.0;
-                if (dist_sq > schwarzschild_radius * schwarzschild_radius)
-                {
-                    double dist = sqrt(dist_sq);
+    celestial_body_t bodies_snapshot[MAX_CELESTIAL_BODIES];
+    physics_snapshot_bodies(bodies_snapshot);
 
-                    // visual approximation of spacetime curvature (flamm's paraboloid)
-                    delta_y = sqrt(8.0 * schwarzschild_radius * (dist - schwarzschild_radius));
-
-                    // non-black-hole objects have a different curvature scale
-                    if (i != 2)
-                    {
-                        delta_y *= PLANET_CURVATURE_SCALE;
-                    }
-                }
-                y += (float)delta_y;
-            }
-            buffer->vertices[vertex_count++] = (vector3_t){world_x, y, world_z};
-        }
-    }
-    buffer->vertex_count = vertex_count;
+    // scenes below GRID_MESH_FIELD_MIN_BODIES take the exact sum
+    buffer->vertex_count = grid_mesh_compute_vertices_field(field, bodies_snapshot, NUM_CELESTIAL_BODIES, GRID_SIZE,
+                                                            GRID_SPACING, GRID_MESH_DEFAULT_RELATIVE_ERROR,
+                                                            buffer->vertices);
 }
 
 static void compute_grid_indices(grid_buffer_t *buffer)
 {
-    int index_count = 0;
-    
-    // for each square add four lines (two edges)
-    for (int z = 0; z < GRID_SIZE; ++z)
-    {
-        for (int x = 0; x < GRID_SIZE; ++x)
-        {
-            int i = z * (GRID_SIZE + 1) + x;
-            
-            // horizontal line
-            buffer->indices[index_count++] = i;
-            buffer->indices[index_count++] = i + 1;
-            
-            // vertical line
-            buffer->indices[index_count++] = i;
-            buffer->indices[index_count++] = i + GRID_SIZE + 1;
-        }
-    }
-    buffer->index_count = index_count;
+    buffer->index_count = grid_mesh_compute_indices(GRID_SIZE, buffer->indices);
 }
 
 // ------------------------------
-// background thread
+// background job
 // ------------------------------
 
-static void* grid_thread_proc(void* arg)
+static void grid_compute_job(void *data)
 {
-    (void)arg;
-    const double target_hz = 30.0; // grid updates at 30 Hz
-    const long sleep_ns = (long)((1.0 / target_hz) * 1e9);
-    
-    while (atomic_load(&grid_thread_should_run))
-    {
-        if (!is_physics_paused)
-        {
-            // compute grid in the write buffer
-            compute_grid_vertices(&grid_buffers[grid_write_buffer]);
-            compute_grid_indices(&grid_buffers[grid_write_buffer]);
-            
-            // swap buffers
-            pthread_mutex_lock(&grid_mutex);
-            int temp = grid_read_buffer;
-            grid_read_buffer = grid_write_buffer;
-            grid_write_buffer = temp;
-            atomic_store(&grid_data_ready, true);
-            pthread_mutex_unlock(&grid_mutex);
-        }
-        
-        // sleep until next update
-        struct timespec req = {0, sleep_ns};
-        nanosleep(&req, NULL);
-    }
-    return NULL;
+    (void)data;
+
+    // compute grid in the write buffer
+    double step_start = profiler_now();
+    compute_grid_vertices(&grid_buffers[grid_write_buffer], &grid_field);
+    compute_grid_indices(&grid_buffers[grid_write_buffer]);
+    profiler_record(PROFILER_STAGE_GRID_STEP, step_start, profiler_now() - step_start);
+
+    // swap buffers
+    pthread_mutex_lock(&grid_mutex);
+    int temp = grid_read_buffer;
+    grid_read_buffer = grid_write_buffer;
+    grid_write_buffer = temp;
+    atomic_store(&grid_data_ready, true);
+    atomic_fetch_add(&grid_generation, 1u);
+    pthread_mutex_unlock(&grid_mutex);
 }
 
 // ------------------------------
@@ -191,7 +119,7 @@ void grid_init_buffers(void)
     }
     
     // generate initial grid data
-    compute_grid_vertices(&grid_buffers[grid_read_buffer]);
+    compute_grid_vertices(&grid_buffers[grid_read_buffer], &grid_field);
     compute_grid_indices(&grid_buffers[grid_read_buffer]);
     atomic_store(&grid_data_ready, true);
 }
@@ -205,40 +133,23 @@ void grid_cleanup_buffers(void)
         grid_buffers[i].vertices = NULL;
         grid_buffers[i].indices = NULL;
     }
+    grid_mesh_field_destroy(&grid_field);
 }
 
-void grid_start_thread(void)
-{
-    if (grid_thread_handle != 0)
-        return;
-    
-    atomic_store(&grid_thread_should_run, true);
-    if (pthread_create(&grid_thread_handle, NULL, grid_thread_proc, NULL) != 0)
-    {
-        atomic_store(&grid_thread_should_run, false);
-        grid_thread_handle = 0;
-    }
-}
-
-void grid_stop_thread(void)
+job_handle_t grid_schedule(double now, job_handle_t physics_job)
 {
-    if (grid_thread_handle == 0)
-        return;
-    
-    atomic_store(&grid_thread_should_run, false);
-    pthread_join(grid_thread_handle, NULL);
-    grid_thread_handle = 0;
-}
+    if (is_physics_paused || !jobs_is_done(grid_job) || now - grid_last_schedule_time < 1.0 / GRID_UPDATE_HZ)
+        return grid_job;
 
-bool grid_is_threaded(void)
-{
-    return grid_thread_handle != 0;
+    grid_last_schedule_time = now;
+    grid_job = jobs_submit(grid_compute_job, NULL, &physics_job, 1);
+    return grid_job;
 }
 
 void grid_update_mesh(renderer_engine_t *engine)
 {
-    // check if new data is available
-    if (!atomic_load(&grid_data_ready))
+    // check if new data is available; an unchanged mesh stays on the gpu
+    if (!atomic_exchange(&grid_data_ready, false))
         return;
     
     // get the current read buffer
@@ -268,14 +179,21 @@ void grid_update_mesh(renderer_engine_t *engine)
     pthread_mutex_unlock(&grid_mutex);
 }
 
-// legacy synchronous version (fallback when threading not used)
+unsigned grid_get_generation(void)
+{
+    return atomic_load(&grid_generation);
+}
+
+// synchronous version, for a single fixed mesh (posters)
 void grid_generate_mesh(renderer_engine_t *engine)
 {
     grid_buffer_t temp_buffer;
     temp_buffer.vertices = malloc((GRID_SIZE + 1) * (GRID_SIZE + 1) * sizeof(vector3_t));
     temp_buffer.indices = malloc(GRID_SIZE * GRID_SIZE * 4 * sizeof(unsigned int));
     
-    compute_grid_vertices(&temp_buffer);
+    grid_mesh_field_t field = {0};
+    compute_grid_vertices(&temp_buffer, &field);
+    grid_mesh_field_destroy(&field);
     compute_grid_indices(&temp_buffer);
     
     if (engine->grid_vao == 0)
@@ -306,8 +224,7 @@ void grid_render(renderer_engine_t *engine, matrix4_t view_projection_matrix)
     if (!is_grid_visible) return;
 
     glUseProgram(engine->grid_shader_program);
-    glUniformMatrix4fv(glGetUniformLocation(engine->grid_shader_program, "viewProj"),
-                       1, GL_FALSE, view_projection_matrix.elements);
+    glUniformMatrix4fv(engine->grid_view_proj_location, 1, GL_FALSE, view_projection_matrix.elements);
     glBindVertexArray(engine->grid_vao);
     glDisable(GL_DEPTH_TEST);
     glEnable(GL_BLEND);
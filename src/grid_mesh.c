@@ -0,0 +1,502 @@
+/**
+deformed spacetime grid mesh, shared by the app's grid and the benchmarks
+**/
+
+#include "grid_mesh.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the dips of bodies other than the black hole (body 2) are exaggerated to be visible
+#define GRID_MESH_PLANET_CURVATURE_SCALE 500.0f
+
+int grid_mesh_compute_vertices(const celestial_body_t *bodies, int body_count, int grid_size, float spacing,
+                               vector3_t *vertices)
+{
+    int vertex_count = 0;
+
+    // compute grid vertices a row at a time, so the square roots of each body run as one
+    // batch over the row
+    int row_length = grid_size + 1;
+    float *row_y = math_aligned_alloc(sizeof(float) * row_length);
+    float *row_work = math_aligned_alloc(sizeof(float) * row_length);
+    if (!row_y || !row_work)
+    {
+        math_aligned_free(row_y);
+        math_aligned_free(row_work);
+        return 0;
+    }
+
+    for (int z = 0; z <= grid_size; ++z)
+    {
+        float world_z = (z - grid_size / 2) * spacing;
+        for (int x = 0; x <= grid_size; ++x)
+        {
+            row_y[x] = GRID_MESH_FLAT_HEIGHT;
+        }
+
+        // for each celestial body
+        for (int i = 0; i < body_count; ++i)
+        {
+            // get position of the body
+            vector3_t obj_pos = {
+                bodies[i].position_and_radius.x,
+                bodies[i].position_and_radius.y,
+                bodies[i].position_and_radius.z
+            };
+
+            double mass = bodies[i].mass;
+            // calculate schwarzschild radius
+            float schwarzschild_radius = (float)(2.0 * GRAVITATIONAL_CONSTANT * mass / (SPEED_OF_LIGHT * SPEED_OF_LIGHT));
+
+            // squared distance between grid point and body
+            float dz = world_z - obj_pos.z;
+            for (int x = 0; x <= grid_size; ++x)
+            {
+                float dx = (x - grid_size / 2) * spacing - obj_pos.x;
+                row_work[x] = dx * dx + dz * dz;
+            }
+            math_batch_sqrt(row_work, row_work, row_length);
+
+            // visual approximation of spacetime curvature (flamm's paraboloid), flat inside
+            // the horizon
+            for (int x = 0; x <= grid_size; ++x)
+            {
+                float dist = row_work[x];
+                row_work[x] = dist > schwarzschild_radius ? 8.0f * schwarzschild_radius * (dist - schwarzschild_radius) : 0.0f;
+            }
+            math_batch_sqrt(row_work, row_work, row_length);
+
+            // non-black-hole objects have a different curvature scale
+            float scale = i != 2 ? GRID_MESH_PLANET_CURVATURE_SCALE : 1.0f;
+            for (int x = 0; x <= grid_size; ++x)
+            {
+                row_y[x] += row_work[x] * scale;
+            }
+        }
+
+        for (int x = 0; x <= grid_size; ++x)
+        {
+            float world_x = (x - grid_size / 2) * spacing;
+            vertices[vertex_count++] = (vector3_t){world_x, row_y[x], world_z};
+        }
+    }
+    math_aligned_free(row_y);
+    math_aligned_free(row_work);
+    return vertex_count;
+}
+
+int grid_mesh_compute_indices(int grid_size, unsigned int *indices)
+{
+    int index_count = 0;
+
+    // for each square add four lines (two edges)
+    for (int z = 0; z < grid_size; ++z)
+    {
+        for (int x = 0; x < grid_size; ++x)
+        {
+            int i = z * (grid_size + 1) + x;
+
+            // horizontal line
+            indices[index_count++] = i;
+            indices[index_count++] = i + 1;
+
+            // vertical line
+            indices[index_count++] = i;
+            indices[index_count++] = i + grid_size + 1;
+        }
+    }
+    return index_count;
+}
+
+// ------------------------------
+// field approximation
+// ------------------------------
+
+// bodies a quadtree leaf holds before it is split
+#define GRID_MESH_FIELD_LEAF_BODIES 8
+
+// depth at which coincident bodies stop being split
+#define GRID_MESH_FIELD_MAX_DEPTH 24
+
+// vertices along each side of a block that shares one interaction list
+#define GRID_MESH_FIELD_BLOCK 8
+
+// a cell's dip around its centroid C, at distance D in direction u from it, to second order
+// in the bodies' offsets d from C and their radii rs (w = the body's dip weight):
+//   W sqrt(D) - S / (2 sqrt(D)) + (2 tr(Q) - 3 u.Q.u - 2 u.P - T) / (8 D^1.5)
+// with W = sum w, S = sum w rs, Q = sum w d d^T, P = sum w rs d, T = sum w rs^2; the first
+// order term in d vanishes because C is the w-weighted centroid.
+//
+// along the path from C to a body (offset d, horizon rs) its dip is sqrt(rho) with rho at
+// least margin = D - |d| - rs, so the expansion's third-order remainder is below
+//   w (|d|^3 / (6 sqrt(3)) + a |d|^2 / 8 + a^3 / 16) / margin^2.5,  a = |d| + rs
+// per body; remainder holds the sum of the numerators
+struct grid_mesh_field_node
+{
+    float center_x, center_z, half_size; // square the node covers
+    float centroid_x, centroid_z;
+    float weight, weight_rs;             // W, S
+    float qxx, qxz, qzz, px, pz, t;      // Q, P, T
+    float trace_term;                    // 2 tr(Q) - T
+    float radius;                        // farthest body from the centroid
+    float max_rs;
+    double remainder;
+    int first, count; // bodies order[first .. first + count)
+    int children[4];  // -1 where there is none; leaves have none
+};
+
+static bool grid_field_reserve(grid_mesh_field_t *field, int body_count)
+{
+    if (body_count <= field->capacity)
+        return true;
+    int capacity = field->capacity ? field->capacity : 64;
+    while (capacity < body_count)
+        capacity *= 2;
+    float *x = realloc(field->body_x, sizeof(float) * capacity);
+    field->body_x = x ? x : field->body_x;
+    float *z = realloc(field->body_z, sizeof(float) * capacity);
+    field->body_z = z ? z : field->body_z;
+    float *weight = realloc(field->body_weight, sizeof(float) * capacity);
+    field->body_weight = weight ? weight : field->body_weight;
+    float *rs = realloc(field->body_rs, sizeof(float) * capacity);
+    field->body_rs = rs ? rs : field->body_rs;
+    int *order = realloc(field->order, sizeof(int) * capacity);
+    field->order = order ? order : field->order;
+    int *exact = realloc(field->exact, sizeof(int) * capacity);
+    field->exact = exact ? exact : field->exact;
+    if (!x || !z || !weight || !rs || !order || !exact)
+        return false;
+    field->capacity = capacity;
+    return true;
+}
+
+static int grid_field_add_node(grid_mesh_field_t *field)
+{
+    if (field->node_count == field->node_capacity)
+    {
+        int capacity = field->node_capacity ? field->node_capacity * 2 : 256;
+        grid_mesh_field_node_t *nodes = realloc(field->nodes, sizeof(grid_mesh_field_node_t) * capacity);
+        if (!nodes)
+            return -1;
+        field->nodes = nodes;
+        int *cells = realloc(field->cells, sizeof(int) * capacity);
+        if (!cells)
+            return -1;
+        field->cells = cells;
+        field->node_capacity = capacity;
+    }
+    return field->node_count++;
+}
+
+// builds the node over order[first .. first + count) and its subtree; -1 if out of memory
+static int grid_field_build(grid_mesh_field_t *field, int first, int count, float center_x, float center_z,
+                            float half_size, int depth)
+{
+    int index = grid_field_add_node(field);
+    if (index < 0)
+        return -1;
+
+    // moments in double: the offsets are taken around the centroid, so it comes first
+    const int *order = field->order + first;
+    double weight = 0.0, weight_rs = 0.0, sum_x = 0.0, sum_z = 0.0;
+    for (int i = 0; i < count; ++i)
+    {
+        int b = order[i];
+        weight += field->body_weight[b];
+        weight_rs += (double)field->body_weight[b] * field->body_rs[b];
+        sum_x += (double)field->body_weight[b] * field->body_x[b];
+        sum_z += (double)field->body_weight[b] * field->body_z[b];
+    }
+    double centroid_x = sum_x / weight, centroid_z = sum_z / weight;
+    double qxx = 0.0, qxz = 0.0, qzz = 0.0, px = 0.0, pz = 0.0, t = 0.0, radius = 0.0, remainder = 0.0;
+    float max_rs = 0.0f;
+    for (int i = 0; i < count; ++i)
+    {
+        int b = order[i];
+        double w = field->body_weight[b], rs = field->body_rs[b];
+        double dx = field->body_x[b] - centroid_x, dz = field->body_z[b] - centroid_z;
+        qxx += w * dx * dx;
+        qxz += w * dx * dz;
+        qzz += w * dz * dz;
+        px += w * rs * dx;
+        pz += w * rs * dz;
+        t += w * rs * rs;
+        double offset = sqrt(dx * dx + dz * dz), a = offset + rs;
+        remainder += w * (offset * offset * offset / (6.0 * sqrt(3.0)) + a * offset * offset / 8.0 + a * a * a / 16.0);
+        radius = fmax(radius, offset);
+        max_rs = fmaxf(max_rs, field->body_rs[b]);
+    }
+    field->nodes[index] = (grid_mesh_field_node_t){
+        .center_x = center_x, .center_z = center_z, .half_size = half_size,
+        .centroid_x = (float)centroid_x, .centroid_z = (float)centroid_z,
+        .weight = (float)weight, .weight_rs = (float)weight_rs,
+        .qxx = (float)qxx, .qxz = (float)qxz, .qzz = (float)qzz, .px = (float)px, .pz = (float)pz, .t = (float)t,
+        .trace_term = (float)(2.0 * (qxx + qzz) - t),
+        .radius = (float)radius, .max_rs = max_rs, .remainder = remainder,
+        .first = first, .count = count, .children = {-1, -1, -1, -1},
+    };
+    if (count <= GRID_MESH_FIELD_LEAF_BODIES || depth >= GRID_MESH_FIELD_MAX_DEPTH)
+        return index;
+
+    // split into quadrants through the exact list, which is free until the mesh is evaluated
+    int quadrant_count[4] = {0, 0, 0, 0};
+    for (int i = 0; i < count; ++i)
+    {
+        int b = order[i];
+        ++quadrant_count[(field->body_x[b] >= center_x) + 2 * (field->body_z[b] >= center_z)];
+    }
+    int quadrant_start[4] = {0, quadrant_count[0], quadrant_count[0] + quadrant_count[1],
+                             quadrant_count[0] + quadrant_count[1] + quadrant_count[2]};
+    int fill[4] = {quadrant_start[0], quadrant_start[1], quadrant_start[2], quadrant_start[3]};
+    for (int i = 0; i < count; ++i)
+    {
+        int b = order[i];
+        field->exact[fill[(field->body_x[b] >= center_x) + 2 * (field->body_z[b] >= center_z)]++] = b;
+    }
+    memcpy(field->order + first, field->exact, sizeof(int) * count);
+
+    float quarter = 0.5f * half_size;
+    for (int q = 0; q < 4; ++q)
+    {
+        if (quadrant_count[q] == 0)
+            continue;
+        float child_x = center_x + (q & 1 ? quarter : -quarter), child_z = center_z + (q & 2 ? quarter : -quarter);
+        int child = grid_field_build(field, first + quadrant_start[q], quadrant_count[q], child_x, child_z, quarter,
+                                     depth + 1);
+        if (child < 0)
+            return -1;
+        field->nodes[index].children[q] = child; // the nodes may have moved while the child was built
+    }
+    return index;
+}
+
+// bodies that pull the grid down, and the quadtree over them; false if out of memory
+static bool grid_field_prepare(grid_mesh_field_t *field, const celestial_body_t *bodies, int body_count)
+{
+    if (!grid_field_reserve(field, body_count))
+        return false;
+    int count = 0;
+    float min_x = INFINITY, max_x = -INFINITY, min_z = INFINITY, max_z = -INFINITY;
+    for (int i = 0; i < body_count; ++i)
+    {
+        // the exact sum's dip, scale * sqrt(8 rs (dist - rs)), as weight * sqrt(dist - rs)
+        float rs = (float)(2.0 * GRAVITATIONAL_CONSTANT * bodies[i].mass / (SPEED_OF_LIGHT * SPEED_OF_LIGHT));
+        float scale = i != 2 ? GRID_MESH_PLANET_CURVATURE_SCALE : 1.0f;
+        float weight = scale * sqrtf(8.0f * rs);
+        if (!(weight > 0.0f))
+            continue; // absorbed bodies have no mass and no dip
+        field->body_x[count] = bodies[i].position_and_radius.x;
+        field->body_z[count] = bodies[i].position_and_radius.z;
+        field->body_weight[count] = weight;
+        field->body_rs[count] = rs;
+        field->order[count] = count;
+        min_x = fminf(min_x, field->body_x[count]);
+        max_x = fmaxf(max_x, field->body_x[count]);
+        min_z = fminf(min_z, field->body_z[count]);
+        max_z = fmaxf(max_z, field->body_z[count]);
+        ++count;
+    }
+    field->node_count = 0;
+    if (count == 0)
+        return true;
+    float half_size = 0.5f * fmaxf(max_x - min_x, max_z - min_z) * 1.0001f + 1.0f;
+    return grid_field_build(field, 0, count, 0.5f * (min_x + max_x), 0.5f * (min_z + max_z), half_size, 0) == 0;
+}
+
+// distance from the block's rectangle to a point, 0 inside it
+static float grid_field_rect_distance(float min_x, float max_x, float min_z, float max_z, float x, float z)
+{
+    float dx = fmaxf(fmaxf(min_x - x, x - max_x), 0.0f);
+    float dz = fmaxf(fmaxf(min_z - z, z - max_z), 0.0f);
+    return sqrtf(dx * dx + dz * dz);
+}
+
+// lower bound of the dip at every vertex of the block: cells well away from it at their
+// nearest distance, the bodies of nearby leaves one by one
+static double grid_field_lower_dip(const grid_mesh_field_t *field, float min_x, float max_x, float min_z, float max_z)
+{
+    double dip = 0.0;
+    int stack[GRID_MESH_FIELD_MAX_DEPTH * 3 + 4];
+    int depth = 0;
+    if (field->node_count > 0)
+        stack[depth++] = 0;
+    while (depth > 0)
+    {
+        const grid_mesh_field_node_t *node = &field->nodes[stack[--depth]];
+        float margin = grid_field_rect_distance(min_x, max_x, min_z, max_z, node->centroid_x, node->centroid_z) -
+                       node->radius - node->max_rs;
+        if (margin > node->radius)
+        {
+            dip += node->weight * sqrt(margin);
+            continue;
+        }
+        if (node->children[0] < 0 && node->children[1] < 0 && node->children[2] < 0 && node->children[3] < 0)
+        {
+            for (int i = node->first; i < node->first + node->count; ++i)
+            {
+                int b = field->order[i];
+                float distance = grid_field_rect_distance(min_x, max_x, min_z, max_z, field->body_x[b], field->body_z[b]);
+                if (distance > field->body_rs[b])
+                    dip += field->body_weight[b] * sqrt(distance - field->body_rs[b]);
+            }
+            continue;
+        }
+        for (int q = 0; q < 4; ++q)
+        {
+            if (node->children[q] >= 0)
+                stack[depth++] = node->children[q];
+        }
+    }
+    return dip;
+}
+
+// splits the tree into the cells a block of vertices takes as one expansion each and the
+// bodies it sums exactly; returns the cell count, the exact count goes to exact_count
+//
+// the error budget of the block is max_relative_error of its lower dip bound, shared out by
+// weight: a cell may be off by its weight's share of it. the shares add up to the budget, so
+// no vertex's dip is off by more than max_relative_error of it
+static int grid_field_interactions(grid_mesh_field_t *field, float min_x, float max_x, float min_z, float max_z,
+                                   float max_relative_error, int *exact_count)
+{
+    int cell_count = 0, exact = 0;
+    int stack[GRID_MESH_FIELD_MAX_DEPTH * 3 + 4];
+    int depth = 0;
+    double budget_per_weight = 0.0;
+    if (field->node_count > 0)
+    {
+        stack[depth++] = 0;
+        budget_per_weight =
+            max_relative_error * grid_field_lower_dip(field, min_x, max_x, min_z, max_z) / field->nodes[0].weight;
+    }
+    while (depth > 0)
+    {
+        const grid_mesh_field_node_t *node = &field->nodes[stack[--depth]];
+        float margin = grid_field_rect_distance(min_x, max_x, min_z, max_z, node->centroid_x, node->centroid_z) -
+                       node->radius - node->max_rs;
+        if (margin > 0.0f && node->remainder <= budget_per_weight * node->weight * pow(margin, 2.5))
+        {
+            field->cells[cell_count++] = (int)(node - field->nodes);
+            continue;
+        }
+        if (node->children[0] < 0 && node->children[1] < 0 && node->children[2] < 0 && node->children[3] < 0)
+        {
+            memcpy(field->exact + exact, field->order + node->first, sizeof(int) * node->count);
+            exact += node->count;
+            continue;
+        }
+        for (int q = 0; q < 4; ++q)
+        {
+            if (node->children[q] >= 0)
+                stack[depth++] = node->children[q];
+        }
+    }
+    *exact_count = exact;
+    return cell_count;
+}
+
+int grid_mesh_compute_vertices_field(grid_mesh_field_t *field, const celestial_body_t *bodies, int body_count,
+                                     int grid_size, float spacing, float max_relative_error, vector3_t *vertices)
+{
+    if (body_count < GRID_MESH_FIELD_MIN_BODIES || !(max_relative_error > 0.0f))
+    {
+        field->exact_terms = (long)GRID_MESH_VERTEX_COUNT(grid_size) * body_count;
+        field->cell_terms = 0;
+        return grid_mesh_compute_vertices(bodies, body_count, grid_size, spacing, vertices);
+    }
+    if (!grid_field_prepare(field, bodies, body_count))
+        return 0;
+
+    enum { BLOCK_VERTICES = GRID_MESH_FIELD_BLOCK * GRID_MESH_FIELD_BLOCK };
+    _Alignas(MATH_SIMD_ALIGNMENT) float block_x[BLOCK_VERTICES], block_z[BLOCK_VERTICES], block_y[BLOCK_VERTICES];
+    _Alignas(MATH_SIMD_ALIGNMENT) float work[BLOCK_VERTICES], distance[BLOCK_VERTICES];
+    field->exact_terms = 0;
+    field->cell_terms = 0;
+    int row_length = grid_size + 1;
+    for (int block_z0 = 0; block_z0 <= grid_size; block_z0 += GRID_MESH_FIELD_BLOCK)
+    {
+        for (int block_x0 = 0; block_x0 <= grid_size; block_x0 += GRID_MESH_FIELD_BLOCK)
+        {
+            int columns = row_length - block_x0 < GRID_MESH_FIELD_BLOCK ? row_length - block_x0 : GRID_MESH_FIELD_BLOCK;
+            int rows = row_length - block_z0 < GRID_MESH_FIELD_BLOCK ? row_length - block_z0 : GRID_MESH_FIELD_BLOCK;
+            int n = rows * columns;
+            for (int k = 0; k < n; ++k)
+            {
+                block_x[k] = (block_x0 + k % columns - grid_size / 2) * spacing;
+                block_z[k] = (block_z0 + k / columns - grid_size / 2) * spacing;
+                block_y[k] = GRID_MESH_FLAT_HEIGHT;
+            }
+
+            int exact_count;
+            int cell_count = grid_field_interactions(field, block_x[0], block_x[n - 1], block_z[0], block_z[n - 1],
+                                                     max_relative_error, &exact_count);
+            field->exact_terms += (long)exact_count * n;
+            field->cell_terms += (long)cell_count * n;
+
+            // near bodies: the exact dip, flat inside the horizon
+            for (int e = 0; e < exact_count; ++e)
+            {
+                int b = field->exact[e];
+                float body_x = field->body_x[b], body_z = field->body_z[b], rs = field->body_rs[b];
+                for (int k = 0; k < n; ++k)
+                {
+                    float dx = block_x[k] - body_x, dz = block_z[k] - body_z;
+                    work[k] = dx * dx + dz * dz;
+                }
+                math_batch_sqrt(work, work, n);
+                for (int k = 0; k < n; ++k)
+                    work[k] = work[k] > rs ? work[k] - rs : 0.0f;
+                math_batch_sqrt(work, work, n);
+                float weight = field->body_weight[b];
+                for (int k = 0; k < n; ++k)
+                    block_y[k] += weight * work[k];
+            }
+
+            // distant cells: the expansion around their centroid
+            for (int c = 0; c < cell_count; ++c)
+            {
+                const grid_mesh_field_node_t *node = &field->nodes[field->cells[c]];
+                for (int k = 0; k < n; ++k)
+                {
+                    float dx = block_x[k] - node->centroid_x, dz = block_z[k] - node->centroid_z;
+                    distance[k] = dx * dx + dz * dz;
+                }
+                math_batch_sqrt(distance, distance, n);
+                math_batch_sqrt(distance, work, n);
+                for (int k = 0; k < n; ++k)
+                {
+                    // u before the products: Q times a squared offset overflows a float
+                    float inverse = 1.0f / distance[k], root = work[k], inverse_root = root * inverse;
+                    float ux = (block_x[k] - node->centroid_x) * inverse, uz = (block_z[k] - node->centroid_z) * inverse;
+                    float quadrupole = node->qxx * ux * ux + 2.0f * node->qxz * ux * uz + node->qzz * uz * uz;
+                    float dipole = node->px * ux + node->pz * uz;
+                    block_y[k] += node->weight * root +
+                                  inverse_root * (-0.5f * node->weight_rs +
+                                                  0.125f * inverse * (node->trace_term - 3.0f * quadrupole - 2.0f * dipole));
+                }
+            }
+
+            for (int k = 0; k < n; ++k)
+            {
+                int index = (block_z0 + k / columns) * row_length + block_x0 + k % columns;
+                vertices[index] = (vector3_t){block_x[k], block_y[k], block_z[k]};
+            }
+        }
+    }
+    return GRID_MESH_VERTEX_COUNT(grid_size);
+}
+
+void grid_mesh_field_destroy(grid_mesh_field_t *field)
+{
+    free(field->nodes);
+    free(field->body_x);
+    free(field->body_z);
+    free(field->body_weight);
+    free(field->body_rs);
+    free(field->order);
+    free(field->exact);
+    free(field->cells);
+    *field = (grid_mesh_field_t){0};
+}
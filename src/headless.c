@@ -0,0 +1,144 @@
+/**
+offscreen opengl context through egl, for render servers and ci machines without a display
+**/
+
+#include "headless.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef BLACKHOLE_HAVE_EGL
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static EGLDisplay headless_display = EGL_NO_DISPLAY;
+static EGLContext headless_context = EGL_NO_CONTEXT;
+static EGLSurface headless_surface = EGL_NO_SURFACE;
+
+static bool headless_has_extension(const char *extensions, const char *name)
+{
+    if (!extensions)
+        return false;
+
+    size_t length = strlen(name);
+    for (const char *p = strstr(extensions, name); p; p = strstr(p + length, name))
+    {
+        if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+            return true;
+    }
+    return false;
+}
+
+static EGLDisplay headless_open_display(void)
+{
+    // client extensions are queried on EGL_NO_DISPLAY
+    const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (headless_has_extension(client_extensions, "EGL_MESA_platform_surfaceless"))
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (get_platform_display)
+        {
+            EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (display != EGL_NO_DISPLAY)
+                return display;
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool headless_context_create(void)
+{
+    headless_display = headless_open_display();
+    EGLint major, minor;
+    if (headless_display == EGL_NO_DISPLAY || !eglInitialize(headless_display, &major, &minor))
+    {
+        printf("Failed to initialize EGL display\n");
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        printf("EGL display does not support desktop OpenGL\n");
+        headless_context_destroy();
+        return false;
+    }
+
+    const EGLint config_attributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE};
+    EGLConfig config;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(headless_display, config_attributes, &config, 1, &config_count) || config_count == 0)
+    {
+        printf("No suitable EGL config found\n");
+        headless_context_destroy();
+        return false;
+    }
+
+    const EGLint context_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE};
+    headless_context = eglCreateContext(headless_display, config, EGL_NO_CONTEXT, context_attributes);
+    if (headless_context == EGL_NO_CONTEXT)
+    {
+        printf("Failed to create EGL OpenGL 3.3 core context\n");
+        headless_context_destroy();
+        return false;
+    }
+
+    // all rendering goes to framebuffer objects, so a surface is only created if the driver requires one
+    const char *display_extensions = eglQueryString(headless_display, EGL_EXTENSIONS);
+    if (!headless_has_extension(display_extensions, "EGL_KHR_surfaceless_context"))
+    {
+        const EGLint pbuffer_attributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        headless_surface = eglCreatePbufferSurface(headless_display, config, pbuffer_attributes);
+    }
+
+    if (!eglMakeCurrent(headless_display, headless_surface, headless_surface, headless_context))
+    {
+        printf("Failed to make EGL context current\n");
+        headless_context_destroy();
+        return false;
+    }
+
+    printf("EGL %d.%d offscreen context (%s)\n", major, minor,
+           headless_surface == EGL_NO_SURFACE ? "surfaceless" : "pbuffer");
+    return true;
+}
+
+void headless_context_destroy(void)
+{
+    if (headless_display == EGL_NO_DISPLAY)
+        return;
+
+    eglMakeCurrent(headless_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (headless_surface != EGL_NO_SURFACE) eglDestroySurface(headless_display, headless_surface);
+    if (headless_context != EGL_NO_CONTEXT) eglDestroyContext(headless_display, headless_context);
+    eglTerminate(headless_display);
+
+    headless_surface = EGL_NO_SURFACE;
+    headless_context = EGL_NO_CONTEXT;
+    headless_display = EGL_NO_DISPLAY;
+}
+
+#else
+
+bool headless_context_create(void)
+{
+    printf("Headless mode is not available: built without EGL\n");
+    return false;
+}
+
+void headless_context_destroy(void)
+{
+}
+
+#endif // BLACKHOLE_HAVE_EGL
@@ -0,0 +1,119 @@
+/**
+idle-aware rendering: dirty tracking of the render loop and the sleep between frames
+**/
+
+#include "idle.h"
+#include "grid.h"
+#include "physics.h"
+#include "profiler.h"
+#include <stdio.h>
+
+// changes after which the temporal history starts over
+#define IDLE_SCENE_REASONS (IDLE_DIRTY_INPUT | IDLE_DIRTY_CAMERA | IDLE_DIRTY_PHYSICS | IDLE_DIRTY_GRID | IDLE_DIRTY_WINDOW)
+
+idle_tracker_t idle_tracker;
+
+static const char *idle_reason_names[IDLE_DIRTY_REASON_COUNT] = {
+    "input", "camera", "physics", "grid", "window", "settling", "animation", "overlay",
+};
+
+void idle_init(idle_tracker_t *idle, bool enabled, double animation_fps)
+{
+    *idle = (idle_tracker_t){0};
+    idle->enabled = enabled;
+    idle->animation_interval = animation_fps > 0.0 ? 1.0 / animation_fps : 0.0;
+    idle->pending = IDLE_DIRTY_INPUT; // nothing rendered yet
+}
+
+void idle_mark(idle_tracker_t *idle, unsigned reasons)
+{
+    idle->pending |= reasons;
+}
+
+unsigned idle_check(const idle_tracker_t *idle, const renderer_engine_t *engine, const camera_t *cam, double now)
+{
+    unsigned dirty = idle->pending;
+    if (!idle->enabled)
+        return dirty | IDLE_DIRTY_ANIMATION;
+
+    if (cam->radius != idle->radius || cam->azimuth != idle->azimuth || cam->elevation != idle->elevation ||
+        cam->target.x != idle->target.x || cam->target.y != idle->target.y || cam->target.z != idle->target.z)
+        dirty |= IDLE_DIRTY_CAMERA;
+    // physics only steps from the render loop, so a running simulation needs every frame
+    if (!is_physics_paused || physics_get_generation() != idle->physics_generation)
+        dirty |= IDLE_DIRTY_PHYSICS;
+    if (grid_get_generation() != idle->grid_generation)
+        dirty |= IDLE_DIRTY_GRID;
+    if (engine->resize_pending || engine->window_width != idle->width || engine->window_height != idle->height)
+        dirty |= IDLE_DIRTY_WINDOW;
+    if (idle->settle_frames > 0 || engine->quality.current < engine->quality.preset_count - 1)
+        dirty |= IDLE_DIRTY_SETTLING;
+    if (idle->animation_interval > 0.0 && now - idle->last_frame_time >= idle->animation_interval)
+        dirty |= IDLE_DIRTY_ANIMATION;
+    if (is_profiler_overlay_visible)
+        dirty |= IDLE_DIRTY_OVERLAY;
+    return dirty;
+}
+
+void idle_frame_rendered(idle_tracker_t *idle, unsigned reasons, const renderer_engine_t *engine, const camera_t *cam,
+                         double now)
+{
+    idle->pending = 0;
+    idle->target = cam->target;
+    idle->radius = cam->radius;
+    idle->azimuth = cam->azimuth;
+    idle->elevation = cam->elevation;
+    idle->physics_generation = physics_get_generation();
+    idle->grid_generation = grid_get_generation();
+    idle->width = engine->window_width;
+    idle->height = engine->window_height;
+    idle->last_frame_time = now;
+
+    // interleaved tracing fills in every pixel after interleave_mode frames; the upscaler converges slower
+    if (reasons & IDLE_SCENE_REASONS)
+        idle->settle_frames = engine->upscale_enabled ? IDLE_SETTLE_FRAMES : (int)engine->interleave_mode - 1;
+    else if (idle->settle_frames > 0)
+        --idle->settle_frames;
+
+    ++idle->rendered_frames;
+    for (int i = 0; i < IDLE_DIRTY_REASON_COUNT; ++i)
+    {
+        if (reasons & (1u << i))
+            ++idle->reason_frames[i];
+    }
+}
+
+void idle_wait(idle_tracker_t *idle, renderer_engine_t *engine, double now)
+{
+    double timeout = IDLE_MAX_WAIT;
+    if (idle->animation_interval > 0.0)
+    {
+        double due = idle->last_frame_time + idle->animation_interval - now;
+        timeout = due < timeout ? due : timeout;
+    }
+    if (timeout <= 0.0)
+        return;
+    double start = profiler_now();
+    engine_wait_events(engine, timeout);
+    idle->idle_seconds += profiler_now() - start;
+}
+
+void idle_print_stats(const idle_tracker_t *idle, double run_seconds)
+{
+    if (!idle->enabled)
+        return;
+    // skipped frames: the refresh intervals spent waiting
+    const GLFWvidmode *mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    int refresh_rate = mode && mode->refreshRate > 0 ? mode->refreshRate : 60;
+    printf("[INFO] Idle: %ld frames rendered, %ld skipped at %d Hz (%.1f s of %.1f s idle)", idle->rendered_frames,
+           (long)(idle->idle_seconds * refresh_rate), refresh_rate, idle->idle_seconds, run_seconds);
+    const char *separator = "; rendered for";
+    for (int i = 0; i < IDLE_DIRTY_REASON_COUNT; ++i)
+    {
+        if (idle->reason_frames[i] == 0)
+            continue;
+        printf("%s %s %ld", separator, idle_reason_names[i], idle->reason_frames[i]);
+        separator = ",";
+    }
+    printf("\n");
+}
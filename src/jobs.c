@@ -0,0 +1,406 @@
+/**
+work-stealing job scheduler: a fixed pool of job slots, one deque per worker thread plus a
+shared one for outside threads, and dependency counts that queue a job when its last
+dependency finishes
+**/
+
+#define _GNU_SOURCE
+
+#include "jobs.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct
+{
+    job_function_t function;
+    void *data;
+    atomic_uint generation; // bumped when the job finishes, which invalidates its handles
+    atomic_int pending;     // unfinished dependencies, plus one until submission is complete
+    int dependents[JOBS_MAX_DEPENDENTS];
+    int dependent_count;    // guarded by jobs.lock, like the generation changes
+    int next_free;
+} job_slot_t;
+
+// ring of slot indices: the owner works at the bottom, thieves take from the top
+typedef struct
+{
+    pthread_mutex_t lock;
+    int slots[JOBS_CAPACITY];
+    int top, bottom;
+} job_deque_t;
+
+typedef struct
+{
+    int index;
+    pthread_t thread;
+    pthread_mutex_t stats_lock; // the thread updating stats against jobs_get_stats
+    jobs_worker_stats_t stats;
+} job_worker_t;
+
+static struct
+{
+    bool initialized;
+    int worker_count;
+    atomic_bool running;
+    double start_time, stop_time;
+
+    job_slot_t slots[JOBS_CAPACITY];
+    int free_list;
+    atomic_int alive; // submitted and not finished
+
+    job_deque_t deques[JOBS_MAX_WORKERS + 1]; // the last one belongs to threads outside the pool
+    job_worker_t workers[JOBS_MAX_WORKERS + 1];
+    atomic_int queued;   // jobs sitting in a deque
+    atomic_int sleepers; // threads waiting on wake
+
+    pthread_mutex_t lock; // free list, dependents, generations and sleeping
+    pthread_cond_t wake;
+} jobs;
+
+// deque of the calling thread: its own for workers, the shared one otherwise
+static _Thread_local int jobs_thread_index = -1;
+
+static double jobs_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int jobs_current_deque(void)
+{
+    return jobs_thread_index >= 0 ? jobs_thread_index : jobs.worker_count;
+}
+
+static void jobs_push(int deque_index, int slot)
+{
+    job_deque_t *deque = &jobs.deques[deque_index];
+    pthread_mutex_lock(&deque->lock);
+    deque->slots[deque->bottom % JOBS_CAPACITY] = slot;
+    deque->bottom++;
+    pthread_mutex_unlock(&deque->lock);
+
+    // sleepers count themselves before checking queued, so one of the two sides sees the other
+    atomic_fetch_add(&jobs.queued, 1);
+    if (atomic_load(&jobs.sleepers) > 0)
+    {
+        pthread_mutex_lock(&jobs.lock);
+        pthread_cond_broadcast(&jobs.wake);
+        pthread_mutex_unlock(&jobs.lock);
+    }
+}
+
+// newest job of the deque (owner side) or oldest (steal side); -1 when empty
+static int jobs_pop(int deque_index, bool steal)
+{
+    job_deque_t *deque = &jobs.deques[deque_index];
+    int slot = -1;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->top != deque->bottom)
+    {
+        if (steal)
+            slot = deque->slots[deque->top++ % JOBS_CAPACITY];
+        else
+            slot = deque->slots[--deque->bottom % JOBS_CAPACITY];
+        if (deque->top == deque->bottom)
+            deque->top = deque->bottom = 0;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    if (slot >= 0)
+        atomic_fetch_sub(&jobs.queued, 1);
+    return slot;
+}
+
+// drops one pending count; the last one queues the job on the calling thread's deque
+static void jobs_release(int slot)
+{
+    if (atomic_fetch_sub(&jobs.slots[slot].pending, 1) == 1)
+        jobs_push(jobs_current_deque(), slot);
+}
+
+static void jobs_finish(int slot)
+{
+    job_slot_t *job = &jobs.slots[slot];
+    int dependents[JOBS_MAX_DEPENDENTS];
+
+    pthread_mutex_lock(&jobs.lock);
+    unsigned int generation = atomic_load(&job->generation) + 1;
+    atomic_store(&job->generation, generation ? generation : 1);
+    int dependent_count = job->dependent_count;
+    for (int i = 0; i < dependent_count; ++i)
+        dependents[i] = job->dependents[i];
+    job->dependent_count = 0;
+    job->next_free = jobs.free_list;
+    jobs.free_list = slot;
+    atomic_fetch_sub(&jobs.alive, 1);
+    if (atomic_load(&jobs.sleepers) > 0)
+        pthread_cond_broadcast(&jobs.wake); // waiters, and submitters waiting for a free slot
+    pthread_mutex_unlock(&jobs.lock);
+
+    for (int i = 0; i < dependent_count; ++i)
+        jobs_release(dependents[i]);
+}
+
+// runs one job from the own deque or, failing that, one stolen from another thread
+static bool jobs_run_one(void)
+{
+    int self = jobs_current_deque();
+    bool stolen = false;
+    int slot = jobs_pop(self, false);
+    for (int k = 1; slot < 0 && k <= jobs.worker_count; ++k)
+    {
+        slot = jobs_pop((self + k) % (jobs.worker_count + 1), true);
+        stolen = slot >= 0;
+    }
+    if (slot < 0)
+        return false;
+
+    job_slot_t *job = &jobs.slots[slot];
+    double start = jobs_now();
+    job->function(job->data);
+    double busy = jobs_now() - start;
+
+    // threads outside the pool share one counter; a pool worker's lock is only contended
+    // while jobs_get_stats reads it
+    job_worker_t *worker = &jobs.workers[self];
+    pthread_mutex_lock(&worker->stats_lock);
+    worker->stats.executed++;
+    worker->stats.stolen += stolen;
+    worker->stats.busy_seconds += busy;
+    pthread_mutex_unlock(&worker->stats_lock);
+
+    jobs_finish(slot);
+    return true;
+}
+
+// sleeps until work is queued or the condition may have changed; call with jobs.lock held
+static void jobs_sleep(void)
+{
+    atomic_fetch_add(&jobs.sleepers, 1);
+    if (atomic_load(&jobs.queued) == 0 && atomic_load(&jobs.running))
+        pthread_cond_wait(&jobs.wake, &jobs.lock);
+    atomic_fetch_sub(&jobs.sleepers, 1);
+}
+
+static void *jobs_worker_proc(void *arg)
+{
+    job_worker_t *worker = arg;
+    jobs_thread_index = worker->index;
+    while (atomic_load(&jobs.running))
+    {
+        if (jobs_run_one())
+            continue;
+        pthread_mutex_lock(&jobs.lock);
+        jobs_sleep();
+        pthread_mutex_unlock(&jobs.lock);
+    }
+    return NULL;
+}
+
+bool jobs_init(int worker_count, bool pin_threads)
+{
+    if (jobs.initialized)
+        return true;
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (worker_count < 0)
+        worker_count = cores > 1 ? (int)cores - 1 : 0;
+    if (worker_count > JOBS_MAX_WORKERS)
+        worker_count = JOBS_MAX_WORKERS;
+
+    pthread_mutex_init(&jobs.lock, NULL);
+    pthread_cond_init(&jobs.wake, NULL);
+    for (int i = 0; i < JOBS_CAPACITY; ++i)
+    {
+        atomic_init(&jobs.slots[i].generation, 1);
+        jobs.slots[i].next_free = i + 1 < JOBS_CAPACITY ? i + 1 : -1;
+    }
+    jobs.free_list = 0;
+    for (int i = 0; i <= JOBS_MAX_WORKERS; ++i)
+    {
+        pthread_mutex_init(&jobs.deques[i].lock, NULL);
+        jobs.workers[i] = (job_worker_t){.index = i};
+        pthread_mutex_init(&jobs.workers[i].stats_lock, NULL);
+    }
+
+    jobs.worker_count = worker_count;
+    jobs.start_time = jobs_now();
+    atomic_store(&jobs.running, true);
+    jobs.initialized = true;
+
+    for (int i = 0; i < worker_count; ++i)
+    {
+        if (pthread_create(&jobs.workers[i].thread, NULL, jobs_worker_proc, &jobs.workers[i]) != 0)
+        {
+            // the deques of the missing workers stay empty; nothing is pushed to them
+            printf("Failed to start job worker %d, continuing with %d\n", i, i);
+            jobs.worker_count = i;
+            break;
+        }
+#ifdef __linux__
+        if (pin_threads && cores > 1)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET((i + 1) % cores, &set);
+            if (pthread_setaffinity_np(jobs.workers[i].thread, sizeof(set), &set) != 0)
+                printf("Failed to pin job worker %d to core %ld\n", i, (i + 1) % cores);
+        }
+#endif
+    }
+#ifndef __linux__
+    (void)pin_threads;
+#endif
+    printf("[INFO] Job system: %d worker threads%s\n", jobs.worker_count, pin_threads ? " (pinned)" : "");
+    return true;
+}
+
+void jobs_shutdown(void)
+{
+    if (!jobs.initialized)
+        return;
+    jobs_wait_all();
+
+    pthread_mutex_lock(&jobs.lock);
+    atomic_store(&jobs.running, false);
+    pthread_cond_broadcast(&jobs.wake);
+    pthread_mutex_unlock(&jobs.lock);
+    for (int i = 0; i < jobs.worker_count; ++i)
+        pthread_join(jobs.workers[i].thread, NULL);
+
+    pthread_mutex_destroy(&jobs.lock);
+    pthread_cond_destroy(&jobs.wake);
+    for (int i = 0; i <= JOBS_MAX_WORKERS; ++i)
+    {
+        pthread_mutex_destroy(&jobs.deques[i].lock);
+        pthread_mutex_destroy(&jobs.workers[i].stats_lock);
+    }
+    jobs.stop_time = jobs_now();
+    jobs.initialized = false;
+}
+
+int jobs_worker_count(void)
+{
+    return jobs.worker_count;
+}
+
+bool jobs_is_done(job_handle_t job)
+{
+    return job.generation == 0 || atomic_load(&jobs.slots[job.index].generation) != job.generation;
+}
+
+job_handle_t jobs_submit(job_function_t function, void *data, const job_handle_t *dependencies, int dependency_count)
+{
+    if (!jobs.initialized)
+    {
+        // no scheduler (tools, the poster path): dependencies have already run the same way
+        function(data);
+        return (job_handle_t){0, 0};
+    }
+
+    pthread_mutex_lock(&jobs.lock);
+    while (jobs.free_list < 0)
+    {
+        // every slot is taken: help finish some before queueing more
+        pthread_mutex_unlock(&jobs.lock);
+        if (!jobs_run_one())
+        {
+            pthread_mutex_lock(&jobs.lock);
+            if (jobs.free_list < 0)
+                jobs_sleep();
+            pthread_mutex_unlock(&jobs.lock);
+        }
+        pthread_mutex_lock(&jobs.lock);
+    }
+    int slot = jobs.free_list;
+    job_slot_t *job = &jobs.slots[slot];
+    jobs.free_list = job->next_free;
+    job->function = function;
+    job->data = data;
+    job->dependent_count = 0;
+    atomic_store(&job->pending, 1);
+    atomic_fetch_add(&jobs.alive, 1);
+    job_handle_t handle = {slot, atomic_load(&job->generation)};
+
+    int overflow[JOBS_MAX_DEPENDENTS];
+    int overflow_count = 0;
+    for (int i = 0; i < dependency_count; ++i)
+    {
+        job_handle_t dependency = dependencies[i];
+        if (jobs_is_done(dependency))
+            continue;
+        job_slot_t *parent = &jobs.slots[dependency.index];
+        if (parent->dependent_count < JOBS_MAX_DEPENDENTS)
+        {
+            parent->dependents[parent->dependent_count++] = slot;
+            atomic_fetch_add(&job->pending, 1);
+        }
+        else if (overflow_count < JOBS_MAX_DEPENDENTS)
+        {
+            overflow[overflow_count++] = i;
+        }
+    }
+    pthread_mutex_unlock(&jobs.lock);
+
+    // dependencies with no room left for another dependent are waited for here
+    for (int i = 0; i < overflow_count; ++i)
+        jobs_wait(dependencies[overflow[i]]);
+
+    jobs_release(slot);
+    return handle;
+}
+
+void jobs_wait(job_handle_t job)
+{
+    while (!jobs_is_done(job))
+    {
+        if (jobs_run_one())
+            continue;
+        pthread_mutex_lock(&jobs.lock);
+        if (!jobs_is_done(job))
+            jobs_sleep();
+        pthread_mutex_unlock(&jobs.lock);
+    }
+}
+
+void jobs_wait_all(void)
+{
+    while (atomic_load(&jobs.alive) > 0)
+    {
+        if (jobs_run_one())
+            continue;
+        pthread_mutex_lock(&jobs.lock);
+        if (atomic_load(&jobs.alive) > 0)
+            jobs_sleep();
+        pthread_mutex_unlock(&jobs.lock);
+    }
+}
+
+jobs_worker_stats_t jobs_get_stats(int worker)
+{
+    // after jobs_shutdown no thread is left to update them
+    if (!jobs.initialized)
+        return jobs.workers[worker].stats;
+    pthread_mutex_lock(&jobs.workers[worker].stats_lock);
+    jobs_worker_stats_t stats = jobs.workers[worker].stats;
+    pthread_mutex_unlock(&jobs.workers[worker].stats_lock);
+    return stats;
+}
+
+void jobs_print_stats(void)
+{
+    double elapsed = (jobs.initialized ? jobs_now() : jobs.stop_time) - jobs.start_time;
+    printf("--- Job system (%d workers, %.2f s) ---\n", jobs.worker_count, elapsed);
+    printf("%-8s %10s %10s %8s\n", "thread", "jobs", "steals", "busy");
+    for (int i = 0; i <= jobs.worker_count; ++i)
+    {
+        jobs_worker_stats_t stats = jobs_get_stats(i);
+        char name[16];
+        snprintf(name, sizeof(name), i < jobs.worker_count ? "worker%d" : "outside", i);
+        printf("%-8s %10lld %10lld %7.1f%%\n", name, stats.executed, stats.stolen,
+               elapsed > 0.0 ? 100.0 * stats.busy_seconds / elapsed : 0.0);
+    }
+}
@@ -13,7 +13,40 @@
  * - 'r': reset the camera to its initial state.
  * - 'p': pause or resume the physics simulation.
  * - 'g': toggle the visibility of the spacetime grid.
+ * - 'o': toggle the frame-stage profiler overlay.
+ * - 't': print stage percentiles and write blackhole_trace.json (chrome trace format).
+ * - 'c': cycle interleaved tracing (off, checkerboard, 2x2) with temporal reconstruction.
+ * - 'u': toggle temporal upscaling of the trace target to window resolution.
+ * - 'h': toggle the ray-step heatmap (steps per pixel; magenta = step budget exhausted) and collect ray statistics.
+ * - 'b': toggle per-tile body culling (off tests every body on every ray step).
  * - 'esc': exit the application.
+ *
+ * command line:
+ * - --headless: render offscreen through egl (no window, no vsync), e.g. on render servers.
+ * - --size WxH: headless output resolution (default 1280x720).
+ * - --frames N: number of frames to render in headless mode (default 100).
+ * - --scale N: trace at 1/N of the output resolution (default 7).
+ * - --interleave N: trace 1/N of the pixels per frame and reconstruct the rest (1, 2 or 4; default 1).
+ * - --no-upscale: stretch the trace target bilinearly instead of temporally upscaling it.
+ * - --no-body-culling: test every body on every ray step instead of only the bodies a screen tile can see.
+ * - --quality FILE: load the motion-adaptive quality presets and timings (see quality.h).
+ * - --sky FILE: use an equirectangular binary ppm panorama as the sky instead of the baked stars.
+ * - --ray-stats FILE: record steps and termination reasons of every ray and write per-frame totals as json.
+ * - --output FILE: write the last headless frame as a binary ppm.
+ * - --capture DIR: record every frame as DIR/frame_NNNNN.ppm through the asynchronous readback ring.
+ * - --stream ADDRESS: serve every frame to remote viewers (tools/stream_client) on unix:PATH or HOST:PORT.
+ * - --poster WxH: render one still of any size tile by tile into --output (headless); rerun to resume.
+ * - --tile N: poster tile size in pixels (default 1024).
+ * - --jobs N: worker threads for physics, grid and file writing (default: one per core minus the render thread).
+ * - --pin-threads: bind each worker thread to its own core (linux).
+ * - --collisions MODE: what touching bodies do: off (default, they pass through each other), merge or bounce.
+ * - --record FILE: log the starting state, every frame's clock and all input to FILE.
+ * - --replay FILE: play a recording back at its recorded pace instead of taking input (run it
+ *   with the options it was recorded with); the window or headless target takes the recorded
+ *   size, and a replay's window can't be resized by hand.
+ * - --replay-fast: play the --replay recording as fast as possible.
+ * - --no-idle: render every frame even when nothing on screen changes.
+ * - --idle-fps N: disk animation frame rate while nothing else changes (default 10; 0 freezes it until input).
  */
 
 #include "math_utils.h"
@@ -23,6 +56,15 @@
 #include "shaders.h"
 #include "renderer.h"
 #include "callbacks.h"
+#include "profiler.h"
+#include "readback.h"
+#include "stream.h"
+#include "ray_stats.h"
+#include "poster.h"
+#include "jobs.h"
+#include "collision.h"
+#include "replay.h"
+#include "idle.h"
 
 #ifdef __APPLE__
 #define GL_SILENCE_DEPRECATION
@@ -33,46 +75,469 @@
 #include <GLFW/glfw3.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+// command line options
+typedef struct
+{
+    bool headless;
+    int width, height;
+    int frames;
+    int scale;
+    int interleave;
+    bool no_upscale;
+    bool no_body_culling;
+    const char *quality_path;
+    const char *sky_path;
+    const char *ray_stats_path;
+    const char *output_path;
+    const char *capture_dir;
+    const char *stream_address;
+    int poster_width, poster_height;
+    int tile_size;
+    int jobs;
+    bool pin_threads;
+    collision_mode_t collisions;
+    const char *record_path;
+    const char *replay_path;
+    bool replay_fast;
+    bool no_idle;
+    double idle_fps;
+} app_options_t;
+
+// captured frames being written at once; the readback consumer waits for the oldest beyond this
+#define CAPTURE_MAX_WRITES 4
+
+// one captured frame owned by its writer job
+typedef struct
+{
+    const char *directory;
+    unsigned char *pixels;
+    int width, height;
+    int frame_index;
+} capture_frame_t;
+
+static job_handle_t capture_writes[CAPTURE_MAX_WRITES];
+
+// writer job: writes a frame as a numbered ppm (flipped to top-down rgb)
+static void capture_write_job(void *data)
+{
+    capture_frame_t *frame = data;
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/frame_%05d.ppm", frame->directory, frame->frame_index);
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        printf("Failed to open %s for writing\n", path);
+        free(frame->pixels);
+        free(frame);
+        return;
+    }
+
+    int width = frame->width, height = frame->height;
+    unsigned char *row = malloc((size_t)width * 3);
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for (int y = height - 1; row && y >= 0; --y)
+    {
+        const unsigned char *src = frame->pixels + (size_t)y * width * 4;
+        for (int x = 0; x < width; ++x)
+        {
+            row[x * 3 + 0] = src[x * 4 + 0];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + 2];
+        }
+        fwrite(row, 3, width, file);
+    }
+    free(row);
+    fclose(file);
+    free(frame->pixels);
+    free(frame);
+}
+
+// readback consumer: copies the mapped frame and hands it to a writer job
+static void capture_write_ppm(const unsigned char *pixels, int width, int height, int frame_index, double capture_time,
+                              void *user_data)
+{
+    (void)capture_time;
+    capture_frame_t *frame = malloc(sizeof(capture_frame_t));
+    size_t size = (size_t)width * height * 4;
+    unsigned char *copy = frame ? malloc(size) : NULL;
+    if (!copy)
+    {
+        printf("Failed to allocate capture frame %d\n", frame_index);
+        free(frame);
+        return;
+    }
+    memcpy(copy, pixels, size);
+    *frame = (capture_frame_t){user_data, copy, width, height, frame_index};
+
+    job_handle_t *slot = &capture_writes[frame_index % CAPTURE_MAX_WRITES];
+    jobs_wait(*slot);
+    *slot = jobs_submit(capture_write_job, frame, NULL, 0);
+}
+
+// readback consumer: hands the mapped frame to the stream server, which copies it
+static void stream_submit_frame(const unsigned char *pixels, int width, int height, int frame_index,
+                                double capture_time, void *user_data)
+{
+    stream_server_submit(user_data, pixels, width, height, frame_index, capture_time);
+}
 
-int main()
+static bool parse_options(int argc, char **argv, app_options_t *options)
 {
+    *options = (app_options_t){.width = 1280, .height = 720, .frames = 100, .tile_size = POSTER_DEFAULT_TILE_SIZE,
+                               .jobs = -1, .collisions = COLLISION_OFF, .idle_fps = IDLE_DEFAULT_ANIMATION_FPS};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--headless") == 0)
+        {
+            options->headless = true;
+        }
+        else if (strcmp(arg, "--size") == 0 && value && sscanf(value, "%dx%d", &options->width, &options->height) == 2)
+        {
+            ++i;
+        }
+        else if (strcmp(arg, "--frames") == 0 && value)
+        {
+            options->frames = atoi(value);
+            ++i;
+        }
+        else if (strcmp(arg, "--scale") == 0 && value)
+        {
+            options->scale = atoi(value);
+            ++i;
+        }
+        else if (strcmp(arg, "--interleave") == 0 && value)
+        {
+            options->interleave = atoi(value);
+            ++i;
+        }
+        else if (strcmp(arg, "--no-upscale") == 0)
+        {
+            options->no_upscale = true;
+        }
+        else if (strcmp(arg, "--no-body-culling") == 0)
+        {
+            options->no_body_culling = true;
+        }
+        else if (strcmp(arg, "--quality") == 0 && value)
+        {
+            options->quality_path = value;
+            ++i;
+        }
+        else if (strcmp(arg, "--sky") == 0 && value)
+        {
+            options->sky_path = value;
+            ++i;
+        }
+        else if (strcmp(arg, "--ray-stats") == 0 && value)
+        {
+            options->ray_stats_path = value;
+            ++i;
+        }
+        else if (strcmp(arg, "--output") == 0 && value)
+        {
+            options->output_path = value;
+            ++i;
+        }
+        else if (strcmp(arg, "--capture") == 0 && value)
+        {
+            options->capture_dir = value;
+            ++i;
+        }
+        else if (strcmp(arg, "--stream") == 0 && value)
+        {
+            options->stream_address = value;
+            ++i;
+        }
+        else if (strcmp(arg, "--poster") == 0 && value &&
+                 sscanf(value, "%dx%d", &options->poster_width, &options->poster_height) == 2)
+        {
+            options->headless = true;
+            ++i;
+        }
+        else if (strcmp(arg, "--tile") == 0 && value)
+        {
+            options->tile_size = atoi(value);
+            ++i;
+        }
+        else if (strcmp(arg, "--jobs") == 0 && value)
+        {
+            options->jobs = atoi(value);
+            ++i;
+        }
+        else if (strcmp(arg, "--pin-threads") == 0)
+        {
+            options->pin_threads = true;
+        }
+        else if (strcmp(arg, "--collisions") == 0 && value &&
+                 (strcmp(value, "merge") == 0 || strcmp(value, "bounce") == 0 || strcmp(value, "off") == 0))
+        {
+            options->collisions = value[0] == 'm' ? COLLISION_MERGE : value[0] == 'b' ? COLLISION_BOUNCE : COLLISION_OFF;
+            ++i;
+        }
+        else if (strcmp(arg, "--record") == 0 && value)
+        {
+            options->record_path = value;
+            ++i;
+        }
+        else if (strcmp(arg, "--replay") == 0 && value)
+        {
+            options->replay_path = value;
+            ++i;
+        }
+        else if (strcmp(arg, "--replay-fast") == 0)
+        {
+            options->replay_fast = true;
+        }
+        else if (strcmp(arg, "--no-idle") == 0)
+        {
+            options->no_idle = true;
+        }
+        else if (strcmp(arg, "--idle-fps") == 0 && value)
+        {
+            options->idle_fps = atof(value);
+            ++i;
+        }
+        else
+        {
+            printf("Unknown or incomplete option: %s\n", arg);
+            printf("Usage: %s [--headless] [--size WxH] [--frames N] [--scale N] [--interleave 1|2|4] [--no-upscale] [--no-body-culling] [--quality FILE] [--sky FILE.ppm] [--ray-stats FILE.json] [--output FILE.ppm] [--capture DIR] [--stream ADDRESS] [--poster WxH] [--tile N] [--jobs N] [--pin-threads] [--collisions off|merge|bounce] [--record FILE] [--replay FILE] [--replay-fast] [--no-idle] [--idle-fps N]\n", argv[0]);
+            return false;
+        }
+    }
+
+    if (options->width < 1 || options->height < 1 || options->frames < 1)
+    {
+        printf("Size and frame count must be positive\n");
+        return false;
+    }
+    if (options->jobs < -1 || options->jobs > JOBS_MAX_WORKERS)
+    {
+        printf("Jobs must be between 0 and %d\n", JOBS_MAX_WORKERS);
+        return false;
+    }
+    if (options->interleave != 0 && options->interleave != INTERLEAVE_OFF &&
+        options->interleave != INTERLEAVE_CHECKERBOARD && options->interleave != INTERLEAVE_2X2)
+    {
+        printf("Interleave must be 1, 2 or 4\n");
+        return false;
+    }
+    if (options->record_path && options->replay_path)
+    {
+        printf("--record and --replay can't be combined\n");
+        return false;
+    }
+    if (options->idle_fps < 0.0)
+    {
+        printf("Idle fps can't be negative\n");
+        return false;
+    }
+    if (options->replay_fast && !options->replay_path)
+    {
+        printf("--replay-fast needs --replay FILE\n");
+        return false;
+    }
+    if ((options->poster_width || options->poster_height) && (options->record_path || options->replay_path))
+    {
+        printf("--poster can't be recorded or replayed\n");
+        return false;
+    }
+    if (options->poster_width || options->poster_height)
+    {
+        if (options->poster_width < 1 || options->poster_height < 1 || options->tile_size < 1)
+        {
+            printf("Poster size and tile size must be positive\n");
+            return false;
+        }
+        if (!options->output_path)
+        {
+            printf("--poster needs --output FILE.ppm\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    double launch_time = profiler_now();
+    app_options_t options;
+    if (!parse_options(argc, argv, &options))
+    {
+        return EXIT_FAILURE;
+    }
+
     camera_reset(&camera);
+    physics_reset();
+    collision_mode = options.collisions;
+
+    renderer_engine.render_scale_divisor = options.scale;
+    renderer_engine.interleave_mode = options.interleave ? (interleave_mode_t)options.interleave : INTERLEAVE_OFF;
+    renderer_engine.upscale_enabled = !options.no_upscale;
+    renderer_engine.body_culling_enabled = !options.no_body_culling;
+    renderer_engine.sky_path = options.sky_path;
+    quality_init_defaults(&renderer_engine.quality);
+    if (options.quality_path && !quality_load_config(&renderer_engine.quality, options.quality_path))
+    {
+        return EXIT_FAILURE;
+    }
+    if (options.poster_width > 0)
+    {
+        // a still: the offscreen targets are one tile, traced at full resolution, no threads
+        renderer_engine.render_scale_divisor = 1;
+        if (!engine_initialize_headless(&renderer_engine, options.tile_size, options.tile_size))
+        {
+            return EXIT_FAILURE;
+        }
+        bool written = poster_render(&renderer_engine, &camera, options.output_path, options.poster_width,
+                                     options.poster_height, options.tile_size);
+        engine_cleanup(&renderer_engine);
+        return written ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // a replay starts from the recorded state, at the recorded size
+    replay_seed_t seed;
+    if (options.replay_path)
+    {
+        if (!replay_start_playback(&replay_session, options.replay_path, !options.replay_fast, &seed))
+        {
+            return EXIT_FAILURE;
+        }
+        if (seed.body_count != NUM_CELESTIAL_BODIES)
+        {
+            printf("Failed to replay %s: it has %d bodies, this build %d\n", options.replay_path, seed.body_count,
+                   NUM_CELESTIAL_BODIES);
+            return EXIT_FAILURE;
+        }
+        memcpy(celestial_bodies, seed.bodies, sizeof(celestial_body_t) * seed.body_count);
+        camera = seed.camera;
+        collision_mode = (collision_mode_t)seed.collision_mode;
+        options.width = seed.width;
+        options.height = seed.height;
+    }
 
-    if (!engine_initialize(&renderer_engine))
+    bool initialized = options.headless
+                           ? engine_initialize_headless(&renderer_engine, options.width, options.height)
+                           : engine_initialize(&renderer_engine);
+    if (!initialized)
+    {
+        return EXIT_FAILURE;
+    }
+    if (options.headless)
+    {
+        // replays end with the recording
+        renderer_engine.frame_limit = options.replay_path ? 0 : options.frames;
+    }
+    if (options.replay_path && !options.headless)
+    {
+        callback_begin_replay(renderer_engine.window, seed.width, seed.height);
+    }
+    if (options.ray_stats_path && !engine_set_ray_stats(&renderer_engine, true))
     {
         return EXIT_FAILURE;
     }
 
-	physics_start_thread();
-	
-	// initialize and start grid generation
+	profiler_init();
+    jobs_init(options.jobs, options.pin_threads);
+
+    readback_ring_t capture_ring;
+    if (options.capture_dir)
+    {
+        readback_init(&capture_ring, capture_write_ppm, (void *)options.capture_dir);
+    }
+
+    // a ring of its own, so the viewers get frames at the stream's pace rather than the disk's
+    readback_ring_t stream_ring;
+    stream_server_t *stream_server = NULL;
+    if (options.stream_address)
+    {
+        stream_server = stream_server_start(options.stream_address);
+        if (!stream_server)
+        {
+            return EXIT_FAILURE;
+        }
+        readback_init(&stream_ring, stream_submit_frame, stream_server);
+    }
+
+	// initial grid data; later meshes are computed by jobs after each physics step
 	grid_init_buffers();
-	grid_start_thread();
 	grid_update_mesh(&renderer_engine);
 
-    double last_time = glfwGetTime();
+    double last_time = engine_get_time(&renderer_engine);
+    if (options.replay_path)
+    {
+        last_time = seed.start_time;
+    }
+    else if (options.record_path)
+    {
+        seed = (replay_seed_t){.body_count = NUM_CELESTIAL_BODIES, .camera = camera, .collision_mode = collision_mode,
+                               .width = renderer_engine.window_width, .height = renderer_engine.window_height,
+                               .start_time = last_time};
+        memcpy(seed.bodies, celestial_bodies, sizeof(celestial_body_t) * NUM_CELESTIAL_BODIES);
+        if (!replay_start_recording(&replay_session, options.record_path, &seed))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    // recorded and replayed runs step physics and the grid to completion every frame, on a
+    // clock pinned per frame, so both see the same simulation whatever the machine's speed
+    bool deterministic = replay_session.mode != REPLAY_OFF;
+    // windowed runs skip frames that would show the same picture; headless and recorded runs render every frame
+    idle_init(&idle_tracker, !options.headless && !deterministic && !options.no_idle, options.idle_fps);
 
-    while (!glfwWindowShouldClose(renderer_engine.window))
+    while (!engine_should_close(&renderer_engine))
     {
-        double current_time = glfwGetTime();
+        double current_time = engine_get_wall_time(&renderer_engine);
+        if (deterministic)
+        {
+            if (!replay_begin_frame(&replay_session, &current_time))
+                break; // the replay has no frames left
+            engine_set_fixed_time(&renderer_engine, current_time);
+        }
         double delta_time = current_time - last_time;
         last_time = current_time;
 
-		if (!physics_is_threaded())
-		{
-			simulation_update_physics(delta_time * 500.0); // speed up simulation time (single-thread fallback)
-		}
-		
-		// update grid mesh from background thread, or generate synchronously if threading not available
-		if (grid_is_threaded())
-		{
-			grid_update_mesh(&renderer_engine);
-		}
-		else if (!is_physics_paused)
+        unsigned dirty = idle_check(&idle_tracker, &renderer_engine, &camera, current_time);
+        if (!dirty)
+        {
+            // hand over the captured frames still in flight, no later frame will push them out
+            if (options.capture_dir)
+            {
+                readback_poll(&capture_ring, renderer_engine.frame_index, true);
+            }
+            if (stream_server)
+            {
+                readback_poll(&stream_ring, renderer_engine.frame_index, true);
+            }
+            idle_wait(&idle_tracker, &renderer_engine, current_time);
+            continue;
+        }
+
+        profiler_begin_frame();
+        double frame_start = profiler_begin(PROFILER_STAGE_FRAME);
+
+        engine_begin_frame(&renderer_engine);
+
+		// physics steps and the grid computed from them run as jobs on the worker threads
+		job_handle_t physics_job = physics_schedule(delta_time);
+		job_handle_t grid_job = grid_schedule(current_time, physics_job);
+		if (jobs_worker_count() == 0 || deterministic)
 		{
-			grid_generate_mesh(&renderer_engine);
+			jobs_wait(physics_job); // no workers: run them here, before the frame that shows them
+			jobs_wait(grid_job);
 		}
 
+		// upload the latest grid mesh
+		double stage_start = profiler_begin(PROFILER_STAGE_GRID_UPLOAD);
+		grid_update_mesh(&renderer_engine);
+		profiler_end(PROFILER_STAGE_GRID_UPLOAD, stage_start);
+
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         vector3_t cam_pos = camera_get_position(&camera);
@@ -80,17 +545,107 @@ int main()
         matrix4_t projection_matrix = matrix4_perspective(M_PI / 3.0f, (float)renderer_engine.window_width / (float)renderer_engine.window_height, 1e9f, 1e14f);
         matrix4_t view_projection_matrix = matrix4_multiply(projection_matrix, view_matrix);
 
+        stage_start = profiler_begin(PROFILER_STAGE_GRID_RENDER);
         grid_render(&renderer_engine, view_projection_matrix);
+        profiler_end(PROFILER_STAGE_GRID_RENDER, stage_start);
+
+        int quality_level = engine_update_quality(&renderer_engine);
+        stage_start = profiler_begin_variant(PROFILER_STAGE_RAY_TRACE, quality_level);
         engine_render_raytraced_scene_to_texture(&renderer_engine, &camera);
+        profiler_end(PROFILER_STAGE_RAY_TRACE, stage_start);
+
+        stage_start = profiler_begin(PROFILER_STAGE_BLIT);
         engine_render_texture_to_screen(&renderer_engine);
+        profiler_end(PROFILER_STAGE_BLIT, stage_start);
+
+        profiler_render_overlay(renderer_engine.window_width, renderer_engine.window_height);
+
+        if (options.capture_dir)
+        {
+            readback_capture(&capture_ring, engine_output_framebuffer(&renderer_engine),
+                             renderer_engine.window_width, renderer_engine.window_height, renderer_engine.frame_index);
+        }
+        if (stream_server)
+        {
+            readback_capture(&stream_ring, engine_output_framebuffer(&renderer_engine),
+                             renderer_engine.window_width, renderer_engine.window_height, renderer_engine.frame_index);
+        }
+
+        stage_start = profiler_begin(PROFILER_STAGE_SWAP);
+        engine_present(&renderer_engine);
+        profiler_end(PROFILER_STAGE_SWAP, stage_start);
+        idle_frame_rendered(&idle_tracker, dirty, &renderer_engine, &camera, current_time);
+
+        if (renderer_engine.frame_index == 1)
+        {
+            printf("[INFO] Time to first frame: %.1f ms\n", (profiler_now() - launch_time) * 1000.0);
+        }
+
+        if (options.capture_dir)
+        {
+            readback_poll(&capture_ring, renderer_engine.frame_index, false);
+        }
+        if (stream_server)
+        {
+            readback_poll(&stream_ring, renderer_engine.frame_index, false);
+        }
+
+        engine_poll_events(&renderer_engine);
+        replay_event_t event;
+        while (replay_next_event(&replay_session, &event))
+        {
+            callback_apply_event(renderer_engine.window, &event);
+        }
+        profiler_end(PROFILER_STAGE_FRAME, frame_start);
+    }
+    replay_close(&replay_session);
+    idle_print_stats(&idle_tracker, engine_get_wall_time(&renderer_engine));
 
-        glfwSwapBuffers(renderer_engine.window);
-        glfwPollEvents();
+    if (options.headless)
+    {
+        glFinish();
+        double elapsed = engine_get_wall_time(&renderer_engine);
+        printf("[INFO] Rendered %d frames in %.2f s (%.2f ms/frame)\n", renderer_engine.frame_index, elapsed,
+               1000.0 * elapsed / renderer_engine.frame_index);
+        if (options.output_path)
+        {
+            engine_write_output_ppm(&renderer_engine, options.output_path);
+        }
+    }
+
+    // frame-time distribution of the run, to compare replays between builds and machines
+    if (options.headless || options.replay_path)
+    {
+        profiler_print_summary();
+    }
+
+    if (options.ray_stats_path)
+    {
+        engine_flush_ray_stats(&renderer_engine);
+        ray_stats_print_summary(&renderer_engine.ray_stats);
+        ray_stats_write_json(&renderer_engine.ray_stats, options.ray_stats_path);
+    }
+
+    if (options.capture_dir)
+    {
+        readback_poll(&capture_ring, renderer_engine.frame_index, true);
+        readback_print_stats(&capture_ring);
+        readback_destroy(&capture_ring);
+    }
+
+    if (stream_server)
+    {
+        readback_poll(&stream_ring, renderer_engine.frame_index, true);
+        readback_print_stats(&stream_ring);
+        readback_destroy(&stream_ring);
+        stream_server_stop(stream_server);
     }
 
-	physics_stop_thread();
-	grid_stop_thread();
+	// finishes the queued physics, grid and capture writer jobs first
+	jobs_shutdown();
+	jobs_print_stats();
 	grid_cleanup_buffers();
+    profiler_shutdown();
     engine_cleanup(&renderer_engine);
     return EXIT_SUCCESS;
 }
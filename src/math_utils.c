@@ -4,6 +4,16 @@ vector and matrix math utilities
 
 #include "math_utils.h"
 #include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MATH_HAVE_X86 1
+#define MATH_TARGET_SSE __attribute__((target("sse2")))
+#define MATH_TARGET_AVX __attribute__((target("avx")))
+#endif
 
 float utility_clamp_float(float value, float min_val, float max_val)
 {
@@ -93,6 +103,19 @@ matrix4_t matrix4_look_at(vector3_t eye, vector3_t center, vector3_t up)
 matrix4_t matrix4_multiply(matrix4_t a, matrix4_t b)
 {
     matrix4_t result = {0};
+#if defined(__SSE__)
+    // column c of the result is a's columns weighted by b's column c, summed in the same
+    // order as the scalar loop so both give identical results
+    for (int c = 0; c < 4; ++c)
+    {
+        __m128 sum = _mm_mul_ps(_mm_loadu_ps(&a.elements[0]), _mm_set1_ps(b.elements[c * 4 + 0]));
+        for (int k = 1; k < 4; ++k)
+        {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&a.elements[k * 4]), _mm_set1_ps(b.elements[c * 4 + k])));
+        }
+        _mm_storeu_ps(&result.elements[c * 4], sum);
+    }
+#else
     for (int c = 0; c < 4; ++c)
     {
         for (int r = 0; r < 4; ++r)
@@ -105,6 +128,414 @@ matrix4_t matrix4_multiply(matrix4_t a, matrix4_t b)
             result.elements[c * 4 + r] = sum;
         }
     }
+#endif
     return result;
 }
 
+// ------------------------------
+// batch math
+// ------------------------------
+
+// cody-waite split of π/4 and the minimax polynomials of cephes' sinf/cosf on [-π/4, π/4]
+#define MATH_FOUR_OVER_PI 1.27323954473516f
+#define MATH_PI4_A 0.78515625f
+#define MATH_PI4_B 2.4187564849853515625e-4f
+#define MATH_PI4_C 3.77489497744594108e-8f
+#define MATH_SIN_P0 -1.6666654611e-1f
+#define MATH_SIN_P1 8.3321608736e-3f
+#define MATH_SIN_P2 -1.9515295891e-4f
+#define MATH_COS_P0 4.166664568298827e-2f
+#define MATH_COS_P1 -1.388731625493765e-3f
+#define MATH_COS_P2 2.443315711809948e-5f
+
+// the batch functions' level, -1 until the first call picks the best supported one; read
+// from every thread that runs the batch math (grid jobs, libblackhole workers)
+static atomic_int math_simd_current = -1;
+
+math_simd_level_t math_simd_supported(void)
+{
+#if MATH_HAVE_X86
+    __builtin_cpu_init();
+    // the avx check includes the os saving the ymm registers (xgetbv)
+    if (__builtin_cpu_supports("avx"))
+        return MATH_SIMD_AVX;
+    if (__builtin_cpu_supports("sse2"))
+        return MATH_SIMD_SSE;
+#endif
+    return MATH_SIMD_SCALAR;
+}
+
+math_simd_level_t math_simd_level(void)
+{
+    int level = atomic_load_explicit(&math_simd_current, memory_order_acquire);
+    if (level >= 0)
+        return (math_simd_level_t)level;
+    // the first call picks the level unless another thread (or math_simd_set_level) got there first
+    int expected = -1;
+    level = math_simd_supported();
+    if (!atomic_compare_exchange_strong_explicit(&math_simd_current, &expected, level, memory_order_acq_rel,
+                                                 memory_order_acquire))
+        level = expected;
+    return (math_simd_level_t)level;
+}
+
+void math_simd_set_level(math_simd_level_t level)
+{
+    math_simd_level_t supported = math_simd_supported();
+    atomic_store_explicit(&math_simd_current, level < supported ? level : supported, memory_order_release);
+}
+
+const char *math_simd_level_name(math_simd_level_t level)
+{
+    switch (level)
+    {
+    case MATH_SIMD_AVX:
+        return "avx";
+    case MATH_SIMD_SSE:
+        return "sse";
+    default:
+        return "scalar";
+    }
+}
+
+void *math_aligned_alloc(size_t size)
+{
+    // aligned_alloc wants a multiple of the alignment
+    size_t rounded = (size + MATH_SIMD_ALIGNMENT - 1) / MATH_SIMD_ALIGNMENT * MATH_SIMD_ALIGNMENT;
+    return aligned_alloc(MATH_SIMD_ALIGNMENT, rounded ? rounded : MATH_SIMD_ALIGNMENT);
+}
+
+void math_aligned_free(void *pointer)
+{
+    free(pointer);
+}
+
+void math_sincos(float angle, float *sine, float *cosine)
+{
+    float x = fabsf(angle);
+    int j = (int)(x * MATH_FOUR_OVER_PI);
+    j = (j + 1) & ~1; // nearest multiple of π/4 with an even index
+    float y = (float)j;
+    float r = ((x - y * MATH_PI4_A) - y * MATH_PI4_B) - y * MATH_PI4_C;
+    float z = r * r;
+    float ps = r + r * z * (MATH_SIN_P0 + z * (MATH_SIN_P1 + z * MATH_SIN_P2));
+    float pc = 1.0f - 0.5f * z + z * z * (MATH_COS_P0 + z * (MATH_COS_P1 + z * MATH_COS_P2));
+
+    // quadrant: swap the polynomials on odd ones, then fix the signs
+    int quadrant = (j >> 1) & 3;
+    float s = quadrant & 1 ? pc : ps;
+    float c = quadrant & 1 ? ps : pc;
+    *sine = ((quadrant & 2) != 0) != (angle < 0.0f) ? -s : s;
+    *cosine = quadrant == 1 || quadrant == 2 ? -c : c;
+}
+
+static void math_scalar_transform_points(const matrix4_t *m, vector3_soa_t in, vector3_soa_t out, int start, int count)
+{
+    const float *e = m->elements;
+    bool projective = e[3] != 0.0f || e[7] != 0.0f || e[11] != 0.0f || e[15] != 1.0f;
+    for (int i = start; i < count; ++i)
+    {
+        float x = in.x[i], y = in.y[i], z = in.z[i];
+        float tx = e[0] * x + e[4] * y + e[8] * z + e[12];
+        float ty = e[1] * x + e[5] * y + e[9] * z + e[13];
+        float tz = e[2] * x + e[6] * y + e[10] * z + e[14];
+        if (projective)
+        {
+            float w = e[3] * x + e[7] * y + e[11] * z + e[15];
+            tx /= w;
+            ty /= w;
+            tz /= w;
+        }
+        out.x[i] = tx;
+        out.y[i] = ty;
+        out.z[i] = tz;
+    }
+}
+
+static void math_scalar_normalize(vector3_soa_t in, vector3_soa_t out, int start, int count)
+{
+    for (int i = start; i < count; ++i)
+    {
+        vector3_t v = vector3_normalize((vector3_t){in.x[i], in.y[i], in.z[i]});
+        out.x[i] = v.x;
+        out.y[i] = v.y;
+        out.z[i] = v.z;
+    }
+}
+
+#if MATH_HAVE_X86
+
+// ---- sse: 4 lanes ----
+
+MATH_TARGET_SSE static __m128 math_sse_select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+MATH_TARGET_SSE static __m128 math_sse_trunc(__m128 v)
+{
+    return _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+}
+
+MATH_TARGET_SSE static int math_sse_transform_points(const matrix4_t *m, vector3_soa_t in, vector3_soa_t out, int count)
+{
+    const float *e = m->elements;
+    if (e[3] != 0.0f || e[7] != 0.0f || e[11] != 0.0f || e[15] != 1.0f)
+        return 0; // projective: left to the scalar loop
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(in.x + i), y = _mm_loadu_ps(in.y + i), z = _mm_loadu_ps(in.z + i);
+        for (int row = 0; row < 3; ++row)
+        {
+            __m128 t = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(e[row]), x),
+                                                        _mm_mul_ps(_mm_set1_ps(e[4 + row]), y)),
+                                             _mm_mul_ps(_mm_set1_ps(e[8 + row]), z)),
+                                  _mm_set1_ps(e[12 + row]));
+            _mm_storeu_ps((row == 0 ? out.x : row == 1 ? out.y : out.z) + i, t);
+        }
+    }
+    return i;
+}
+
+// one newton step on the estimate: r * (1.5 - 0.5 v r²)
+MATH_TARGET_SSE static __m128 math_sse_rsqrt(__m128 v)
+{
+    __m128 r = _mm_rsqrt_ps(v);
+    __m128 half_v_r2 = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), v), _mm_mul_ps(r, r));
+    return _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f), half_v_r2));
+}
+
+MATH_TARGET_SSE static int math_sse_normalize(vector3_soa_t in, vector3_soa_t out, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(in.x + i), y = _mm_loadu_ps(in.y + i), z = _mm_loadu_ps(in.z + i);
+        __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        __m128 scale = _mm_and_ps(_mm_cmpgt_ps(length2, _mm_setzero_ps()), math_sse_rsqrt(length2));
+        _mm_storeu_ps(out.x + i, _mm_mul_ps(x, scale));
+        _mm_storeu_ps(out.y + i, _mm_mul_ps(y, scale));
+        _mm_storeu_ps(out.z + i, _mm_mul_ps(z, scale));
+    }
+    return i;
+}
+
+MATH_TARGET_SSE static int math_sse_sqrt(const float *in, float *out, int count, bool reciprocal)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 v = _mm_loadu_ps(in + i);
+        _mm_storeu_ps(out + i, reciprocal ? math_sse_rsqrt(v) : _mm_sqrt_ps(v));
+    }
+    return i;
+}
+
+MATH_TARGET_SSE static int math_sse_sincos(const float *angles, float *sines, float *cosines, int count)
+{
+    const __m128 sign_bit = _mm_set1_ps(-0.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 angle = _mm_loadu_ps(angles + i);
+        __m128 x = _mm_andnot_ps(sign_bit, angle);
+        __m128 j = math_sse_trunc(_mm_mul_ps(x, _mm_set1_ps(MATH_FOUR_OVER_PI)));
+        __m128 y = _mm_mul_ps(_mm_set1_ps(2.0f), math_sse_trunc(_mm_mul_ps(_mm_add_ps(j, _mm_set1_ps(1.0f)), _mm_set1_ps(0.5f))));
+        __m128 r = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(MATH_PI4_A))),
+                                         _mm_mul_ps(y, _mm_set1_ps(MATH_PI4_B))),
+                              _mm_mul_ps(y, _mm_set1_ps(MATH_PI4_C)));
+        __m128 z = _mm_mul_ps(r, r);
+        __m128 ps = _mm_add_ps(_mm_set1_ps(MATH_SIN_P1), _mm_mul_ps(z, _mm_set1_ps(MATH_SIN_P2)));
+        ps = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z), _mm_add_ps(_mm_set1_ps(MATH_SIN_P0), _mm_mul_ps(z, ps))));
+        __m128 pc = _mm_add_ps(_mm_set1_ps(MATH_COS_P1), _mm_mul_ps(z, _mm_set1_ps(MATH_COS_P2)));
+        pc = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), z)),
+                        _mm_mul_ps(_mm_mul_ps(z, z), _mm_add_ps(_mm_set1_ps(MATH_COS_P0), _mm_mul_ps(z, pc))));
+
+        // quadrant 0..3 of the multiple of π/2
+        __m128 half = _mm_mul_ps(y, _mm_set1_ps(0.5f));
+        __m128 quadrant = _mm_sub_ps(half, _mm_mul_ps(_mm_set1_ps(4.0f), math_sse_trunc(_mm_mul_ps(half, _mm_set1_ps(0.25f)))));
+        __m128 odd = _mm_or_ps(_mm_cmpeq_ps(quadrant, _mm_set1_ps(1.0f)), _mm_cmpeq_ps(quadrant, _mm_set1_ps(3.0f)));
+        __m128 sine_negative = _mm_cmpge_ps(quadrant, _mm_set1_ps(2.0f));
+        __m128 cosine_negative = _mm_or_ps(_mm_cmpeq_ps(quadrant, _mm_set1_ps(1.0f)), _mm_cmpeq_ps(quadrant, _mm_set1_ps(2.0f)));
+        __m128 sine_sign = _mm_xor_ps(_mm_and_ps(sine_negative, sign_bit), _mm_and_ps(angle, sign_bit));
+
+        _mm_storeu_ps(sines + i, _mm_xor_ps(math_sse_select(odd, pc, ps), sine_sign));
+        _mm_storeu_ps(cosines + i, _mm_xor_ps(math_sse_select(odd, ps, pc), _mm_and_ps(cosine_negative, sign_bit)));
+    }
+    return i;
+}
+
+// ---- avx: 8 lanes ----
+
+MATH_TARGET_AVX static __m256 math_avx_select(__m256 mask, __m256 a, __m256 b)
+{
+    return _mm256_or_ps(_mm256_and_ps(mask, a), _mm256_andnot_ps(mask, b));
+}
+
+MATH_TARGET_AVX static __m256 math_avx_trunc(__m256 v)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(v));
+}
+
+MATH_TARGET_AVX static int math_avx_transform_points(const matrix4_t *m, vector3_soa_t in, vector3_soa_t out, int count)
+{
+    const float *e = m->elements;
+    if (e[3] != 0.0f || e[7] != 0.0f || e[11] != 0.0f || e[15] != 1.0f)
+        return 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(in.x + i), y = _mm256_loadu_ps(in.y + i), z = _mm256_loadu_ps(in.z + i);
+        for (int row = 0; row < 3; ++row)
+        {
+            __m256 t = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(e[row]), x),
+                                                                 _mm256_mul_ps(_mm256_set1_ps(e[4 + row]), y)),
+                                                   _mm256_mul_ps(_mm256_set1_ps(e[8 + row]), z)),
+                                     _mm256_set1_ps(e[12 + row]));
+            _mm256_storeu_ps((row == 0 ? out.x : row == 1 ? out.y : out.z) + i, t);
+        }
+    }
+    return i;
+}
+
+MATH_TARGET_AVX static __m256 math_avx_rsqrt(__m256 v)
+{
+    __m256 r = _mm256_rsqrt_ps(v);
+    __m256 half_v_r2 = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), v), _mm256_mul_ps(r, r));
+    return _mm256_mul_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.5f), half_v_r2));
+}
+
+MATH_TARGET_AVX static int math_avx_normalize(vector3_soa_t in, vector3_soa_t out, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(in.x + i), y = _mm256_loadu_ps(in.y + i), z = _mm256_loadu_ps(in.z + i);
+        __m256 length2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+        __m256 scale = _mm256_and_ps(_mm256_cmp_ps(length2, _mm256_setzero_ps(), _CMP_GT_OQ), math_avx_rsqrt(length2));
+        _mm256_storeu_ps(out.x + i, _mm256_mul_ps(x, scale));
+        _mm256_storeu_ps(out.y + i, _mm256_mul_ps(y, scale));
+        _mm256_storeu_ps(out.z + i, _mm256_mul_ps(z, scale));
+    }
+    return i;
+}
+
+MATH_TARGET_AVX static int math_avx_sqrt(const float *in, float *out, int count, bool reciprocal)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(in + i);
+        _mm256_storeu_ps(out + i, reciprocal ? math_avx_rsqrt(v) : _mm256_sqrt_ps(v));
+    }
+    return i;
+}
+
+MATH_TARGET_AVX static int math_avx_sincos(const float *angles, float *sines, float *cosines, int count)
+{
+    const __m256 sign_bit = _mm256_set1_ps(-0.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 angle = _mm256_loadu_ps(angles + i);
+        __m256 x = _mm256_andnot_ps(sign_bit, angle);
+        __m256 j = math_avx_trunc(_mm256_mul_ps(x, _mm256_set1_ps(MATH_FOUR_OVER_PI)));
+        __m256 y = _mm256_mul_ps(_mm256_set1_ps(2.0f),
+                                 math_avx_trunc(_mm256_mul_ps(_mm256_add_ps(j, _mm256_set1_ps(1.0f)), _mm256_set1_ps(0.5f))));
+        __m256 r = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(MATH_PI4_A))),
+                                               _mm256_mul_ps(y, _mm256_set1_ps(MATH_PI4_B))),
+                                 _mm256_mul_ps(y, _mm256_set1_ps(MATH_PI4_C)));
+        __m256 z = _mm256_mul_ps(r, r);
+        __m256 ps = _mm256_add_ps(_mm256_set1_ps(MATH_SIN_P1), _mm256_mul_ps(z, _mm256_set1_ps(MATH_SIN_P2)));
+        ps = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, z), _mm256_add_ps(_mm256_set1_ps(MATH_SIN_P0), _mm256_mul_ps(z, ps))));
+        __m256 pc = _mm256_add_ps(_mm256_set1_ps(MATH_COS_P1), _mm256_mul_ps(z, _mm256_set1_ps(MATH_COS_P2)));
+        pc = _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_set1_ps(0.5f), z)),
+                           _mm256_mul_ps(_mm256_mul_ps(z, z), _mm256_add_ps(_mm256_set1_ps(MATH_COS_P0), _mm256_mul_ps(z, pc))));
+
+        __m256 half = _mm256_mul_ps(y, _mm256_set1_ps(0.5f));
+        __m256 quadrant = _mm256_sub_ps(half, _mm256_mul_ps(_mm256_set1_ps(4.0f), math_avx_trunc(_mm256_mul_ps(half, _mm256_set1_ps(0.25f)))));
+        __m256 odd = _mm256_or_ps(_mm256_cmp_ps(quadrant, _mm256_set1_ps(1.0f), _CMP_EQ_OQ),
+                                  _mm256_cmp_ps(quadrant, _mm256_set1_ps(3.0f), _CMP_EQ_OQ));
+        __m256 sine_negative = _mm256_cmp_ps(quadrant, _mm256_set1_ps(2.0f), _CMP_GE_OQ);
+        __m256 cosine_negative = _mm256_or_ps(_mm256_cmp_ps(quadrant, _mm256_set1_ps(1.0f), _CMP_EQ_OQ),
+                                              _mm256_cmp_ps(quadrant, _mm256_set1_ps(2.0f), _CMP_EQ_OQ));
+        __m256 sine_sign = _mm256_xor_ps(_mm256_and_ps(sine_negative, sign_bit), _mm256_and_ps(angle, sign_bit));
+
+        _mm256_storeu_ps(sines + i, _mm256_xor_ps(math_avx_select(odd, pc, ps), sine_sign));
+        _mm256_storeu_ps(cosines + i, _mm256_xor_ps(math_avx_select(odd, ps, pc), _mm256_and_ps(cosine_negative, sign_bit)));
+    }
+    return i;
+}
+
+#endif // MATH_HAVE_X86
+
+// each batch function runs the widest variant over whole registers and the scalar code on the rest
+
+void vector3_batch_transform_points(const matrix4_t *m, vector3_soa_t in, vector3_soa_t out, int count)
+{
+    int done = 0;
+#if MATH_HAVE_X86
+    math_simd_level_t level = math_simd_level();
+    if (level == MATH_SIMD_AVX)
+        done = math_avx_transform_points(m, in, out, count);
+    else if (level == MATH_SIMD_SSE)
+        done = math_sse_transform_points(m, in, out, count);
+#endif
+    math_scalar_transform_points(m, in, out, done, count);
+}
+
+void vector3_batch_normalize(vector3_soa_t in, vector3_soa_t out, int count)
+{
+    int done = 0;
+#if MATH_HAVE_X86
+    math_simd_level_t level = math_simd_level();
+    if (level == MATH_SIMD_AVX)
+        done = math_avx_normalize(in, out, count);
+    else if (level == MATH_SIMD_SSE)
+        done = math_sse_normalize(in, out, count);
+#endif
+    math_scalar_normalize(in, out, done, count);
+}
+
+void math_batch_sqrt(const float *in, float *out, int count)
+{
+    int done = 0;
+#if MATH_HAVE_X86
+    math_simd_level_t level = math_simd_level();
+    if (level == MATH_SIMD_AVX)
+        done = math_avx_sqrt(in, out, count, false);
+    else if (level == MATH_SIMD_SSE)
+        done = math_sse_sqrt(in, out, count, false);
+#endif
+    for (int i = done; i < count; ++i)
+        out[i] = sqrtf(in[i]);
+}
+
+void math_batch_rsqrt(const float *in, float *out, int count)
+{
+    int done = 0;
+#if MATH_HAVE_X86
+    math_simd_level_t level = math_simd_level();
+    if (level == MATH_SIMD_AVX)
+        done = math_avx_sqrt(in, out, count, true);
+    else if (level == MATH_SIMD_SSE)
+        done = math_sse_sqrt(in, out, count, true);
+#endif
+    for (int i = done; i < count; ++i)
+        out[i] = 1.0f / sqrtf(in[i]);
+}
+
+void math_batch_sincos(const float *angles, float *sines, float *cosines, int count)
+{
+    int done = 0;
+#if MATH_HAVE_X86
+    math_simd_level_t level = math_simd_level();
+    if (level == MATH_SIMD_AVX)
+        done = math_avx_sincos(angles, sines, cosines, count);
+    else if (level == MATH_SIMD_SSE)
+        done = math_sse_sincos(angles, sines, cosines, count);
+#endif
+    for (int i = done; i < count; ++i)
+        math_sincos(angles[i], &sines[i], &cosines[i]);
+}
@@ -0,0 +1,197 @@
+/**
+stream sockets over tcp or unix addresses and length-prefixed messages on top of them
+**/
+
+#define _GNU_SOURCE
+
+#include "net.h"
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// pending connections a listener queues
+#define NET_BACKLOG 64
+
+// splits "unix:PATH" or "HOST:PORT"
+static bool net_parse_address(const char *address, bool *is_unix, char *host, size_t host_size, const char **rest)
+{
+    *is_unix = strncmp(address, "unix:", 5) == 0;
+    if (*is_unix)
+    {
+        *rest = address + 5;
+        return strlen(*rest) > 0 && strlen(*rest) < sizeof(((struct sockaddr_un *)0)->sun_path);
+    }
+    const char *colon = strrchr(address, ':');
+    if (!colon || colon[1] == '\0' || (size_t)(colon - address) >= host_size)
+        return false;
+    memcpy(host, address, (size_t)(colon - address));
+    host[colon - address] = '\0';
+    *rest = colon + 1;
+    return true;
+}
+
+int net_open(const char *address, bool listening)
+{
+    bool is_unix;
+    char host[256];
+    const char *rest;
+    if (!net_parse_address(address, &is_unix, host, sizeof(host), &rest))
+    {
+        printf("Failed to parse address %s (unix:PATH or HOST:PORT)\n", address);
+        return -1;
+    }
+
+    if (is_unix)
+    {
+        struct sockaddr_un addr = {.sun_family = AF_UNIX};
+        strcpy(addr.sun_path, rest);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        if (listening)
+        {
+            unlink(rest); // a stale socket of an earlier run
+            if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 && listen(fd, NET_BACKLOG) == 0)
+                return fd;
+        }
+        else if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+        {
+            return fd;
+        }
+        close(fd);
+        return -1;
+    }
+
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = listening ? AI_PASSIVE : 0};
+    struct addrinfo *list;
+    bool any_host = host[0] == '\0' || strcmp(host, "*") == 0;
+    if (getaddrinfo(any_host ? NULL : host, rest, &hints, &list) != 0)
+    {
+        printf("Failed to resolve %s\n", address);
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo *info = list; info && fd < 0; info = info->ai_next)
+    {
+        fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (fd < 0)
+            continue;
+        int one = 1;
+        bool ok;
+        if (listening)
+        {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            ok = bind(fd, info->ai_addr, info->ai_addrlen) == 0 && listen(fd, NET_BACKLOG) == 0;
+        }
+        else
+        {
+            ok = connect(fd, info->ai_addr, info->ai_addrlen) == 0;
+            // messages are small and latency bound
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        if (!ok)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(list);
+    return fd;
+}
+
+void net_release(const char *address)
+{
+    if (strncmp(address, "unix:", 5) == 0)
+        unlink(address + 5);
+}
+
+bool net_send_all(int fd, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    while (size > 0)
+    {
+        ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        bytes += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+bool net_send_message(int fd, uint32_t type, const void *payload, uint32_t length)
+{
+    net_header_t header = {type, length};
+    return net_send_all(fd, &header, sizeof(header)) && (length == 0 || net_send_all(fd, payload, length));
+}
+
+bool net_receive(net_buffer_t *buffer, int fd, bool wait, size_t *received)
+{
+    if (received)
+        *received = 0;
+    if (buffer->start > 0)
+    {
+        memmove(buffer->data, buffer->data + buffer->start, buffer->size - buffer->start);
+        buffer->size -= buffer->start;
+        buffer->start = 0;
+    }
+    if (buffer->capacity - buffer->size < 65536)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 262144;
+        unsigned char *data = realloc(buffer->data, capacity);
+        if (!data)
+            return false;
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+    ssize_t count = recv(fd, buffer->data + buffer->size, buffer->capacity - buffer->size, wait ? 0 : MSG_DONTWAIT);
+    if (count > 0)
+    {
+        buffer->size += (size_t)count;
+        if (received)
+            *received = (size_t)count;
+        return true;
+    }
+    return count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+}
+
+bool net_next_message(net_buffer_t *buffer, net_header_t *header, const unsigned char **payload, bool *corrupt)
+{
+    *corrupt = false;
+    if (buffer->size - buffer->start < sizeof(net_header_t))
+        return false;
+    memcpy(header, buffer->data + buffer->start, sizeof(net_header_t));
+    if (header->length > NET_MAX_MESSAGE)
+    {
+        *corrupt = true;
+        return false;
+    }
+    if (buffer->size - buffer->start < sizeof(net_header_t) + header->length)
+        return false;
+    *payload = buffer->data + buffer->start + sizeof(net_header_t);
+    buffer->start += sizeof(net_header_t) + header->length;
+    return true;
+}
+
+void net_buffer_free(net_buffer_t *buffer)
+{
+    free(buffer->data);
+    *buffer = (net_buffer_t){0};
+}
+
+double net_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
@@ -4,93 +4,51 @@
  */
 
 #include "physics.h"
+#include "simulation.h"
+#include "profiler.h"
 #include <math.h>
 #include <pthread.h>
-#include <time.h>
 #include <stdatomic.h>
+#include <string.h>
 
 // simulation and physical constants
-const double SPEED_OF_LIGHT = 299792458.0;
-const double GRAVITATIONAL_CONSTANT = 6.67430e-11;
-const float BLACK_HOLE_SCHWARZSCHILD_RADIUS = 1.269e10f;
+const float BLACK_HOLE_SCHWARZSCHILD_RADIUS = SIMULATION_SCHWARZSCHILD_RADIUS;
 float RAY_INTEGRATION_STEP = 5e7f; // initial step size for ray integration
 const double RAY_ESCAPE_RADIUS = 1e30;    // radius at which rays are considered to have escaped
-const int NUM_CELESTIAL_BODIES = 3;
+const int NUM_CELESTIAL_BODIES = SIMULATION_INITIAL_BODY_COUNT;
 bool is_physics_paused = false;
 
-celestial_body_t celestial_bodies[] = {
-    {{2.3e11f, 0.0f, 0.0f, 4e10f},   // position and radius
-     {0.4, 0.7, 1.0, 1.0},           // color (blue star)
-     1.98892e30f,                    // mass (solar mass)
-     {0.0f, 0.0f, 5.34e7}},          // initial velocity
-    {{-1.6e11f, 0.0f, 0.0f, 4e10f},  // position and radius
-     {0.8, 0.3, 0.2, 1.0},           // color (red star)
-     1.98892e30f,                    // mass (solar mass)
-     {0.0f, 0.0f, -5.34e7}},         // initial velocity
-    {{0.0f, 0.0f, 0.0f, BLACK_HOLE_SCHWARZSCHILD_RADIUS}, // position and radius
-     {0, 0, 0, 1},                   // color (black hole)
-     8.54e36f,                       // mass (supermassive)
-     {0, 0, 0}}                      // initial velocity
-};
+// the scene itself is simulation_initial_bodies, copied in by physics_reset
+celestial_body_t celestial_bodies[MAX_CELESTIAL_BODIES];
 
 // ------------------------------
 // Internal threading primitives
 // ------------------------------
 
 static pthread_mutex_t physics_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_t physics_thread_handle = 0;
-static atomic_bool physics_thread_should_run = false;
+static double physics_lock_acquired_at = 0.0; // only touched while holding physics_mutex
 
-// Next-state buffer for threaded stepping (not exposed)
-static celestial_body_t celestial_bodies_next[NUM_CELESTIAL_BODIES];
+// fixed-step simulation run as jobs; only the step job writes celestial_bodies
+#define PHYSICS_STEP_HZ 60.0
+#define PHYSICS_SIM_SPEED 500.0
+#define PHYSICS_MAX_STEPS_PER_JOB 8
 
-static void simulation_step_buffered(const celestial_body_t *in_bodies, celestial_body_t *out_bodies, double delta_time)
-{
-    // copy input to output to ensure we keep unmodified fields if needed
-    for (int k = 0; k < NUM_CELESTIAL_BODIES; ++k)
-    {
-        out_bodies[k] = in_bodies[k];
-    }
+static job_handle_t physics_job;
+static double physics_accumulator = 0.0; // real seconds not simulated yet
+static int physics_job_steps = 0;        // steps of the job in flight
+static atomic_uint physics_generation;   // steps applied to celestial_bodies
 
-    // n-body simulation using newton's law of universal gravitation.
-    for (int i = 0; i < NUM_CELESTIAL_BODIES; ++i)
-    {
-        double vx = in_bodies[i].velocity.x;
-        double vy = in_bodies[i].velocity.y;
-        double vz = in_bodies[i].velocity.z;
+// Next-state buffer for threaded stepping (not exposed)
+static celestial_body_t celestial_bodies_next[MAX_CELESTIAL_BODIES];
 
-        for (int j = 0; j < NUM_CELESTIAL_BODIES; ++j)
-        {
-            if (i == j)
-                continue;
-
-            float dx = in_bodies[j].position_and_radius.x - in_bodies[i].position_and_radius.x;
-            float dy = in_bodies[j].position_and_radius.y - in_bodies[i].position_and_radius.y;
-            float dz = in_bodies[j].position_and_radius.z - in_bodies[i].position_and_radius.z;
-            float distance = sqrtf(dx * dx + dy * dy + dz * dz);
-
-            if (distance > (in_bodies[i].position_and_radius.w + in_bodies[j].position_and_radius.w))
-            {
-                vector3_t direction = {dx / distance, dy / distance, dz / distance};
-                double gravitational_force = (GRAVITATIONAL_CONSTANT * in_bodies[i].mass * in_bodies[j].mass) / (distance * distance);
-                double acceleration = gravitational_force / in_bodies[i].mass;
-                vx += direction.x * acceleration * delta_time;
-                vy += direction.y * acceleration * delta_time;
-                vz += direction.z * acceleration * delta_time;
-            }
-        }
+// contact search buffers of the step, reused between steps
+static collision_broadphase_t physics_broadphase;
 
-        out_bodies[i].velocity.x = (float)vx;
-        out_bodies[i].velocity.y = (float)vy;
-        out_bodies[i].velocity.z = (float)vz;
-    }
+collision_mode_t collision_mode = COLLISION_OFF;
 
-    for (int i = 0; i < NUM_CELESTIAL_BODIES; i++)
-    {
-        out_bodies[i].position_and_radius.x += out_bodies[i].velocity.x * (float)delta_time;
-        out_bodies[i].position_and_radius.y += out_bodies[i].velocity.y * (float)delta_time;
-        out_bodies[i].position_and_radius.z += out_bodies[i].velocity.z * (float)delta_time;
-    }
+void physics_reset(void)
+{
+    memcpy(celestial_bodies, simulation_initial_bodies, sizeof(simulation_initial_bodies));
 }
 
 void simulation_update_physics(double delta_time)
@@ -99,7 +57,8 @@ void simulation_update_physics(double delta_time)
         return;
 
     // In-place update for single-threaded mode
-    simulation_step_buffered(celestial_bodies, celestial_bodies, delta_time);
+    simulation_step_buffered(celestial_bodies, celestial_bodies, NUM_CELESTIAL_BODIES, delta_time, collision_mode,
+                             &physics_broadphase);
 }
 
 // ---------------
@@ -108,66 +67,75 @@ void simulation_update_physics(double delta_time)
 
 void physics_lock(void)
 {
+    double wait_start = profiler_now();
     pthread_mutex_lock(&physics_mutex);
+    physics_lock_acquired_at = profiler_now();
+    profiler_record(PROFILER_STAGE_PHYSICS_LOCK_WAIT, wait_start, physics_lock_acquired_at - wait_start);
 }
 
 void physics_unlock(void)
 {
+    double hold_start = physics_lock_acquired_at;
+    profiler_record(PROFILER_STAGE_PHYSICS_LOCK_HOLD, hold_start, profiler_now() - hold_start);
     pthread_mutex_unlock(&physics_mutex);
 }
 
-bool physics_is_threaded(void)
+void physics_snapshot_bodies(celestial_body_t *out_bodies)
 {
-    return physics_thread_handle != 0;
+    physics_lock();
+    memcpy(out_bodies, celestial_bodies, NUM_CELESTIAL_BODIES * sizeof(celestial_body_t));
+    physics_unlock();
 }
 
-static void* physics_thread_proc(void* arg)
+static void physics_step_job(void *data)
 {
-    (void)arg;
-    const double target_hz = 60.0;
-    const double sim_speed = 500.0;
-    const long sleep_ns = (long)((1.0 / target_hz) * 1e9);
-
-    while (atomic_load(&physics_thread_should_run))
+    (void)data;
+    const double dt = PHYSICS_SIM_SPEED / PHYSICS_STEP_HZ;
+    for (int step = 0; step < physics_job_steps; ++step)
     {
-        if (!is_physics_paused)
+        double step_start = profiler_now();
+        simulation_step_buffered(celestial_bodies, celestial_bodies_next, NUM_CELESTIAL_BODIES, dt, collision_mode,
+                                 &physics_broadphase);
+        profiler_record(PROFILER_STAGE_PHYSICS_STEP, step_start, profiler_now() - step_start);
+        physics_lock();
+        for (int i = 0; i < NUM_CELESTIAL_BODIES; ++i)
         {
-            simulation_step_buffered(celestial_bodies, celestial_bodies_next, (1.0 / target_hz) * sim_speed);
-            physics_lock();
-            for (int i = 0; i < NUM_CELESTIAL_BODIES; ++i)
-            {
-                celestial_bodies[i] = celestial_bodies_next[i];
-            }
-            physics_unlock();
+            celestial_bodies[i] = celestial_bodies_next[i];
         }
-        
-        // cross-platform sleep using nanosleep
-        struct timespec req = {0, sleep_ns};
-        nanosleep(&req, NULL);
+        atomic_fetch_add(&physics_generation, 1u);
+        physics_unlock();
     }
-    return NULL;
 }
 
-void physics_start_thread(void)
+job_handle_t physics_schedule(double delta_time)
 {
-    if (physics_thread_handle != 0)
-        return;
-    
-    atomic_store(&physics_thread_should_run, true);
-    if (pthread_create(&physics_thread_handle, NULL, physics_thread_proc, NULL) != 0)
+    if (is_physics_paused)
+    {
+        physics_accumulator = 0.0;
+        return physics_job;
+    }
+
+    // the previous steps are still running: their time carries over to the next frame
+    physics_accumulator += delta_time;
+    if (!jobs_is_done(physics_job))
+        return physics_job;
+
+    int steps = (int)(physics_accumulator * PHYSICS_STEP_HZ);
+    if (steps == 0)
+        return physics_job;
+    if (steps > PHYSICS_MAX_STEPS_PER_JOB)
     {
-        atomic_store(&physics_thread_should_run, false);
-        physics_thread_handle = 0;
+        // too far behind (a stall or a breakpoint): drop the backlog instead of catching up
+        steps = PHYSICS_MAX_STEPS_PER_JOB;
+        physics_accumulator = steps / PHYSICS_STEP_HZ;
     }
+    physics_accumulator -= steps / PHYSICS_STEP_HZ;
+    physics_job_steps = steps;
+    physics_job = jobs_submit(physics_step_job, NULL, NULL, 0);
+    return physics_job;
 }
 
-void physics_stop_thread(void)
+unsigned physics_get_generation(void)
 {
-    if (physics_thread_handle == 0)
-        return;
-    
-    atomic_store(&physics_thread_should_run, false);
-    pthread_join(physics_thread_handle, NULL);
-    physics_thread_handle = 0;
+    return atomic_load(&physics_generation);
 }
-
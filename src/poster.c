@@ -0,0 +1,286 @@
+/**
+out-of-core poster rendering: the image is traced one tile at a time through the normal
+frame pipeline and streamed into a pre-sized ppm, so memory does not grow with the poster
+**/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "poster.h"
+#include "grid.h"
+#include "readback.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// header of the output; its length is fixed by the size, so pixel offsets follow from it
+static int poster_header(char *buffer, size_t size, int width, int height)
+{
+    return snprintf(buffer, size, "P6\n%d %d\n255\n", width, height);
+}
+
+// marks the tiles listed in the sidecar; false when there is nothing to resume or the
+// sidecar was written for another tile grid
+static bool poster_load_progress(poster_file_t *file)
+{
+    FILE *progress = fopen(file->progress_path, "r");
+    if (!progress)
+        return false;
+    int width, height, tile_size;
+    if (fscanf(progress, "poster %d %d %d", &width, &height, &tile_size) != 3 || width != file->width ||
+        height != file->height || tile_size != file->tile_size)
+    {
+        fclose(progress);
+        return false;
+    }
+    int tile;
+    while (fscanf(progress, "%d", &tile) == 1)
+    {
+        if (tile >= 0 && tile < file->tiles_x * file->tiles_y && !file->done[tile])
+        {
+            file->done[tile] = 1;
+            file->done_count++;
+        }
+    }
+    fclose(progress);
+    return true;
+}
+
+// an existing output can be resumed when its header and size match the request
+static bool poster_matches(int fd, const char *header, long header_length, off_t expected_size)
+{
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size != expected_size)
+        return false;
+    char existing[64];
+    return pread(fd, existing, (size_t)header_length, 0) == header_length && memcmp(existing, header, (size_t)header_length) == 0;
+}
+
+bool poster_file_open(poster_file_t *file, const char *path, int width, int height, int tile_size)
+{
+    *file = (poster_file_t){.fd = -1, .width = width, .height = height, .tile_size = tile_size};
+    file->tiles_x = (width + tile_size - 1) / tile_size;
+    file->tiles_y = (height + tile_size - 1) / tile_size;
+    snprintf(file->progress_path, sizeof(file->progress_path), "%s.progress", path);
+
+    char header[64];
+    file->header_length = poster_header(header, sizeof(header), width, height);
+    off_t size = (off_t)file->header_length + (off_t)width * height * 3;
+
+    file->done = calloc((size_t)file->tiles_x * file->tiles_y, 1);
+    file->row = malloc((size_t)tile_size * 3);
+    if (!file->done || !file->row)
+    {
+        printf("Failed to allocate the poster tile table\n");
+        poster_file_close(file);
+        return false;
+    }
+
+    file->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (file->fd < 0)
+    {
+        printf("Failed to open %s for writing\n", path);
+        poster_file_close(file);
+        return false;
+    }
+
+    bool resume = poster_matches(file->fd, header, file->header_length, size) && poster_load_progress(file);
+    if (!resume)
+    {
+        // start over: the sidecar of another size or tile size, or of a finished image, is stale
+        memset(file->done, 0, (size_t)file->tiles_x * file->tiles_y);
+        file->done_count = 0;
+        if (ftruncate(file->fd, 0) != 0 || ftruncate(file->fd, size) != 0 ||
+            pwrite(file->fd, header, (size_t)file->header_length, 0) != file->header_length)
+        {
+            printf("Failed to allocate %lld bytes for %s\n", (long long)size, path);
+            poster_file_close(file);
+            return false;
+        }
+    }
+
+    file->progress = fopen(file->progress_path, resume ? "a" : "w");
+    if (!file->progress)
+    {
+        printf("Failed to open %s for writing\n", file->progress_path);
+        poster_file_close(file);
+        return false;
+    }
+    if (!resume)
+    {
+        // the tile indices that follow only mean something for this size and tile grid
+        fprintf(file->progress, "poster %d %d %d\n", width, height, tile_size);
+        fflush(file->progress);
+    }
+    else
+    {
+        printf("[INFO] Resuming %s: %d of %d tiles already done\n", path, file->done_count,
+               file->tiles_x * file->tiles_y);
+    }
+    return true;
+}
+
+void poster_file_tile_rect(const poster_file_t *file, int tile, int *x, int *y, int *width, int *height)
+{
+    // tile rows count from the top of the image, gl rows from the bottom
+    int column = tile % file->tiles_x, row = tile / file->tiles_x;
+    int top = row * file->tile_size;
+    int bottom = top + file->tile_size < file->height ? top + file->tile_size : file->height;
+    *x = column * file->tile_size;
+    *width = *x + file->tile_size < file->width ? file->tile_size : file->width - *x;
+    *y = file->height - bottom;
+    *height = bottom - top;
+}
+
+bool poster_file_write_tile(poster_file_t *file, int tile, const unsigned char *pixels, int pixels_width)
+{
+    int x, y, width, height;
+    poster_file_tile_rect(file, tile, &x, &y, &width, &height);
+
+    for (int j = 0; j < height; ++j)
+    {
+        const unsigned char *src = pixels + (size_t)j * pixels_width * 4;
+        for (int i = 0; i < width; ++i)
+        {
+            file->row[i * 3 + 0] = src[i * 4 + 0];
+            file->row[i * 3 + 1] = src[i * 4 + 1];
+            file->row[i * 3 + 2] = src[i * 4 + 2];
+        }
+        off_t file_row = file->height - 1 - (y + j);
+        off_t offset = file->header_length + (file_row * file->width + x) * 3;
+        if (pwrite(file->fd, file->row, (size_t)width * 3, offset) != (ssize_t)width * 3)
+        {
+            printf("Failed to write poster tile %d\n", tile);
+            return false;
+        }
+    }
+
+    // the tile only counts as done once its pixels are on disk
+    if (fsync(file->fd) != 0)
+    {
+        printf("Failed to flush poster tile %d\n", tile);
+        return false;
+    }
+    fprintf(file->progress, "%d\n", tile);
+    fflush(file->progress);
+    if (!file->done[tile])
+    {
+        file->done[tile] = 1;
+        file->done_count++;
+    }
+    return true;
+}
+
+bool poster_file_close(poster_file_t *file)
+{
+    bool complete = file->done && file->done_count == file->tiles_x * file->tiles_y;
+    if (file->progress)
+        fclose(file->progress);
+    if (file->fd >= 0)
+        close(file->fd);
+    if (complete)
+        remove(file->progress_path);
+    free(file->done);
+    free(file->row);
+    *file = (poster_file_t){.fd = -1};
+    return complete;
+}
+
+typedef struct
+{
+    poster_file_t *file;
+    bool failed;
+} poster_job_t;
+
+// readback consumer: frame_index is the tile index
+static void poster_write_tile(const unsigned char *pixels, int width, int height, int frame_index, double capture_time,
+                              void *user_data)
+{
+    (void)height;
+    (void)capture_time;
+    poster_job_t *job = user_data;
+    if (!poster_file_write_tile(job->file, frame_index, pixels, width))
+        job->failed = true;
+}
+
+// projection of the tile's window of the full view: scales the window to clip space
+static matrix4_t poster_crop_matrix(int width, int height, int x, int y, int tile_size)
+{
+    float scale_x = (float)width / (float)tile_size, scale_y = (float)height / (float)tile_size;
+    float centre_x = (2.0f * x + tile_size) / (float)width - 1.0f;
+    float centre_y = (2.0f * y + tile_size) / (float)height - 1.0f;
+    matrix4_t crop = {0};
+    crop.elements[0] = scale_x;
+    crop.elements[5] = scale_y;
+    crop.elements[10] = 1.0f;
+    crop.elements[15] = 1.0f;
+    crop.elements[12] = -centre_x * scale_x;
+    crop.elements[13] = -centre_y * scale_y;
+    return crop;
+}
+
+bool poster_render(renderer_engine_t *engine, camera_t *cam, const char *path, int width, int height, int tile_size)
+{
+    poster_file_t file;
+    if (!poster_file_open(&file, path, width, height, tile_size))
+        return false;
+
+    int tile_count = file.tiles_x * file.tiles_y;
+    printf("[INFO] Poster %d x %d in %d tiles of %d px (%.1f MB of tile buffers, %.1f MB on disk)\n", width, height,
+           tile_count, tile_size, (double)tile_size * tile_size * 4 * READBACK_RING_SIZE / (1024.0 * 1024.0),
+           (double)width * height * 3 / (1024.0 * 1024.0));
+
+    // every tile at full quality, tracing each pixel: nothing may depend on earlier frames
+    engine_set_interleave_mode(engine, INTERLEAVE_OFF);
+    engine_set_upscale(engine, false);
+    engine->quality.current = engine->quality.preset_count - 1;
+    engine_update_quality(engine);
+    grid_generate_mesh(engine);
+
+    vector3_t cam_pos = camera_get_position(cam);
+    matrix4_t view_matrix = matrix4_look_at(cam_pos, cam->target, (vector3_t){0, 1, 0});
+    matrix4_t projection_matrix = matrix4_perspective(M_PI / 3.0f, (float)width / (float)height, 1e9f, 1e14f);
+    matrix4_t view_projection_matrix = matrix4_multiply(projection_matrix, view_matrix);
+
+    poster_job_t job = {.file = &file};
+    readback_ring_t ring;
+    readback_init(&ring, poster_write_tile, &job);
+
+    double start = engine_get_time(engine);
+    int rendered = 0, remaining = tile_count - file.done_count;
+    for (int tile = 0; tile < tile_count && !job.failed; ++tile)
+    {
+        if (file.done[tile])
+            continue;
+
+        int x, y, tile_width, tile_height;
+        poster_file_tile_rect(&file, tile, &x, &y, &tile_width, &tile_height);
+        // edge tiles still render tile_size pixels; the part outside the image is not written
+        engine_set_view_region(engine, width, height, x, y);
+        engine_begin_frame(engine);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        grid_render(engine, matrix4_multiply(poster_crop_matrix(width, height, x, y, tile_size), view_projection_matrix));
+        engine_render_raytraced_scene_to_texture(engine, cam);
+        engine_render_texture_to_screen(engine);
+
+        // keep up to READBACK_RING_SIZE tiles in flight while the next ones render
+        while (ring.in_flight == READBACK_RING_SIZE)
+            readback_poll(&ring, tile, true);
+        readback_capture(&ring, engine_output_framebuffer(engine), tile_size, tile_size, tile);
+        readback_poll(&ring, tile, false);
+
+        ++rendered;
+        printf("[INFO] Poster tile %d/%d (%dx%d at %d, %d) %.1f s\n", rendered, remaining, tile_width, tile_height, x,
+               file.height - y - tile_height, engine_get_time(engine) - start);
+    }
+    while (ring.in_flight > 0)
+        readback_poll(&ring, tile_count, true);
+    readback_destroy(&ring);
+    engine_set_view_region(engine, 0, 0, 0, 0);
+
+    bool complete = poster_file_close(&file) && !job.failed;
+    if (complete)
+        printf("[INFO] Wrote %d x %d poster to %s\n", width, height, path);
+    return complete;
+}
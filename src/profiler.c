@@ -0,0 +1,394 @@
+/**
+frame-stage profiler: cpu scopes, double-buffered gpu timer queries, percentile
+histograms, an on-screen bar overlay and chrome trace_event export
+**/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "profiler.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#define PROFILER_HISTORY 1024     // samples per stage used for percentiles
+#define PROFILER_MAX_EVENTS 65536 // trace events kept for export (oldest are overwritten)
+#define PROFILER_MAX_THREADS 16
+#define PROFILER_GPU_STAGES (PROFILER_STAGE_BLIT + 1)
+#define PROFILER_QUERY_SETS 2     // results are read one frame after they were issued
+#define PROFILER_GPU_THREAD_ID 1000
+
+bool is_profiler_overlay_visible = false;
+
+static const char *profiler_stage_names[PROFILER_STAGE_COUNT] = {
+    "grid_upload",
+    "grid_render",
+    "ray_trace",
+    "blit",
+    "swap",
+    "frame",
+    "physics_step",
+    "grid_step",
+    "physics_lock_wait",
+    "physics_lock_hold",
+};
+
+// ring of recent samples in milliseconds
+typedef struct
+{
+    float samples[PROFILER_HISTORY];
+    int count;
+    int next;
+} profiler_history_t;
+
+typedef struct
+{
+    short stage;
+    short thread;
+    short variant;
+    double start;
+    double duration;
+} profiler_event_t;
+
+static pthread_mutex_t profiler_mutex = PTHREAD_MUTEX_INITIALIZER;
+static profiler_history_t cpu_history[PROFILER_STAGE_COUNT];
+static profiler_history_t gpu_history[PROFILER_STAGE_COUNT];
+static profiler_history_t cpu_variant_history[PROFILER_STAGE_COUNT][PROFILER_MAX_VARIANTS];
+static profiler_history_t gpu_variant_history[PROFILER_STAGE_COUNT][PROFILER_MAX_VARIANTS];
+static const char *variant_names[PROFILER_STAGE_COUNT][PROFILER_MAX_VARIANTS];
+static int active_variant[PROFILER_STAGE_COUNT]; // set by profiler_begin_variant
+static profiler_event_t events[PROFILER_MAX_EVENTS];
+static int event_next = 0;
+static int event_count = 0;
+
+static atomic_int profiler_thread_count = 0;
+static _Thread_local int profiler_thread_id = -1;
+
+static GLuint gpu_queries[PROFILER_QUERY_SETS][PROFILER_GPU_STAGES];
+static bool gpu_query_pending[PROFILER_QUERY_SETS][PROFILER_GPU_STAGES];
+static double gpu_query_start[PROFILER_QUERY_SETS][PROFILER_GPU_STAGES];
+static int gpu_query_variant[PROFILER_QUERY_SETS][PROFILER_GPU_STAGES];
+static int gpu_query_set = 0;
+static bool gpu_queries_created = false;
+
+// ------------------------------
+// sample storage
+// ------------------------------
+
+static int profiler_current_thread(void)
+{
+    if (profiler_thread_id < 0)
+    {
+        profiler_thread_id = atomic_fetch_add(&profiler_thread_count, 1);
+    }
+    return profiler_thread_id;
+}
+
+static int profiler_compare_float(const void *a, const void *b)
+{
+    float fa = *(const float *)a, fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+static void profiler_push_history(profiler_history_t *history, double duration)
+{
+    history->samples[history->next] = (float)(duration * 1000.0);
+    history->next = (history->next + 1) % PROFILER_HISTORY;
+    if (history->count < PROFILER_HISTORY) history->count++;
+}
+
+static void profiler_push(int stage, int variant, bool gpu, int thread, double start, double duration)
+{
+    pthread_mutex_lock(&profiler_mutex);
+    profiler_push_history(gpu ? &gpu_history[stage] : &cpu_history[stage], duration);
+    if (variant >= 0)
+    {
+        profiler_push_history(gpu ? &gpu_variant_history[stage][variant] : &cpu_variant_history[stage][variant], duration);
+    }
+
+    events[event_next] = (profiler_event_t){(short)stage, (short)thread, (short)variant, start, duration};
+    event_next = (event_next + 1) % PROFILER_MAX_EVENTS;
+    if (event_count < PROFILER_MAX_EVENTS) event_count++;
+    pthread_mutex_unlock(&profiler_mutex);
+}
+
+static profiler_stats_t profiler_history_stats(profiler_history_t *history)
+{
+    float sorted[PROFILER_HISTORY];
+
+    pthread_mutex_lock(&profiler_mutex);
+    int count = history->count;
+    memcpy(sorted, history->samples, count * sizeof(float));
+    pthread_mutex_unlock(&profiler_mutex);
+
+    profiler_stats_t stats = {count, 0.0, 0.0, 0.0};
+    if (count == 0)
+        return stats;
+
+    qsort(sorted, count, sizeof(float), profiler_compare_float);
+    stats.p50 = sorted[(int)(0.50 * (count - 1) + 0.5)];
+    stats.p95 = sorted[(int)(0.95 * (count - 1) + 0.5)];
+    stats.p99 = sorted[(int)(0.99 * (count - 1) + 0.5)];
+    return stats;
+}
+
+// "stage" or "stage[variant]"
+static void profiler_event_name(int stage, int variant, char *name, size_t size)
+{
+    if (variant >= 0 && variant_names[stage][variant])
+        snprintf(name, size, "%s[%s]", profiler_stage_names[stage], variant_names[stage][variant]);
+    else if (variant >= 0)
+        snprintf(name, size, "%s[%d]", profiler_stage_names[stage], variant);
+    else
+        snprintf(name, size, "%s", profiler_stage_names[stage]);
+}
+
+// ------------------------------
+// public api
+// ------------------------------
+
+void profiler_init(void)
+{
+    glGenQueries(PROFILER_QUERY_SETS * PROFILER_GPU_STAGES, &gpu_queries[0][0]);
+    memset(gpu_query_pending, 0, sizeof(gpu_query_pending));
+    gpu_queries_created = true;
+}
+
+void profiler_shutdown(void)
+{
+    if (!gpu_queries_created)
+        return;
+
+    glDeleteQueries(PROFILER_QUERY_SETS * PROFILER_GPU_STAGES, &gpu_queries[0][0]);
+    gpu_queries_created = false;
+}
+
+double profiler_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+void profiler_begin_frame(void)
+{
+    if (!gpu_queries_created)
+        return;
+
+    // the set issued two frames ago is reused now, so collect whatever finished
+    gpu_query_set = (gpu_query_set + 1) % PROFILER_QUERY_SETS;
+    for (int stage = 0; stage < PROFILER_GPU_STAGES; ++stage)
+    {
+        if (!gpu_query_pending[gpu_query_set][stage])
+            continue;
+
+        GLuint query = gpu_queries[gpu_query_set][stage];
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 elapsed_ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_ns);
+            profiler_push(stage, gpu_query_variant[gpu_query_set][stage], true, PROFILER_GPU_THREAD_ID,
+                          gpu_query_start[gpu_query_set][stage], (double)elapsed_ns * 1e-9);
+        }
+        // results that are still in flight are dropped instead of stalling the frame
+        gpu_query_pending[gpu_query_set][stage] = false;
+    }
+}
+
+double profiler_begin(profiler_stage_t stage)
+{
+    return profiler_begin_variant(stage, -1);
+}
+
+double profiler_begin_variant(profiler_stage_t stage, int variant)
+{
+    double start = profiler_now();
+    active_variant[stage] = variant < PROFILER_MAX_VARIANTS ? variant : -1;
+    if (gpu_queries_created && stage < PROFILER_GPU_STAGES)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, gpu_queries[gpu_query_set][stage]);
+        gpu_query_start[gpu_query_set][stage] = start;
+        gpu_query_variant[gpu_query_set][stage] = active_variant[stage];
+    }
+    return start;
+}
+
+void profiler_set_variant_name(profiler_stage_t stage, int variant, const char *name)
+{
+    if (variant >= 0 && variant < PROFILER_MAX_VARIANTS)
+        variant_names[stage][variant] = name;
+}
+
+void profiler_end(profiler_stage_t stage, double start_time)
+{
+    if (gpu_queries_created && stage < PROFILER_GPU_STAGES)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        gpu_query_pending[gpu_query_set][stage] = true;
+    }
+    profiler_push(stage, active_variant[stage], false, profiler_current_thread(), start_time, profiler_now() - start_time);
+    active_variant[stage] = -1;
+}
+
+void profiler_record(profiler_stage_t stage, double start_time, double duration)
+{
+    profiler_push(stage, -1, false, profiler_current_thread(), start_time, duration);
+}
+
+profiler_stats_t profiler_get_stats(profiler_stage_t stage, bool gpu)
+{
+    return profiler_history_stats(gpu ? &gpu_history[stage] : &cpu_history[stage]);
+}
+
+profiler_stats_t profiler_get_variant_stats(profiler_stage_t stage, int variant, bool gpu)
+{
+    return profiler_history_stats(gpu ? &gpu_variant_history[stage][variant] : &cpu_variant_history[stage][variant]);
+}
+
+static void profiler_draw_bar(int x, int y, int width, int height, float r, float g, float b)
+{
+    if (width <= 0)
+        return;
+    glScissor(x, y, width, height);
+    glClearColor(r, g, b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void profiler_render_overlay(int window_width, int window_height)
+{
+    if (!is_profiler_overlay_visible)
+        return;
+
+    // bars are drawn with scissored clears, so no shader or vertex data is needed.
+    // full scale is 33.3 ms over half the window; the white tick marks 16.7 ms.
+    static const float stage_colors[PROFILER_STAGE_COUNT][3] = {
+        {0.3f, 0.8f, 0.3f}, {0.2f, 0.6f, 1.0f}, {1.0f, 0.5f, 0.1f}, {0.8f, 0.3f, 0.9f}, {0.9f, 0.9f, 0.2f},
+        {0.9f, 0.9f, 0.9f}, {0.4f, 0.9f, 0.9f}, {0.6f, 0.9f, 0.4f}, {1.0f, 0.3f, 0.3f}, {0.9f, 0.6f, 0.6f},
+    };
+    const float pixels_per_ms = (window_width * 0.5f) / 33.3f;
+    const int row_height = 5;
+    const int margin = 8;
+
+    GLfloat clear_color[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+    glEnable(GL_SCISSOR_TEST);
+
+    int y = margin;
+    for (int stage = PROFILER_STAGE_COUNT - 1; stage >= 0; --stage)
+    {
+        const float *c = stage_colors[stage];
+        for (int gpu = 1; gpu >= 0; --gpu)
+        {
+            if (gpu && stage >= PROFILER_GPU_STAGES)
+                continue;
+
+            // gpu rows are drawn darker above the matching cpu row
+            float shade = gpu ? 0.6f : 1.0f;
+            profiler_stats_t stats = profiler_get_stats((profiler_stage_t)stage, gpu);
+            profiler_draw_bar(margin, y, (int)(stats.p95 * pixels_per_ms), row_height,
+                              c[0] * shade * 0.4f, c[1] * shade * 0.4f, c[2] * shade * 0.4f);
+            profiler_draw_bar(margin, y, (int)(stats.p50 * pixels_per_ms), row_height,
+                              c[0] * shade, c[1] * shade, c[2] * shade);
+            y += row_height + 1;
+        }
+        y += 2;
+    }
+    if (y < window_height)
+    {
+        profiler_draw_bar(margin + (int)(16.7f * pixels_per_ms), margin, 1, y - margin, 1.0f, 1.0f, 1.0f);
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+}
+
+void profiler_print_summary(void)
+{
+    printf("--- PROFILE (ms) ---\n");
+    printf("%-18s %8s %8s %8s %8s %8s %8s\n", "stage", "cpu p50", "cpu p95", "cpu p99", "gpu p50", "gpu p95", "gpu p99");
+    for (int stage = 0; stage < PROFILER_STAGE_COUNT; ++stage)
+    {
+        profiler_stats_t cpu = profiler_get_stats((profiler_stage_t)stage, false);
+        profiler_stats_t gpu = profiler_get_stats((profiler_stage_t)stage, true);
+        if (cpu.sample_count == 0 && gpu.sample_count == 0)
+            continue;
+        printf("%-18s %8.3f %8.3f %8.3f", profiler_stage_names[stage], cpu.p50, cpu.p95, cpu.p99);
+        if (gpu.sample_count > 0)
+            printf(" %8.3f %8.3f %8.3f", gpu.p50, gpu.p95, gpu.p99);
+        printf("\n");
+
+        for (int variant = 0; variant < PROFILER_MAX_VARIANTS; ++variant)
+        {
+            profiler_stats_t variant_cpu = profiler_get_variant_stats((profiler_stage_t)stage, variant, false);
+            profiler_stats_t variant_gpu = profiler_get_variant_stats((profiler_stage_t)stage, variant, true);
+            if (variant_cpu.sample_count == 0 && variant_gpu.sample_count == 0)
+                continue;
+            char name[64];
+            profiler_event_name(stage, variant, name, sizeof(name));
+            printf("  %-16s %8.3f %8.3f %8.3f", name, variant_cpu.p50, variant_cpu.p95, variant_cpu.p99);
+            if (variant_gpu.sample_count > 0)
+                printf(" %8.3f %8.3f %8.3f", variant_gpu.p50, variant_gpu.p95, variant_gpu.p99);
+            printf("\n");
+        }
+    }
+    printf("--------------------\n");
+}
+
+bool profiler_write_trace(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        printf("Failed to open trace file %s\n", path);
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"gpu\"}}",
+            PROFILER_GPU_THREAD_ID);
+
+    pthread_mutex_lock(&profiler_mutex);
+    int first = (event_next - event_count + PROFILER_MAX_EVENTS) % PROFILER_MAX_EVENTS;
+    for (int i = 0; i < event_count; ++i)
+    {
+        const profiler_event_t *e = &events[(first + i) % PROFILER_MAX_EVENTS];
+        char name[64];
+        profiler_event_name(e->stage, e->variant, name, sizeof(name));
+        fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                name, e->thread == PROFILER_GPU_THREAD_ID ? "gpu" : "cpu",
+                e->start * 1e6, e->duration * 1e6, e->thread);
+    }
+    pthread_mutex_unlock(&profiler_mutex);
+
+    // percentiles go into otherData so the file is self-contained
+    fprintf(file, "\n],\"otherData\":{");
+    bool first_entry = true;
+    for (int stage = 0; stage < PROFILER_STAGE_COUNT; ++stage)
+    {
+        for (int gpu = 0; gpu <= 1; ++gpu)
+        {
+            profiler_stats_t stats = profiler_get_stats((profiler_stage_t)stage, gpu);
+            if (stats.sample_count == 0)
+                continue;
+            fprintf(file, "%s\"%s.%s\":\"p50=%.3f p95=%.3f p99=%.3f n=%d\"", first_entry ? "" : ",",
+                    profiler_stage_names[stage], gpu ? "gpu" : "cpu", stats.p50, stats.p95, stats.p99, stats.sample_count);
+            first_entry = false;
+        }
+    }
+    fprintf(file, "}}\n");
+    fclose(file);
+
+    printf("[INFO] Wrote %d trace events to %s\n", event_count, path);
+    return true;
+}
@@ -0,0 +1,170 @@
+/**
+motion-adaptive quality: preset ladder, config loading and progressive restore
+**/
+
+#include "quality.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// every preset covers the same affine distance (max_steps * step_size) so the
+// horizon and the disk stay in place while the quality changes
+static const quality_preset_t quality_default_presets[] = {
+    {"interactive", 2, {.max_steps = 6500, .step_size = 2e8f, .integrator = RAYTRACER_INTEGRATOR_SPHERICAL_EULER,
+                        .enable_disk = true, .enable_bodies = true, .enable_starfield = false}},
+    {"balanced", 1, {.max_steps = 13000, .step_size = 1e8f, .integrator = RAYTRACER_INTEGRATOR_SPHERICAL_EULER,
+                     .enable_disk = true, .enable_bodies = true, .enable_starfield = true}},
+    {"full", 1, {.max_steps = 26000, .step_size = 5e7f, .integrator = RAYTRACER_INTEGRATOR_SPHERICAL_EULER,
+                 .enable_disk = true, .enable_bodies = true, .enable_starfield = true}},
+};
+
+void quality_init_defaults(quality_controller_t *quality)
+{
+    *quality = (quality_controller_t){0};
+    quality->preset_count = (int)(sizeof(quality_default_presets) / sizeof(quality_default_presets[0]));
+    memcpy(quality->presets, quality_default_presets, sizeof(quality_default_presets));
+    quality->current = quality->preset_count - 1;
+    quality->settle_time = 0.3;
+    quality->restore_interval = 0.25;
+    quality->last_input_time = -1e9;
+    quality->last_change_time = -1e9;
+}
+
+// trims leading and trailing whitespace in place
+static char *quality_trim(char *text)
+{
+    while (isspace((unsigned char)*text))
+        ++text;
+    char *end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+    return text;
+}
+
+bool quality_load_config(quality_controller_t *quality, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        printf("Failed to open quality config %s\n", path);
+        return false;
+    }
+
+    quality_controller_t loaded = *quality;
+    loaded.preset_count = 0;
+    quality_preset_t *preset = NULL;
+    bool ok = true;
+    char line[256];
+    int line_number = 0;
+
+    while (ok && fgets(line, sizeof(line), file))
+    {
+        ++line_number;
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+        char *text = quality_trim(line);
+        if (*text == '\0')
+            continue;
+
+        if (*text == '[')
+        {
+            char *close = strchr(text, ']');
+            if (!close || loaded.preset_count == QUALITY_MAX_PRESETS)
+            {
+                printf("%s:%d: bad section or more than %d presets\n", path, line_number, QUALITY_MAX_PRESETS);
+                ok = false;
+                break;
+            }
+            *close = '\0';
+            // new presets start from full quality so a section only lists what it lowers
+            preset = &loaded.presets[loaded.preset_count++];
+            *preset = quality_default_presets[sizeof(quality_default_presets) / sizeof(quality_default_presets[0]) - 1];
+            snprintf(preset->name, sizeof(preset->name), "%s", quality_trim(text + 1));
+            continue;
+        }
+
+        char *equals = strchr(text, '=');
+        if (!equals)
+        {
+            printf("%s:%d: expected key = value\n", path, line_number);
+            ok = false;
+            break;
+        }
+        *equals = '\0';
+        const char *key = quality_trim(text);
+        const char *value_text = quality_trim(equals + 1);
+        double value = atof(value_text);
+
+        if (strcmp(key, "settle_time") == 0)
+            loaded.settle_time = value;
+        else if (strcmp(key, "restore_interval") == 0)
+            loaded.restore_interval = value;
+        else if (preset && strcmp(key, "render_scale") == 0 && value >= 1)
+            preset->render_scale = (int)value;
+        else if (preset && strcmp(key, "max_steps") == 0 && value >= 1)
+            preset->permutation.max_steps = (int)value;
+        else if (preset && strcmp(key, "step_size") == 0 && value > 0)
+            preset->permutation.step_size = (float)value;
+        else if (preset && strcmp(key, "disk") == 0)
+            preset->permutation.enable_disk = value != 0;
+        else if (preset && strcmp(key, "bodies") == 0)
+            preset->permutation.enable_bodies = value != 0;
+        else if (preset && strcmp(key, "starfield") == 0)
+            preset->permutation.enable_starfield = value != 0;
+        else if (preset && strcmp(key, "integrator") == 0 && strcmp(value_text, "spherical") == 0)
+            preset->permutation.integrator = RAYTRACER_INTEGRATOR_SPHERICAL_EULER;
+        else if (preset && strcmp(key, "integrator") == 0 && strcmp(value_text, "cartesian") == 0)
+            preset->permutation.integrator = RAYTRACER_INTEGRATOR_CARTESIAN;
+        else
+        {
+            printf("%s:%d: unknown or invalid setting '%s'\n", path, line_number, key);
+            ok = false;
+        }
+    }
+    fclose(file);
+
+    if (ok && loaded.preset_count == 0)
+    {
+        // timings only; keep the current ladder
+        loaded.preset_count = quality->preset_count;
+    }
+    if (!ok)
+        return false;
+
+    loaded.current = loaded.preset_count - 1;
+    *quality = loaded;
+    printf("[INFO] Loaded %d quality presets from %s\n", quality->preset_count, path);
+    return true;
+}
+
+void quality_notify_input(quality_controller_t *quality, double now)
+{
+    quality->last_input_time = now;
+    if (quality->current != 0)
+    {
+        quality->current = 0;
+        quality->last_change_time = now;
+    }
+}
+
+int quality_update(quality_controller_t *quality, double now)
+{
+    if (quality->current < quality->preset_count - 1 && now - quality->last_input_time >= quality->settle_time)
+    {
+        // the first step up comes right after the settle time, later ones every restore_interval
+        bool first_step = quality->last_change_time <= quality->last_input_time;
+        if (first_step || now - quality->last_change_time >= quality->restore_interval)
+        {
+            quality->current++;
+            quality->last_change_time = now;
+        }
+    }
+    return quality->current;
+}
+
+const quality_preset_t *quality_current(const quality_controller_t *quality)
+{
+    return &quality->presets[quality->current];
+}
@@ -0,0 +1,122 @@
+/**
+per-frame reduction and export of the ray tracer's step and termination statistics
+**/
+
+#include "ray_stats.h"
+#include <stdio.h>
+#include <string.h>
+
+const char *ray_stats_reason_names[RAY_STATS_REASON_COUNT] = {"horizon", "disk", "body", "escape", "budget"};
+
+static int ray_stats_bucket(uint32_t steps)
+{
+    int bucket = 0;
+    while (steps > 0 && bucket < RAY_STATS_HISTOGRAM_BUCKETS - 1)
+    {
+        steps >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+// oldest-first index into the ring
+static const ray_stats_frame_t *ray_stats_log_at(const ray_stats_log_t *log, int i)
+{
+    int first = log->count < RAY_STATS_MAX_FRAMES ? 0 : log->next;
+    return &log->frames[(first + i) % RAY_STATS_MAX_FRAMES];
+}
+
+void ray_stats_reduce(const uint32_t *pixels, int width, int height, ray_stats_frame_t *frame)
+{
+    frame->ray_count = width * height;
+    frame->total_steps = 0;
+    frame->max_steps_taken = 0;
+    memset(frame->reasons, 0, sizeof(frame->reasons));
+    memset(frame->histogram, 0, sizeof(frame->histogram));
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        uint32_t steps = pixels[i * 2 + 0];
+        uint32_t reason = pixels[i * 2 + 1];
+        frame->total_steps += steps;
+        if (steps > frame->max_steps_taken)
+            frame->max_steps_taken = steps;
+        if (reason < RAY_STATS_REASON_COUNT)
+            frame->reasons[reason]++;
+        frame->histogram[ray_stats_bucket(steps)]++;
+    }
+}
+
+void ray_stats_log_add(ray_stats_log_t *log, const ray_stats_frame_t *frame)
+{
+    log->frames[log->next] = *frame;
+    log->next = (log->next + 1) % RAY_STATS_MAX_FRAMES;
+    if (log->count < RAY_STATS_MAX_FRAMES)
+        log->count++;
+}
+
+void ray_stats_log_clear(ray_stats_log_t *log)
+{
+    log->count = 0;
+    log->next = 0;
+}
+
+void ray_stats_print_summary(const ray_stats_log_t *log)
+{
+    uint64_t rays = 0, steps = 0, reasons[RAY_STATS_REASON_COUNT] = {0};
+    for (int i = 0; i < log->count; ++i)
+    {
+        const ray_stats_frame_t *frame = ray_stats_log_at(log, i);
+        rays += frame->ray_count;
+        steps += frame->total_steps;
+        for (int reason = 0; reason < RAY_STATS_REASON_COUNT; ++reason)
+            reasons[reason] += frame->reasons[reason];
+    }
+    if (rays == 0)
+    {
+        printf("[INFO] No ray statistics recorded\n");
+        return;
+    }
+
+    printf("--- Ray statistics (%d frames, %llu rays) ---\n", log->count, (unsigned long long)rays);
+    printf("mean steps per ray: %.1f\n", (double)steps / (double)rays);
+    for (int reason = 0; reason < RAY_STATS_REASON_COUNT; ++reason)
+    {
+        printf("%-8s %6.2f %%\n", ray_stats_reason_names[reason], 100.0 * (double)reasons[reason] / (double)rays);
+    }
+}
+
+bool ray_stats_write_json(const ray_stats_log_t *log, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        printf("Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    fprintf(file, "{\"frames\":[\n");
+    for (int i = 0; i < log->count; ++i)
+    {
+        const ray_stats_frame_t *frame = ray_stats_log_at(log, i);
+        fprintf(file, "{\"frame\":%d,\"quality\":%d,\"budget\":%d,\"rays\":%d,\"total_steps\":%llu,\"max_steps\":%u,\"reasons\":{",
+                frame->frame_index, frame->quality_level, frame->step_budget, frame->ray_count,
+                (unsigned long long)frame->total_steps, frame->max_steps_taken);
+        for (int reason = 0; reason < RAY_STATS_REASON_COUNT; ++reason)
+        {
+            fprintf(file, "%s\"%s\":%u", reason ? "," : "", ray_stats_reason_names[reason], frame->reasons[reason]);
+        }
+        fprintf(file, "},\"histogram\":[");
+        for (int bucket = 0; bucket < RAY_STATS_HISTOGRAM_BUCKETS; ++bucket)
+        {
+            fprintf(file, "%s%u", bucket ? "," : "", frame->histogram[bucket]);
+        }
+        fprintf(file, "]}%s\n", i + 1 < log->count ? "," : "");
+    }
+    fprintf(file, "]}\n");
+
+    bool ok = fclose(file) == 0;
+    if (ok)
+        printf("[INFO] Wrote ray statistics of %d frames to %s\n", log->count, path);
+    return ok;
+}
@@ -0,0 +1,122 @@
+/**
+asynchronous frame readback through a ring of pixel buffer objects
+**/
+
+#include "readback.h"
+#include "profiler.h"
+#include <stdio.h>
+
+void readback_init(readback_ring_t *ring, readback_consumer_t consumer, void *user_data)
+{
+    *ring = (readback_ring_t){0};
+    ring->consumer = consumer;
+    ring->user_data = user_data;
+    readback_set_format(ring, GL_RGBA, GL_UNSIGNED_BYTE, 4);
+    for (int i = 0; i < READBACK_RING_SIZE; ++i)
+    {
+        glGenBuffers(1, &ring->slots[i].buffer);
+    }
+}
+
+void readback_set_format(readback_ring_t *ring, GLenum format, GLenum type, int pixel_size)
+{
+    ring->format = format;
+    ring->type = type;
+    ring->pixel_size = pixel_size;
+}
+
+bool readback_capture(readback_ring_t *ring, GLuint framebuffer, int width, int height, int frame_index)
+{
+    if (ring->in_flight == READBACK_RING_SIZE)
+    {
+        // the consumer is behind; never stall the render loop for it
+        ring->dropped_frames++;
+        return false;
+    }
+
+    readback_slot_t *slot = &ring->slots[ring->head];
+    size_t size = (size_t)width * height * ring->pixel_size;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+    if (slot->capacity != size)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        slot->capacity = size;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(framebuffer ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, ring->format, ring->type, (void *)0); // returns immediately into the pbo
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot->width = width;
+    slot->height = height;
+    slot->frame_index = frame_index;
+    slot->capture_time = profiler_now();
+
+    ring->head = (ring->head + 1) % READBACK_RING_SIZE;
+    ring->in_flight++;
+    ring->captured_frames++;
+    return true;
+}
+
+void readback_poll(readback_ring_t *ring, int current_frame_index, bool wait)
+{
+    while (ring->in_flight > 0)
+    {
+        readback_slot_t *slot = &ring->slots[ring->tail];
+        GLuint64 timeout = wait ? 1000000000ull : 0;
+        GLenum status = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return; // frames complete in order, so nothing behind this one is ready either
+
+        glDeleteSync(slot->fence);
+        slot->fence = 0;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+        const unsigned char *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot->capacity, GL_MAP_READ_BIT);
+        if (pixels)
+        {
+            if (ring->consumer)
+                ring->consumer(pixels, slot->width, slot->height, slot->frame_index, slot->capture_time, ring->user_data);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        double latency = profiler_now() - slot->capture_time;
+        ring->delivered_frames++;
+        ring->latency_frames_total += current_frame_index - slot->frame_index;
+        ring->latency_seconds_total += latency;
+        if (latency > ring->latency_seconds_max)
+            ring->latency_seconds_max = latency;
+
+        ring->tail = (ring->tail + 1) % READBACK_RING_SIZE;
+        ring->in_flight--;
+    }
+}
+
+void readback_print_stats(const readback_ring_t *ring)
+{
+    printf("[INFO] Readback: %d captured, %d delivered, %d dropped", ring->captured_frames, ring->delivered_frames,
+           ring->dropped_frames);
+    if (ring->delivered_frames > 0)
+    {
+        printf(", latency avg %.2f frames / %.2f ms, max %.2f ms",
+               (double)ring->latency_frames_total / ring->delivered_frames,
+               1000.0 * ring->latency_seconds_total / ring->delivered_frames, 1000.0 * ring->latency_seconds_max);
+    }
+    printf("\n");
+}
+
+void readback_destroy(readback_ring_t *ring)
+{
+    for (int i = 0; i < READBACK_RING_SIZE; ++i)
+    {
+        if (ring->slots[i].fence) glDeleteSync(ring->slots[i].fence);
+        if (ring->slots[i].buffer) glDeleteBuffers(1, &ring->slots[i].buffer);
+        ring->slots[i] = (readback_slot_t){0};
+    }
+    ring->in_flight = 0;
+}
@@ -0,0 +1,140 @@
+/**
+persistent offscreen render targets, allocated by size class and resized lazily
+**/
+
+#include "render_target.h"
+#include <stdio.h>
+
+static int render_target_size_class(int size)
+{
+    if (size < 1) size = 1;
+    return (size + RENDER_TARGET_SIZE_CLASS - 1) / RENDER_TARGET_SIZE_CLASS * RENDER_TARGET_SIZE_CLASS;
+}
+
+static GLenum render_target_pixel_type(GLenum internal_format)
+{
+    switch (internal_format)
+    {
+    case GL_RGBA16F:
+    case GL_RGBA32F:
+        return GL_FLOAT;
+    case GL_RG32UI:
+        return GL_UNSIGNED_INT;
+    default:
+        return GL_UNSIGNED_BYTE;
+    }
+}
+
+static GLenum render_target_pixel_format(GLenum internal_format)
+{
+    return internal_format == GL_RG32UI ? GL_RG_INTEGER : GL_RGBA;
+}
+
+static void render_target_allocate(render_target_t *target, int alloc_width, int alloc_height)
+{
+    if (target->texture == 0)
+    {
+        glGenTextures(1, &target->texture);
+        glGenFramebuffers(1, &target->framebuffer);
+    }
+
+    // integer textures cannot be filtered
+    GLint filter = target->internal_format == GL_RG32UI ? GL_NEAREST : GL_LINEAR;
+    glBindTexture(GL_TEXTURE_2D, target->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, target->internal_format, alloc_width, alloc_height,
+                 0, render_target_pixel_format(target->internal_format), render_target_pixel_type(target->internal_format), NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        printf("Render target %d x %d is incomplete\n", alloc_width, alloc_height);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    target->alloc_width = alloc_width;
+    target->alloc_height = alloc_height;
+}
+
+void render_target_manager_init(render_target_manager_t *manager)
+{
+    for (int i = 0; i < RENDER_TARGET_COUNT; ++i)
+    {
+        manager->targets[i] = (render_target_t){0};
+        manager->targets[i].internal_format = GL_RGBA8;
+    }
+    // the upscaler blends a few percent per frame, which 8 bits cannot represent without banding
+    manager->targets[RENDER_TARGET_UPSCALE_0].internal_format = GL_RGBA16F;
+    manager->targets[RENDER_TARGET_UPSCALE_1].internal_format = GL_RGBA16F;
+    manager->targets[RENDER_TARGET_RAY_STATS].internal_format = GL_RG32UI;
+}
+
+void render_target_manager_request(render_target_manager_t *manager, render_target_id_t id, int width, int height)
+{
+    manager->targets[id].requested_width = width > 1 ? width : 1;
+    manager->targets[id].requested_height = height > 1 ? height : 1;
+}
+
+void render_target_manager_apply(render_target_manager_t *manager)
+{
+    for (int i = 0; i < RENDER_TARGET_COUNT; ++i)
+    {
+        render_target_t *target = &manager->targets[i];
+        if (target->requested_width == 0 ||
+            (target->requested_width == target->width && target->requested_height == target->height))
+        {
+            continue;
+        }
+
+        int class_width = render_target_size_class(target->requested_width);
+        int class_height = render_target_size_class(target->requested_height);
+
+        // keep the allocation while the new size fits and does not waste more than half of it
+        bool fits = class_width <= target->alloc_width && class_height <= target->alloc_height;
+        bool oversized = class_width * 2 < target->alloc_width || class_height * 2 < target->alloc_height;
+        if (target->texture == 0 || !fits || oversized)
+        {
+            render_target_allocate(target, class_width, class_height);
+        }
+
+        target->width = target->requested_width;
+        target->height = target->requested_height;
+    }
+}
+
+void render_target_manager_release(render_target_manager_t *manager, render_target_id_t id)
+{
+    render_target_t *target = &manager->targets[id];
+    if (target->framebuffer) glDeleteFramebuffers(1, &target->framebuffer);
+    if (target->texture) glDeleteTextures(1, &target->texture);
+
+    // back to unrequested, keeping only the pixel format
+    GLenum internal_format = target->internal_format;
+    *target = (render_target_t){0};
+    target->internal_format = internal_format;
+}
+
+void render_target_manager_destroy(render_target_manager_t *manager)
+{
+    for (int i = 0; i < RENDER_TARGET_COUNT; ++i)
+    {
+        render_target_manager_release(manager, (render_target_id_t)i);
+    }
+}
+
+void render_target_bind(const render_target_t *target)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glViewport(0, 0, target->width, target->height);
+}
+
+void render_target_uv_scale(const render_target_t *target, float *u, float *v)
+{
+    *u = target->alloc_width ? (float)target->width / (float)target->alloc_width : 1.0f;
+    *v = target->alloc_height ? (float)target->height / (float)target->alloc_height : 1.0f;
+}
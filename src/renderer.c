@@ -5,9 +5,13 @@
 
 #include "renderer.h"
 #include "shaders.h"
+#include "shader_cache.h"
 #include "physics.h"
 #include "callbacks.h"
+#include "headless.h"
+#include "profiler.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 
 renderer_engine_t renderer_engine;
@@ -38,26 +42,439 @@ void engine_init_fullscreen_quad(renderer_engine_t *engine)
     glBindVertexArray(0);
 }
 
-void engine_init_render_texture(renderer_engine_t *engine)
+void engine_init_render_targets(renderer_engine_t *engine)
 {
-    glGenTextures(1, &engine->render_texture);
-    glBindTexture(GL_TEXTURE_2D, engine->render_texture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, engine->render_texture_width, engine->render_texture_height,
-                 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    render_target_manager_init(&engine->render_targets);
+    engine_request_resize(engine, engine->window_width, engine->window_height);
+    engine_begin_frame(engine);
+}
+
+void engine_request_resize(renderer_engine_t *engine, int width, int height)
+{
+    engine->pending_window_width = width;
+    engine->pending_window_height = height;
+    engine->resize_pending = true;
+}
+
+// full trace resolution; interleaved modes trace a subset of it each frame
+static void engine_trace_size(const renderer_engine_t *engine, int *width, int *height)
+{
+    int divisor = engine->render_scale_divisor * (engine->quality_render_scale > 0 ? engine->quality_render_scale : 1);
+    *width = engine->window_width / divisor;
+    *height = engine->window_height / divisor;
+    if (*width < 1) *width = 1;
+    if (*height < 1) *height = 1;
+}
+
+static void engine_request_trace_targets(renderer_engine_t *engine)
+{
+    int width, height;
+    engine_trace_size(engine, &width, &height);
+
+    int sparse_width = width, sparse_height = height;
+    if (engine->interleave_mode != INTERLEAVE_OFF)
+    {
+        sparse_width = (width + 1) / 2;
+        if (engine->interleave_mode == INTERLEAVE_2X2)
+            sparse_height = (height + 1) / 2;
+        render_target_manager_request(&engine->render_targets, RENDER_TARGET_HISTORY_0, width, height);
+        render_target_manager_request(&engine->render_targets, RENDER_TARGET_HISTORY_1, width, height);
+    }
+    render_target_manager_request(&engine->render_targets, RENDER_TARGET_TRACE, sparse_width, sparse_height);
+    if (engine->ray_stats_enabled)
+    {
+        render_target_manager_request(&engine->render_targets, RENDER_TARGET_RAY_STATS, sparse_width, sparse_height);
+    }
+    if (engine->upscale_enabled)
+    {
+        render_target_manager_request(&engine->render_targets, RENDER_TARGET_UPSCALE_0, engine->window_width, engine->window_height);
+        render_target_manager_request(&engine->render_targets, RENDER_TARGET_UPSCALE_1, engine->window_width, engine->window_height);
+    }
+    engine->history_valid = false;
+}
+
+void engine_set_interleave_mode(renderer_engine_t *engine, interleave_mode_t mode)
+{
+    if (engine->interleave_mode == mode)
+        return;
+    engine->interleave_mode = mode;
+    engine->interleave_phase = 0;
+    if (mode == INTERLEAVE_OFF)
+    {
+        render_target_manager_release(&engine->render_targets, RENDER_TARGET_HISTORY_0);
+        render_target_manager_release(&engine->render_targets, RENDER_TARGET_HISTORY_1);
+    }
+    engine_request_trace_targets(engine);
+    render_target_manager_apply(&engine->render_targets);
+    engine_bind_output_framebuffer(engine);
+}
+
+void engine_set_upscale(renderer_engine_t *engine, bool enabled)
+{
+    if (engine->upscale_enabled == enabled)
+        return;
+    engine->upscale_enabled = enabled;
+    engine->upscale_phase = 0;
+    engine->upscale_history_valid = false;
+    if (!enabled)
+    {
+        render_target_manager_release(&engine->render_targets, RENDER_TARGET_UPSCALE_0);
+        render_target_manager_release(&engine->render_targets, RENDER_TARGET_UPSCALE_1);
+    }
+    engine_request_trace_targets(engine);
+    render_target_manager_apply(&engine->render_targets);
+    engine_bind_output_framebuffer(engine);
+}
+
+void engine_set_view_region(renderer_engine_t *engine, int width, int height, int x, int y)
+{
+    engine->view_width = width;
+    engine->view_height = height;
+    engine->region_x = x;
+    engine->region_y = y;
+}
+
+// element of the halton low-discrepancy sequence, in [0, 1)
+static float engine_halton(int index, int base)
+{
+    float result = 0.0f, fraction = 1.0f;
+    for (int i = index + 1; i > 0; i /= base)
+    {
+        fraction /= (float)base;
+        result += fraction * (float)(i % base);
+    }
+    return result;
+}
+
+void engine_begin_frame(renderer_engine_t *engine)
+{
+    if (engine->resize_pending)
+    {
+        engine->resize_pending = false;
+        engine->window_width = engine->pending_window_width;
+        engine->window_height = engine->pending_window_height;
+
+        engine_request_trace_targets(engine);
+        engine->upscale_history_valid = false;
+        if (engine->headless)
+        {
+            // without a window the final image lives in an offscreen target
+            render_target_manager_request(&engine->render_targets, RENDER_TARGET_DISPLAY,
+                                          engine->window_width, engine->window_height);
+        }
+        render_target_manager_apply(&engine->render_targets);
+    }
+
+    engine_bind_output_framebuffer(engine);
+}
+
+GLuint engine_output_framebuffer(const renderer_engine_t *engine)
+{
+    return engine->headless ? engine->render_targets.targets[RENDER_TARGET_DISPLAY].framebuffer : 0;
+}
+
+void engine_bind_output_framebuffer(renderer_engine_t *engine)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, engine_output_framebuffer(engine));
+    glViewport(0, 0, engine->window_width, engine->window_height);
+}
+
+double engine_get_time(const renderer_engine_t *engine)
+{
+    if (engine->clock_fixed)
+        return engine->fixed_time;
+    return engine_get_wall_time(engine);
+}
+
+double engine_get_wall_time(const renderer_engine_t *engine)
+{
+    return profiler_now() - engine->start_time;
+}
+
+void engine_set_fixed_time(renderer_engine_t *engine, double seconds)
+{
+    engine->clock_fixed = true;
+    engine->fixed_time = seconds;
+}
+
+bool engine_should_close(const renderer_engine_t *engine)
+{
+    if (engine->headless)
+        return engine->frame_limit > 0 && engine->frame_index >= engine->frame_limit;
+    return glfwWindowShouldClose(engine->window);
+}
+
+void engine_present(renderer_engine_t *engine)
+{
+    if (engine->headless)
+    {
+        glFlush(); // nothing to swap and no vsync to wait for
+    }
+    else
+    {
+        glfwSwapBuffers(engine->window);
+    }
+    engine->frame_index++;
+}
+
+void engine_poll_events(renderer_engine_t *engine)
+{
+    if (!engine->headless)
+        glfwPollEvents();
+}
+
+void engine_wait_events(renderer_engine_t *engine, double timeout)
+{
+    if (!engine->headless)
+        glfwWaitEventsTimeout(timeout);
+}
+
+bool engine_write_output_ppm(renderer_engine_t *engine, const char *path)
+{
+    int width = engine->window_width, height = engine->window_height;
+    unsigned char *pixels = malloc((size_t)width * height * 3);
+    if (!pixels)
+        return false;
+
+    engine_bind_output_framebuffer(engine);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        printf("Failed to open %s for writing\n", path);
+        free(pixels);
+        return false;
+    }
+
+    // gl rows start at the bottom, ppm rows at the top
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for (int y = height - 1; y >= 0; --y)
+    {
+        fwrite(pixels + (size_t)y * width * 3, 3, width, file);
+    }
+    fclose(file);
+    free(pixels);
+    printf("[INFO] Wrote %d x %d frame to %s\n", width, height, path);
+    return true;
+}
+
+void engine_init_shader_bindings(renderer_engine_t *engine)
+{
+    // scene data reaches every pass through one uniform buffer; the ray tracer
+    // permutations bind their block in engine_build_raytracer_program
+    glGenBuffers(1, &engine->scene_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, engine->scene_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(scene_uniform_block_t), NULL, GL_STREAM_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, SCENE_UNIFORM_BINDING, engine->scene_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    GLuint reconstruct_block = glGetUniformBlockIndex(engine->reconstruct_program, "SceneData");
+    glUniformBlockBinding(engine->reconstruct_program, reconstruct_block, SCENE_UNIFORM_BINDING);
+    GLuint upscale_block = glGetUniformBlockIndex(engine->upscale_program, "SceneData");
+    glUniformBlockBinding(engine->upscale_program, upscale_block, SCENE_UNIFORM_BINDING);
+
+    engine->grid_view_proj_location = glGetUniformLocation(engine->grid_shader_program, "viewProj");
+    engine->texture_quad_uv_scale_location = glGetUniformLocation(engine->texture_quad_shader_program, "uvScale");
+    engine->heatmap_stats_size_location = glGetUniformLocation(engine->heatmap_program, "statsSize");
+    engine->heatmap_max_steps_location = glGetUniformLocation(engine->heatmap_program, "maxSteps");
+
+    // the blit always samples texture unit 0
+    glUseProgram(engine->texture_quad_shader_program);
+    glUniform1i(glGetUniformLocation(engine->texture_quad_shader_program, "screenTexture"), 0);
+    // reconstruction reads this frame's samples from unit 0 and the previous result from unit 1
+    glUseProgram(engine->reconstruct_program);
+    glUniform1i(glGetUniformLocation(engine->reconstruct_program, "currentSamples"), 0);
+    glUniform1i(glGetUniformLocation(engine->reconstruct_program, "history"), 1);
+    glUseProgram(engine->upscale_program);
+    glUniform1i(glGetUniformLocation(engine->upscale_program, "currentSamples"), 0);
+    glUniform1i(glGetUniformLocation(engine->upscale_program, "history"), 1);
+    glUseProgram(engine->heatmap_program);
+    glUniform1i(glGetUniformLocation(engine->heatmap_program, "rayStats"), 0);
+    glUseProgram(0);
+}
+
+// compiles (or loads from the cache) the ray tracer permutation of a quality preset
+static GLuint engine_build_raytracer_program(renderer_engine_t *engine, int level, bool stats)
+{
+    raytracer_permutation_t permutation = engine->quality.presets[level].permutation;
+    permutation.num_objects = NUM_CELESTIAL_BODIES;
+    permutation.enable_stats = stats;
+    char *source = utility_build_raytracer_source(&permutation);
+    GLuint program = source ? shader_cache_create_program(quad_vertex_shader_source, source) : 0;
+    free(source);
+    if (!program)
+        return 0;
+
+    GLuint scene_block = glGetUniformBlockIndex(program, "SceneData");
+    glUniformBlockBinding(program, scene_block, SCENE_UNIFORM_BINDING);
+
+    // absent (-1) in permutations without the starfield, which makes this a no-op
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "starfield"), STARFIELD_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(program, "bodyTiles"), BODY_TILES_TEXTURE_UNIT);
+    glUseProgram(0);
+    return program;
+}
+
+// readback consumer of the stats target: reduces a frame to its totals once the gpu has
+// copied it, with the preset it was traced at
+static void engine_collect_ray_stats(const unsigned char *pixels, int width, int height, int frame_index,
+                                     double capture_time, void *user_data)
+{
+    (void)frame_index;
+    (void)capture_time;
+    renderer_engine_t *engine = user_data;
+    ray_stats_frame_t pending = engine->ray_stats_pending[engine->ray_stats_pending_first];
+    engine->ray_stats_pending_first = (engine->ray_stats_pending_first + 1) % READBACK_RING_SIZE;
+    engine->ray_stats_pending_count--;
+
+    ray_stats_frame_t frame;
+    ray_stats_reduce((const uint32_t *)pixels, width, height, &frame);
+    frame.frame_index = pending.frame_index;
+    frame.quality_level = pending.quality_level;
+    frame.step_budget = pending.step_budget;
+    ray_stats_log_add(&engine->ray_stats, &frame);
+}
+
+// queues the copy of this frame's stats target; a frame is skipped rather than stalling
+// the render loop when the ring is full
+static void engine_capture_ray_stats(renderer_engine_t *engine, const render_target_t *stats)
+{
+    if (!readback_capture(&engine->ray_stats_ring, stats->framebuffer, stats->width, stats->height, engine->frame_index))
+        return;
+    int slot = (engine->ray_stats_pending_first + engine->ray_stats_pending_count) % READBACK_RING_SIZE;
+    engine->ray_stats_pending[slot] = (ray_stats_frame_t){
+        .frame_index = engine->frame_index,
+        .quality_level = engine->quality_level,
+        .step_budget = engine->quality.presets[engine->quality_level].permutation.max_steps,
+    };
+    engine->ray_stats_pending_count++;
+}
+
+void engine_flush_ray_stats(renderer_engine_t *engine)
+{
+    if (engine->ray_stats_enabled)
+        readback_poll(&engine->ray_stats_ring, engine->frame_index, true);
+}
+
+bool engine_set_ray_stats(renderer_engine_t *engine, bool enabled)
+{
+    if (enabled)
+    {
+        for (int level = 0; level < engine->quality.preset_count; ++level)
+        {
+            if (!engine->stats_programs[level])
+                engine->stats_programs[level] = engine_build_raytracer_program(engine, level, true);
+            if (!engine->stats_programs[level])
+                return false;
+        }
+        ray_stats_log_clear(&engine->ray_stats);
+    }
+    if (engine->ray_stats_enabled != enabled)
+    {
+        if (enabled)
+        {
+            readback_init(&engine->ray_stats_ring, engine_collect_ray_stats, engine);
+            readback_set_format(&engine->ray_stats_ring, GL_RG_INTEGER, GL_UNSIGNED_INT, 2 * sizeof(uint32_t));
+            engine->ray_stats_pending_first = engine->ray_stats_pending_count = 0;
+        }
+        else
+        {
+            engine_flush_ray_stats(engine);
+            readback_destroy(&engine->ray_stats_ring);
+            render_target_manager_release(&engine->render_targets, RENDER_TARGET_RAY_STATS);
+        }
+        engine->ray_stats_enabled = enabled;
+        engine_request_trace_targets(engine);
+        render_target_manager_apply(&engine->render_targets);
+        engine_bind_output_framebuffer(engine);
+    }
+    return true;
+}
+
+// fills and uploads the body candidates of every tile of this frame's trace
+static void engine_update_body_tiles(renderer_engine_t *engine, const scene_uniform_block_t *scene, int trace_width,
+                                     int trace_height)
+{
+    int tiles_x, tiles_y;
+    culling_tile_count(trace_width, trace_height, &tiles_x, &tiles_y);
+    size_t needed = (size_t)tiles_x * tiles_y;
+    if (needed > engine->body_tile_capacity)
+    {
+        uint32_t *masks = realloc(engine->body_tile_masks, needed * sizeof(uint32_t));
+        if (!masks)
+            return;
+        engine->body_tile_masks = masks;
+        engine->body_tile_capacity = needed;
+    }
+
+    if (engine->body_culling_enabled)
+    {
+        culling_view_t view = {
+            .position = scene->cam_pos,
+            .right = scene->cam_right,
+            .up = scene->cam_up,
+            .forward = scene->cam_forward,
+            .tan_half_fov = scene->tan_half_fov,
+            .aspect = scene->aspect,
+            .width = (int)scene->resolution[0],
+            .height = (int)scene->resolution[1],
+            .origin_x = scene->region_origin[0],
+            .origin_y = scene->region_origin[1],
+            .region_width = trace_width,
+            .region_height = trace_height,
+        };
+        culling_build_body_tiles(&view, BLACK_HOLE_SCHWARZSCHILD_RADIUS, scene->obj_pos_radius, NUM_CELESTIAL_BODIES,
+                                 engine->body_tile_masks);
+    }
+    else
+    {
+        for (size_t i = 0; i < needed; ++i)
+            engine->body_tile_masks[i] = (1u << NUM_CELESTIAL_BODIES) - 1u;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, engine->body_tile_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (tiles_x != engine->body_tiles_x || tiles_y != engine->body_tiles_y)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, tiles_x, tiles_y, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, engine->body_tile_masks);
+        engine->body_tiles_x = tiles_x;
+        engine->body_tiles_y = tiles_y;
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tiles_x, tiles_y, GL_RED_INTEGER, GL_UNSIGNED_INT, engine->body_tile_masks);
+    }
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+int engine_update_quality(renderer_engine_t *engine)
+{
+    engine->quality_level = quality_update(&engine->quality, engine_get_time(engine));
+
+    // only the trace-resolution targets follow the preset; the upscaler keeps its window-size history
+    int render_scale = quality_current(&engine->quality)->render_scale;
+    if (render_scale != engine->quality_render_scale)
+    {
+        engine->quality_render_scale = render_scale;
+        engine_request_trace_targets(engine);
+        render_target_manager_apply(&engine->render_targets);
+        engine_bind_output_framebuffer(engine);
+    }
+    return engine->quality_level;
+}
+
 void engine_render_raytraced_scene_to_texture(renderer_engine_t *engine, camera_t *cam)
 {
-    GLuint framebuffer;
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, engine->render_texture, 0);
+    // snapshot the bodies first so the physics lock is not held while talking to the driver
+    celestial_body_t bodies[MAX_CELESTIAL_BODIES];
+    physics_snapshot_bodies(bodies);
 
-    glViewport(0, 0, engine->render_texture_width, engine->render_texture_height);
-    glUseProgram(engine->raytracer_shader_program);
+    const render_target_t *trace = &engine->render_targets.targets[RENDER_TARGET_TRACE];
+    int trace_width, trace_height;
+    engine_trace_size(engine, &trace_width, &trace_height);
 
     vector3_t pos = camera_get_position(cam);
     vector3_t fwd = vector3_normalize(vector3_subtract(cam->target, pos));
@@ -65,51 +482,171 @@ void engine_render_raytraced_scene_to_texture(renderer_engine_t *engine, camera_
     vector3_t right = vector3_normalize(vector3_cross(fwd, global_up));
     vector3_t up = vector3_cross(right, fwd);
 
-    glUniform3f(glGetUniformLocation(engine->raytracer_shader_program, "camPos"), pos.x, pos.y, pos.z);
-    glUniform3f(glGetUniformLocation(engine->raytracer_shader_program, "camRight"), right.x, right.y, right.z);
-    glUniform3f(glGetUniformLocation(engine->raytracer_shader_program, "camUp"), up.x, up.y, up.z);
-    glUniform3f(glGetUniformLocation(engine->raytracer_shader_program, "camForward"), fwd.x, fwd.y, fwd.z);
-    glUniform1f(glGetUniformLocation(engine->raytracer_shader_program, "tanHalfFov"), tanf(M_PI / 6.0f));
-    glUniform1f(glGetUniformLocation(engine->raytracer_shader_program, "aspect"), (float)engine->window_width / (float)engine->window_height);
-    glUniform1i(glGetUniformLocation(engine->raytracer_shader_program, "moving"), cam->is_moving ? 1 : 0);
-    glUniform2f(glGetUniformLocation(engine->raytracer_shader_program, "resolution"),
-                (float)engine->render_texture_width, (float)engine->render_texture_height);
-    glUniform1f(glGetUniformLocation(engine->raytracer_shader_program, "time"), (float)glfwGetTime());
-
-    float disk_inner_radius = BLACK_HOLE_SCHWARZSCHILD_RADIUS * 2.2f;
-    float disk_outer_radius = BLACK_HOLE_SCHWARZSCHILD_RADIUS * 5.2f;
-    glUniform1f(glGetUniformLocation(engine->raytracer_shader_program, "disk_r1"), disk_inner_radius);
-    glUniform1f(glGetUniformLocation(engine->raytracer_shader_program, "disk_r2"), disk_outer_radius);
-
-    glUniform1i(glGetUniformLocation(engine->raytracer_shader_program, "numObjects"), NUM_CELESTIAL_BODIES);
-	physics_lock();
-	for (int i = 0; i < NUM_CELESTIAL_BODIES; ++i)
-	{
-		char uniform_name[64];
-		snprintf(uniform_name, sizeof(uniform_name), "objPosRadius[%d]", i);
-		glUniform4fv(glGetUniformLocation(engine->raytracer_shader_program, uniform_name), 1, &celestial_bodies[i].position_and_radius.x);
-		snprintf(uniform_name, sizeof(uniform_name), "objColor[%d]", i);
-		glUniform4fv(glGetUniformLocation(engine->raytracer_shader_program, uniform_name), 1, &celestial_bodies[i].color.x);
-		snprintf(uniform_name, sizeof(uniform_name), "objMass[%d]", i);
-		glUniform1f(glGetUniformLocation(engine->raytracer_shader_program, uniform_name), celestial_bodies[i].mass);
-	}
-	physics_unlock();
-    
+    scene_uniform_block_t scene = {0};
+    scene.cam_pos = pos;
+    scene.cam_right = right;
+    scene.cam_up = up;
+    scene.cam_forward = fwd;
+    scene.tan_half_fov = tanf(M_PI / 6.0f);
+    scene.aspect = (float)engine->window_width / (float)engine->window_height;
+    if (engine->view_width > 0)
+        scene.aspect = (float)engine->view_width / (float)engine->view_height;
+    scene.disk_r1 = BLACK_HOLE_SCHWARZSCHILD_RADIUS * 2.2f;
+    scene.disk_r2 = BLACK_HOLE_SCHWARZSCHILD_RADIUS * 5.2f;
+    scene.prev_cam_pos = engine->prev_cam_pos;
+    scene.prev_cam_right = engine->prev_cam_right;
+    scene.prev_cam_up = engine->prev_cam_up;
+    scene.prev_cam_forward = engine->prev_cam_forward;
+    scene.focus_distance = vector3_length(vector3_subtract(cam->target, pos));
+    scene.history_valid = engine->history_valid ? 1.0f : 0.0f;
+    scene.upscale_history_valid = engine->upscale_history_valid ? 1.0f : 0.0f;
+    scene.output_resolution[0] = (float)engine->window_width;
+    scene.output_resolution[1] = (float)engine->window_height;
+    scene.resolution[0] = (float)trace_width;
+    scene.resolution[1] = (float)trace_height;
+    scene.time = (float)engine_get_time(engine);
+    if (engine->view_width > 0)
+    {
+        // one tile of a still image: every tile must see the same moment
+        scene.resolution[0] = (float)engine->view_width;
+        scene.resolution[1] = (float)engine->view_height;
+        scene.region_origin[0] = engine->region_x;
+        scene.region_origin[1] = engine->region_y;
+        scene.time = 0.0f;
+    }
+
+    // the pixel subset traced this frame cycles so every pixel is refreshed every interleave_mode frames
+    scene.interleave_scale[0] = scene.interleave_scale[1] = 1;
+    if (engine->interleave_mode == INTERLEAVE_CHECKERBOARD)
+    {
+        scene.interleave_checkerboard = 1;
+        scene.interleave_scale[0] = 2;
+        scene.interleave_offset[0] = engine->interleave_phase & 1;
+    }
+    else if (engine->interleave_mode == INTERLEAVE_2X2)
+    {
+        static const int offsets[4][2] = {{0, 0}, {1, 1}, {1, 0}, {0, 1}}; // diagonal first
+        scene.interleave_scale[0] = scene.interleave_scale[1] = 2;
+        scene.interleave_offset[0] = offsets[engine->interleave_phase & 3][0];
+        scene.interleave_offset[1] = offsets[engine->interleave_phase & 3][1];
+    }
+
+    // interleaved frames already rotate their sample positions, and the reconstruction
+    // assumes pixel centres, so the upscaler only jitters full traces
+    if (engine->upscale_enabled && engine->interleave_mode == INTERLEAVE_OFF)
+    {
+        int phase = engine->upscale_phase++ % 8;
+        scene.jitter[0] = engine_halton(phase, 2) - 0.5f;
+        scene.jitter[1] = engine_halton(phase, 3) - 0.5f;
+    }
+    for (int i = 0; i < NUM_CELESTIAL_BODIES; ++i)
+    {
+        scene.obj_pos_radius[i] = bodies[i].position_and_radius;
+        scene.obj_color[i] = bodies[i].color;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, engine->scene_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(scene), &scene, GL_STREAM_DRAW); // orphan + upload in one call
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    engine_update_body_tiles(engine, &scene, trace_width, trace_height);
+
+    static const GLenum draw_buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    const render_target_t *stats = &engine->render_targets.targets[RENDER_TARGET_RAY_STATS];
+
+    render_target_bind(trace);
+    if (engine->ray_stats_enabled)
+    {
+        // the stats permutation writes its second output into the stats target
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, stats->texture, 0);
+        glDrawBuffers(2, draw_buffers);
+    }
+    glUseProgram(engine->ray_stats_enabled ? engine->stats_programs[engine->quality_level]
+                                           : engine->raytracer_programs[engine->quality_level]);
+    glActiveTexture(GL_TEXTURE0 + STARFIELD_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, engine->starfield_texture);
+    glActiveTexture(GL_TEXTURE0 + BODY_TILES_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, engine->body_tile_texture);
+    glActiveTexture(GL_TEXTURE0);
+
     glBindVertexArray(engine->fullscreen_quad_vao);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glDeleteFramebuffers(1, &framebuffer);
+    if (engine->ray_stats_enabled)
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, 0, 0);
+        glDrawBuffers(1, draw_buffers);
+        // the stats target's own framebuffer has it as attachment 0, which the readback copies
+        engine_capture_ray_stats(engine, stats);
+        readback_poll(&engine->ray_stats_ring, engine->frame_index, false);
+    }
+
+    if (engine->interleave_mode != INTERLEAVE_OFF)
+    {
+        // fill the untraced pixels into the next history target from the previous one
+        int previous = engine->history_index;
+        engine->history_index ^= 1;
+        const render_target_t *target = &engine->render_targets.targets[RENDER_TARGET_HISTORY_0 + engine->history_index];
+        const render_target_t *history = &engine->render_targets.targets[RENDER_TARGET_HISTORY_0 + previous];
+
+        render_target_bind(target);
+        glUseProgram(engine->reconstruct_program);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, history->texture);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, trace->texture);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        engine->interleave_phase++;
+        engine->history_valid = true;
+    }
+
+    // the reconstruction and upscale passes of the next frame reproject from this camera
+    engine->prev_cam_pos = pos;
+    engine->prev_cam_right = right;
+    engine->prev_cam_up = up;
+    engine->prev_cam_forward = fwd;
+
+    engine_bind_output_framebuffer(engine);
 }
 
 void engine_render_texture_to_screen(renderer_engine_t *engine)
 {
-    glViewport(0, 0, engine->window_width, engine->window_height);
+    // interleaved frames show the reconstruction, which is already at full trace resolution
+    render_target_id_t source_id = engine->interleave_mode != INTERLEAVE_OFF
+                                       ? RENDER_TARGET_HISTORY_0 + engine->history_index
+                                       : RENDER_TARGET_TRACE;
+
+    if (engine->upscale_enabled)
+    {
+        // accumulate into the next window-resolution target, then blit that one 1:1
+        int previous = engine->upscale_index;
+        engine->upscale_index ^= 1;
+        const render_target_t *target = &engine->render_targets.targets[RENDER_TARGET_UPSCALE_0 + engine->upscale_index];
+        const render_target_t *history = &engine->render_targets.targets[RENDER_TARGET_UPSCALE_0 + previous];
+
+        render_target_bind(target);
+        glUseProgram(engine->upscale_program);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, history->texture);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, engine->render_targets.targets[source_id].texture);
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(engine->fullscreen_quad_vao);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        engine->upscale_history_valid = true;
+        source_id = RENDER_TARGET_UPSCALE_0 + engine->upscale_index;
+    }
+
+    engine_bind_output_framebuffer(engine);
+    const render_target_t *trace = &engine->render_targets.targets[source_id];
+    float uv_scale_u, uv_scale_v;
+    render_target_uv_scale(trace, &uv_scale_u, &uv_scale_v);
 
     glUseProgram(engine->texture_quad_shader_program);
+    glUniform2f(engine->texture_quad_uv_scale_location, uv_scale_u, uv_scale_v);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, engine->render_texture);
-    glUniform1i(glGetUniformLocation(engine->texture_quad_shader_program, "screenTexture"), 0);
+    glBindTexture(GL_TEXTURE_2D, trace->texture);
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -117,12 +654,117 @@ void engine_render_texture_to_screen(renderer_engine_t *engine)
     
     glBindVertexArray(engine->fullscreen_quad_vao);
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    
+
+    if (engine->heatmap_visible && engine->ray_stats_enabled)
+    {
+        const render_target_t *stats = &engine->render_targets.targets[RENDER_TARGET_RAY_STATS];
+        glUseProgram(engine->heatmap_program);
+        glUniform2f(engine->heatmap_stats_size_location, (float)stats->width, (float)stats->height);
+        glUniform1f(engine->heatmap_max_steps_location,
+                    (float)engine->quality.presets[engine->quality_level].permutation.max_steps);
+        glBindTexture(GL_TEXTURE_2D, stats->texture);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+
     glEnable(GL_DEPTH_TEST);
     glDisable(GL_BLEND);
     glBindVertexArray(0);
 }
 
+// bakes or loads the sky and uploads it as a mipmapped cubemap
+static bool engine_init_starfield(renderer_engine_t *engine)
+{
+    double start = profiler_now();
+    bool ok = engine->sky_path ? starfield_load_panorama(&engine->starfield, engine->sky_path, STARFIELD_DEFAULT_FACE_SIZE)
+                               : starfield_bake(&engine->starfield, STARFIELD_DEFAULT_FACE_SIZE);
+    if (!ok)
+        return false;
+
+    glGenTextures(1, &engine->starfield_texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, engine->starfield_texture);
+    for (int face = 0; face < STARFIELD_FACE_COUNT; ++face)
+    {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA8, engine->starfield.face_size, engine->starfield.face_size,
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, engine->starfield.faces[face]);
+    }
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    printf("[INFO] Sky cubemap %d x %d x 6 ready in %.1f ms\n", engine->starfield.face_size, engine->starfield.face_size,
+           (profiler_now() - start) * 1000.0);
+    return true;
+}
+
+// shared by the window and headless paths once a context is current
+static bool engine_init_pipeline(renderer_engine_t *engine)
+{
+    engine->start_time = profiler_now();
+    engine->frame_index = 0;
+    if (engine->render_scale_divisor < 1)
+        engine->render_scale_divisor = 7; // low resolution to improve performance
+    if (engine->interleave_mode < INTERLEAVE_OFF)
+        engine->interleave_mode = INTERLEAVE_OFF;
+    if (engine->quality.preset_count == 0)
+        quality_init_defaults(&engine->quality);
+    engine->quality_level = engine->quality.current;
+    engine->quality_render_scale = quality_current(&engine->quality)->render_scale;
+
+    printf("--- Black Hole ---\n");
+    printf("Initial Framebuffer Size: %d x %d pixels\n", engine->window_width, engine->window_height);
+    int trace_width, trace_height;
+    engine_trace_size(engine, &trace_width, &trace_height);
+    printf("Compute Resolution: %d x %d pixels\n", trace_width, trace_height);
+
+    shader_cache_init();
+    for (int level = 0; level < engine->quality.preset_count; ++level)
+    {
+        engine->raytracer_programs[level] = engine_build_raytracer_program(engine, level, false);
+        if (!engine->raytracer_programs[level])
+        {
+            return false;
+        }
+        profiler_set_variant_name(PROFILER_STAGE_RAY_TRACE, level, engine->quality.presets[level].name);
+    }
+    engine->grid_shader_program = shader_cache_create_program(grid_vertex_shader_source, grid_fragment_shader_source);
+    engine->texture_quad_shader_program = shader_cache_create_program(quad_vertex_shader_source, quad_fragment_shader_source);
+    engine->reconstruct_program = shader_cache_create_program(quad_vertex_shader_source, reconstruct_fragment_shader_source);
+    engine->upscale_program = shader_cache_create_program(quad_vertex_shader_source, upscale_fragment_shader_source);
+    engine->heatmap_program = shader_cache_create_program(quad_vertex_shader_source, heatmap_fragment_shader_source);
+
+    if (!engine->grid_shader_program || !engine->texture_quad_shader_program || !engine->reconstruct_program ||
+        !engine->upscale_program || !engine->heatmap_program)
+    {
+        return false;
+    }
+
+    if (!engine_init_starfield(engine))
+    {
+        return false;
+    }
+
+    // sized on the first frame, and whenever the trace target changes
+    glGenTextures(1, &engine->body_tile_texture);
+    glBindTexture(GL_TEXTURE_2D, engine->body_tile_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    engine_init_shader_bindings(engine);
+    engine_init_fullscreen_quad(engine);
+    engine_init_render_targets(engine);
+
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    return true;
+}
+
 bool engine_initialize(renderer_engine_t *engine)
 {
     if (!glfwInit())
@@ -157,14 +799,13 @@ bool engine_initialize(renderer_engine_t *engine)
     glfwGetFramebufferSize(engine->window, &engine->window_width, &engine->window_height);
     glViewport(0, 0, engine->window_width, engine->window_height);
 
-    engine->render_texture_width = engine->window_width / 7; // low resolution to improve performance
-    engine->render_texture_height = engine->window_height / 7;
-
     glfwSwapInterval(1); // v-sync
 
-    printf("--- Black Hole ---\n");
-    printf("Initial Framebuffer Size: %d x %d pixels\n", engine->window_width, engine->window_height);
-    printf("Compute Resolution: %d x %d pixels\n", engine->render_texture_width, engine->render_texture_height);
+    if (!engine_init_pipeline(engine))
+    {
+        return false;
+    }
+
     printf("--- CONTROLS ---\n");
     printf("Left Mouse + Drag: Orbit Camera\n");
     printf("Middle Mouse + Drag: Pan Camera\n");
@@ -172,43 +813,85 @@ bool engine_initialize(renderer_engine_t *engine)
     printf("R: Reset Camera\n");
     printf("P: Pause/Resume Physics\n");
     printf("G: Toggle Spacetime Grid\n");
+    printf("O: Toggle Profiler Overlay\n");
+    printf("T: Dump Profile + Chrome Trace\n");
+    printf("C: Cycle Interleaved Tracing (off / checkerboard / 2x2)\n");
+    printf("U: Toggle Temporal Upscaling\n");
+    printf("H: Toggle Ray-Step Heatmap + Statistics\n");
     printf("ESC: Exit\n");
     printf("----------------\n");
 
-    engine->raytracer_shader_program = utility_create_shader_program(quad_vertex_shader_source, raytracer_fragment_shader_source);
-    engine->grid_shader_program = utility_create_shader_program(grid_vertex_shader_source, grid_fragment_shader_source);
-    engine->texture_quad_shader_program = utility_create_shader_program(quad_vertex_shader_source, quad_fragment_shader_source);
+    glfwSetMouseButtonCallback(engine->window, callback_mouse_button);
+    glfwSetCursorPosCallback(engine->window, callback_cursor_position);
+    glfwSetScrollCallback(engine->window, callback_scroll);
+    glfwSetKeyCallback(engine->window, callback_key);
+
+    return true;
+}
 
-    if (!engine->raytracer_shader_program || !engine->grid_shader_program || !engine->texture_quad_shader_program)
+bool engine_initialize_headless(renderer_engine_t *engine, int width, int height)
+{
+    if (!headless_context_create())
     {
         return false;
     }
+    engine->headless = true;
+    engine->window = NULL;
 
-    engine_init_fullscreen_quad(engine);
-    engine_init_render_texture(engine);
-
-    glfwSetMouseButtonCallback(engine->window, callback_mouse_button);
-    glfwSetCursorPosCallback(engine->window, callback_cursor_position);
-    glfwSetScrollCallback(engine->window, callback_scroll);
-    glfwSetKeyCallback(engine->window, callback_key);
+#ifndef __APPLE__
+    glewExperimental = GL_TRUE;
+    GLenum glew_err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // glx builds of glew report this for egl contexts but still load the entry points
+    if (glew_err == GLEW_ERROR_NO_GLX_DISPLAY)
+        glew_err = GLEW_OK;
+#endif
+    if (glew_err != GLEW_OK)
+    {
+        printf("Failed to initialize GLEW: %s\n", glewGetErrorString(glew_err));
+        return false;
+    }
+#endif
 
-    glEnable(GL_DEPTH_TEST);
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    engine->window_width = width;
+    engine->window_height = height;
+    printf("GL Renderer: %s (%s)\n", (const char *)glGetString(GL_RENDERER), (const char *)glGetString(GL_VERSION));
 
-    return true;
+    return engine_init_pipeline(engine);
 }
 
 void engine_cleanup(renderer_engine_t *engine)
 {
     if (engine->fullscreen_quad_vao) glDeleteVertexArrays(1, &engine->fullscreen_quad_vao);
-    if (engine->render_texture) glDeleteTextures(1, &engine->render_texture);
-    if (engine->raytracer_shader_program) glDeleteProgram(engine->raytracer_shader_program);
+    render_target_manager_destroy(&engine->render_targets);
+    for (int level = 0; level < QUALITY_MAX_PRESETS; ++level)
+    {
+        if (engine->raytracer_programs[level]) glDeleteProgram(engine->raytracer_programs[level]);
+        if (engine->stats_programs[level]) glDeleteProgram(engine->stats_programs[level]);
+    }
     if (engine->grid_shader_program) glDeleteProgram(engine->grid_shader_program);
     if (engine->texture_quad_shader_program) glDeleteProgram(engine->texture_quad_shader_program);
+    if (engine->reconstruct_program) glDeleteProgram(engine->reconstruct_program);
+    if (engine->upscale_program) glDeleteProgram(engine->upscale_program);
+    if (engine->heatmap_program) glDeleteProgram(engine->heatmap_program);
+    if (engine->ray_stats_enabled)
+        readback_destroy(&engine->ray_stats_ring);
+    if (engine->scene_ubo) glDeleteBuffers(1, &engine->scene_ubo);
+    if (engine->starfield_texture) glDeleteTextures(1, &engine->starfield_texture);
+    if (engine->body_tile_texture) glDeleteTextures(1, &engine->body_tile_texture);
+    free(engine->body_tile_masks);
+    engine->body_tile_masks = NULL;
+    starfield_destroy(&engine->starfield);
     if (engine->grid_vao) glDeleteVertexArrays(1, &engine->grid_vao);
     if (engine->grid_vbo) glDeleteBuffers(1, &engine->grid_vbo);
     if (engine->grid_ebo) glDeleteBuffers(1, &engine->grid_ebo);
 
+    if (engine->headless)
+    {
+        headless_context_destroy();
+        return;
+    }
+
     if (engine->window)
     {
         glfwDestroyWindow(engine->window);
@@ -0,0 +1,324 @@
+/**
+input recording and playback: a run's seed state, then per frame its clock and the inputs
+that arrived during it, so a replay drives the app through the identical workload
+**/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "replay.h"
+#include "profiler.h"
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+// record tags
+#define REPLAY_TAG_FRAME 'F'
+#define REPLAY_TAG_MOUSE_BUTTON 'M'
+#define REPLAY_TAG_CURSOR 'C'
+#define REPLAY_TAG_SCROLL 'S'
+#define REPLAY_TAG_KEY 'K'
+#define REPLAY_TAG_RESIZE 'R'
+
+replay_t replay_session;
+
+// ------------------------------
+// field i/o
+// ------------------------------
+
+static bool replay_write(replay_t *replay, const void *data, size_t size)
+{
+    if (fwrite(data, 1, size, replay->file) == size)
+        return true;
+    printf("Failed to write replay %s, recording stopped\n", replay->path);
+    fclose(replay->file);
+    replay->file = NULL;
+    replay->mode = REPLAY_OFF;
+    return false;
+}
+
+static bool replay_read(replay_t *replay, void *data, size_t size)
+{
+    return fread(data, 1, size, replay->file) == size;
+}
+
+static bool replay_write_int(replay_t *replay, int value)
+{
+    int32_t v = value;
+    return replay_write(replay, &v, sizeof(v));
+}
+
+static bool replay_read_int(replay_t *replay, int *value)
+{
+    int32_t v;
+    if (!replay_read(replay, &v, sizeof(v)))
+        return false;
+    *value = v;
+    return true;
+}
+
+// a body is 12 floats: position and radius, colour, mass, velocity
+static void replay_body_floats(celestial_body_t *body, float *fields[12])
+{
+    float *p[12] = {&body->position_and_radius.x, &body->position_and_radius.y, &body->position_and_radius.z,
+                    &body->position_and_radius.w, &body->color.x, &body->color.y, &body->color.z, &body->color.w,
+                    &body->mass, &body->velocity.x, &body->velocity.y, &body->velocity.z};
+    memcpy(fields, p, sizeof(p));
+}
+
+// the persistent part of the camera; the drag state starts released
+static void replay_camera_floats(camera_t *cam, float *fields[9])
+{
+    float *p[9] = {&cam->target.x, &cam->target.y, &cam->target.z, &cam->radius, &cam->min_radius,
+                   &cam->max_radius, &cam->azimuth, &cam->elevation, &cam->orbit_speed};
+    memcpy(fields, p, sizeof(p));
+}
+
+static bool replay_write_seed(replay_t *replay, const replay_seed_t *seed)
+{
+    replay_seed_t copy = *seed;
+    bool ok = replay_write(replay, REPLAY_MAGIC, strlen(REPLAY_MAGIC)) && replay_write_int(replay, REPLAY_VERSION) &&
+              replay_write_int(replay, copy.body_count);
+    for (int i = 0; ok && i < copy.body_count; ++i)
+    {
+        float *fields[12];
+        replay_body_floats(&copy.bodies[i], fields);
+        for (int f = 0; ok && f < 12; ++f)
+            ok = replay_write(replay, fields[f], sizeof(float));
+    }
+    float *camera_fields[9];
+    replay_camera_floats(&copy.camera, camera_fields);
+    for (int f = 0; ok && f < 9; ++f)
+        ok = replay_write(replay, camera_fields[f], sizeof(float));
+    return ok && replay_write(replay, &copy.camera.pan_speed, sizeof(float)) &&
+           replay_write(replay, &copy.camera.zoom_speed, sizeof(double)) &&
+           replay_write_int(replay, copy.collision_mode) && replay_write_int(replay, copy.width) &&
+           replay_write_int(replay, copy.height) && replay_write(replay, &copy.start_time, sizeof(double));
+}
+
+static bool replay_read_seed(replay_t *replay, replay_seed_t *seed)
+{
+    char magic[sizeof(REPLAY_MAGIC)] = {0};
+    int version;
+    if (!replay_read(replay, magic, strlen(REPLAY_MAGIC)) || strcmp(magic, REPLAY_MAGIC) != 0 ||
+        !replay_read_int(replay, &version))
+    {
+        printf("Failed to read replay %s: not a recording\n", replay->path);
+        return false;
+    }
+    if (version != REPLAY_VERSION)
+    {
+        printf("Failed to read replay %s: version %d, expected %d\n", replay->path, version, REPLAY_VERSION);
+        return false;
+    }
+
+    *seed = (replay_seed_t){.camera = initial_camera_state};
+    bool ok = replay_read_int(replay, &seed->body_count) && seed->body_count >= 0 &&
+              seed->body_count <= MAX_CELESTIAL_BODIES;
+    for (int i = 0; ok && i < seed->body_count; ++i)
+    {
+        float *fields[12];
+        replay_body_floats(&seed->bodies[i], fields);
+        for (int f = 0; ok && f < 12; ++f)
+            ok = replay_read(replay, fields[f], sizeof(float));
+    }
+    float *camera_fields[9];
+    replay_camera_floats(&seed->camera, camera_fields);
+    for (int f = 0; ok && f < 9; ++f)
+        ok = replay_read(replay, camera_fields[f], sizeof(float));
+    ok = ok && replay_read(replay, &seed->camera.pan_speed, sizeof(float)) &&
+         replay_read(replay, &seed->camera.zoom_speed, sizeof(double)) &&
+         replay_read_int(replay, &seed->collision_mode) && replay_read_int(replay, &seed->width) &&
+         replay_read_int(replay, &seed->height) && replay_read(replay, &seed->start_time, sizeof(double));
+    if (!ok)
+        printf("Failed to read replay %s: truncated seed\n", replay->path);
+    return ok;
+}
+
+// ------------------------------
+// public api
+// ------------------------------
+
+bool replay_start_recording(replay_t *replay, const char *path, const replay_seed_t *seed)
+{
+    *replay = (replay_t){.mode = REPLAY_RECORDING, .path = path};
+    replay->file = fopen(path, "wb");
+    if (!replay->file)
+    {
+        printf("Failed to open replay %s for writing\n", path);
+        replay->mode = REPLAY_OFF;
+        return false;
+    }
+    if (!replay_write_seed(replay, seed))
+        return false;
+    printf("[INFO] Recording input to %s\n", path);
+    return true;
+}
+
+bool replay_start_playback(replay_t *replay, const char *path, bool paced, replay_seed_t *seed)
+{
+    *replay = (replay_t){.mode = REPLAY_PLAYING, .path = path, .paced = paced};
+    replay->file = fopen(path, "rb");
+    if (!replay->file)
+    {
+        printf("Failed to open replay %s\n", path);
+        replay->mode = REPLAY_OFF;
+        return false;
+    }
+    if (!replay_read_seed(replay, seed))
+    {
+        fclose(replay->file);
+        replay->file = NULL;
+        replay->mode = REPLAY_OFF;
+        return false;
+    }
+    replay->next_record = fgetc(replay->file);
+    printf("[INFO] Replaying %s %s\n", path, paced ? "at the recorded pace" : "as fast as possible");
+    return true;
+}
+
+bool replay_begin_frame(replay_t *replay, double *time)
+{
+    if (replay->mode == REPLAY_RECORDING)
+    {
+        unsigned char tag = REPLAY_TAG_FRAME;
+        if (replay_write(replay, &tag, 1) && replay_write(replay, time, sizeof(double)))
+            ++replay->frame_count;
+        return true;
+    }
+    if (replay->mode != REPLAY_PLAYING)
+        return true;
+
+    // inputs of the previous frame that weren't consumed are skipped
+    replay_event_t skipped;
+    while (replay_next_event(replay, &skipped))
+        ;
+    double recorded;
+    if (replay->next_record != REPLAY_TAG_FRAME || !replay_read(replay, &recorded, sizeof(recorded)))
+        return false;
+    replay->next_record = fgetc(replay->file);
+
+    if (replay->frame_count++ == 0)
+    {
+        replay->wall_start = profiler_now();
+        replay->first_time = recorded;
+    }
+    else if (replay->paced)
+    {
+        double wait = (recorded - replay->first_time) - (profiler_now() - replay->wall_start);
+        if (wait > 0.0)
+        {
+            struct timespec ts = {(time_t)wait, (long)((wait - (double)(time_t)wait) * 1e9)};
+            nanosleep(&ts, NULL);
+        }
+    }
+    *time = recorded;
+    return true;
+}
+
+void replay_record_event(replay_t *replay, const replay_event_t *event)
+{
+    if (replay->mode != REPLAY_RECORDING)
+        return;
+
+    unsigned char tag;
+    bool ok;
+    switch (event->type)
+    {
+    case REPLAY_EVENT_MOUSE_BUTTON:
+    {
+        tag = REPLAY_TAG_MOUSE_BUTTON;
+        unsigned char fields[3] = {(unsigned char)event->a, (unsigned char)event->b, (unsigned char)event->c};
+        ok = replay_write(replay, &tag, 1) && replay_write(replay, fields, sizeof(fields)) &&
+             replay_write(replay, &event->x, sizeof(double)) && replay_write(replay, &event->y, sizeof(double));
+        break;
+    }
+    case REPLAY_EVENT_CURSOR:
+    case REPLAY_EVENT_SCROLL:
+        tag = event->type == REPLAY_EVENT_CURSOR ? REPLAY_TAG_CURSOR : REPLAY_TAG_SCROLL;
+        ok = replay_write(replay, &tag, 1) && replay_write(replay, &event->x, sizeof(double)) &&
+             replay_write(replay, &event->y, sizeof(double));
+        break;
+    case REPLAY_EVENT_KEY:
+    {
+        tag = REPLAY_TAG_KEY;
+        unsigned char fields[2] = {(unsigned char)event->c, (unsigned char)event->d};
+        ok = replay_write(replay, &tag, 1) && replay_write_int(replay, event->a) && replay_write_int(replay, event->b) &&
+             replay_write(replay, fields, sizeof(fields));
+        break;
+    }
+    case REPLAY_EVENT_RESIZE:
+        tag = REPLAY_TAG_RESIZE;
+        ok = replay_write(replay, &tag, 1) && replay_write_int(replay, event->a) && replay_write_int(replay, event->b);
+        break;
+    default:
+        return;
+    }
+    if (ok)
+        ++replay->event_count;
+}
+
+bool replay_next_event(replay_t *replay, replay_event_t *event)
+{
+    if (replay->mode != REPLAY_PLAYING || replay->next_record == EOF || replay->next_record == REPLAY_TAG_FRAME)
+        return false;
+
+    *event = (replay_event_t){0};
+    bool ok;
+    switch (replay->next_record)
+    {
+    case REPLAY_TAG_MOUSE_BUTTON:
+    {
+        unsigned char fields[3];
+        event->type = REPLAY_EVENT_MOUSE_BUTTON;
+        ok = replay_read(replay, fields, sizeof(fields)) && replay_read(replay, &event->x, sizeof(double)) &&
+             replay_read(replay, &event->y, sizeof(double));
+        event->a = fields[0];
+        event->b = fields[1];
+        event->c = fields[2];
+        break;
+    }
+    case REPLAY_TAG_CURSOR:
+    case REPLAY_TAG_SCROLL:
+        event->type = replay->next_record == REPLAY_TAG_CURSOR ? REPLAY_EVENT_CURSOR : REPLAY_EVENT_SCROLL;
+        ok = replay_read(replay, &event->x, sizeof(double)) && replay_read(replay, &event->y, sizeof(double));
+        break;
+    case REPLAY_TAG_KEY:
+    {
+        unsigned char fields[2];
+        event->type = REPLAY_EVENT_KEY;
+        ok = replay_read_int(replay, &event->a) && replay_read_int(replay, &event->b) &&
+             replay_read(replay, fields, sizeof(fields));
+        event->c = fields[0];
+        event->d = fields[1];
+        break;
+    }
+    case REPLAY_TAG_RESIZE:
+        event->type = REPLAY_EVENT_RESIZE;
+        ok = replay_read_int(replay, &event->a) && replay_read_int(replay, &event->b);
+        break;
+    default:
+        ok = false;
+        break;
+    }
+    if (!ok)
+    {
+        printf("Failed to read replay %s: corrupt record after frame %d\n", replay->path, replay->frame_count);
+        replay->next_record = EOF;
+        return false;
+    }
+    replay->next_record = fgetc(replay->file);
+    ++replay->event_count;
+    return true;
+}
+
+void replay_close(replay_t *replay)
+{
+    if (replay->mode == REPLAY_OFF)
+        return;
+    if (replay->file && fclose(replay->file) != 0 && replay->mode == REPLAY_RECORDING)
+        printf("Failed to write replay %s\n", replay->path);
+    printf("[INFO] %s %d frames and %ld input events %s %s\n", replay->mode == REPLAY_RECORDING ? "Recorded" : "Replayed",
+           replay->frame_count, replay->event_count, replay->mode == REPLAY_RECORDING ? "to" : "from", replay->path);
+    replay->file = NULL;
+    replay->mode = REPLAY_OFF;
+}
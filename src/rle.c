@@ -0,0 +1,41 @@
+/**
+run-length coding of rgb8 pixel rows for tiles and frames sent over sockets
+**/
+
+#include "rle.h"
+#include <string.h>
+
+size_t rle_encode_rgb(const unsigned char *rgb, int pixel_count, unsigned char *out)
+{
+    size_t size = 0;
+    int i = 0;
+    while (i < pixel_count)
+    {
+        const unsigned char *pixel = rgb + (size_t)i * 3;
+        int run = 1;
+        while (run < 256 && i + run < pixel_count && memcmp(pixel, pixel + (size_t)run * 3, 3) == 0)
+            ++run;
+        out[size++] = (unsigned char)(run - 1);
+        out[size++] = pixel[0];
+        out[size++] = pixel[1];
+        out[size++] = pixel[2];
+        i += run;
+    }
+    return size;
+}
+
+bool rle_decode_rgb(const unsigned char *data, size_t size, unsigned char *rgb, int pixel_count)
+{
+    if (size % 4 != 0)
+        return false;
+    int written = 0;
+    for (size_t offset = 0; offset < size; offset += 4)
+    {
+        int run = data[offset] + 1;
+        if (written + run > pixel_count)
+            return false;
+        for (int i = 0; i < run; ++i, ++written)
+            memcpy(rgb + (size_t)written * 3, data + offset + 1, 3);
+    }
+    return written == pixel_count;
+}
@@ -0,0 +1,214 @@
+/**
+on-disk cache of linked shader program binaries, keyed by source and driver
+**/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "shader_cache.h"
+#include "shaders.h"
+#include "profiler.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define SHADER_CACHE_MAGIC 0x43534842u // "BHSC"
+#define SHADER_CACHE_VERSION 1u
+
+// file layout: header followed by binary_length bytes of program binary
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t binary_format;
+    uint32_t binary_length;
+} shader_cache_header_t;
+
+static bool shader_cache_enabled = false;
+static char shader_cache_dir[1024];
+static uint64_t shader_cache_driver_hash = 0;
+
+// ------------------------------
+// helpers
+// ------------------------------
+
+// 64-bit fnv-1a, chained through the seed
+static uint64_t shader_cache_hash(uint64_t seed, const char *text)
+{
+    uint64_t hash = seed;
+    for (const unsigned char *p = (const unsigned char *)(text ? text : ""); *p; ++p)
+    {
+        hash ^= *p;
+        hash *= 0x100000001b3ull;
+    }
+    // separator, so ("ab", "c") and ("a", "bc") differ
+    hash ^= 0xff;
+    hash *= 0x100000001b3ull;
+    return hash;
+}
+
+static bool shader_cache_make_dirs(char *path)
+{
+    for (char *p = path + 1; *p; ++p)
+    {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        bool ok = mkdir(path, 0755) == 0 || errno == EEXIST;
+        *p = '/';
+        if (!ok)
+            return false;
+    }
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+static void shader_cache_entry_path(uint64_t key, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%016llx.bin", shader_cache_dir, (unsigned long long)key);
+}
+
+static GLuint shader_cache_load(uint64_t key)
+{
+    char path[1100];
+    shader_cache_entry_path(key, path, sizeof(path));
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return 0;
+
+    shader_cache_header_t header;
+    void *binary = NULL;
+    GLuint program = 0;
+    if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == SHADER_CACHE_MAGIC &&
+        header.version == SHADER_CACHE_VERSION && header.key == key && header.binary_length > 0)
+    {
+        binary = malloc(header.binary_length);
+        if (binary && fread(binary, 1, header.binary_length, file) == header.binary_length)
+        {
+            program = glCreateProgram();
+            glProgramBinary(program, header.binary_format, binary, (GLsizei)header.binary_length);
+
+            // drivers reject binaries after updates even when the version string did not change
+            GLint success = GL_FALSE;
+            glGetProgramiv(program, GL_LINK_STATUS, &success);
+            if (!success)
+            {
+                glDeleteProgram(program);
+                program = 0;
+            }
+        }
+    }
+
+    free(binary);
+    fclose(file);
+    return program;
+}
+
+static void shader_cache_store(uint64_t key, GLuint program)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    void *binary = malloc(length);
+    if (!binary)
+        return;
+
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary);
+
+    char path[1100], temp_path[1110];
+    shader_cache_entry_path(key, path, sizeof(path));
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    // write to a temporary name and rename, so a concurrent launch never reads half a file
+    FILE *file = fopen(temp_path, "wb");
+    if (file)
+    {
+        shader_cache_header_t header = {SHADER_CACHE_MAGIC, SHADER_CACHE_VERSION, key, format, (uint32_t)written};
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary, 1, written, file) == (size_t)written;
+        ok = fclose(file) == 0 && ok;
+        if (!ok || rename(temp_path, path) != 0)
+        {
+            remove(temp_path);
+        }
+    }
+    free(binary);
+}
+
+// ------------------------------
+// public api
+// ------------------------------
+
+void shader_cache_init(void)
+{
+    shader_cache_enabled = false;
+
+#ifndef __APPLE__
+    if (!GLEW_ARB_get_program_binary)
+    {
+        printf("[INFO] Shader cache disabled: GL_ARB_get_program_binary not supported\n");
+        return;
+    }
+#endif
+    GLint format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    if (format_count <= 0)
+    {
+        printf("[INFO] Shader cache disabled: driver exposes no program binary formats\n");
+        return;
+    }
+
+    const char *override_dir = getenv("BLACKHOLE_SHADER_CACHE_DIR");
+    const char *xdg_cache = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (override_dir && *override_dir)
+        snprintf(shader_cache_dir, sizeof(shader_cache_dir), "%s", override_dir);
+    else if (xdg_cache && *xdg_cache)
+        snprintf(shader_cache_dir, sizeof(shader_cache_dir), "%s/blackhole-simulator", xdg_cache);
+    else if (home && *home)
+        snprintf(shader_cache_dir, sizeof(shader_cache_dir), "%s/.cache/blackhole-simulator", home);
+    else
+        return;
+
+    if (!shader_cache_make_dirs(shader_cache_dir))
+    {
+        printf("[INFO] Shader cache disabled: cannot create %s\n", shader_cache_dir);
+        return;
+    }
+
+    // any change of driver, gpu or gl version produces different keys
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = shader_cache_hash(hash, (const char *)glGetString(GL_VENDOR));
+    hash = shader_cache_hash(hash, (const char *)glGetString(GL_RENDERER));
+    hash = shader_cache_hash(hash, (const char *)glGetString(GL_VERSION));
+    hash = shader_cache_hash(hash, (const char *)glGetString(GL_SHADING_LANGUAGE_VERSION));
+    shader_cache_driver_hash = hash;
+    shader_cache_enabled = true;
+}
+
+GLuint shader_cache_create_program(const char *vertex_source, const char *fragment_source)
+{
+    if (!shader_cache_enabled)
+        return utility_create_shader_program(vertex_source, fragment_source);
+
+    double start = profiler_now();
+    uint64_t key = shader_cache_hash(shader_cache_hash(shader_cache_driver_hash, vertex_source), fragment_source);
+
+    GLuint program = shader_cache_load(key);
+    bool hit = program != 0;
+    if (!hit)
+    {
+        program = utility_create_retrievable_shader_program(vertex_source, fragment_source);
+        if (program)
+            shader_cache_store(key, program);
+    }
+
+    printf("[INFO] Shader program %016llx: %s in %.1f ms\n", (unsigned long long)key,
+           hit ? "loaded from cache" : "compiled", (profiler_now() - start) * 1000.0);
+    return program;
+}
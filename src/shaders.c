@@ -4,7 +4,11 @@
  */
 
 #include "shaders.h"
+#include "culling.h"
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 GLuint utility_compile_shader(const char *source, GLenum type)
 {
@@ -24,7 +28,7 @@ GLuint utility_compile_shader(const char *source, GLenum type)
     return shader;
 }
 
-GLuint utility_create_shader_program(const char *vertex_source, const char *fragment_source)
+static GLuint utility_link_shader_program(const char *vertex_source, const char *fragment_source, bool retrievable)
 {
     GLuint vertex_shader = utility_compile_shader(vertex_source, GL_VERTEX_SHADER);
     GLuint fragment_shader = utility_compile_shader(fragment_source, GL_FRAGMENT_SHADER);
@@ -34,6 +38,10 @@ GLuint utility_create_shader_program(const char *vertex_source, const char *frag
     GLuint program = glCreateProgram();
     glAttachShader(program, vertex_shader);
     glAttachShader(program, fragment_shader);
+    if (retrievable)
+    {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(program);
 
     GLint success;
@@ -51,8 +59,87 @@ GLuint utility_create_shader_program(const char *vertex_source, const char *frag
     return program;
 }
 
+GLuint utility_create_shader_program(const char *vertex_source, const char *fragment_source)
+{
+    return utility_link_shader_program(vertex_source, fragment_source, false);
+}
+
+GLuint utility_create_retrievable_shader_program(const char *vertex_source, const char *fragment_source)
+{
+    return utility_link_shader_program(vertex_source, fragment_source, true);
+}
+
+char *utility_build_raytracer_source(const raytracer_permutation_t *permutation)
+{
+    char header[512];
+    int header_length = snprintf(header, sizeof(header),
+                                 "#version 330 core\n"
+                                 "#define NUM_OBJECTS %d\n"
+                                 "#define MAX_STEPS %d\n"
+                                 "#define STEP_SIZE %.9e\n"
+                                 "#define INTEGRATOR %d\n"
+                                 "#define ENABLE_DISK %d\n"
+                                 "#define ENABLE_BODIES %d\n"
+                                 "#define ENABLE_STARFIELD %d\n"
+                                 "#define ENABLE_STATS %d\n"
+                                 "#define BODY_TILE_SIZE %d\n",
+                                 permutation->num_objects, permutation->max_steps, permutation->step_size,
+                                 permutation->integrator, permutation->enable_disk ? 1 : 0,
+                                 permutation->enable_bodies ? 1 : 0, permutation->enable_starfield ? 1 : 0,
+                                 permutation->enable_stats ? 1 : 0, CULLING_TILE_SIZE);
+
+    size_t body_length = strlen(raytracer_fragment_shader_source);
+    char *source = malloc(header_length + body_length + 1);
+    if (!source)
+        return NULL;
+    memcpy(source, header, header_length);
+    memcpy(source + header_length, raytracer_fragment_shader_source, body_length + 1);
+    return source;
+}
+
 // shader sources
 
+// scene data shared by the trace and reconstruction passes, filled once per frame
+// from scene_uniform_block_t (renderer.h)
+#define SCENE_DATA_BLOCK \
+    "layout(std140) uniform SceneData {\n" \
+    "    vec3 camPos;          float tanHalfFov;\n" \
+    "    vec3 camRight;        float aspect;\n" \
+    "    vec3 camUp;           float disk_r1;\n" \
+    "    vec3 camForward;      float disk_r2;\n" \
+    "    vec3 prevCamPos;      float focusDistance;\n" \
+    "    vec3 prevCamRight;    float historyValid;\n" \
+    "    vec3 prevCamUp;       float upscaleHistoryValid;\n" \
+    "    vec3 prevCamForward;  float sceneReserved;\n" \
+    "    vec2 resolution;      // full trace resolution\n" \
+    "    float time;\n" \
+    "    int interleaveCheckerboard;\n" \
+    "    ivec2 interleaveScale; // full pixels per traced pixel\n" \
+    "    ivec2 interleaveOffset;\n" \
+    "    vec2 jitter;          // sub-pixel offset of this frame's primary rays, in trace pixels\n" \
+    "    vec2 outputResolution; // window (upscaled) resolution\n" \
+    "    ivec2 regionOrigin;   // first full-resolution pixel of the trace target (poster tiles)\n" \
+    "    ivec2 regionReserved;\n" \
+    "    vec4 objPosRadius[16];\n" \
+    "    vec4 objColor[16];\n" \
+    "};\n" \
+    "\n"
+
+// primary ray through a trace pixel centre (same convention as gl_FragCoord)
+#define PIXEL_RAY_FUNCTION \
+    "vec3 pixelRay(vec2 pix, vec3 right, vec3 up, vec3 forward) {\n" \
+    "    float u = (2.0 * (pix.x + 0.5) / resolution.x - 1.0) * aspect * tanHalfFov;\n" \
+    "    float v = (1.0 - 2.0 * (pix.y + 0.5) / resolution.y) * tanHalfFov;\n" \
+    "    return normalize(u * right - v * up + forward);\n" \
+    "}\n" \
+    "\n" \
+    "// full-resolution pixel traced by a fragment of the (possibly sparse) trace target\n" \
+    "ivec2 interleavedPixel(ivec2 p) {\n" \
+    "    if (interleaveCheckerboard != 0) return ivec2(p.x * 2 + ((p.y + interleaveOffset.x) & 1), p.y) + regionOrigin;\n" \
+    "    return p * interleaveScale + interleaveOffset + regionOrigin;\n" \
+    "}\n" \
+    "\n"
+
 const char *quad_vertex_shader_source =
     "#version 330 core\n"
     "layout (location = 0) in vec2 aPos;\n"
@@ -68,8 +155,28 @@ const char *quad_fragment_shader_source =
     "in vec2 TexCoord;\n"
     "out vec4 FragColor;\n"
     "uniform sampler2D screenTexture;\n"
+    "uniform vec2 uvScale; // used part of a size-class allocated render target\n"
     "void main() {\n"
-    "    FragColor = texture(screenTexture, TexCoord);\n"
+    "    vec2 uv = min(TexCoord * uvScale, uvScale - 0.5 / vec2(textureSize(screenTexture, 0)));\n"
+    "    FragColor = texture(screenTexture, uv);\n"
+    "}\n";
+
+// false-colour view of the ray tracer's step counts (log scale, blue to red); rays
+// that ran out of budget are magenta
+const char *heatmap_fragment_shader_source =
+    "#version 330 core\n"
+    "in vec2 TexCoord;\n"
+    "out vec4 FragColor;\n"
+    "uniform usampler2D rayStats;\n"
+    "uniform vec2 statsSize; // used area of the stats target\n"
+    "uniform float maxSteps;\n"
+    "void main() {\n"
+    "    ivec2 texel = min(ivec2(TexCoord * statsSize), ivec2(statsSize) - 1);\n"
+    "    uvec2 stats = texelFetch(rayStats, texel, 0).xy;\n"
+    "    if (stats.y == 4u) { FragColor = vec4(1.0, 0.0, 1.0, 0.85); return; }\n"
+    "    float t = log2(1.0 + float(stats.x)) / log2(1.0 + maxSteps);\n"
+    "    vec3 ramp = clamp(vec3(1.5 - abs(4.0 * t - 3.0), 1.5 - abs(4.0 * t - 2.0), 1.5 - abs(4.0 * t - 1.0)), 0.0, 1.0);\n"
+    "    FragColor = vec4(ramp, 0.85);\n"
     "}\n";
 
 const char *grid_vertex_shader_source =
@@ -87,59 +194,87 @@ const char *grid_fragment_shader_source =
     "    FragColor = vec4(0.5, 0.5, 0.5, 1.0);\n"
     "}\n";
 
+// the ray tracer is compiled per permutation: utility_build_raytracer_source prepends
+// the #version line and the #defines below, so this string starts after them.
 const char *raytracer_fragment_shader_source =
-    "#version 330 core\n"
-    "in vec2 TexCoord;\n"
-    "out vec4 FragColor;\n"
+    "#ifndef NUM_OBJECTS\n"
+    "#define NUM_OBJECTS 3\n"
+    "#endif\n"
+    "#ifndef MAX_STEPS\n"
+    "#define MAX_STEPS 26000\n"
+    "#endif\n"
+    "#ifndef STEP_SIZE\n"
+    "#define STEP_SIZE 5e7\n"
+    "#endif\n"
+    "#define INTEGRATOR_SPHERICAL_EULER 0\n"
+    "#define INTEGRATOR_CARTESIAN 1\n"
+    "#ifndef INTEGRATOR\n"
+    "#define INTEGRATOR INTEGRATOR_SPHERICAL_EULER\n"
+    "#endif\n"
+    "#ifndef ENABLE_DISK\n"
+    "#define ENABLE_DISK 1\n"
+    "#endif\n"
+    "#ifndef ENABLE_BODIES\n"
+    "#define ENABLE_BODIES 1\n"
+    "#endif\n"
+    "#ifndef ENABLE_STARFIELD\n"
+    "#define ENABLE_STARFIELD 1\n"
+    "#endif\n"
+    "#ifndef ENABLE_STATS\n"
+    "#define ENABLE_STATS 0\n"
+    "#endif\n"
     "\n"
-    "// Uniforms\n"
-    "uniform vec3 camPos;\n"
-    "uniform vec3 camRight;\n"
-    "uniform vec3 camUp;\n"
-    "uniform vec3 camForward;\n"
-    "uniform float tanHalfFov;\n"
-    "uniform float aspect;\n"
-    "uniform bool moving;\n"
-    "uniform float disk_r1;\n"
-    "uniform float disk_r2;\n"
-    "uniform int numObjects;\n"
-    "uniform vec4 objPosRadius[16];\n"
-    "uniform vec4 objColor[16];\n"
-    "uniform float objMass[16];\n"
-    "uniform vec2 resolution;\n"
-    "uniform float time;\n"
+    "in vec2 TexCoord;\n"
+    "layout(location = 0) out vec4 FragColor;\n"
+    "#if ENABLE_STATS\n"
+    "// steps taken and termination reason, in the order of ray_stats_reason_t\n"
+    "layout(location = 1) out uvec2 RayStats;\n"
+    "const uint REASON_HORIZON = 0u, REASON_DISK = 1u, REASON_BODY = 2u, REASON_ESCAPE = 3u, REASON_BUDGET = 4u;\n"
+    "#endif\n"
     "\n"
+    SCENE_DATA_BLOCK
+    PIXEL_RAY_FUNCTION
     "const float blackhole = 1.269e10;\n"
-    "float D_LAMBDA = 5e7;\n"
+    "const float D_LAMBDA = STEP_SIZE;\n"
     "const float ESCAPE_R = 1e30;\n"
     "\n"
     "struct Ray {\n"
     "    float x, y, z, r, theta, phi;\n"
     "    float dr, dtheta, dphi;\n"
     "    float E, L;\n"
+    "#if INTEGRATOR == INTEGRATOR_CARTESIAN\n"
+    "    vec3 vel;  // cartesian direction of travel\n"
+    "    float h2;  // |pos x vel|^2, conserved\n"
+    "#endif\n"
     "};\n"
     "\n"
     "// Global hit variables\n"
     "vec4 hitObjectColor;\n"
     "vec3 hitCenter;\n"
     "float hitRadius;\n"
-    "float random(vec3 p) {\n"
-    "    return fract(sin(dot(p, vec3(12.9898, 78.233, 151.7182))) * 43758.5453);\n"
-    "}\n"
+    "\n"
+    "#if ENABLE_STARFIELD\n"
+    "uniform samplerCube starfield; // baked sky (starfield.c)\n"
+    "\n"
+    "// one filtered lookup in the escape direction. the mip level follows the angular size of\n"
+    "// a trace pixel; explicit lod because the branch is not uniform across a quad.\n"
     "vec4 getStarColor(vec3 dir) {\n"
-    "    float star_density = 0.9995;\n"
-    "    float r = random(dir);\n"
-    "    if (r > star_density) {\n"
-    "        float star_brightness = (r - star_density) / (1.0 - star_density);\n"
-    "        return vec4(vec3(star_brightness), 1.0);\n"
-    "    }\n"
-    "    return vec4(0.0);\n"
+    "    float pixelAngle = 2.0 * tanHalfFov / resolution.y;\n"
+    "    float texelAngle = 1.5707963 / float(textureSize(starfield, 0).x);\n"
+    "    return textureLod(starfield, dir, max(log2(pixelAngle / texelAngle), 0.0));\n"
     "}\n"
+    "#endif\n"
     "\n"
     "Ray initRay(vec3 pos, vec3 dir) {\n"
     "    Ray ray;\n"
     "    ray.x = pos.x; ray.y = pos.y; ray.z = pos.z;\n"
     "    ray.r = length(pos);\n"
+    "#if INTEGRATOR == INTEGRATOR_CARTESIAN\n"
+    "    vec3 h = cross(pos, dir);\n"
+    "    ray.vel = dir;\n"
+    "    ray.h2 = dot(h, h);\n"
+    "    return ray;\n"
+    "#else\n"
     "    ray.theta = acos(pos.z / ray.r);\n"
     "    ray.phi = atan(pos.y, pos.x);\n"
     "\n"
@@ -150,19 +285,38 @@ const char *raytracer_fragment_shader_source =
     "\n"
     "    ray.L = ray.r * ray.r * sin(ray.theta) * ray.dphi;\n"
     "    float f = 1.0 - blackhole / ray.r;\n"
-    "    float dt_dL = sqrt((ray.dr*ray.dr)/f + ray.r*ray.r*(ray.dtheta*ray.dtheta + sin(ray.theta)*sin(ray.theta)*ray.dphi*ray.dphi));\n"
+    "    // null condition: f dt^2 = dr^2/f + r^2 dOmega^2\n"
+    "    float dt_dL = sqrt(((ray.dr*ray.dr)/f + ray.r*ray.r*(ray.dtheta*ray.dtheta + sin(ray.theta)*sin(ray.theta)*ray.dphi*ray.dphi)) / f);\n"
     "    ray.E = f * dt_dL;\n"
     "\n"
     "    return ray;\n"
+    "#endif\n"
+    "}\n"
+    "\n"
+    "// cartesian direction of travel, for rays that leave the scene\n"
+    "vec3 escapeDirection(Ray ray) {\n"
+    "#if INTEGRATOR == INTEGRATOR_CARTESIAN\n"
+    "    return normalize(ray.vel);\n"
+    "#else\n"
+    "    float st = sin(ray.theta), ct = cos(ray.theta), sp = sin(ray.phi), cp = cos(ray.phi);\n"
+    "    vec3 radial = vec3(st * cp, st * sp, ct);\n"
+    "    vec3 polar = vec3(ct * cp, ct * sp, -st);\n"
+    "    vec3 azimuthal = vec3(-sp, cp, 0.0);\n"
+    "    return normalize(ray.dr * radial + ray.r * ray.dtheta * polar + ray.r * st * ray.dphi * azimuthal);\n"
+    "#endif\n"
     "}\n"
     "\n"
     "bool intercept(Ray ray, float rs) {\n"
     "    return ray.r <= rs;\n"
     "}\n"
     "\n"
-    "bool interceptObject(Ray ray) {\n"
+    "#if ENABLE_BODIES\n"
+    "uniform usampler2D bodyTiles; // bit i: body i can be seen in the tile (culling.c)\n"
+    "\n"
+    "bool interceptObject(Ray ray, uint candidates) {\n"
     "    vec3 P = vec3(ray.x, ray.y, ray.z);\n"
-    "    for (int i = 0; i < numObjects; ++i) {\n"
+    "    for (int i = 0; i < NUM_OBJECTS; ++i) {\n"
+    "        if ((candidates & (1u << uint(i))) == 0u) continue;\n"
     "        vec3 center = objPosRadius[i].xyz;\n"
     "        float radius = objPosRadius[i].w;\n"
     "        if (distance(P, center) <= radius) {\n"
@@ -174,6 +328,7 @@ const char *raytracer_fragment_shader_source =
     "    }\n"
     "    return false;\n"
     "}\n"
+    "#endif\n"
     "\n"
     "void geodesicRHS(Ray ray, out vec3 d1, out vec3 d2) {\n"
     "    float r = ray.r, theta = ray.theta;\n"
@@ -184,7 +339,7 @@ const char *raytracer_fragment_shader_source =
     "    d1 = vec3(dr, dtheta, dphi);\n"
     "    d2.x = -(blackhole / (2.0 * r*r)) * f * dt_dL * dt_dL\n"
     "         + (blackhole / (2.0 * r*r * f)) * dr * dr\n"
-    "         + r * (dtheta*dtheta + sin(theta)*sin(theta)*dphi*dphi);\n"
+    "         + r * f * (dtheta*dtheta + sin(theta)*sin(theta)*dphi*dphi);\n"
     "    d2.y = -2.0*dr*dtheta/r + sin(theta)*cos(theta)*dphi*dphi;\n"
     "    d2.z = -2.0*dr*dphi/r - 2.0*cos(theta)/(sin(theta)) * dtheta * dphi;\n"
     "}\n"
@@ -205,6 +360,29 @@ const char *raytracer_fragment_shader_source =
     "    ray.z = ray.r * cos(ray.theta);\n"
     "}\n"
     "\n"
+    "#if INTEGRATOR == INTEGRATOR_CARTESIAN\n"
+    "// photon orbit in cartesian form: a = -1.5 rs h^2 pos / r^5, semi-implicit euler.\n"
+    "// no trigonometry and no pole singularity; the factoring keeps r^5 out of float range.\n"
+    "void cartesianStep(inout Ray ray, float dL) {\n"
+    "    vec3 p = vec3(ray.x, ray.y, ray.z);\n"
+    "    float r2 = dot(p, p);\n"
+    "    float invR = inversesqrt(r2);\n"
+    "    float k = -1.5 * blackhole * (ray.h2 / r2) * invR * invR * invR;\n"
+    "    ray.vel += p * (k * dL);\n"
+    "    p += ray.vel * dL;\n"
+    "    ray.x = p.x; ray.y = p.y; ray.z = p.z;\n"
+    "    ray.r = length(p);\n"
+    "}\n"
+    "#endif\n"
+    "\n"
+    "void integrateStep(inout Ray ray, float dL) {\n"
+    "#if INTEGRATOR == INTEGRATOR_CARTESIAN\n"
+    "    cartesianStep(ray, dL);\n"
+    "#else\n"
+    "    eulerStep(ray, dL);\n"
+    "#endif\n"
+    "}\n"
+    "\n"
     "bool crossesEquatorialPlane(vec3 oldPos, vec3 newPos) {\n"
     "    bool crossed = (oldPos.y * newPos.y < 0.0);\n"
     "    float r = length(vec2(newPos.x, newPos.z));\n"
@@ -212,11 +390,9 @@ const char *raytracer_fragment_shader_source =
     "}\n"
     "\n"
     "void main() {\n"
-    "    vec2 pix = gl_FragCoord.xy;\n"
-    "\n"
-    "    float u = (2.0 * (pix.x + 0.5) / resolution.x - 1.0) * aspect * tanHalfFov;\n"
-    "    float v = (1.0 - 2.0 * (pix.y + 0.5) / resolution.y) * tanHalfFov;\n"
-    "    vec3 dir = normalize(u * camRight - v * camUp + camForward);\n"
+    "    ivec2 pixel = interleavedPixel(ivec2(gl_FragCoord.xy));\n"
+    "    vec2 pix = vec2(pixel) + 0.5 + jitter;\n"
+    "    vec3 dir = pixelRay(pix, camRight, camUp, camForward);\n"
     "    Ray ray = initRay(camPos, dir);\n"
     "\n"
     "    vec4 color = vec4(0.0);\n"
@@ -225,20 +401,42 @@ const char *raytracer_fragment_shader_source =
     "    bool hitBlackHole = false;\n"
     "    bool hitDisk = false;\n"
     "    bool hitObject = false;\n"
+    "#if ENABLE_BODIES\n"
+    "    // most tiles can never see most bodies; empty tiles skip the test entirely\n"
+    "    uint bodyCandidates = texelFetch(bodyTiles, (pixel - regionOrigin) / BODY_TILE_SIZE, 0).r;\n"
+    "#endif\n"
+    "#if ENABLE_STATS\n"
+    "    uint stepsTaken = 0u;\n"
+    "    bool escaped = false;\n"
+    "#endif\n"
     "\n"
-    "    int steps = moving ? 25000 : 26000;\n"
-    "\n"
-    "    for (int i = 0; i < steps; ++i) {\n"
+    "    for (int i = 0; i < MAX_STEPS; ++i) {\n"
     "        if (intercept(ray, blackhole)) { hitBlackHole = true; break; }\n"
     "        float step_scale = clamp(ray.r / (blackhole * 20.0), 0.1, 5.0);\n"
     "        float dynamic_step = D_LAMBDA * step_scale;\n"
-        "        eulerStep(ray, dynamic_step);\n"
+    "        integrateStep(ray, dynamic_step);\n"
+    "#if ENABLE_STATS\n"
+    "        stepsTaken++;\n"
+    "#endif\n"
     "        vec3 newPos = vec3(ray.x, ray.y, ray.z);\n"
+    "#if ENABLE_DISK\n"
     "        if (crossesEquatorialPlane(prevPos, newPos)) { hitDisk = true; break; }\n"
-    "        if (interceptObject(ray)) { hitObject = true; break; }\n"
+    "#endif\n"
+    "#if ENABLE_BODIES\n"
+    "        if (bodyCandidates != 0u && interceptObject(ray, bodyCandidates)) { hitObject = true; break; }\n"
+    "#endif\n"
     "        prevPos = newPos;\n"
+    "#if ENABLE_STATS\n"
+    "        if (ray.r > ESCAPE_R) { escaped = true; break; }\n"
+    "#else\n"
     "        if (ray.r > ESCAPE_R) break;\n"
+    "#endif\n"
     "    }\n"
+    "#if ENABLE_STATS\n"
+    "    uint reason = hitBlackHole ? REASON_HORIZON : hitDisk ? REASON_DISK : hitObject ? REASON_BODY\n"
+    "                : escaped ? REASON_ESCAPE : REASON_BUDGET;\n"
+    "    RayStats = uvec2(stepsTaken, reason);\n"
+    "#endif\n"
     "    if (hitDisk) {\n"
     "        vec3 hitPos = vec3(ray.x, ray.y, ray.z);\n"
     "        float r_norm = (length(hitPos) - disk_r1) / (disk_r2 - disk_r1);\n"
@@ -273,9 +471,133 @@ const char *raytracer_fragment_shader_source =
     "\n"
     "        color = vec4(shaded + specular, hitObjectColor.a);\n"
     "    } else {\n"
-    "        color = getStarColor(dir);\n"
+    "#if ENABLE_STARFIELD\n"
+    "        color = getStarColor(escapeDirection(ray));\n"
+    "#endif\n"
     "    }\n"
     "\n"
     "    FragColor = color;\n"
     "}\n";
 
+
+// fills the pixels the interleaved trace skipped this frame. traced pixels are copied;
+// the others reproject the previous reconstruction through the focus plane and clamp it
+// to the neighbouring fresh samples, falling back to their average when history is
+// off-screen, invalid or far outside that range (moving bodies, disocclusion).
+const char *reconstruct_fragment_shader_source =
+    "#version 330 core\n"
+    "out vec4 FragColor;\n"
+    "uniform sampler2D currentSamples; // sparse trace target\n"
+    "uniform sampler2D history;        // previous reconstruction, full trace resolution\n"
+    SCENE_DATA_BLOCK
+    PIXEL_RAY_FUNCTION
+    "bool isTraced(ivec2 q) {\n"
+    "    if (interleaveCheckerboard != 0) return ((q.x + q.y + interleaveOffset.x) & 1) == 0;\n"
+    "    ivec2 d = q - interleaveOffset;\n"
+    "    return d.x % interleaveScale.x == 0 && d.y % interleaveScale.y == 0 && d.x >= 0 && d.y >= 0;\n"
+    "}\n"
+    "\n"
+    "ivec2 sparseCoord(ivec2 q) {\n"
+    "    if (interleaveCheckerboard != 0) return ivec2(q.x >> 1, q.y);\n"
+    "    return (q - interleaveOffset) / interleaveScale;\n"
+    "}\n"
+    "\n"
+    "vec4 fetchSparse(ivec2 s) {\n"
+    "    ivec2 sparseSize = (ivec2(resolution) + interleaveScale - 1) / interleaveScale;\n"
+    "    return texelFetch(currentSamples, clamp(s, ivec2(0), sparseSize - 1), 0);\n"
+    "}\n"
+    "\n"
+    "void main() {\n"
+    "    ivec2 p = ivec2(gl_FragCoord.xy);\n"
+    "    if (isTraced(p)) { FragColor = fetchSparse(sparseCoord(p)); return; }\n"
+    "\n"
+    "    // the nearest fresh samples: 4-neighbours for checkerboard, the enclosing 2x2 block otherwise\n"
+    "    vec4 n[4];\n"
+    "    if (interleaveCheckerboard != 0) {\n"
+    "        n[0] = fetchSparse(sparseCoord(p + ivec2(-1, 0)));\n"
+    "        n[1] = fetchSparse(sparseCoord(p + ivec2(1, 0)));\n"
+    "        n[2] = fetchSparse(sparseCoord(p + ivec2(0, -1)));\n"
+    "        n[3] = fetchSparse(sparseCoord(p + ivec2(0, 1)));\n"
+    "    } else {\n"
+    "        ivec2 base = ivec2(floor(vec2(p - interleaveOffset) / vec2(interleaveScale)));\n"
+    "        n[0] = fetchSparse(base);\n"
+    "        n[1] = fetchSparse(base + ivec2(1, 0));\n"
+    "        n[2] = fetchSparse(base + ivec2(0, 1));\n"
+    "        n[3] = fetchSparse(base + ivec2(1, 1));\n"
+    "    }\n"
+    "    vec4 spatial = 0.25 * (n[0] + n[1] + n[2] + n[3]);\n"
+    "    vec4 lo = min(min(n[0], n[1]), min(n[2], n[3]));\n"
+    "    vec4 hi = max(max(n[0], n[1]), max(n[2], n[3]));\n"
+    "\n"
+    "    if (historyValid < 0.5) { FragColor = spatial; return; }\n"
+    "\n"
+    "    // reproject through the plane at the focus distance into the previous camera\n"
+    "    vec3 dir = pixelRay(vec2(p) + 0.5, camRight, camUp, camForward);\n"
+    "    vec3 world = camPos + dir * (focusDistance / max(dot(dir, camForward), 1e-3));\n"
+    "    vec3 rel = world - prevCamPos;\n"
+    "    float z = dot(rel, prevCamForward);\n"
+    "    float u = dot(rel, prevCamRight) / z;\n"
+    "    float v = -dot(rel, prevCamUp) / z;\n"
+    "    vec2 prevPixel = vec2((u / (aspect * tanHalfFov) + 1.0) * 0.5 * resolution.x,\n"
+    "                          (1.0 - v / tanHalfFov) * 0.5 * resolution.y) - 0.5;\n"
+    "    if (z <= 0.0 || any(lessThan(prevPixel, vec2(0.5))) || any(greaterThan(prevPixel, resolution - 0.5))) {\n"
+    "        FragColor = spatial; return;\n"
+    "    }\n"
+    "\n"
+    "    vec4 previous = texture(history, prevPixel / vec2(textureSize(history, 0)));\n"
+    "    vec4 clamped = clamp(previous, lo, hi);\n"
+    "    FragColor = distance(previous, clamped) > 0.25 ? spatial : clamped;\n"
+    "}\n";
+
+// temporal upscaling from the trace resolution to the window. each output pixel
+// gathers the jittered trace samples around it with a gaussian weight, reprojects
+// the previous output through the focus plane, clamps it to the local sample range
+// and blends; samples that land close to the pixel centre get a larger weight, so
+// detail converges over the jitter sequence.
+const char *upscale_fragment_shader_source =
+    "#version 330 core\n"
+    "out vec4 FragColor;\n"
+    "uniform sampler2D currentSamples; // trace result at full trace resolution\n"
+    "uniform sampler2D history;        // previous upscaled frame\n"
+    SCENE_DATA_BLOCK
+    PIXEL_RAY_FUNCTION
+    "void main() {\n"
+    "    // output pixel centre in trace pixels; trace texel i was shot through i + 1 + jitter\n"
+    "    vec2 c = gl_FragCoord.xy / outputResolution * resolution;\n"
+    "    ivec2 nearest = ivec2(floor(c - 0.5 - jitter));\n"
+    "\n"
+    "    vec4 sum = vec4(0.0), lo = vec4(1e9), hi = vec4(-1e9);\n"
+    "    float weightSum = 0.0, nearestWeight = 0.0;\n"
+    "    for (int dy = -1; dy <= 1; ++dy) {\n"
+    "        for (int dx = -1; dx <= 1; ++dx) {\n"
+    "            ivec2 i = clamp(nearest + ivec2(dx, dy), ivec2(0), ivec2(resolution) - 1);\n"
+    "            vec4 s = texelFetch(currentSamples, i, 0);\n"
+    "            vec2 d = vec2(i) + 1.0 + jitter - c;\n"
+    "            float w = exp(-2.0 * dot(d, d)); // sigma = half a trace pixel\n"
+    "            sum += s * w;\n"
+    "            weightSum += w;\n"
+    "            lo = min(lo, s);\n"
+    "            hi = max(hi, s);\n"
+    "            nearestWeight = max(nearestWeight, w);\n"
+    "        }\n"
+    "    }\n"
+    "    vec4 current = sum / max(weightSum, 1e-4);\n"
+    "    if (upscaleHistoryValid < 0.5) { FragColor = current; return; }\n"
+    "\n"
+    "    vec3 dir = pixelRay(c - 0.5, camRight, camUp, camForward);\n"
+    "    vec3 world = camPos + dir * (focusDistance / max(dot(dir, camForward), 1e-3));\n"
+    "    vec3 rel = world - prevCamPos;\n"
+    "    float z = dot(rel, prevCamForward);\n"
+    "    float u = dot(rel, prevCamRight) / z;\n"
+    "    float v = -dot(rel, prevCamUp) / z;\n"
+    "    vec2 prevUv = vec2(u / (aspect * tanHalfFov) + 1.0, 1.0 - v / tanHalfFov) * 0.5;\n"
+    "    if (z <= 0.0 || any(lessThan(prevUv, vec2(0.0))) || any(greaterThan(prevUv, vec2(1.0)))) {\n"
+    "        FragColor = current; return;\n"
+    "    }\n"
+    "\n"
+    "    vec4 previous = texture(history, prevUv * outputResolution / vec2(textureSize(history, 0)));\n"
+    "    vec4 clamped = clamp(previous, lo, hi);\n"
+    "    // a large clamp means the history no longer matches (moving bodies); trust the new samples\n"
+    "    float alpha = max(mix(0.05, 0.3, nearestWeight), clamp(4.0 * distance(previous, clamped), 0.0, 1.0));\n"
+    "    FragColor = mix(clamped, current, alpha);\n"
+    "}\n";
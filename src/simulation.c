@@ -0,0 +1,89 @@
+/**
+the n-body step, free of locks, threads and gl so it can also run outside the app
+**/
+
+#include "simulation.h"
+#include <math.h>
+
+// physical constants
+const double SPEED_OF_LIGHT = 299792458.0;
+const double GRAVITATIONAL_CONSTANT = 6.67430e-11;
+
+const celestial_body_t simulation_initial_bodies[SIMULATION_INITIAL_BODY_COUNT] = {
+    {{2.3e11f, 0.0f, 0.0f, 4e10f},   // position and radius
+     {0.4, 0.7, 1.0, 1.0},           // color (blue star)
+     1.98892e30f,                    // mass (solar mass)
+     {0.0f, 0.0f, 5.34e7}},          // initial velocity
+    {{-1.6e11f, 0.0f, 0.0f, 4e10f},  // position and radius
+     {0.8, 0.3, 0.2, 1.0},           // color (red star)
+     1.98892e30f,                    // mass (solar mass)
+     {0.0f, 0.0f, -5.34e7}},         // initial velocity
+    {{0.0f, 0.0f, 0.0f, SIMULATION_SCHWARZSCHILD_RADIUS}, // position and radius
+     {0, 0, 0, 1},                   // color (black hole)
+     8.54e36f,                       // mass (supermassive)
+     {0, 0, 0}}                      // initial velocity
+};
+
+void simulation_step_buffered(const celestial_body_t *in_bodies, celestial_body_t *out_bodies, int count,
+                              double delta_time, collision_mode_t mode, collision_broadphase_t *broadphase)
+{
+    // copy input to output to ensure we keep unmodified fields if needed
+    for (int k = 0; k < count; ++k)
+    {
+        out_bodies[k] = in_bodies[k];
+    }
+
+    // n-body simulation using newton's law of universal gravitation.
+    for (int i = 0; i < count; ++i)
+    {
+        if (in_bodies[i].mass <= 0.0f)
+            continue; // absorbed by a merge
+
+        double vx = in_bodies[i].velocity.x;
+        double vy = in_bodies[i].velocity.y;
+        double vz = in_bodies[i].velocity.z;
+
+        for (int j = 0; j < count; ++j)
+        {
+            if (i == j || in_bodies[j].mass <= 0.0f)
+                continue;
+
+            float dx = in_bodies[j].position_and_radius.x - in_bodies[i].position_and_radius.x;
+            float dy = in_bodies[j].position_and_radius.y - in_bodies[i].position_and_radius.y;
+            float dz = in_bodies[j].position_and_radius.z - in_bodies[i].position_and_radius.z;
+            float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+            if (distance <= 0.0f)
+                continue;
+
+            // contacts are the broadphase's job; overlapping spheres only cap the force at its
+            // value at touching distance so it stays finite. without collisions they pass
+            // through each other with no force, as the app always did
+            double contact = in_bodies[i].position_and_radius.w + in_bodies[j].position_and_radius.w;
+            if (distance <= contact && mode == COLLISION_OFF)
+                continue;
+            double separation = distance > contact ? distance : contact;
+            vector3_t direction = {dx / distance, dy / distance, dz / distance};
+            double acceleration = GRAVITATIONAL_CONSTANT * in_bodies[j].mass / (separation * separation);
+            vx += direction.x * acceleration * delta_time;
+            vy += direction.y * acceleration * delta_time;
+            vz += direction.z * acceleration * delta_time;
+        }
+
+        out_bodies[i].velocity.x = (float)vx;
+        out_bodies[i].velocity.y = (float)vy;
+        out_bodies[i].velocity.z = (float)vz;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        out_bodies[i].position_and_radius.x += out_bodies[i].velocity.x * (float)delta_time;
+        out_bodies[i].position_and_radius.y += out_bodies[i].velocity.y * (float)delta_time;
+        out_bodies[i].position_and_radius.z += out_bodies[i].velocity.z * (float)delta_time;
+    }
+
+    // contacts at the new positions, found and handled separately from gravity
+    if (mode == COLLISION_OFF)
+        return;
+    int pair_count = collision_find_pairs(broadphase, out_bodies, count);
+    collision_resolve(out_bodies, broadphase->pairs, pair_count, mode);
+}
@@ -0,0 +1,229 @@
+/**
+sky background: procedural star bake, panorama loading and cpu lookups of the cubemap
+**/
+
+#include "starfield.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// fraction of texels that hold no star
+#define STARFIELD_STAR_DENSITY 0.995f
+
+// ------------------------------
+// helpers
+// ------------------------------
+
+static bool starfield_allocate(starfield_t *starfield, int face_size)
+{
+    *starfield = (starfield_t){0};
+    starfield->face_size = face_size;
+    for (int face = 0; face < STARFIELD_FACE_COUNT; ++face)
+    {
+        starfield->faces[face] = calloc((size_t)face_size * face_size, 4);
+        if (!starfield->faces[face])
+        {
+            starfield_destroy(starfield);
+            return false;
+        }
+    }
+    return true;
+}
+
+// direction through the centre of texel (x, y) of a face, following the gl cubemap table
+static vector3_t starfield_texel_direction(int face, int x, int y, int face_size)
+{
+    float s = 2.0f * (x + 0.5f) / face_size - 1.0f;
+    float t = 2.0f * (y + 0.5f) / face_size - 1.0f;
+    vector3_t d;
+    switch (face)
+    {
+    case STARFIELD_FACE_POSITIVE_X: d = (vector3_t){1.0f, -t, -s}; break;
+    case STARFIELD_FACE_NEGATIVE_X: d = (vector3_t){-1.0f, -t, s}; break;
+    case STARFIELD_FACE_POSITIVE_Y: d = (vector3_t){s, 1.0f, t}; break;
+    case STARFIELD_FACE_NEGATIVE_Y: d = (vector3_t){s, -1.0f, -t}; break;
+    case STARFIELD_FACE_POSITIVE_Z: d = (vector3_t){s, -t, 1.0f}; break;
+    default: d = (vector3_t){-s, -t, -1.0f}; break;
+    }
+    return vector3_normalize(d);
+}
+
+// integer hash to [0, 1); stable per texel, so the sky no longer sparkles under motion
+static float starfield_hash(uint32_t value)
+{
+    value ^= value >> 16;
+    value *= 0x7feb352du;
+    value ^= value >> 15;
+    value *= 0x846ca68bu;
+    value ^= value >> 16;
+    return (float)(value >> 8) / 16777216.0f;
+}
+
+// reads the next header integer of a ppm, skipping whitespace and comments
+static bool starfield_read_ppm_int(FILE *file, int *value)
+{
+    int c = fgetc(file);
+    while (c == '#' || c == ' ' || c == '\t' || c == '\n' || c == '\r')
+    {
+        if (c == '#')
+        {
+            while (c != '\n' && c != EOF)
+                c = fgetc(file);
+        }
+        c = fgetc(file);
+    }
+    if (c == EOF)
+        return false;
+    ungetc(c, file);
+    return fscanf(file, "%d", value) == 1;
+}
+
+// ------------------------------
+// public api
+// ------------------------------
+
+bool starfield_bake(starfield_t *starfield, int face_size)
+{
+    if (face_size < 1 || !starfield_allocate(starfield, face_size))
+        return false;
+
+    for (int face = 0; face < STARFIELD_FACE_COUNT; ++face)
+    {
+        unsigned char *texel = starfield->faces[face];
+        for (uint32_t i = 0; i < (uint32_t)face_size * face_size; ++i, texel += 4)
+        {
+            float r = starfield_hash(i * 6u + (uint32_t)face);
+            if (r > STARFIELD_STAR_DENSITY)
+            {
+                unsigned char brightness = (unsigned char)(255.0f * (r - STARFIELD_STAR_DENSITY) / (1.0f - STARFIELD_STAR_DENSITY));
+                texel[0] = texel[1] = texel[2] = brightness;
+                texel[3] = 255;
+            }
+        }
+    }
+    return true;
+}
+
+bool starfield_load_panorama(starfield_t *starfield, const char *path, int face_size)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        printf("Failed to open sky panorama %s\n", path);
+        return false;
+    }
+
+    int width = 0, height = 0, max_value = 0;
+    char magic[3] = {0};
+    bool ok = fread(magic, 1, 2, file) == 2 && strcmp(magic, "P6") == 0 && starfield_read_ppm_int(file, &width) &&
+              starfield_read_ppm_int(file, &height) && starfield_read_ppm_int(file, &max_value) &&
+              width > 0 && height > 0 && max_value == 255;
+    unsigned char *pixels = ok ? malloc((size_t)width * height * 3) : NULL;
+    ok = ok && pixels && fgetc(file) != EOF && fread(pixels, 3, (size_t)width * height, file) == (size_t)width * height;
+    fclose(file);
+
+    if (!ok || !starfield_allocate(starfield, face_size))
+    {
+        printf("Sky panorama %s is not an 8-bit binary ppm\n", path);
+        free(pixels);
+        return false;
+    }
+
+    // y is up in the scene; longitude wraps around it, row 0 of the panorama is the zenith
+    for (int face = 0; face < STARFIELD_FACE_COUNT; ++face)
+    {
+        unsigned char *texel = starfield->faces[face];
+        for (int y = 0; y < face_size; ++y)
+        {
+            for (int x = 0; x < face_size; ++x, texel += 4)
+            {
+                vector3_t d = starfield_texel_direction(face, x, y, face_size);
+                float u = (0.5f + atan2f(d.z, d.x) / (2.0f * (float)M_PI)) * width - 0.5f;
+                float v = (0.5f - asinf(utility_clamp_float(d.y, -1.0f, 1.0f)) / (float)M_PI) * height - 0.5f;
+                int x0 = (int)floorf(u), y0 = (int)floorf(v);
+                float fx = u - x0, fy = v - y0;
+
+                for (int channel = 0; channel < 3; ++channel)
+                {
+                    float sum = 0.0f;
+                    for (int corner = 0; corner < 4; ++corner)
+                    {
+                        int px = ((x0 + (corner & 1)) % width + width) % width;
+                        int py = y0 + (corner >> 1);
+                        py = py < 0 ? 0 : (py >= height ? height - 1 : py);
+                        float weight = ((corner & 1) ? fx : 1.0f - fx) * ((corner >> 1) ? fy : 1.0f - fy);
+                        sum += weight * pixels[((size_t)py * width + px) * 3 + channel];
+                    }
+                    texel[channel] = (unsigned char)(sum + 0.5f);
+                }
+                texel[3] = 255; // a panorama is opaque and hides the grid behind the sky
+            }
+        }
+    }
+
+    free(pixels);
+    printf("[INFO] Loaded %d x %d sky panorama from %s\n", width, height, path);
+    return true;
+}
+
+vector4_t starfield_sample(const starfield_t *starfield, vector3_t direction)
+{
+    float ax = fabsf(direction.x), ay = fabsf(direction.y), az = fabsf(direction.z);
+    int face;
+    float sc, tc, ma;
+    if (ax >= ay && ax >= az)
+    {
+        face = direction.x >= 0.0f ? STARFIELD_FACE_POSITIVE_X : STARFIELD_FACE_NEGATIVE_X;
+        sc = direction.x >= 0.0f ? -direction.z : direction.z;
+        tc = -direction.y;
+        ma = ax;
+    }
+    else if (ay >= az)
+    {
+        face = direction.y >= 0.0f ? STARFIELD_FACE_POSITIVE_Y : STARFIELD_FACE_NEGATIVE_Y;
+        sc = direction.x;
+        tc = direction.y >= 0.0f ? direction.z : -direction.z;
+        ma = ay;
+    }
+    else
+    {
+        face = direction.z >= 0.0f ? STARFIELD_FACE_POSITIVE_Z : STARFIELD_FACE_NEGATIVE_Z;
+        sc = direction.z >= 0.0f ? direction.x : -direction.x;
+        tc = -direction.y;
+        ma = az;
+    }
+    if (ma <= 0.0f || !starfield->faces[face])
+        return (vector4_t){0.0f, 0.0f, 0.0f, 0.0f};
+
+    // clamp to the face edge like GL_CLAMP_TO_EDGE (no seamless filtering on the cpu)
+    int size = starfield->face_size;
+    float u = (0.5f * (sc / ma + 1.0f)) * size - 0.5f;
+    float v = (0.5f * (tc / ma + 1.0f)) * size - 0.5f;
+    u = utility_clamp_float(u, 0.0f, (float)(size - 1));
+    v = utility_clamp_float(v, 0.0f, (float)(size - 1));
+    int x0 = (int)u, y0 = (int)v;
+    int x1 = x0 + 1 < size ? x0 + 1 : x0, y1 = y0 + 1 < size ? y0 + 1 : y0;
+    float fx = u - x0, fy = v - y0;
+
+    const unsigned char *texels = starfield->faces[face];
+    float result[4];
+    for (int channel = 0; channel < 4; ++channel)
+    {
+        float top = texels[((size_t)y0 * size + x0) * 4 + channel] * (1.0f - fx) + texels[((size_t)y0 * size + x1) * 4 + channel] * fx;
+        float bottom = texels[((size_t)y1 * size + x0) * 4 + channel] * (1.0f - fx) + texels[((size_t)y1 * size + x1) * 4 + channel] * fx;
+        result[channel] = (top * (1.0f - fy) + bottom * fy) / 255.0f;
+    }
+    return (vector4_t){result[0], result[1], result[2], result[3]};
+}
+
+void starfield_destroy(starfield_t *starfield)
+{
+    for (int face = 0; face < STARFIELD_FACE_COUNT; ++face)
+    {
+        free(starfield->faces[face]);
+        starfield->faces[face] = NULL;
+    }
+    starfield->face_size = 0;
+}
@@ -0,0 +1,654 @@
+/**
+frame streaming server: a one-frame mailbox filled by the render loop, and a thread that
+detects dirty tiles, encodes them and serves the clients without blocking on any of them
+**/
+
+#define _GNU_SOURCE
+
+#include "stream.h"
+#include "net.h"
+#include "rle.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// frames whose capture time is kept for the latency of late acks
+#define STREAM_CAPTURE_HISTORY 256
+
+typedef struct
+{
+    int fd; // -1 when the slot is free
+    net_buffer_t input;
+    unsigned char *output; // the frame being sent
+    size_t output_size, output_sent, output_capacity;
+    int in_flight;       // frames sent and not acked yet
+    bool needs_keyframe; // joined, or skipped a frame and can't apply deltas
+    int catch_up_frame;  // latest frame resent after catching up; its ack isn't a latency sample
+    long frames_sent, frames_dropped, catch_ups;
+    long long bytes_sent;
+} stream_client_t;
+
+// an encoded frame message, net header included
+typedef struct
+{
+    unsigned char *data;
+    size_t size, capacity;
+} stream_message_t;
+
+struct stream_server
+{
+    char address[256];
+    int listen_fd;
+    int wake[2]; // a byte per submitted frame or stop request
+    pthread_t thread;
+
+    // mailbox, guarded by mutex
+    pthread_mutex_t mutex;
+    unsigned char *pending;
+    size_t pending_capacity;
+    int pending_width, pending_height, pending_frame;
+    double pending_time;
+    bool has_pending, stopping;
+    long submitted, replaced;
+
+    // server thread only
+    unsigned char *rgba; // the frame taken from the mailbox
+    size_t rgba_capacity;
+    unsigned char *current, *latest; // rgb rows top-down: the frame being served and the one before
+    int width, height, tiles_x, tiles_y;
+    int latest_frame;
+    bool has_latest;
+    unsigned char *tile_rgb;
+    stream_message_t delta, keyframe;
+    int keyframe_frame; // frame the keyframe message holds, -1 if none
+    stream_client_t clients[STREAM_MAX_CLIENTS];
+    int capture_frames[STREAM_CAPTURE_HISTORY];
+    double capture_times[STREAM_CAPTURE_HISTORY];
+
+    // statistics
+    long frames_encoded, delta_frames, keyframes_encoded, clients_served, dirty_tiles, total_tiles;
+    double encode_seconds, encode_seconds_max;
+    long long delta_bytes, keyframe_bytes;
+    float latency[STREAM_LATENCY_SAMPLES];
+    long latency_count;
+};
+
+// ------------------------------
+// encoding
+// ------------------------------
+
+static bool stream_reserve(unsigned char **data, size_t *capacity, size_t size)
+{
+    if (size <= *capacity)
+        return true;
+    unsigned char *grown = realloc(*data, size);
+    if (!grown)
+        return false;
+    *data = grown;
+    *capacity = size;
+    return true;
+}
+
+static bool stream_tile_dirty(const stream_server_t *s, const unsigned char *pixels, const unsigned char *reference,
+                              int x, int y, int width, int height)
+{
+    for (int row = 0; row < height; ++row)
+    {
+        size_t offset = ((size_t)(y + row) * s->width + x) * 3;
+        if (memcmp(pixels + offset, reference + offset, (size_t)width * 3) != 0)
+            return true;
+    }
+    return false;
+}
+
+// builds the frame message of pixels: the tiles that differ from reference, or every tile without one
+static bool stream_encode(stream_server_t *s, int frame_index, const unsigned char *pixels,
+                          const unsigned char *reference, stream_message_t *message)
+{
+    int tile_count = s->tiles_x * s->tiles_y;
+    size_t bound = sizeof(net_header_t) + sizeof(stream_frame_header_t) + sizeof(stream_tile_t) * (size_t)tile_count +
+                   RLE_MAX_ENCODED_SIZE((size_t)s->width * s->height);
+    if (!stream_reserve(&message->data, &message->capacity, bound))
+        return false;
+
+    size_t size = sizeof(net_header_t) + sizeof(stream_frame_header_t);
+    uint32_t encoded = 0;
+    for (int tile = 0; tile < tile_count; ++tile)
+    {
+        int x = (tile % s->tiles_x) * STREAM_TILE_SIZE, y = (tile / s->tiles_x) * STREAM_TILE_SIZE;
+        int width = x + STREAM_TILE_SIZE <= s->width ? STREAM_TILE_SIZE : s->width - x;
+        int height = y + STREAM_TILE_SIZE <= s->height ? STREAM_TILE_SIZE : s->height - y;
+        if (reference && !stream_tile_dirty(s, pixels, reference, x, y, width, height))
+            continue;
+
+        for (int row = 0; row < height; ++row)
+        {
+            memcpy(s->tile_rgb + (size_t)row * width * 3, pixels + ((size_t)(y + row) * s->width + x) * 3,
+                   (size_t)width * 3);
+        }
+        stream_tile_t record = {(uint32_t)tile, 0};
+        record.encoded_size =
+            (uint32_t)rle_encode_rgb(s->tile_rgb, width * height, message->data + size + sizeof(stream_tile_t));
+        memcpy(message->data + size, &record, sizeof(record));
+        size += sizeof(record) + record.encoded_size;
+        ++encoded;
+    }
+
+    stream_frame_header_t header = {frame_index, s->width, s->height, STREAM_TILE_SIZE, encoded, reference ? 0u : 1u};
+    net_header_t net = {STREAM_MESSAGE_FRAME, (uint32_t)(size - sizeof(net_header_t))};
+    memcpy(message->data, &net, sizeof(net));
+    memcpy(message->data + sizeof(net), &header, sizeof(header));
+    message->size = size;
+    return true;
+}
+
+// the latest frame as a keyframe, encoded once however many clients need it
+static const stream_message_t *stream_keyframe(stream_server_t *s)
+{
+    if (s->keyframe_frame != s->latest_frame)
+    {
+        if (!stream_encode(s, s->latest_frame, s->latest, NULL, &s->keyframe))
+            return NULL;
+        s->keyframe_frame = s->latest_frame;
+        ++s->keyframes_encoded;
+        s->keyframe_bytes += (long long)s->keyframe.size;
+    }
+    return &s->keyframe;
+}
+
+// ------------------------------
+// clients
+// ------------------------------
+
+static void stream_drop_client(stream_client_t *client)
+{
+    close(client->fd);
+    client->fd = -1;
+    net_buffer_free(&client->input);
+    free(client->output);
+    client->output = NULL;
+    client->output_capacity = 0;
+}
+
+// the client has sent everything and acked enough to take another frame
+static bool stream_client_ready(const stream_client_t *client)
+{
+    return client->fd >= 0 && client->output_sent == client->output_size && client->in_flight < STREAM_MAX_IN_FLIGHT;
+}
+
+// sends what the socket takes without blocking
+static void stream_flush(stream_client_t *client)
+{
+    while (client->output_sent < client->output_size)
+    {
+        ssize_t sent = send(client->fd, client->output + client->output_sent, client->output_size - client->output_sent,
+                            MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent > 0)
+        {
+            client->output_sent += (size_t)sent;
+            client->bytes_sent += sent;
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return;
+        stream_drop_client(client);
+        return;
+    }
+}
+
+static void stream_queue(stream_client_t *client, const stream_message_t *message, bool catch_up)
+{
+    if (!message || !stream_reserve(&client->output, &client->output_capacity, message->size))
+    {
+        stream_drop_client(client);
+        return;
+    }
+    memcpy(client->output, message->data, message->size);
+    client->output_size = message->size;
+    client->output_sent = 0;
+    client->needs_keyframe = false;
+    ++client->in_flight;
+    ++client->frames_sent;
+    stream_frame_header_t header;
+    memcpy(&header, message->data + sizeof(net_header_t), sizeof(header));
+    client->catch_up_frame = catch_up ? header.frame_index : -1;
+    client->catch_ups += catch_up;
+    stream_flush(client);
+}
+
+// a client that joined or skipped frames gets the latest frame as soon as it can take one,
+// so it doesn't wait for (or, with an idle renderer, never see) the next frame
+static void stream_catch_up(stream_server_t *s, stream_client_t *client)
+{
+    if (s->has_latest && client->needs_keyframe && stream_client_ready(client))
+        stream_queue(client, stream_keyframe(s), true);
+}
+
+static void stream_accept(stream_server_t *s)
+{
+    int fd = accept(s->listen_fd, NULL, NULL);
+    if (fd < 0)
+        return;
+    for (int i = 0; i < STREAM_MAX_CLIENTS; ++i)
+    {
+        stream_client_t *client = &s->clients[i];
+        if (client->fd >= 0)
+            continue;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        *client = (stream_client_t){.fd = fd, .needs_keyframe = true, .catch_up_frame = -1};
+        ++s->clients_served;
+        printf("[INFO] Stream client %d connected\n", i);
+        stream_catch_up(s, client);
+        return;
+    }
+    printf("[INFO] Stream client refused: %d clients already\n", STREAM_MAX_CLIENTS);
+    close(fd);
+}
+
+static void stream_read_acks(stream_server_t *s, stream_client_t *client)
+{
+    if (!net_receive(&client->input, client->fd, false, NULL))
+    {
+        printf("[INFO] Stream client %d disconnected\n", (int)(client - s->clients));
+        stream_drop_client(client);
+        return;
+    }
+    net_header_t header;
+    const unsigned char *payload;
+    bool corrupt;
+    double now = net_now();
+    while (net_next_message(&client->input, &header, &payload, &corrupt))
+    {
+        if (header.type != STREAM_MESSAGE_ACK || header.length != sizeof(stream_ack_t))
+            continue;
+        stream_ack_t ack;
+        memcpy(&ack, payload, sizeof(ack));
+        client->in_flight -= client->in_flight > 0;
+        int slot = (int)((unsigned)ack.frame_index % STREAM_CAPTURE_HISTORY);
+        if (ack.frame_index != client->catch_up_frame && s->capture_frames[slot] == ack.frame_index)
+            s->latency[s->latency_count++ % STREAM_LATENCY_SAMPLES] = (float)(now - s->capture_times[slot]);
+    }
+    if (corrupt)
+    {
+        stream_drop_client(client);
+        return;
+    }
+    stream_catch_up(s, client);
+}
+
+// ------------------------------
+// server thread
+// ------------------------------
+
+// converts the taken frame, encodes it once as a delta (and as a keyframe if a client needs
+// one) and queues it on every ready client; the others skip it
+static void stream_serve_frame(stream_server_t *s, int width, int height, int frame_index, double capture_time)
+{
+    double start = net_now();
+    if (width != s->width || height != s->height)
+    {
+        size_t size = (size_t)width * height * 3;
+        free(s->current);
+        free(s->latest);
+        s->current = malloc(size);
+        s->latest = malloc(size);
+        s->width = width;
+        s->height = height;
+        s->tiles_x = (width + STREAM_TILE_SIZE - 1) / STREAM_TILE_SIZE;
+        s->tiles_y = (height + STREAM_TILE_SIZE - 1) / STREAM_TILE_SIZE;
+        s->has_latest = false;
+        for (int i = 0; i < STREAM_MAX_CLIENTS; ++i)
+            s->clients[i].needs_keyframe = true;
+        if (!s->current || !s->latest)
+        {
+            printf("Failed to allocate the stream frames\n");
+            s->width = s->height = 0;
+            return;
+        }
+    }
+    // kept even without clients: whoever connects next starts from it
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char *src = s->rgba + (size_t)(height - 1 - y) * width * 4;
+        unsigned char *dst = s->current + (size_t)y * width * 3;
+        for (int x = 0; x < width; ++x)
+        {
+            dst[x * 3 + 0] = src[x * 4 + 0];
+            dst[x * 3 + 1] = src[x * 4 + 1];
+            dst[x * 3 + 2] = src[x * 4 + 2];
+        }
+    }
+    int slot = (int)((unsigned)frame_index % STREAM_CAPTURE_HISTORY);
+    s->capture_frames[slot] = frame_index;
+    s->capture_times[slot] = capture_time;
+
+    bool any_ready = false, need_delta = false;
+    for (int i = 0; i < STREAM_MAX_CLIENTS; ++i)
+    {
+        any_ready |= stream_client_ready(&s->clients[i]);
+        need_delta |= stream_client_ready(&s->clients[i]) && !s->clients[i].needs_keyframe;
+    }
+    bool ok = true;
+    if (need_delta && s->has_latest)
+    {
+        ok = stream_encode(s, frame_index, s->current, s->latest, &s->delta);
+        if (ok)
+        {
+            stream_frame_header_t header;
+            memcpy(&header, s->delta.data + sizeof(net_header_t), sizeof(header));
+            ++s->delta_frames;
+            s->delta_bytes += (long long)s->delta.size;
+            s->dirty_tiles += header.tile_count;
+            s->total_tiles += s->tiles_x * s->tiles_y;
+        }
+    }
+
+    unsigned char *swap = s->latest;
+    s->latest = s->current;
+    s->current = swap;
+    s->latest_frame = frame_index;
+    s->has_latest = true;
+
+    for (int i = 0; i < STREAM_MAX_CLIENTS && ok; ++i)
+    {
+        stream_client_t *client = &s->clients[i];
+        if (client->fd < 0)
+            continue;
+        if (!stream_client_ready(client))
+        {
+            // still busy with earlier frames: skip this one, and the deltas after it can't apply
+            ++client->frames_dropped;
+            client->needs_keyframe = true;
+            continue;
+        }
+        stream_queue(client, client->needs_keyframe ? stream_keyframe(s) : &s->delta, false);
+    }
+    if (!ok)
+        printf("Failed to encode stream frame %d\n", frame_index);
+
+    if (any_ready)
+    {
+        double seconds = net_now() - start;
+        ++s->frames_encoded;
+        s->encode_seconds += seconds;
+        s->encode_seconds_max = seconds > s->encode_seconds_max ? seconds : s->encode_seconds_max;
+    }
+}
+
+static void *stream_thread(void *data)
+{
+    stream_server_t *s = data;
+    for (;;)
+    {
+        struct pollfd fds[STREAM_MAX_CLIENTS + 2];
+        int polled[STREAM_MAX_CLIENTS + 2];
+        int count = 0;
+        fds[count++] = (struct pollfd){.fd = s->wake[0], .events = POLLIN};
+        fds[count++] = (struct pollfd){.fd = s->listen_fd, .events = POLLIN};
+        for (int i = 0; i < STREAM_MAX_CLIENTS; ++i)
+        {
+            stream_client_t *client = &s->clients[i];
+            if (client->fd < 0)
+                continue;
+            polled[count] = i;
+            fds[count++] = (struct pollfd){
+                .fd = client->fd, .events = POLLIN | (client->output_sent < client->output_size ? POLLOUT : 0)};
+        }
+        poll(fds, (nfds_t)count, -1);
+
+        if (fds[1].revents & POLLIN)
+            stream_accept(s);
+        for (int i = 2; i < count; ++i)
+        {
+            stream_client_t *client = &s->clients[polled[i]];
+            if (client->fd >= 0 && (fds[i].revents & POLLOUT))
+                stream_flush(client);
+            if (client->fd >= 0 && (fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                stream_read_acks(s, client);
+        }
+
+        if (!(fds[0].revents & POLLIN))
+            continue;
+        char drain[64];
+        while (read(s->wake[0], drain, sizeof(drain)) == (ssize_t)sizeof(drain))
+        {
+        }
+
+        pthread_mutex_lock(&s->mutex);
+        if (s->stopping)
+        {
+            pthread_mutex_unlock(&s->mutex);
+            return NULL;
+        }
+        bool has_frame = s->has_pending;
+        int width = s->pending_width, height = s->pending_height, frame_index = s->pending_frame;
+        double capture_time = s->pending_time;
+        if (has_frame)
+        {
+            // take the pending pixels by swapping buffers; the render thread fills the other one next
+            unsigned char *buffer = s->rgba;
+            size_t capacity = s->rgba_capacity;
+            s->rgba = s->pending;
+            s->rgba_capacity = s->pending_capacity;
+            s->pending = buffer;
+            s->pending_capacity = capacity;
+            s->has_pending = false;
+        }
+        pthread_mutex_unlock(&s->mutex);
+
+        if (has_frame)
+            stream_serve_frame(s, width, height, frame_index, capture_time);
+    }
+}
+
+// ------------------------------
+// public functions
+// ------------------------------
+
+stream_server_t *stream_server_start(const char *address)
+{
+    stream_server_t *s = calloc(1, sizeof(stream_server_t));
+    if (!s)
+        return NULL;
+    snprintf(s->address, sizeof(s->address), "%s", address);
+    s->tile_rgb = malloc((size_t)STREAM_TILE_SIZE * STREAM_TILE_SIZE * 3);
+    for (int i = 0; i < STREAM_MAX_CLIENTS; ++i)
+        s->clients[i].fd = -1;
+    for (int i = 0; i < STREAM_CAPTURE_HISTORY; ++i)
+        s->capture_frames[i] = -1;
+    s->keyframe_frame = -1;
+
+    s->listen_fd = net_open(address, true);
+    if (s->listen_fd < 0 || !s->tile_rgb || pipe(s->wake) != 0)
+    {
+        printf("Failed to start the stream server on %s\n", address);
+        if (s->listen_fd >= 0)
+            close(s->listen_fd);
+        free(s->tile_rgb);
+        free(s);
+        return NULL;
+    }
+    fcntl(s->wake[0], F_SETFL, fcntl(s->wake[0], F_GETFL) | O_NONBLOCK);
+    fcntl(s->wake[1], F_SETFL, fcntl(s->wake[1], F_GETFL) | O_NONBLOCK);
+    pthread_mutex_init(&s->mutex, NULL);
+    if (pthread_create(&s->thread, NULL, stream_thread, s) != 0)
+    {
+        printf("Failed to start the stream server thread\n");
+        close(s->listen_fd);
+        close(s->wake[0]);
+        close(s->wake[1]);
+        pthread_mutex_destroy(&s->mutex);
+        free(s->tile_rgb);
+        free(s);
+        return NULL;
+    }
+    printf("[INFO] Streaming frames on %s\n", address);
+    return s;
+}
+
+void stream_server_submit(stream_server_t *s, const unsigned char *rgba, int width, int height, int frame_index,
+                          double capture_time)
+{
+    size_t size = (size_t)width * height * 4;
+    pthread_mutex_lock(&s->mutex);
+    ++s->submitted;
+    if (s->has_pending)
+        ++s->replaced; // the server thread is behind: the newest frame wins
+    if (stream_reserve(&s->pending, &s->pending_capacity, size))
+    {
+        memcpy(s->pending, rgba, size);
+        s->pending_width = width;
+        s->pending_height = height;
+        s->pending_frame = frame_index;
+        s->pending_time = capture_time;
+        s->has_pending = true;
+    }
+    pthread_mutex_unlock(&s->mutex);
+    char byte = 0;
+    if (write(s->wake[1], &byte, 1) < 0)
+    {
+        // the pipe is full, so the thread is awake already
+    }
+}
+
+static int stream_compare_floats(const void *a, const void *b)
+{
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+static void stream_print_stats(const stream_server_t *s)
+{
+    printf("--- Stream (%s, %ld client(s) served) ---\n", s->address, s->clients_served);
+    printf("frames: %ld submitted, %ld replaced before encoding, %ld served, %ld keyframes encoded\n", s->submitted,
+           s->replaced, s->frames_encoded, s->keyframes_encoded);
+    if (s->frames_encoded > 0)
+    {
+        printf("encode: %.2f ms mean, %.2f ms max; %.1f%% of tiles dirty\n", 1e3 * s->encode_seconds / s->frames_encoded,
+               1e3 * s->encode_seconds_max, s->total_tiles ? 100.0 * s->dirty_tiles / s->total_tiles : 0.0);
+        printf("bytes per frame: %.1f KB delta, %.1f KB keyframe, %.1f KB raw rgb\n",
+               s->delta_frames > 0 ? s->delta_bytes / 1e3 / s->delta_frames : 0.0,
+               s->keyframes_encoded > 0 ? s->keyframe_bytes / 1e3 / s->keyframes_encoded : 0.0,
+               (double)s->width * s->height * 3 / 1e3);
+    }
+    long samples = s->latency_count < STREAM_LATENCY_SAMPLES ? s->latency_count : STREAM_LATENCY_SAMPLES;
+    if (samples > 0)
+    {
+        float sorted[STREAM_LATENCY_SAMPLES];
+        memcpy(sorted, s->latency, sizeof(float) * (size_t)samples);
+        qsort(sorted, (size_t)samples, sizeof(float), stream_compare_floats);
+        printf("latency (frame finished to client ack): %.2f ms median, %.2f ms p95, %.2f ms max over %ld frames\n",
+               1e3 * sorted[samples / 2], 1e3 * sorted[(samples * 95) / 100], 1e3 * sorted[samples - 1], samples);
+    }
+    for (int i = 0; i < STREAM_MAX_CLIENTS; ++i)
+    {
+        const stream_client_t *client = &s->clients[i];
+        if (client->frames_sent + client->frames_dropped == 0)
+            continue;
+        printf("client %d: %ld frames sent (%ld catching up), %ld skipped, %.2f MB\n", i, client->frames_sent,
+               client->catch_ups, client->frames_dropped, client->bytes_sent / 1e6);
+    }
+}
+
+void stream_server_stop(stream_server_t *s)
+{
+    if (!s)
+        return;
+    pthread_mutex_lock(&s->mutex);
+    s->stopping = true;
+    pthread_mutex_unlock(&s->mutex);
+    char byte = 0;
+    if (write(s->wake[1], &byte, 1) < 0)
+    {
+        // the pipe is full, so the thread wakes up anyway
+    }
+    pthread_join(s->thread, NULL);
+
+    stream_print_stats(s);
+    for (int i = 0; i < STREAM_MAX_CLIENTS; ++i)
+    {
+        if (s->clients[i].fd >= 0)
+            stream_drop_client(&s->clients[i]);
+    }
+    close(s->listen_fd);
+    net_release(s->address);
+    close(s->wake[0]);
+    close(s->wake[1]);
+    pthread_mutex_destroy(&s->mutex);
+    free(s->pending);
+    free(s->rgba);
+    free(s->current);
+    free(s->latest);
+    free(s->tile_rgb);
+    free(s->delta.data);
+    free(s->keyframe.data);
+    free(s);
+}
+
+bool stream_view_apply(stream_view_t *view, const unsigned char *payload, uint32_t length)
+{
+    stream_frame_header_t header;
+    if (length < sizeof(header))
+        return false;
+    memcpy(&header, payload, sizeof(header));
+    if (header.width <= 0 || header.height <= 0 || header.tile_size <= 0)
+        return false;
+    if (header.width != view->width || header.height != view->height)
+    {
+        if (!header.keyframe)
+            return false; // a delta against pixels the view doesn't have
+        free(view->rgb);
+        view->rgb = malloc((size_t)header.width * header.height * 3);
+        if (!view->rgb)
+            return false;
+        view->width = header.width;
+        view->height = header.height;
+    }
+
+    int tiles_x = (header.width + header.tile_size - 1) / header.tile_size;
+    int tiles_y = (header.height + header.tile_size - 1) / header.tile_size;
+    unsigned char *tile_rgb = malloc((size_t)header.tile_size * header.tile_size * 3);
+    size_t offset = sizeof(header);
+    bool ok = tile_rgb != NULL;
+    for (uint32_t i = 0; ok && i < header.tile_count; ++i)
+    {
+        stream_tile_t record;
+        ok = length - offset >= sizeof(record);
+        if (!ok)
+            break;
+        memcpy(&record, payload + offset, sizeof(record));
+        offset += sizeof(record);
+        ok = record.tile < (uint32_t)(tiles_x * tiles_y) && length - offset >= record.encoded_size;
+        if (!ok)
+            break;
+        int x = (int)(record.tile % tiles_x) * header.tile_size, y = (int)(record.tile / tiles_x) * header.tile_size;
+        int width = x + header.tile_size <= header.width ? header.tile_size : header.width - x;
+        int height = y + header.tile_size <= header.height ? header.tile_size : header.height - y;
+        ok = rle_decode_rgb(payload + offset, record.encoded_size, tile_rgb, width * height);
+        for (int row = 0; ok && row < height; ++row)
+        {
+            memcpy(view->rgb + ((size_t)(y + row) * header.width + x) * 3, tile_rgb + (size_t)row * width * 3,
+                   (size_t)width * 3);
+        }
+        offset += record.encoded_size;
+    }
+    free(tile_rgb);
+    if (ok)
+    {
+        view->frame_index = header.frame_index;
+        view->keyframe = header.keyframe != 0;
+    }
+    return ok;
+}
+
+void stream_view_free(stream_view_t *view)
+{
+    free(view->rgb);
+    *view = (stream_view_t){0};
+}
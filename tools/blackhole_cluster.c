@@ -0,0 +1,186 @@
+/**
+renders frame sequences of the app's scene on the cpu across processes and machines. the
+coordinator owns the sequence (the physics of the app stepped once per frame and a camera
+orbiting the hole) and hands out tiles; workers connect, render and send them back.
+
+usage: blackhole_cluster coordinator --listen ADDRESS [--spawn N] [--size WxH] [--frames N]
+                         [--first-frame N] [--tile N] [--depth N] [--timeout S] [--output PREFIX]
+                         [--steps N] [--step-size S] [--integrator spherical|cartesian] [--orbit RADIANS]
+       blackhole_cluster worker --connect ADDRESS [--fail-after N] [--stall-after N]
+
+ADDRESS is unix:PATH or HOST:PORT. on one machine, --spawn forks local workers:
+  blackhole_cluster coordinator --listen unix:/tmp/bh.sock --spawn 4 --frames 8 --output frame_
+**/
+
+#include "cluster.h"
+#include "simulation.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the app's physics step: PHYSICS_SIM_SPEED / PHYSICS_STEP_HZ simulated seconds, one per 60 fps frame
+#define SEQUENCE_STEP_SECONDS (500.0 / 60.0)
+#define SEQUENCE_FPS 60.0
+
+// the frames the coordinator renders, generated in order
+typedef struct
+{
+    celestial_body_t bodies[SIMULATION_INITIAL_BODY_COUNT];
+    collision_broadphase_t broadphase;
+    int frame; // frame the bodies belong to
+    float orbit; // camera azimuth change per frame
+    int width, height;
+    raytracer_integrator_t integrator;
+    int max_steps;
+    float step_size;
+} sequence_t;
+
+// the app's initial scene
+static void sequence_init(sequence_t *sequence)
+{
+    memcpy(sequence->bodies, simulation_initial_bodies, sizeof(simulation_initial_bodies));
+    sequence->frame = 0;
+}
+
+static bool sequence_scene(int frame, cpu_render_frame_t *scene, void *user)
+{
+    sequence_t *sequence = user;
+    if (frame < sequence->frame)
+        return false; // frames are asked for in order
+    while (sequence->frame < frame)
+    {
+        simulation_step_buffered(sequence->bodies, sequence->bodies, SIMULATION_INITIAL_BODY_COUNT, SEQUENCE_STEP_SECONDS,
+                                 COLLISION_OFF, &sequence->broadphase);
+        ++sequence->frame;
+    }
+
+    camera_t cam = initial_camera_state;
+    cam.azimuth += sequence->orbit * (float)frame;
+    *scene = (cpu_render_frame_t){
+        .time = (float)(frame / SEQUENCE_FPS),
+        .integrator = sequence->integrator,
+        .max_steps = sequence->max_steps,
+        .step_size = sequence->step_size,
+    };
+    cpu_render_set_camera(scene, &cam, sequence->width, sequence->height);
+    cpu_render_set_scene(scene, SIMULATION_SCHWARZSCHILD_RADIUS, sequence->bodies, SIMULATION_INITIAL_BODY_COUNT);
+    return true;
+}
+
+static void usage(const char *program)
+{
+    printf("usage: %s coordinator --listen ADDRESS [--spawn N] [--size WxH] [--frames N] [--first-frame N]\n"
+           "       [--tile N] [--depth N] [--timeout S] [--output PREFIX] [--steps N] [--step-size S]\n"
+           "       [--integrator spherical|cartesian] [--orbit RADIANS]\n",
+           program);
+    printf("       %s worker --connect ADDRESS [--fail-after N] [--stall-after N]\n", program);
+}
+
+static int run_worker(int argc, char **argv)
+{
+    const char *address = NULL;
+    cluster_worker_options_t options = {0};
+    bool valid = true;
+    for (int i = 2; i < argc && valid; ++i)
+    {
+        if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc)
+            address = argv[++i];
+        else if (strcmp(argv[i], "--fail-after") == 0 && i + 1 < argc)
+            options.fail_after = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stall-after") == 0 && i + 1 < argc)
+            options.stall_after = atoi(argv[++i]);
+        else
+            valid = false;
+    }
+    if (!valid || !address)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    return cluster_work(address, &options) ? 0 : 1;
+}
+
+static int run_coordinator(int argc, char **argv)
+{
+    sequence_t *sequence = calloc(1, sizeof(sequence_t));
+    if (!sequence)
+        return 1;
+    sequence_init(sequence);
+    sequence->width = 640;
+    sequence->height = 360;
+    // the interactive quality preset: a quarter of the full step budget at four times the step
+    sequence->integrator = RAYTRACER_INTEGRATOR_SPHERICAL_EULER;
+    sequence->max_steps = 6500;
+    sequence->step_size = 2e8f;
+    sequence->orbit = 0.01f;
+
+    cluster_config_t config = {
+        .tile_size = CLUSTER_DEFAULT_TILE_SIZE,
+        .frame_count = 1,
+        .queue_depth = CLUSTER_DEFAULT_QUEUE_DEPTH,
+        .timeout = CLUSTER_DEFAULT_TIMEOUT,
+        .scene = sequence_scene,
+        .scene_user = sequence,
+    };
+    bool valid = true;
+    for (int i = 2; i < argc && valid; ++i)
+    {
+        if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc)
+            config.address = argv[++i];
+        else if (strcmp(argv[i], "--spawn") == 0 && i + 1 < argc)
+            config.spawn_workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+            valid = sscanf(argv[++i], "%dx%d", &sequence->width, &sequence->height) == 2;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            config.frame_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--first-frame") == 0 && i + 1 < argc)
+            config.first_frame = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc)
+            config.tile_size = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            config.queue_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc)
+            config.timeout = atof(argv[++i]);
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            config.output_prefix = argv[++i];
+        else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc)
+            sequence->max_steps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--step-size") == 0 && i + 1 < argc)
+            sequence->step_size = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--integrator") == 0 && i + 1 < argc)
+        {
+            const char *name = argv[++i];
+            sequence->integrator =
+                strcmp(name, "cartesian") == 0 ? RAYTRACER_INTEGRATOR_CARTESIAN : RAYTRACER_INTEGRATOR_SPHERICAL_EULER;
+            valid = strcmp(name, "cartesian") == 0 || strcmp(name, "spherical") == 0;
+        }
+        else if (strcmp(argv[i], "--orbit") == 0 && i + 1 < argc)
+            sequence->orbit = (float)atof(argv[++i]);
+        else
+            valid = false;
+    }
+    config.width = sequence->width;
+    config.height = sequence->height;
+    if (!valid || !config.address || config.first_frame < 0 || sequence->width <= 0 || sequence->height <= 0 ||
+        sequence->max_steps < 1 || sequence->step_size <= 0.0f)
+    {
+        usage(argv[0]);
+        free(sequence);
+        return 1;
+    }
+
+    bool ok = cluster_coordinate(&config);
+    collision_destroy(&sequence->broadphase);
+    free(sequence);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "coordinator") == 0)
+        return run_coordinator(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "worker") == 0)
+        return run_worker(argc, argv);
+    usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,135 @@
+/**
+viewer of the app's --stream server: connects, applies every frame to its copy of the
+picture and acks it, so the server can measure end-to-end latency. prints what it received.
+
+usage: stream_client --connect ADDRESS [--frames N] [--output FILE.ppm] [--delay MS]
+
+--delay sleeps after each frame to play a slow viewer; the server should skip frames for it
+instead of slowing down the others. e.g. next to ./main --headless --frames 600 --stream unix:/tmp/bh.sock:
+  stream_client --connect unix:/tmp/bh.sock --output last.ppm
+**/
+
+#define _GNU_SOURCE
+
+#include "net.h"
+#include "stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// seconds to keep retrying while the server starts up
+#define CLIENT_CONNECT_RETRY 5.0
+
+static void usage(const char *program)
+{
+    printf("usage: %s --connect ADDRESS [--frames N] [--output FILE.ppm] [--delay MS]\n", program);
+}
+
+static bool write_ppm(const stream_view_t *view, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        printf("Failed to open %s\n", path);
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", view->width, view->height);
+    bool ok = fwrite(view->rgb, 3, (size_t)view->width * view->height, file) == (size_t)view->width * view->height;
+    return fclose(file) == 0 && ok;
+}
+
+int main(int argc, char **argv)
+{
+    const char *address = NULL, *output = NULL;
+    int frame_limit = 0;
+    double delay = 0.0;
+    bool valid = true;
+    for (int i = 1; i < argc && valid; ++i)
+    {
+        if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc)
+            address = argv[++i];
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frame_limit = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else if (strcmp(argv[i], "--delay") == 0 && i + 1 < argc)
+            delay = atof(argv[++i]) * 1e-3;
+        else
+            valid = false;
+    }
+    if (!valid || !address || frame_limit < 0 || delay < 0.0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int fd = -1;
+    double deadline = net_now() + CLIENT_CONNECT_RETRY;
+    while ((fd = net_open(address, false)) < 0 && net_now() < deadline)
+        usleep(50000);
+    if (fd < 0)
+    {
+        printf("Failed to connect to %s\n", address);
+        return 1;
+    }
+
+    stream_view_t view = {0};
+    net_buffer_t input = {0};
+    long frames = 0, keyframes = 0, skipped = 0;
+    long long bytes = 0;
+    double decode_seconds = 0.0, start = net_now();
+    int last_frame = -1;
+    bool ok = true;
+    while (ok && (frame_limit == 0 || frames < frame_limit))
+    {
+        size_t received;
+        if (!net_receive(&input, fd, true, &received))
+            break; // the server stopped
+        bytes += (long long)received;
+
+        net_header_t header;
+        const unsigned char *payload;
+        bool corrupt;
+        while (ok && net_next_message(&input, &header, &payload, &corrupt))
+        {
+            if (header.type != STREAM_MESSAGE_FRAME)
+                continue;
+            double decode_start = net_now();
+            ok = stream_view_apply(&view, payload, header.length);
+            decode_seconds += net_now() - decode_start;
+            if (!ok)
+            {
+                printf("Failed to apply a stream frame\n");
+                break;
+            }
+            stream_ack_t ack = {view.frame_index};
+            ok = net_send_message(fd, STREAM_MESSAGE_ACK, &ack, sizeof(ack));
+            ++frames;
+            keyframes += view.keyframe;
+            if (last_frame >= 0 && view.frame_index > last_frame + 1)
+                skipped += view.frame_index - last_frame - 1;
+            last_frame = view.frame_index;
+            if (delay > 0.0)
+                usleep((useconds_t)(delay * 1e6));
+        }
+        ok = ok && !corrupt;
+    }
+    double seconds = net_now() - start;
+    close(fd);
+
+    printf("--- Stream client (%s) ---\n", address);
+    printf("%ld frames (%ld keyframes) in %.2f s, %ld frames skipped by the server\n", frames, keyframes, seconds,
+           skipped);
+    if (frames > 0)
+    {
+        printf("%.1f KB per frame, %.2f ms decode per frame, %dx%d, last frame %d\n", bytes / 1e3 / frames,
+               1e3 * decode_seconds / frames, view.width, view.height, view.frame_index);
+    }
+    if (output && frames > 0)
+        ok = write_ppm(&view, output) && ok;
+    net_buffer_free(&input);
+    stream_view_free(&view);
+    return ok ? 0 : 1;
+}